@@ -13,9 +13,28 @@ Version 1.3
 #include "MidiCC.h"
 #include "Constants.h"
 #include "Parameters.h"
+//#define PATCHBANK_IN_PSRAM  //Hold the patch bank in PSRAM instead of RAM2
+//#define PATCH_TIMING        //Print program change recall time on Serial
+//#define SCHEDULER_REPORT    //Print task CPU share and overruns on Serial every 5s
+//#define LOOP_PROFILER       //Per-stage cycle timing, "prof" and "prof reset" on the USB serial
+//#define POT_LATENCY         //Pot to DAC latency probes, "pot sweep N", "pot reset" and "pot" on the USB serial
+//#define POT_LATENCY_PIN 39  //Toggled at each probe stage for a scope, check the pin is spare on the board first
+#include "Profiler.h"
+#include "PotLatency.h"
+#include "FlightRecorder.h"
 #include "PatchMgr.h"
+#include "StorageWorker.h"
+//#define VOICE_I2C_DELTA    //Only the changed values to the voice board over I2C, needs voice firmware that takes delta frames
+#include "VoiceI2C.h"
+//#define VOICE_LINK_BINARY  //Framed 16 bit parameters to the voice boards instead of CCs and I2C, needs matching voice firmware
+#include "VoiceLink.h"
 #include "HWControls.h"
 #include "EepromMgr.h"
+#include "VoiceAllocator.h"
+#include "NoteHandler.h"
+#include "CcDispatch.h"
+#include "ModMatrix.h"
+#include "MidiClock.h"
 #include "Settings.h"
 #include <RoxMux.h>
 #include <map>  // Include the map library
@@ -32,39 +51,23 @@ std::map<int, int> voiceAssignment;
 #define DELETEMSG 7      //Delete patch message page
 #define SETTINGS 8       //Settings page
 #define SETTINGSVALUE 9  //Settings page
+#define BROWSE 10        //Encoder patch browsing, recalled once the encoder settles
 
 unsigned int state = PARAMETER;
 
-uint32_t int_ref_on_flexible_mode = 0b00001001000010100000000000000000;  // { 0000 , 1001 , 0000 , 1010000000000000 , 0000 }
+int browseFromPatch = 0;       //Patch to go back to if browsing is cancelled
+int browseDetents = 0;
+uint32_t browseLastDetent = 0;  //Scanner timestamp, micros
+unsigned long browseLastMove = 0;
+uint32_t browseReads = 0;      //storageReads when the gesture started
+bool browseReport = false;
 
-uint32_t sample_data1 = 0b00000000000000000000000000000000;
-uint32_t sample_data2 = 0b00000000000000000000000000000000;
-uint32_t sample_data3 = 0b00000000000000000000000000000000;
-uint32_t sample_data4 = 0b00000000000000000000000000000000;
-uint32_t channel_a = 0b00000010000000000000000000000000;
-uint32_t channel_b = 0b00000010000100000000000000000000;
-uint32_t channel_c = 0b00000010001000000000000000000000;
-uint32_t channel_d = 0b00000010001100000000000000000000;
-uint32_t channel_e = 0b00000010010000000000000000000000;
-uint32_t channel_f = 0b00000010010100000000000000000000;
-uint32_t channel_g = 0b00000010011000000000000000000000;
-uint32_t channel_h = 0b00000010011100000000000000000000;
+uint32_t int_ref_on_flexible_mode = 0b00001001000010100000000000000000;  // { 0000 , 1001 , 0000 , 1010000000000000 , 0000 }
 
 #include "ST7735Display.h"
 
 boolean cardStatus = false;
 
-struct VoiceAndNote {
-  int note;
-  int velocity;
-  long timeOn;
-  bool sustained;  // Sustain flag
-  bool keyDown;
-  double noteFreq;  // Note frequency
-  int position;
-  bool noteOn;
-};
-
 struct VoiceAndNote voices[NO_OF_VOICES] = {
   { -1, -1, 0, false, false, 0, -1, false },
   { -1, -1, 0, false, false, 0, -1, false },
@@ -78,8 +81,7 @@ struct VoiceAndNote voices[NO_OF_VOICES] = {
 
 boolean voiceOn[NO_OF_VOICES] = { false, false, false, false, false, false, false, false };
 int prevNote = 0;  //Initialised to middle value
-bool notes[128] = { 0 }, initial_loop = 1;
-int8_t noteOrder[40] = { 0 }, orderIndx = { 0 };
+bool initial_loop = 1;
 
 //USB HOST MIDI Class Compliant
 USBHost myusb;
@@ -89,12 +91,32 @@ MIDIDevice midi1(myusb);
 
 
 //MIDI 5 Pin DIN
-MIDI_CREATE_INSTANCE(HardwareSerial, Serial1, MIDI);   // main MIDI in and out
+struct DinMidiSettings : public midi::DefaultSettings, public midi::DefaultSerialSettings {
+  static const unsigned SysExMaxSize = 256;  //Room for a whole patch dump message
+};
+MIDI_CREATE_CUSTOM_INSTANCE(HardwareSerial, Serial1, MIDI, DinMidiSettings);  // main MIDI in and out
+#ifdef VOICE_LINK_BINARY
+struct VoiceLinkSettings : public midi::DefaultSettings {
+  static const long BaudRate = VOICE_LINK_BAUD;
+};
+MIDI_CREATE_CUSTOM_INSTANCE(HardwareSerial, Serial6, MIDI6, VoiceLinkSettings);  // MIDI and framed parameters to voices
+#else
 MIDI_CREATE_INSTANCE(HardwareSerial, Serial6, MIDI6);  // MIDI out to voices
+#endif
 MIDI_CREATE_INSTANCE(HardwareSerial, Serial7, MIDI7);  // MIDI out to display (not connected)
 
+#include "MidiInput.h"
+#include "HalTeensy.h"
+
+#include "PatchSysex.h"
+#include "UsbTransfer.h"
+#include "Scheduler.h"
+
+#include "ShiftRegOut.h"
+#include "ModeTables.h"
+
 #define SRP_TOTAL 8
-Rox74HC595<SRP_TOTAL> srp;
+ShiftRegOut<SRP_TOTAL> srp;
 
 // pins for 74HC595
 #define LED_DATA 6   // pin 14 on 74HC595 (DATA)
@@ -103,28 +125,27 @@ Rox74HC595<SRP_TOTAL> srp;
 #define LED_PWM -1   // pin 13 on 74HC595
 
 #define OCTO_TOTAL 4
-#define BTN_DEBOUNCE 50
-RoxOctoswitch<OCTO_TOTAL, BTN_DEBOUNCE> octoswitch;
 
 // pins for 74HC165
 #define PIN_DATA 17  // pin 9 on 74HC165 (DATA)
 #define PIN_CLK 41   // pin 2 on 74HC165 (CLK))
 #define PIN_LOAD 40  // pin 1 on 74HC165 (LOAD)
 
+#include "InputScanner.h"
+
 int count = 0;  //For MIDI Clk Sync
 int DelayForSH3 = 50;
 int midioutfrig = 3;
 int patchNo = 0;
 int patchNoU = 0;
 int patchNoL = 0;
-int voiceToReturn = -1;        //Initialise
-long earliestTime = millis();  //For voice allocation - initialise to now
 unsigned long buttonDebounce = 0;
 
 // create a global shift register object
 // parameters: <number of shift registers> (data pin, clock pin, latch pin)
 
 void setup() {
+  loadSettings();
   SPI.begin();
   Wire.begin();           // Join the I2C bus as Master
   Wire.setClock(400000);  // Set I2C speed to 400 kHz
@@ -132,10 +153,8 @@ void setup() {
   setUpSettings();
   setupHardware();
 
-  octoswitch.begin(PIN_DATA, PIN_LOAD, PIN_CLK);
-  octoswitch.setCallback(onButtonPress);
-
   srp.begin(LED_DATA, LED_LATCH, LED_CLK, LED_PWM);
+  startInputScanner();
 
   SPI.beginTransaction(SPISettings(2000000, MSBFIRST, SPI_MODE1));
   digitalWrite(DAC_CS1, LOW);
@@ -152,7 +171,8 @@ void setup() {
     loadPatches();
     if (patches.size() == 0) {
       //save an initialised patch to SD card
-      savePatch("1", INITPATCH);
+      patches.insert(1, INITPATCHNAME);
+      savePatch(1, INITPATCH);
       loadPatches();
     }
   } else {
@@ -172,17 +192,13 @@ void setup() {
   usbMIDI.setHandlePitchChange(DinHandlePitchBend);
   usbMIDI.setHandleNoteOn(myNoteOn);
   usbMIDI.setHandleNoteOff(myNoteOff);
+  usbMIDI.setHandleSystemExclusive(usbSysEx);
   //Serial.println("USB Client MIDI Listening");
 
-  //MIDI 5 Pin DIN
+  //MIDI 5 Pin DIN, the library only sends, input is parsed from the drain timer and handled in dispatchDinMidi()
   MIDI.begin();
-  MIDI.setHandleControlChange(editControlChange);
-  MIDI.setHandleProgramChange(myProgramChange);
-  MIDI.setHandleAfterTouchChannel(myAfterTouch);
-  MIDI.setHandlePitchBend(DinHandlePitchBend);
-  MIDI.setHandleNoteOn(myNoteOn);
-  MIDI.setHandleNoteOff(myNoteOff);
   MIDI.turnThruOn(midi::Thru::Mode::Off);
+  startDinMidi();
   //Serial.println("MIDI In DIN Listening");
 
   MIDI7.begin();
@@ -191,6 +207,11 @@ void setup() {
 
   MIDI6.begin();
   MIDI6.turnThruOn(midi::Thru::Mode::Off);
+#ifdef VOICE_LINK_BINARY
+  Serial6.addMemoryForWrite(voiceLinkTxBuffer, sizeof(voiceLinkTxBuffer));
+  voiceLinkBegin();
+  MIDI6.setHandleSystemExclusive(voiceLinkSysEx);
+#endif
 
   //Read Aftertouch from EEPROM, this can be set individually by each patch.
   upperData[P_AfterTouchDest] = getAfterTouchU();
@@ -212,13 +233,13 @@ void setup() {
 
   for (int i = 0; i < 8; i++) {
     int noteon = 60;
-    MIDI6.sendNoteOn(noteon, 64, 1);
+    hal.midiVoices->noteOn(noteon, 64, 1);
     delayMicroseconds(DelayForSH3);
-    MIDI6.sendNoteOn(noteon, 64, 2);
+    hal.midiVoices->noteOn(noteon, 64, 2);
     delay(1);
-    MIDI6.sendNoteOff(noteon, 64, 1);
+    hal.midiVoices->noteOff(noteon, 64, 1);
     delayMicroseconds(DelayForSH3);
-    MIDI6.sendNoteOff(noteon, 64, 2);
+    hal.midiVoices->noteOff(noteon, 64, 2);
     noteon++;
   }
   delay(200);
@@ -234,6 +255,29 @@ void setup() {
   lowerSW = 0;
   recallPatch(patchNoL);  //Load first patch
   //updatewholemode();
+
+  if (cardStatus) startStorageWorker();
+  setupTasks();
+#ifdef LOOP_PROFILER
+  addSerialCommand("prof", profileCommand);
+#endif
+#ifdef POT_LATENCY
+  potLatencyReset();
+  addSerialCommand("pot", potCommand);
+#endif
+#ifdef POT_LATENCY_PIN
+  pinMode(POT_LATENCY_PIN, OUTPUT);
+#endif
+  modBegin();
+  addSerialCommand("mod", modCommand);
+  clockBegin();
+  addSerialCommand("clock", clockCommand);
+  addSerialCommand("flight", flightCommand);
+  addSerialCommand("thru", thruCommand);
+  addSerialCommand("rescan", rescanCommand);
+#ifdef VOICE_LINK_BINARY
+  addSerialCommand("link", voiceLinkCommand);
+#endif
 }
 
 void editControlChange(byte channel, byte control, byte value) {
@@ -246,11 +290,6 @@ void panelControlChange(byte channel, byte control, byte value) {
   myControlChange(channel, control, newvalue);
 }
 
-int mod(int a, int b) {
-  int r = a % b;
-  return r < 0 ? r + b : r;
-}
-
 void setTranspose(int splitTrans) {
   switch (splitTrans) {
     case 0:
@@ -321,145 +360,22 @@ void LFODelayHandle() {
   }
 }
 
-void commandTopNote() {
-  int topNote = 0;
-  bool noteActive = false;
-
-  for (int i = 0; i < 128; i++) {
-    if (notes[i]) {
-      topNote = i;
-      noteActive = true;
-    }
-  }
-
-  if (noteActive)
-    commandNote(topNote);
-  else  // All notes are off, turn off gate
-    MIDI6.sendNoteOff(noteMsg, 0, 1);
-}
-
-void commandBottomNote() {
-  int bottomNote = 0;
-  bool noteActive = false;
-
-  for (int i = 127; i >= 0; i--) {
-    if (notes[i]) {
-      bottomNote = i;
-      noteActive = true;
-    }
-  }
-
-  if (noteActive)
-    commandNote(bottomNote);
-  else  // All notes are off, turn off gate
-    MIDI6.sendNoteOff(noteMsg, 0, 1);
-}
-
-void commandLastNote() {
-
-  int8_t noteIndx;
-
-  for (int i = 0; i < 40; i++) {
-    noteIndx = noteOrder[mod(orderIndx - i, 40)];
-    if (notes[noteIndx]) {
-      commandNote(noteIndx);
-      return;
-    }
-  }
-  MIDI6.sendNoteOff(noteMsg, 0, 1);
-}
-
-void commandNote(int noteMsg) {
-  MIDI6.sendNoteOn(noteMsg, noteVel, 1);
-}
-
-void commandTopNoteUni() {
-  int topNote = 0;
-  bool noteActive = false;
-
-  for (int i = 0; i < 128; i++) {
-    if (notes[i]) {
-      topNote = i;
-      noteActive = true;
-    }
-  }
-
-  if (noteActive) {
-    commandNoteUni(topNote);
-  } else {  // All notes are off, turn off gate
-    MIDI6.sendNoteOff(noteMsg, 0, 1);
-    MIDI6.sendNoteOff(noteMsg, 0, 2);
-    MIDI6.sendNoteOff(noteMsg, 0, 3);
-    MIDI6.sendNoteOff(noteMsg, 0, 4);
-    MIDI6.sendNoteOff(noteMsg, 0, 5);
-    MIDI6.sendNoteOff(noteMsg, 0, 6);
-    MIDI6.sendNoteOff(noteMsg, 0, 7);
-    MIDI6.sendNoteOff(noteMsg, 0, 8);
-  }
-}
-
-void commandBottomNoteUni() {
-  int bottomNote = 0;
-  bool noteActive = false;
-
-  for (int i = 127; i >= 0; i--) {
-    if (notes[i]) {
-      bottomNote = i;
-      noteActive = true;
-    }
-  }
-
-  if (noteActive) {
-    commandNoteUni(bottomNote);
-  } else {  // All notes are off, turn off gate
-    MIDI6.sendNoteOff(noteMsg, 0, 1);
-    MIDI6.sendNoteOff(noteMsg, 0, 2);
-    MIDI6.sendNoteOff(noteMsg, 0, 3);
-    MIDI6.sendNoteOff(noteMsg, 0, 4);
-    MIDI6.sendNoteOff(noteMsg, 0, 5);
-    MIDI6.sendNoteOff(noteMsg, 0, 6);
-    MIDI6.sendNoteOff(noteMsg, 0, 7);
-    MIDI6.sendNoteOff(noteMsg, 0, 8);
-  }
-}
-
-void commandLastNoteUni() {
-
-  int8_t noteIndx;
+//By voice index for the poly modes
+void (*const UPDATE_VOICE[NO_OF_VOICES])() = { updateVoice1, updateVoice2, updateVoice3, updateVoice4,
+                                               updateVoice5, updateVoice6, updateVoice7, updateVoice8 };
 
-  for (int i = 0; i < 40; i++) {
-    noteIndx = noteOrder[mod(orderIndx - i, 40)];
-    if (notes[noteIndx]) {
-      commandNoteUni(noteIndx);
-      return;
-    }
-  }
-  MIDI6.sendNoteOff(noteMsg, 0, 1);
-  MIDI6.sendNoteOff(noteIndx, 0, 2);
-  MIDI6.sendNoteOff(noteIndx, 0, 3);
-  MIDI6.sendNoteOff(noteIndx, 0, 4);
-  MIDI6.sendNoteOff(noteIndx, 0, 5);
-  MIDI6.sendNoteOff(noteIndx, 0, 6);
-  MIDI6.sendNoteOff(noteIndx, 0, 7);
-  MIDI6.sendNoteOff(noteIndx, 0, 8);
+void updatePolyVoice(int voice) {
+  UPDATE_VOICE[voice - 1]();
 }
 
-void commandNoteUni(int noteMsg) {
-
-  MIDI6.sendNoteOn(noteMsg, noteVel, 1);
-  MIDI6.sendNoteOn(noteMsg, noteVel, 2);
-  MIDI6.sendNoteOn(noteMsg, noteVel, 3);
-  MIDI6.sendNoteOn(noteMsg, noteVel, 4);
-  MIDI6.sendNoteOn(noteMsg, noteVel, 5);
-  MIDI6.sendNoteOn(noteMsg, noteVel, 6);
-  MIDI6.sendNoteOn(noteMsg, noteVel, 7);
-  MIDI6.sendNoteOn(noteMsg, noteVel, 8);
-}
+KeyState keys = { voices, NO_OF_VOICES, updatePolyVoice };
 
 void myNoteOn(byte channel, byte note, byte velocity) {
 
   // for lfo multi trigger
   numberOfNotes = numberOfNotes + 1;
+  flightRecord(FLIGHT_NOTE_ON, note, channel << 8 | velocity);
+  modNote(note, velocity);
 
   //Check for out of range notes
   if (note >= 0 && note <= 127) {
@@ -467,450 +383,29 @@ void myNoteOn(byte channel, byte note, byte velocity) {
   }
 
   prevNote = note;
-  switch (panelData[P_keyboardMode]) {
-    case 0:
-      switch (getVoiceNo(-1)) {
-        case 1:
-          voices[0].note = note;
-          voices[0].velocity = velocity;
-          voices[0].timeOn = millis();
-          updateVoice1();
-          MIDI6.sendNoteOn(voices[0].note, voices[0].velocity, 1);
-          //trig.writePin(GATE_NOTE1, HIGH);
-          voiceOn[0] = true;
-          break;
-        case 2:
-          voices[1].note = note;
-          voices[1].velocity = velocity;
-          voices[1].timeOn = millis();
-          updateVoice2();
-          MIDI6.sendNoteOn(voices[1].note, voices[1].velocity, 2);
-          //trig.writePin(GATE_NOTE2, HIGH);
-          voiceOn[1] = true;
-          break;
-        case 3:
-          voices[2].note = note;
-          voices[2].velocity = velocity;
-          voices[2].timeOn = millis();
-          updateVoice3();
-          MIDI6.sendNoteOn(voices[2].note, voices[2].velocity, 3);
-          //trig.writePin(GATE_NOTE3, HIGH);
-          voiceOn[2] = true;
-          break;
-        case 4:
-          voices[3].note = note;
-          voices[3].velocity = velocity;
-          voices[3].timeOn = millis();
-          updateVoice4();
-          MIDI6.sendNoteOn(voices[3].note, voices[3].velocity, 4);
-          //trig.writePin(GATE_NOTE4, HIGH);
-          voiceOn[3] = true;
-          break;
-        case 5:
-          voices[4].note = note;
-          voices[4].velocity = velocity;
-          voices[4].timeOn = millis();
-          updateVoice5();
-          MIDI6.sendNoteOn(voices[4].note, voices[4].velocity, 5);
-          //trig.writePin(GATE_NOTE5, HIGH);
-          voiceOn[4] = true;
-          break;
-        case 6:
-          voices[5].note = note;
-          voices[5].velocity = velocity;
-          voices[5].timeOn = millis();
-          updateVoice6();
-          MIDI6.sendNoteOn(voices[5].note, voices[5].velocity, 6);
-          //trig.writePin(GATE_NOTE6, HIGH);
-          voiceOn[5] = true;
-          break;
-        case 7:
-          voices[6].note = note;
-          voices[6].velocity = velocity;
-          voices[6].timeOn = millis();
-          updateVoice7();
-          MIDI6.sendNoteOn(voices[6].note, voices[6].velocity, 7);
-          //trig.writePin(GATE_NOTE7, HIGH);
-          voiceOn[6] = true;
-          break;
-        case 8:
-          voices[7].note = note;
-          voices[7].velocity = velocity;
-          voices[7].timeOn = millis();
-          updateVoice8();
-          MIDI6.sendNoteOn(voices[7].note, voices[7].velocity, 8);
-          //trig.writePin(GATE_NOTE8, HIGH);
-          voiceOn[7] = true;
-          break;
-      }
-      break;
-
-    case 1:
-      switch (getVoiceNoPoly2(-1)) {
-        case 1:
-          voices[0].note = note;
-          voices[0].velocity = velocity;
-          voices[0].timeOn = millis();
-          updateVoice1();
-          MIDI6.sendNoteOn(voices[0].note, voices[0].velocity, 1);
-          //trig.writePin(GATE_NOTE1, HIGH);
-          voiceOn[0] = true;
-          break;
-        case 2:
-          voices[1].note = note;
-          voices[1].velocity = velocity;
-          voices[1].timeOn = millis();
-          updateVoice2();
-          MIDI6.sendNoteOn(voices[1].note, voices[1].velocity, 2);
-          //trig.writePin(GATE_NOTE2, HIGH);
-          voiceOn[1] = true;
-          break;
-        case 3:
-          voices[2].note = note;
-          voices[2].velocity = velocity;
-          voices[2].timeOn = millis();
-          updateVoice3();
-          MIDI6.sendNoteOn(voices[2].note, voices[2].velocity, 3);
-          //trig.writePin(GATE_NOTE3, HIGH);
-          voiceOn[2] = true;
-          break;
-        case 4:
-          voices[3].note = note;
-          voices[3].velocity = velocity;
-          voices[3].timeOn = millis();
-          updateVoice4();
-          MIDI6.sendNoteOn(voices[3].note, voices[3].velocity, 4);
-          //trig.writePin(GATE_NOTE4, HIGH);
-          voiceOn[3] = true;
-          break;
-        case 5:
-          voices[4].note = note;
-          voices[4].velocity = velocity;
-          voices[4].timeOn = millis();
-          updateVoice5();
-          MIDI6.sendNoteOn(voices[4].note, voices[4].velocity, 5);
-          //trig.writePin(GATE_NOTE5, HIGH);
-          voiceOn[4] = true;
-          break;
-        case 6:
-          voices[5].note = note;
-          voices[5].velocity = velocity;
-          voices[5].timeOn = millis();
-          updateVoice6();
-          MIDI6.sendNoteOn(voices[5].note, voices[5].velocity, 6);
-          //trig.writePin(GATE_NOTE6, HIGH);
-          voiceOn[5] = true;
-          break;
-        case 7:
-          voices[6].note = note;
-          voices[6].velocity = velocity;
-          voices[6].timeOn = millis();
-          updateVoice7();
-          MIDI6.sendNoteOn(voices[6].note, voices[6].velocity, 7);
-          //trig.writePin(GATE_NOTE7, HIGH);
-          voiceOn[6] = true;
-          break;
-        case 8:
-          voices[7].note = note;
-          voices[7].velocity = velocity;
-          voices[7].timeOn = millis();
-          updateVoice8();
-          MIDI6.sendNoteOn(voices[7].note, voices[7].velocity, 8);
-          //trig.writePin(GATE_NOTE8, HIGH);
-          voiceOn[7] = true;
-          break;
-      }
-      break;
-
-    case 2:
-      noteMsg = note;
-      noteVel = velocity;
-
-      if (velocity == 0) {
-        notes[noteMsg] = false;
-      } else {
-        notes[noteMsg] = true;
-      }
-
-      if (panelData[P_NotePriority] == 0) {  // Highest note priority
-        commandTopNote();
-      } else if (panelData[P_NotePriority] == 1) {  // Lowest note priority
-        commandBottomNote();
-      } else {                 // Last note priority
-        if (notes[noteMsg]) {  // If note is on and using last note priority, add to ordered list
-          orderIndx = (orderIndx + 1) % 40;
-          noteOrder[orderIndx] = noteMsg;
-        }
-        commandLastNote();
-      }
-      break;
-
-    case 3:
-      noteMsg = note;
-      noteVel = velocity;
-
-      if (velocity == 0) {
-        notes[noteMsg] = false;
-      } else {
-        notes[noteMsg] = true;
-      }
-
-      if (panelData[P_NotePriority] == 0) {  // Highest note priority
-        commandTopNoteUni();
-      } else if (panelData[P_NotePriority] == 1) {  // Lowest note priority
-        commandBottomNoteUni();
-      } else {                 // Last note priority
-        if (notes[noteMsg]) {  // If note is on and using last note priority, add to ordered list
-          orderIndx = (orderIndx + 1) % 40;
-          noteOrder[orderIndx] = noteMsg;
-        }
-        commandLastNoteUni();
-      }
-      break;
-  }
+  int mode = panelData[P_keyboardMode];
+  int voice = keyNoteOn(keys, mode, panelData[P_NotePriority], note, velocity, hal.clock->millis());
+  if (mode == 0 || mode == 1) {
+    flightRecord(FLIGHT_VOICE, note, voice);
+    //trig.writePin(GATE_NOTE1 + voice - 1, HIGH);
+    if (voice) voiceOn[voice - 1] = true;
+  }
+  flightNoteSent(note);
 }
 
 void myNoteOff(byte channel, byte note, byte velocity) {
 
   numberOfNotes = numberOfNotes - 1;
+  flightRecord(FLIGHT_NOTE_OFF, note, channel << 8 | velocity);
   oldnumberOfNotes = oldnumberOfNotes - 1;
 
-  switch (panelData[P_keyboardMode]) {
-    case 0:
-      switch (getVoiceNo(note)) {
-        case 1:
-          MIDI6.sendNoteOn(voices[0].note, 0, 1);
-          voices[0].note = -1;
-          voiceOn[0] = false;
-          break;
-        case 2:
-          MIDI6.sendNoteOn(voices[1].note, 0, 2);
-          voices[1].note = -1;
-          voiceOn[1] = false;
-          break;
-        case 3:
-          MIDI6.sendNoteOn(voices[2].note, 0, 3);
-          voices[2].note = -1;
-          voiceOn[2] = false;
-          break;
-        case 4:
-          MIDI6.sendNoteOn(voices[3].note, 0, 4);
-          voices[3].note = -1;
-          voiceOn[3] = false;
-          break;
-        case 5:
-          MIDI6.sendNoteOn(voices[4].note, 0, 5);
-          voices[4].note = -1;
-          voiceOn[4] = false;
-          break;
-        case 6:
-          MIDI6.sendNoteOn(voices[5].note, 0, 6);
-          voices[5].note = -1;
-          voiceOn[5] = false;
-          break;
-        case 7:
-          MIDI6.sendNoteOn(voices[6].note, 0, 7);
-          voices[6].note = -1;
-          voiceOn[6] = false;
-          break;
-        case 8:
-          MIDI6.sendNoteOn(voices[7].note, 0, 8);
-          voices[7].note = -1;
-          voiceOn[7] = false;
-          break;
-      }
-      break;
-
-    case 1:
-      switch (getVoiceNoPoly2(note)) {
-        case 1:
-          MIDI6.sendNoteOn(voices[0].note, 0, 1);
-          voices[0].note = -1;
-          voiceOn[0] = false;
-          break;
-        case 2:
-          MIDI6.sendNoteOn(voices[1].note, 0, 2);
-          voices[1].note = -1;
-          voiceOn[1] = false;
-          break;
-        case 3:
-          MIDI6.sendNoteOn(voices[2].note, 0, 3);
-          voices[2].note = -1;
-          voiceOn[2] = false;
-          break;
-        case 4:
-          MIDI6.sendNoteOn(voices[3].note, 0, 4);
-          voices[3].note = -1;
-          voiceOn[3] = false;
-          break;
-        case 5:
-          MIDI6.sendNoteOn(voices[4].note, 0, 5);
-          voices[4].note = -1;
-          voiceOn[4] = false;
-          break;
-        case 6:
-          MIDI6.sendNoteOn(voices[5].note, 0, 6);
-          voices[5].note = -1;
-          voiceOn[5] = false;
-          break;
-        case 7:
-          MIDI6.sendNoteOn(voices[6].note, 0, 7);
-          voices[6].note = -1;
-          voiceOn[6] = false;
-          break;
-        case 8:
-          MIDI6.sendNoteOn(voices[7].note, 0, 8);
-          voices[7].note = -1;
-          voiceOn[7] = false;
-          break;
-      }
-      break;
-
-    case 2:
-      noteMsg = note;
-
-      if (velocity == 0 || velocity == 64) {
-        notes[noteMsg] = false;
-      } else {
-        notes[noteMsg] = true;
-      }
-
-      // Pins NP_SEL1 and NP_SEL2 indictate note priority
-      // velmV = ((unsigned int)((float)velocity) * VEL_SF);
-      // sample_data = (channel_a & 0xFFF0000F) | (((int(velmV)) & 0xFFFF) << 4);
-      // outputDAC(DAC_NOTE2, sample_data);
-      if (panelData[P_NotePriority] == 0) {  // Highest note priority
-        commandTopNote();
-      } else if (panelData[P_NotePriority] == 1) {  // Lowest note priority
-        commandBottomNote();
-      } else {                 // Last note priority
-        if (notes[noteMsg]) {  // If note is on and using last note priority, add to ordered list
-          orderIndx = (orderIndx + 1) % 40;
-          noteOrder[orderIndx] = noteMsg;
-        }
-        commandLastNote();
-      }
-      break;
-
-    case 3:
-      noteMsg = note;
-
-      if (velocity == 0 || velocity == 64) {
-        notes[noteMsg] = false;
-      } else {
-        notes[noteMsg] = true;
-      }
-
-      // velmV = ((unsigned int)((float)velocity) * VEL_SF);
-      // sample_data = (channel_a & 0xFFF0000F) | (((int(velmV)) & 0xFFFF) << 4);
-      // outputDAC(DAC_NOTE2, sample_data);
-      // sample_data = (channel_b & 0xFFF0000F) | (((int(velmV)) & 0xFFFF) << 4);
-      // outputDAC(DAC_NOTE2, sample_data);
-      // sample_data = (channel_c & 0xFFF0000F) | (((int(velmV)) & 0xFFFF) << 4);
-      // outputDAC(DAC_NOTE2, sample_data);
-      // sample_data = (channel_d & 0xFFF0000F) | (((int(velmV)) & 0xFFFF) << 4);
-      // outputDAC(DAC_NOTE2, sample_data);
-      // sample_data = (channel_e & 0xFFF0000F) | (((int(velmV)) & 0xFFFF) << 4);
-      // outputDAC(DAC_NOTE2, sample_data);
-      // sample_data = (channel_f & 0xFFF0000F) | (((int(velmV)) & 0xFFFF) << 4);
-      // outputDAC(DAC_NOTE2, sample_data);
-      // sample_data = (channel_g & 0xFFF0000F) | (((int(velmV)) & 0xFFFF) << 4);
-      // outputDAC(DAC_NOTE2, sample_data);
-      // sample_data = (channel_h & 0xFFF0000F) | (((int(velmV)) & 0xFFFF) << 4);
-      // outputDAC(DAC_NOTE2, sample_data);
-      if (panelData[P_NotePriority] == 0) {  // Highest note priority
-        commandTopNoteUni();
-      } else if (panelData[P_NotePriority] == 1) {  // Lowest note priority
-        commandBottomNoteUni();
-      } else {                 // Last note priority
-        if (notes[noteMsg]) {  // If note is on and using last note priority, add to ordered list
-          orderIndx = (orderIndx + 1) % 40;
-          noteOrder[orderIndx] = noteMsg;
-        }
-        commandLastNoteUni();
-      }
-      break;
-  }
+  int voice = keyNoteOff(keys, panelData[P_keyboardMode], panelData[P_NotePriority], note, velocity);
+  if (voice) voiceOn[voice - 1] = false;
 }
 
 int getVoiceNoPoly2(int note) {
-  voiceToReturn = -1;       // Initialize to 'null'
-  earliestTime = millis();  // Initialize to now
-
-  if (note == -1) {
-    // NoteOn() - Get the oldest free voice (recent voices may still be on the release stage)
-    if (voices[lastUsedVoice].note == -1) {
-      return lastUsedVoice + 1;
-    }
-
-    // If the last used voice is not free or doesn't exist, check if the first voice is free
-    if (voices[0].note == -1) {
-      return 1;
-    }
-
-    // Find the lowest available voice for the new note
-    for (int i = 0; i < NO_OF_VOICES; i++) {
-      if (voices[i].note == -1) {
-        return i + 1;
-      }
-    }
-
-    // If no voice is available, release the oldest note
-    int oldestVoice = 0;
-    for (int i = 1; i < NO_OF_VOICES; i++) {
-      if (voices[i].timeOn < voices[oldestVoice].timeOn) {
-        oldestVoice = i;
-      }
-    }
-    return oldestVoice + 1;
-  } else {
-    // NoteOff() - Get the voice number from the note
-    for (int i = 0; i < NO_OF_VOICES; i++) {
-      if (voices[i].note == note) {
-        return i + 1;
-      }
-    }
-  }
-
-  // Shouldn't get here, return voice 1
-  return 1;
-}
-
-
-int getVoiceNo(int note) {
-  voiceToReturn = -1;       //Initialise to 'null'
-  earliestTime = millis();  //Initialise to now
-  if (note == -1) {
-    //NoteOn() - Get the oldest free voice (recent voices may be still on release stage)
-    for (int i = 0; i < NO_OF_VOICES; i++) {
-      if (voices[i].note == -1) {
-        if (voices[i].timeOn < earliestTime) {
-          earliestTime = voices[i].timeOn;
-          voiceToReturn = i;
-        }
-      }
-    }
-    if (voiceToReturn == -1) {
-      //No free voices, need to steal oldest sounding voice
-      earliestTime = millis();  //Reinitialise
-      for (int i = 0; i < NO_OF_VOICES; i++) {
-        if (voices[i].timeOn < earliestTime) {
-          earliestTime = voices[i].timeOn;
-          voiceToReturn = i;
-        }
-      }
-    }
-    return voiceToReturn + 1;
-  } else {
-    //NoteOff() - Get voice number from note
-    for (int i = 0; i < NO_OF_VOICES; i++) {
-      if (voices[i].note == note) {
-        return i + 1;
-      }
-    }
-  }
-  //Shouldn't get here, return voice 1
-  return 1;
+  if (note == -1) return nextFreeVoice(voices, NO_OF_VOICES, keys.lastUsedVoice);  //NoteOn()
+  return voiceForNote(voices, NO_OF_VOICES, note);                         //NoteOff()
 }
 
 void updateVoice1() {
@@ -1172,18 +667,9 @@ void updateVoice8() {
 // }
 
 void DinHandlePitchBend(byte channel, int pitch) {
-  if (wholemode) {
-    MIDI6.sendPitchBend(pitch, 1);
-    MIDI6.sendPitchBend(pitch, 2);
-  }
-  if (dualmode) {
-    MIDI6.sendPitchBend(pitch, 1);
-    MIDI6.sendPitchBend(pitch, 2);
-  }
-  if (splitmode) {
-    MIDI6.sendPitchBend(pitch, 1);
-    MIDI6.sendPitchBend(pitch, 2);
-  }
+  if (wholemode) keyPitchBend(pitch);
+  if (dualmode) keyPitchBend(pitch);
+  if (splitmode) keyPitchBend(pitch);
 }
 
 void getDelayTime() {
@@ -1235,15 +721,15 @@ void updateosc2PW(boolean announce) {
     showCurrentParameterPage("OSC2 PW", String(osc2PWstr) + " %");
   }
   if (upperSW) {
-    midiCCOut62(WSosc2PW, upperData[P_osc2PW] >> midioutfrig);
+    voiceLevelOut(2, WSosc2PW, upperData[P_osc2PW]);
     midiCCOut(CCosc2PW, upperData[P_osc2PW] >> midioutfrig);
     midiCCOut71(CCosc2PW, upperData[P_osc2PW] >> midioutfrig);
   } else {
-    midiCCOut61(WSosc2PW, lowerData[P_osc2PW] >> midioutfrig);
+    voiceLevelOut(1, WSosc2PW, lowerData[P_osc2PW]);
     midiCCOut(CCosc2PW, lowerData[P_osc2PW] >> midioutfrig);
     midiCCOut71(CCosc2PW, lowerData[P_osc2PW] >> midioutfrig);
     if (wholemode) {
-      midiCCOut62(WSosc2PW, upperData[P_osc2PW] >> midioutfrig);
+      voiceLevelOut(2, WSosc2PW, upperData[P_osc2PW]);
     }
   }
 }
@@ -1253,15 +739,15 @@ void updateosc2PWM(boolean announce) {
     showCurrentParameterPage("OSC2 PWM", int(osc2PWMstr));
   }
   if (upperSW) {
-    midiCCOut62(WSosc2PWM, upperData[P_osc2PWM] >> midioutfrig);
+    voiceLevelOut(2, WSosc2PWM, upperData[P_osc2PWM]);
     midiCCOut(CCosc2PWM, upperData[P_osc2PWM] >> midioutfrig);
     midiCCOut71(CCosc2PWM, upperData[P_osc2PWM] >> midioutfrig);
   } else {
-    midiCCOut61(WSosc2PWM, lowerData[P_osc2PWM] >> midioutfrig);
+    voiceLevelOut(1, WSosc2PWM, lowerData[P_osc2PWM]);
     midiCCOut(CCosc2PWM, lowerData[P_osc2PWM] >> midioutfrig);
     midiCCOut71(CCosc2PWM, lowerData[P_osc2PWM] >> midioutfrig);
     if (wholemode) {
-      midiCCOut62(WSosc2PWM, upperData[P_osc2PWM] >> midioutfrig);
+      voiceLevelOut(2, WSosc2PWM, upperData[P_osc2PWM]);
     }
   }
 }
@@ -1271,15 +757,15 @@ void updateosc1PW(boolean announce) {
     showCurrentParameterPage("OSC1 PW", String(osc1PWstr) + " %");
   }
   if (upperSW) {
-    midiCCOut62(WSosc1PW, upperData[P_osc1PW] >> midioutfrig);
+    voiceLevelOut(2, WSosc1PW, upperData[P_osc1PW]);
     midiCCOut(CCosc1PW, upperData[P_osc1PW] >> midioutfrig);
     midiCCOut71(CCosc1PW, upperData[P_osc1PW] >> midioutfrig);
   } else {
-    midiCCOut61(WSosc1PW, lowerData[P_osc1PW] >> midioutfrig);
+    voiceLevelOut(1, WSosc1PW, lowerData[P_osc1PW]);
     midiCCOut(CCosc1PW, lowerData[P_osc1PW] >> midioutfrig);
     midiCCOut71(CCosc1PW, lowerData[P_osc1PW] >> midioutfrig);
     if (wholemode) {
-      midiCCOut62(WSosc1PW, upperData[P_osc1PW] >> midioutfrig);
+      voiceLevelOut(2, WSosc1PW, upperData[P_osc1PW]);
     }
   }
 }
@@ -1289,15 +775,15 @@ void updateosc1PWM(boolean announce) {
     showCurrentParameterPage("OSC1 PWM", int(osc1PWMstr));
   }
   if (upperSW) {
-    midiCCOut62(WSosc1PWM, upperData[P_osc1PWM] >> midioutfrig);
+    voiceLevelOut(2, WSosc1PWM, upperData[P_osc1PWM]);
     midiCCOut(CCosc1PWM, upperData[P_osc1PWM] >> midioutfrig);
     midiCCOut71(CCosc1PWM, upperData[P_osc1PWM] >> midioutfrig);
   } else {
-    midiCCOut61(WSosc1PWM, upperData[P_osc1PWM] >> midioutfrig);
+    voiceLevelOut(1, WSosc1PWM, upperData[P_osc1PWM]);
     midiCCOut(CCosc1PWM, lowerData[P_osc1PWM] >> midioutfrig);
     midiCCOut71(CCosc1PWM, lowerData[P_osc1PWM] >> midioutfrig);
     if (wholemode) {
-      midiCCOut62(WSosc1PWM, upperData[P_osc1PWM] >> midioutfrig);
+      voiceLevelOut(2, WSosc1PWM, upperData[P_osc1PWM]);
     }
   }
 }
@@ -1309,21 +795,21 @@ void updateosc1Range(boolean announce) {
         showCurrentParameterPage("Osc1 Range", String("8"));
       }
       midiCCOut(CCosc1Oct, 2);
-      midiCCOut61(WSosc1oct, 127);
+      voiceParamOut(1, WSosc1oct, 127);
       midiCCOut72(CCosc1Oct, 2);
     } else if (upperData[P_osc1Range] == 1) {
       if (announce) {
         showCurrentParameterPage("Osc1 Range", String("16"));
       }
       midiCCOut(CCosc1Oct, 1);
-      midiCCOut61(WSosc1oct, 63);
+      voiceParamOut(1, WSosc1oct, 63);
       midiCCOut72(CCosc1Oct, 1);
     } else {
       if (announce) {
         showCurrentParameterPage("Osc1 Range", String("32"));
       }
       midiCCOut(CCosc1Oct, 0);
-      midiCCOut61(WSosc1oct, 0);
+      voiceParamOut(1, WSosc1oct, 0);
       midiCCOut72(CCosc1Oct, 0);
     }
   } else {
@@ -1332,30 +818,30 @@ void updateosc1Range(boolean announce) {
         showCurrentParameterPage("Osc1 Range", String("8"));
       }
       midiCCOut(CCosc1Oct, 2);
-      midiCCOut62(WSosc1oct, 127);
+      voiceParamOut(2, WSosc1oct, 127);
       midiCCOut72(CCosc1Oct, 2);
       if (wholemode) {
-        midiCCOut61(WSosc1oct, 127);
+        voiceParamOut(1, WSosc1oct, 127);
       }
     } else if (lowerData[P_osc1Range] == 1) {
       if (announce) {
         showCurrentParameterPage("Osc1 Range", String("16"));
       }
       midiCCOut(CCosc1Oct, 1);
-      midiCCOut62(WSosc1oct, 63);
+      voiceParamOut(2, WSosc1oct, 63);
       midiCCOut72(CCosc1Oct, 1);
       if (wholemode) {
-        midiCCOut61(WSosc1oct, 63);
+        voiceParamOut(1, WSosc1oct, 63);
       }
     } else {
       if (announce) {
         showCurrentParameterPage("Osc1 Range", String("32"));
       }
       midiCCOut(CCosc1Oct, 0);
-      midiCCOut62(WSosc1oct, 0);
+      voiceParamOut(2, WSosc1oct, 0);
       midiCCOut72(CCosc1Oct, 0);
       if (wholemode) {
-        midiCCOut61(WSosc1oct, 0);
+        voiceParamOut(1, WSosc1oct, 0);
       }
     }
   }
@@ -1367,14 +853,14 @@ void updateosc2Range(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Osc2 Range", String("8"));
       }
-      midiCCOut61(WSosc2oct, 127);
+      voiceParamOut(1, WSosc2oct, 127);
       midiCCOut72(CCosc2Oct, 2);
       midiCCOut(CCosc2Oct, 2);
     } else if (upperData[P_osc2Range] == 1) {
       if (announce) {
         showCurrentParameterPage("Osc2 Range", String("16"));
       }
-      midiCCOut61(WSosc2oct, 63);
+      voiceParamOut(1, WSosc2oct, 63);
       midiCCOut72(CCosc2Oct, 1);
       midiCCOut(CCosc2Oct, 1);
     } else {
@@ -1382,7 +868,7 @@ void updateosc2Range(boolean announce) {
         showCurrentParameterPage("Osc2 Range", String("32"));
       }
       midiCCOut(CCosc2Oct, 0);
-      midiCCOut61(WSosc2oct, 0);
+      voiceParamOut(1, WSosc2oct, 0);
       midiCCOut72(CCosc2Oct, 0);
     }
   } else {
@@ -1391,10 +877,10 @@ void updateosc2Range(boolean announce) {
         showCurrentParameterPage("Osc2 Range", String("8"));
       }
       midiCCOut(CCosc2Oct, 2);
-      midiCCOut62(WSosc2oct, 127);
+      voiceParamOut(2, WSosc2oct, 127);
       midiCCOut72(CCosc2Oct, 2);
       if (wholemode) {
-        midiCCOut61(WSosc2oct, 127);
+        voiceParamOut(1, WSosc2oct, 127);
         //midiCCOut72(CCosc2Oct, 2);
       }
     } else if (lowerData[P_osc2Range] == 1) {
@@ -1402,10 +888,10 @@ void updateosc2Range(boolean announce) {
         showCurrentParameterPage("Osc2 Range", String("16"));
       }
       midiCCOut(CCosc2Oct, 1);
-      midiCCOut62(WSosc2oct, 63);
+      voiceParamOut(2, WSosc2oct, 63);
       midiCCOut72(CCosc2Oct, 1);
       if (wholemode) {
-        midiCCOut61(WSosc2oct, 63);
+        voiceParamOut(1, WSosc2oct, 63);
         //midiCCOut72(CCosc2Oct, 1);
       }
     } else {
@@ -1413,10 +899,10 @@ void updateosc2Range(boolean announce) {
         showCurrentParameterPage("Osc2 Range", String("32"));
       }
       midiCCOut(CCosc2Oct, 0);
-      midiCCOut62(WSosc2oct, 0);
+      voiceParamOut(2, WSosc2oct, 0);
       midiCCOut72(CCosc2Oct, 0);
       if (wholemode) {
-        midiCCOut61(WSosc2oct, 0);
+        voiceParamOut(1, WSosc2oct, 0);
         //midiCCOut72(CCosc2Oct, 0);
       }
     }
@@ -1428,15 +914,15 @@ void updateglideTime(boolean announce) {
     showCurrentParameterPage("Glide Time", String(glideTimestr * 10) + " Seconds");
   }
   if (upperSW) {
-    midiCCOut62(WSglideTime, upperData[P_glideTime] >> midioutfrig);
+    voiceLevelOut(2, WSglideTime, upperData[P_glideTime]);
     midiCCOut(CCglideTime, upperData[P_glideTime] >> midioutfrig);
     midiCCOut71(CCglideTime, upperData[P_glideTime] >> midioutfrig);
   } else {
-    midiCCOut61(WSglideTime, upperData[P_glideTime] >> midioutfrig);
+    voiceLevelOut(1, WSglideTime, upperData[P_glideTime]);
     midiCCOut(CCglideTime, lowerData[P_glideTime] >> midioutfrig);
     midiCCOut71(CCglideTime, lowerData[P_glideTime] >> midioutfrig);
     if (wholemode) {
-      midiCCOut62(WSglideTime, upperData[P_glideTime] >> midioutfrig);
+      voiceLevelOut(2, WSglideTime, upperData[P_glideTime]);
       //midiCCOut71(CCglideTime, upperData[P_glideTime] >> midioutfrig);
     }
   }
@@ -1447,15 +933,15 @@ void updateosc2Detune(boolean announce) {
     showCurrentParameterPage("OSC2 Detune", String(osc2Detunestr));
   }
   if (upperSW) {
-    midiCCOut62(WSdetune, upperData[P_osc2Detune] >> midioutfrig);
+    voiceLevelOut(2, WSdetune, upperData[P_osc2Detune]);
     midiCCOut(CCosc2Detune, upperData[P_osc2Detune] >> midioutfrig);
     midiCCOut71(CCosc2Detune, upperData[P_osc2Detune] >> midioutfrig);
   } else {
-    midiCCOut61(WSdetune, lowerData[P_osc2Detune] >> midioutfrig);
+    voiceLevelOut(1, WSdetune, lowerData[P_osc2Detune]);
     midiCCOut(CCosc2Detune, lowerData[P_osc2Detune] >> midioutfrig);
     midiCCOut71(CCosc2Detune, lowerData[P_osc2Detune] >> midioutfrig);
     if (wholemode) {
-      midiCCOut62(WSdetune, upperData[P_osc2Detune] >> midioutfrig);
+      voiceLevelOut(2, WSdetune, upperData[P_osc2Detune]);
     }
   }
 }
@@ -1465,15 +951,15 @@ void updateosc2Interval(boolean announce) {
     showCurrentParameterPage("OSC2 Interval", String(osc2Intervalstr));
   }
   if (upperSW) {
-    midiCCOut62(WSinterval, upperData[P_osc2Interval]);
+    voiceParamOut(2, WSinterval, upperData[P_osc2Interval]);
     midiCCOut(CCosc2Interval, upperData[P_osc2Interval]);
     midiCCOut71(CCosc2Interval, map(upperData[P_osc2Interval], 0, 12, 0, 127));
   } else {
-    midiCCOut61(WSinterval, lowerData[P_osc2Interval]);
+    voiceParamOut(1, WSinterval, lowerData[P_osc2Interval]);
     midiCCOut(CCosc2Interval, lowerData[P_osc2Interval] >> midioutfrig);
     midiCCOut71(CCosc2Interval, map(lowerData[P_osc2Interval], 0, 12, 0, 127));
     if (wholemode) {
-      midiCCOut62(WSinterval, upperData[P_osc2Interval]);
+      voiceParamOut(2, WSinterval, upperData[P_osc2Interval]);
     }
   }
 }
@@ -1622,322 +1108,21 @@ void updatefilterRes(boolean announce) {
 }
 
 void updateFilterType(boolean announce) {
+  int *layerData = upperSW ? upperData : lowerData;
+  int type = layerData[P_filterType];
+  if (type < 0 || type >= FILTER_MODE_COUNT) return;
+  const FilterMode &mode = FILTER_MODES[type];
+  if (announce) {
+    showCurrentParameterPage("Filter Type", String(layerData[P_filterPoleSW] == 1 ? mode.poleLabel : mode.label));
+  }
+  midiCCOut72(CCfilterType, type);
+  midiCCOut(CCfilterType, type);
   if (upperSW) {
-    switch (upperData[P_filterType]) {
-      case 0:
-        if (upperData[P_filterPoleSW] == 1) {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("3P LowPass"));
-          }
-        } else {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("4P LowPass"));
-          }
-        }
-        midiCCOut72(CCfilterType, 0);
-        midiCCOut(CCfilterType, 0);
-        srp.writePin(FILTERA_UPPER, LOW);
-        srp.writePin(FILTERB_UPPER, LOW);
-        srp.writePin(FILTERC_UPPER, LOW);
-        break;
-
-      case 1:
-        if (upperData[P_filterPoleSW] == 1) {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("1P LowPass"));
-          }
-        } else {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("2P LowPass"));
-          }
-        }
-        midiCCOut72(CCfilterType, 1);
-        midiCCOut(CCfilterType, 1);
-        srp.writePin(FILTERA_UPPER, HIGH);
-        srp.writePin(FILTERB_UPPER, LOW);
-        srp.writePin(FILTERC_UPPER, LOW);
-        break;
-
-      case 2:
-        if (upperData[P_filterPoleSW] == 1) {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("3P HP + 1P LP"));
-          }
-        } else {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("4P HighPass"));
-          }
-        }
-        midiCCOut72(CCfilterType, 2);
-        midiCCOut(CCfilterType, 2);
-        srp.writePin(FILTERA_UPPER, LOW);
-        srp.writePin(FILTERB_UPPER, HIGH);
-        srp.writePin(FILTERC_UPPER, LOW);
-        break;
-
-      case 3:
-        if (upperData[P_filterPoleSW] == 1) {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("1P HP + 1P LP"));
-          }
-        } else {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("2P HighPass"));
-          }
-        }
-        midiCCOut72(CCfilterType, 3);
-        midiCCOut(CCfilterType, 3);
-        srp.writePin(FILTERA_UPPER, HIGH);
-        srp.writePin(FILTERB_UPPER, HIGH);
-        srp.writePin(FILTERC_UPPER, LOW);
-        break;
-
-      case 4:
-        if (upperData[P_filterPoleSW] == 1) {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("2P HP + 1P LP"));
-          }
-        } else {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("4P BandPass"));
-          }
-        }
-        midiCCOut72(CCfilterType, 4);
-        midiCCOut(CCfilterType, 4);
-        srp.writePin(FILTERA_UPPER, LOW);
-        srp.writePin(FILTERB_UPPER, LOW);
-        srp.writePin(FILTERC_UPPER, HIGH);
-        break;
-
-      case 5:
-        if (upperData[P_filterPoleSW] == 1) {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("2P BP + 1P LP"));
-          }
-        } else {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("2P BandPass"));
-          }
-        }
-        midiCCOut72(CCfilterType, 5);
-        midiCCOut(CCfilterType, 5);
-        srp.writePin(FILTERA_UPPER, HIGH);
-        srp.writePin(FILTERB_UPPER, LOW);
-        srp.writePin(FILTERC_UPPER, HIGH);
-        break;
-
-      case 6:
-        if (upperData[P_filterPoleSW] == 1) {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("3P AP + 1P LP"));
-          }
-        } else {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("3P AllPass"));
-          }
-        }
-        midiCCOut72(CCfilterType, 6);
-        midiCCOut(CCfilterType, 6);
-        srp.writePin(FILTERA_UPPER, LOW);
-        srp.writePin(FILTERB_UPPER, HIGH);
-        srp.writePin(FILTERC_UPPER, HIGH);
-        break;
-
-      case 7:
-        if (upperData[P_filterPoleSW] == 1) {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("2P Notch + LP"));
-          }
-        } else {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("Notch"));
-          }
-        }
-        midiCCOut72(CCfilterType, 7);
-        midiCCOut(CCfilterType, 7);
-        srp.writePin(FILTERA_UPPER, HIGH);
-        srp.writePin(FILTERB_UPPER, HIGH);
-        srp.writePin(FILTERC_UPPER, HIGH);
-        break;
-    }
+    srp.writeField(FILTERA_UPPER, FILTERB_UPPER, FILTERC_UPPER, mode.bits);
   } else {
-    switch (lowerData[P_filterType]) {
-      case 0:
-        if (lowerData[P_filterPoleSW] == 1) {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("3P LowPass"));
-          }
-        } else {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("4P LowPass"));
-          }
-        }
-        midiCCOut72(CCfilterType, 0);
-        midiCCOut(CCfilterType, 0);
-        srp.writePin(FILTERA_LOWER, LOW);
-        srp.writePin(FILTERB_LOWER, LOW);
-        srp.writePin(FILTERC_LOWER, LOW);
-        if (wholemode) {
-          srp.writePin(FILTERA_UPPER, LOW);
-          srp.writePin(FILTERB_UPPER, LOW);
-          srp.writePin(FILTERC_UPPER, LOW);
-        }
-        break;
-
-      case 1:
-        if (lowerData[P_filterPoleSW] == 1) {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("1P LowPass"));
-          }
-        } else {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("2P LowPass"));
-          }
-        }
-        midiCCOut72(CCfilterType, 1);
-        midiCCOut(CCfilterType, 1);
-        srp.writePin(FILTERA_LOWER, HIGH);
-        srp.writePin(FILTERB_LOWER, LOW);
-        srp.writePin(FILTERC_LOWER, LOW);
-        if (wholemode) {
-          srp.writePin(FILTERA_UPPER, HIGH);
-          srp.writePin(FILTERB_UPPER, LOW);
-          srp.writePin(FILTERC_UPPER, LOW);
-        }
-        break;
-
-      case 2:
-        if (lowerData[P_filterPoleSW] == 1) {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("3P HP + 1P LP"));
-          }
-        } else {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("4P HighPass"));
-          }
-        }
-        midiCCOut72(CCfilterType, 2);
-        midiCCOut(CCfilterType, 2);
-        srp.writePin(FILTERA_LOWER, LOW);
-        srp.writePin(FILTERB_LOWER, HIGH);
-        srp.writePin(FILTERC_LOWER, LOW);
-        if (wholemode) {
-          srp.writePin(FILTERA_UPPER, LOW);
-          srp.writePin(FILTERB_UPPER, HIGH);
-          srp.writePin(FILTERC_UPPER, LOW);
-        }
-        break;
-
-      case 3:
-        if (lowerData[P_filterPoleSW] == 1) {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("1P HP + 1P LP"));
-          }
-        } else {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("2P HighPass"));
-          }
-        }
-        midiCCOut72(CCfilterType, 3);
-        midiCCOut(CCfilterType, 3);
-        srp.writePin(FILTERA_LOWER, HIGH);
-        srp.writePin(FILTERB_LOWER, HIGH);
-        srp.writePin(FILTERC_LOWER, LOW);
-        if (wholemode) {
-          srp.writePin(FILTERA_UPPER, HIGH);
-          srp.writePin(FILTERB_UPPER, HIGH);
-          srp.writePin(FILTERC_UPPER, LOW);
-        }
-        break;
-
-      case 4:
-        if (lowerData[P_filterPoleSW] == 1) {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("2P HP + 1P LP"));
-          }
-        } else {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("4P BandPass"));
-          }
-        }
-        midiCCOut72(CCfilterType, 4);
-        midiCCOut(CCfilterType, 4);
-        srp.writePin(FILTERA_LOWER, LOW);
-        srp.writePin(FILTERB_LOWER, LOW);
-        srp.writePin(FILTERC_LOWER, HIGH);
-        if (wholemode) {
-          srp.writePin(FILTERA_UPPER, LOW);
-          srp.writePin(FILTERB_UPPER, LOW);
-          srp.writePin(FILTERC_UPPER, HIGH);
-        }
-        break;
-
-      case 5:
-        if (lowerData[P_filterPoleSW] == 1) {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("2P BP + 1P LP"));
-          }
-        } else {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("2P BandPass"));
-          }
-        }
-        midiCCOut72(CCfilterType, 5);
-        midiCCOut(CCfilterType, 5);
-        srp.writePin(FILTERA_LOWER, HIGH);
-        srp.writePin(FILTERB_LOWER, LOW);
-        srp.writePin(FILTERC_LOWER, HIGH);
-        if (wholemode) {
-          srp.writePin(FILTERA_UPPER, HIGH);
-          srp.writePin(FILTERB_UPPER, LOW);
-          srp.writePin(FILTERC_UPPER, HIGH);
-        }
-        break;
-
-
-      case 6:
-        if (lowerData[P_filterPoleSW] == 1) {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("3P AP + 1P LP"));
-          }
-        } else {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("3P AllPass"));
-          }
-        }
-        midiCCOut72(CCfilterType, 6);
-        midiCCOut(CCfilterType, 6);
-        srp.writePin(FILTERA_LOWER, LOW);
-        srp.writePin(FILTERB_LOWER, HIGH);
-        srp.writePin(FILTERC_LOWER, HIGH);
-        if (wholemode) {
-          srp.writePin(FILTERA_UPPER, LOW);
-          srp.writePin(FILTERB_UPPER, HIGH);
-          srp.writePin(FILTERC_UPPER, HIGH);
-        }
-        break;
-
-      case 7:
-        if (lowerData[P_filterPoleSW] == 1) {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("2P Notch + LP"));
-          }
-        } else {
-          if (announce) {
-            showCurrentParameterPage("Filter Type", String("Notch"));
-          }
-        }
-        midiCCOut72(CCfilterType, 7);
-        midiCCOut(CCfilterType, 7);
-        srp.writePin(FILTERA_LOWER, HIGH);
-        srp.writePin(FILTERB_LOWER, HIGH);
-        srp.writePin(FILTERC_LOWER, HIGH);
-        if (wholemode) {
-          srp.writePin(FILTERA_UPPER, HIGH);
-          srp.writePin(FILTERB_UPPER, HIGH);
-          srp.writePin(FILTERC_UPPER, HIGH);
-        }
-        break;
+    srp.writeField(FILTERA_LOWER, FILTERB_LOWER, FILTERC_LOWER, mode.bits);
+    if (wholemode) {
+      srp.writeField(FILTERA_UPPER, FILTERB_UPPER, FILTERC_UPPER, mode.bits);
     }
   }
 }
@@ -1960,21 +1145,24 @@ void updatekeytrack(boolean announce) {
     showCurrentParameterPage("Keytrack", int(keytrackstr));
   }
   if (upperSW) {
-    midiCCOut62(WSkeytrack, upperData[P_keytrack] >> midioutfrig);
+    voiceLevelOut(2, WSkeytrack, upperData[P_keytrack]);
     midiCCOut(CCkeyTrack, upperData[P_keytrack] >> midioutfrig);
     midiCCOut71(CCkeyTrack, upperData[P_keytrack] >> midioutfrig);
   } else {
-    midiCCOut61(WSkeytrack, lowerData[P_keytrack] >> midioutfrig);
+    voiceLevelOut(1, WSkeytrack, lowerData[P_keytrack]);
     midiCCOut(CCkeyTrack, lowerData[P_keytrack] >> midioutfrig);
     midiCCOut71(CCkeyTrack, lowerData[P_keytrack] >> midioutfrig);
     if (wholemode) {
-      midiCCOut62(WSkeytrack, upperData[P_keytrack] >> midioutfrig);
+      voiceLevelOut(2, WSkeytrack, upperData[P_keytrack]);
     }
   }
 }
 
 void updateLFORate(boolean announce) {
-  if (announce) {
+  if (announce && clockSync) {
+    int rate = upperSW ? upperData[P_LFORate] : lowerData[P_LFORate];
+    showCurrentParameterPage("LFO Rate", LFOTEMPOSTR[rate >> midioutfrig]);
+  } else if (announce) {
     showCurrentParameterPage("LFO Rate", String(LFORatestr) + " Hz");
   }
   if (upperSW) {
@@ -2017,11 +1205,11 @@ void updatePitchBendDepth(boolean announce) {
     showCurrentParameterPage("Pitch Bend Depth", String(PitchBendLevelstr));
   }
   if (upperSW) {
-    midiCCOut62(WSbendRange, upperData[P_PitchBendLevel]);
+    voiceParamOut(2, WSbendRange, upperData[P_PitchBendLevel]);
     midiCCOut(CCPitchBend, upperData[P_PitchBendLevel] >> midioutfrig);
     midiCCOut71(CCPitchBend, map(upperData[P_PitchBendLevel], 0, 12, 0, 127));
   } else {
-    midiCCOut61(WSbendRange, lowerData[P_PitchBendLevel]);
+    voiceParamOut(1, WSbendRange, lowerData[P_PitchBendLevel]);
     midiCCOut(CCPitchBend, lowerData[P_PitchBendLevel] >> midioutfrig);
     midiCCOut71(CCPitchBend, map(upperData[P_PitchBendLevel], 0, 12, 0, 127));
   }
@@ -2080,106 +1268,11 @@ void updateeffectsMix(boolean announce) {
 }
 
 void updateStratusLFOWaveform(boolean announce) {
-  if (!panelData[P_lfoAlt]) {
-    switch (panelData[P_LFOWaveform]) {
-      case 0:
-        StratusLFOWaveform = "Sawtooth Up";
-        LFOWaveCV = 40;
-        midiCCOut72(CCLFOWaveform, 0);
-        break;
-
-      case 1:
-        StratusLFOWaveform = "Sawtooth Down";
-        LFOWaveCV = 160;
-        midiCCOut72(CCLFOWaveform, 1);
-        break;
-
-      case 2:
-        StratusLFOWaveform = "Squarewave";
-        LFOWaveCV = 280;
-        midiCCOut72(CCLFOWaveform, 2);
-        break;
-
-      case 3:
-        StratusLFOWaveform = "Triangle";
-        LFOWaveCV = 400;
-        midiCCOut72(CCLFOWaveform, 3);
-        break;
-
-      case 4:
-        StratusLFOWaveform = "Sinewave";
-        LFOWaveCV = 592;
-        midiCCOut72(CCLFOWaveform, 4);
-        break;
-
-      case 5:
-        StratusLFOWaveform = "Sweeps";
-        LFOWaveCV = 720;
-        midiCCOut72(CCLFOWaveform, 5);
-        break;
-
-      case 6:
-        StratusLFOWaveform = "Lumps";
-        LFOWaveCV = 840;
-        midiCCOut72(CCLFOWaveform, 6);
-        break;
-
-      case 7:
-        StratusLFOWaveform = "Sample & Hold";
-        LFOWaveCV = 968;
-        midiCCOut72(CCLFOWaveform, 7);
-        break;
-    }
-  } else {
-    switch (panelData[P_LFOWaveform]) {
-      case 0:
-        StratusLFOWaveform = "Saw +Oct";
-        LFOWaveCV = 40;
-        midiCCOut72(CCLFOWaveform, 0);
-        break;
-
-      case 1:
-        StratusLFOWaveform = "Quad Saw";
-        LFOWaveCV = 160;
-        midiCCOut72(CCLFOWaveform, 1);
-        break;
-
-      case 2:
-        StratusLFOWaveform = "Quad Pulse";
-        LFOWaveCV = 280;
-        midiCCOut72(CCLFOWaveform, 2);
-        break;
-
-      case 3:
-        StratusLFOWaveform = "Tri Step";
-        LFOWaveCV = 400;
-        midiCCOut72(CCLFOWaveform, 3);
-        break;
-
-      case 4:
-        StratusLFOWaveform = "Sine +Oct";
-        LFOWaveCV = 592;
-        midiCCOut72(CCLFOWaveform, 4);
-        break;
-
-      case 5:
-        StratusLFOWaveform = "Sine +3rd";
-        LFOWaveCV = 720;
-        midiCCOut72(CCLFOWaveform, 5);
-        break;
-
-      case 6:
-        StratusLFOWaveform = "Sine +4th";
-        LFOWaveCV = 840;
-        midiCCOut72(CCLFOWaveform, 6);
-        break;
-
-      case 7:
-        StratusLFOWaveform = "Rand Slopes";
-        LFOWaveCV = 968;
-        midiCCOut72(CCLFOWaveform, 7);
-        break;
-    }
+  int wave = panelData[P_LFOWaveform];
+  if (wave >= 0 && wave < LFO_WAVEFORM_COUNT) {
+    StratusLFOWaveform = panelData[P_lfoAlt] ? LFO_WAVEFORMS[wave].altLabel : LFO_WAVEFORMS[wave].label;
+    LFOWaveCV = LFO_WAVEFORMS[wave].cv;
+    midiCCOut72(CCLFOWaveform, wave);
   }
   if (announce) {
     showCurrentParameterPage("LFO Wave", StratusLFOWaveform);
@@ -2480,9 +1573,7 @@ void updateeffectNumSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effect", "1");
       }
-      srp.writePin(EFFECT_O_UPPER, LOW);
-      srp.writePin(EFFECT_1_UPPER, LOW);
-      srp.writePin(EFFECT_2_UPPER, LOW);
+      srp.writeField(EFFECT_O_UPPER, EFFECT_1_UPPER, EFFECT_2_UPPER, 0b000);
       midiCCOut72(CCeffectNumSW, 0);
       midiCCOut(CCeffectNumSW, 0);
 
@@ -2490,9 +1581,7 @@ void updateeffectNumSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effect", "2");
       }
-      srp.writePin(EFFECT_O_UPPER, HIGH);
-      srp.writePin(EFFECT_1_UPPER, LOW);
-      srp.writePin(EFFECT_2_UPPER, LOW);
+      srp.writeField(EFFECT_O_UPPER, EFFECT_1_UPPER, EFFECT_2_UPPER, 0b001);
       midiCCOut72(CCeffectNumSW, 1);
       midiCCOut(CCeffectNumSW, 1);
 
@@ -2500,9 +1589,7 @@ void updateeffectNumSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effect", "3");
       }
-      srp.writePin(EFFECT_O_UPPER, LOW);
-      srp.writePin(EFFECT_1_UPPER, HIGH);
-      srp.writePin(EFFECT_2_UPPER, LOW);
+      srp.writeField(EFFECT_O_UPPER, EFFECT_1_UPPER, EFFECT_2_UPPER, 0b010);
       midiCCOut72(CCeffectNumSW, 2);
       midiCCOut(CCeffectNumSW, 2);
 
@@ -2510,9 +1597,7 @@ void updateeffectNumSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effect", "4");
       }
-      srp.writePin(EFFECT_O_UPPER, HIGH);
-      srp.writePin(EFFECT_1_UPPER, HIGH);
-      srp.writePin(EFFECT_2_UPPER, LOW);
+      srp.writeField(EFFECT_O_UPPER, EFFECT_1_UPPER, EFFECT_2_UPPER, 0b011);
       midiCCOut72(CCeffectNumSW, 3);
       midiCCOut(CCeffectNumSW, 3);
 
@@ -2520,9 +1605,7 @@ void updateeffectNumSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effect", "5");
       }
-      srp.writePin(EFFECT_O_UPPER, LOW);
-      srp.writePin(EFFECT_1_UPPER, LOW);
-      srp.writePin(EFFECT_2_UPPER, HIGH);
+      srp.writeField(EFFECT_O_UPPER, EFFECT_1_UPPER, EFFECT_2_UPPER, 0b100);
       midiCCOut72(CCeffectNumSW, 4);
       midiCCOut(CCeffectNumSW, 4);
 
@@ -2530,9 +1613,7 @@ void updateeffectNumSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effect", "6");
       }
-      srp.writePin(EFFECT_O_UPPER, HIGH);
-      srp.writePin(EFFECT_1_UPPER, LOW);
-      srp.writePin(EFFECT_2_UPPER, HIGH);
+      srp.writeField(EFFECT_O_UPPER, EFFECT_1_UPPER, EFFECT_2_UPPER, 0b101);
       midiCCOut72(CCeffectNumSW, 5);
       midiCCOut(CCeffectNumSW, 5);
 
@@ -2540,9 +1621,7 @@ void updateeffectNumSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effect", "7");
       }
-      srp.writePin(EFFECT_O_UPPER, LOW);
-      srp.writePin(EFFECT_1_UPPER, HIGH);
-      srp.writePin(EFFECT_2_UPPER, HIGH);
+      srp.writeField(EFFECT_O_UPPER, EFFECT_1_UPPER, EFFECT_2_UPPER, 0b110);
       midiCCOut72(CCeffectNumSW, 6);
       midiCCOut(CCeffectNumSW, 6);
 
@@ -2550,9 +1629,7 @@ void updateeffectNumSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effect", "8");
       }
-      srp.writePin(EFFECT_O_UPPER, HIGH);
-      srp.writePin(EFFECT_1_UPPER, HIGH);
-      srp.writePin(EFFECT_2_UPPER, HIGH);
+      srp.writeField(EFFECT_O_UPPER, EFFECT_1_UPPER, EFFECT_2_UPPER, 0b111);
       midiCCOut72(CCeffectNumSW, 7);
       midiCCOut(CCeffectNumSW, 7);
     }
@@ -2562,13 +1639,9 @@ void updateeffectNumSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effect", "1");
       }
-      srp.writePin(EFFECT_0_LOWER, LOW);
-      srp.writePin(EFFECT_1_LOWER, LOW);
-      srp.writePin(EFFECT_2_LOWER, LOW);
+      srp.writeField(EFFECT_0_LOWER, EFFECT_1_LOWER, EFFECT_2_LOWER, 0b000);
       if (wholemode) {
-        srp.writePin(EFFECT_O_UPPER, LOW);
-        srp.writePin(EFFECT_1_UPPER, LOW);
-        srp.writePin(EFFECT_2_UPPER, LOW);
+        srp.writeField(EFFECT_O_UPPER, EFFECT_1_UPPER, EFFECT_2_UPPER, 0b000);
       }
       midiCCOut72(CCeffectNumSW, 0);
       midiCCOut(CCeffectNumSW, 0);
@@ -2577,13 +1650,9 @@ void updateeffectNumSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effect", "2");
       }
-      srp.writePin(EFFECT_0_LOWER, HIGH);
-      srp.writePin(EFFECT_1_LOWER, LOW);
-      srp.writePin(EFFECT_2_LOWER, LOW);
+      srp.writeField(EFFECT_0_LOWER, EFFECT_1_LOWER, EFFECT_2_LOWER, 0b001);
       if (wholemode) {
-        srp.writePin(EFFECT_O_UPPER, HIGH);
-        srp.writePin(EFFECT_1_UPPER, LOW);
-        srp.writePin(EFFECT_2_UPPER, LOW);
+        srp.writeField(EFFECT_O_UPPER, EFFECT_1_UPPER, EFFECT_2_UPPER, 0b001);
       }
       midiCCOut72(CCeffectNumSW, 1);
       midiCCOut(CCeffectNumSW, 1);
@@ -2592,13 +1661,9 @@ void updateeffectNumSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effect", "3");
       }
-      srp.writePin(EFFECT_0_LOWER, LOW);
-      srp.writePin(EFFECT_1_LOWER, HIGH);
-      srp.writePin(EFFECT_2_LOWER, LOW);
+      srp.writeField(EFFECT_0_LOWER, EFFECT_1_LOWER, EFFECT_2_LOWER, 0b010);
       if (wholemode) {
-        srp.writePin(EFFECT_O_UPPER, LOW);
-        srp.writePin(EFFECT_1_UPPER, HIGH);
-        srp.writePin(EFFECT_2_UPPER, LOW);
+        srp.writeField(EFFECT_O_UPPER, EFFECT_1_UPPER, EFFECT_2_UPPER, 0b010);
       }
       midiCCOut72(CCeffectNumSW, 2);
       midiCCOut(CCeffectNumSW, 2);
@@ -2607,13 +1672,9 @@ void updateeffectNumSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effect", "4");
       }
-      srp.writePin(EFFECT_0_LOWER, HIGH);
-      srp.writePin(EFFECT_1_LOWER, HIGH);
-      srp.writePin(EFFECT_2_LOWER, LOW);
+      srp.writeField(EFFECT_0_LOWER, EFFECT_1_LOWER, EFFECT_2_LOWER, 0b011);
       if (wholemode) {
-        srp.writePin(EFFECT_O_UPPER, HIGH);
-        srp.writePin(EFFECT_1_UPPER, HIGH);
-        srp.writePin(EFFECT_2_UPPER, LOW);
+        srp.writeField(EFFECT_O_UPPER, EFFECT_1_UPPER, EFFECT_2_UPPER, 0b011);
       }
       midiCCOut72(CCeffectNumSW, 3);
       midiCCOut(CCeffectNumSW, 3);
@@ -2622,13 +1683,9 @@ void updateeffectNumSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effect", "5");
       }
-      srp.writePin(EFFECT_0_LOWER, LOW);
-      srp.writePin(EFFECT_1_LOWER, LOW);
-      srp.writePin(EFFECT_2_LOWER, HIGH);
+      srp.writeField(EFFECT_0_LOWER, EFFECT_1_LOWER, EFFECT_2_LOWER, 0b100);
       if (wholemode) {
-        srp.writePin(EFFECT_O_UPPER, LOW);
-        srp.writePin(EFFECT_1_UPPER, LOW);
-        srp.writePin(EFFECT_2_UPPER, HIGH);
+        srp.writeField(EFFECT_O_UPPER, EFFECT_1_UPPER, EFFECT_2_UPPER, 0b100);
       }
       midiCCOut72(CCeffectNumSW, 4);
       midiCCOut(CCeffectNumSW, 4);
@@ -2637,13 +1694,9 @@ void updateeffectNumSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effect", "6");
       }
-      srp.writePin(EFFECT_0_LOWER, HIGH);
-      srp.writePin(EFFECT_1_LOWER, LOW);
-      srp.writePin(EFFECT_2_LOWER, HIGH);
+      srp.writeField(EFFECT_0_LOWER, EFFECT_1_LOWER, EFFECT_2_LOWER, 0b101);
       if (wholemode) {
-        srp.writePin(EFFECT_O_UPPER, HIGH);
-        srp.writePin(EFFECT_1_UPPER, LOW);
-        srp.writePin(EFFECT_2_UPPER, HIGH);
+        srp.writeField(EFFECT_O_UPPER, EFFECT_1_UPPER, EFFECT_2_UPPER, 0b101);
       }
       midiCCOut72(CCeffectNumSW, 5);
       midiCCOut(CCeffectNumSW, 5);
@@ -2652,13 +1705,9 @@ void updateeffectNumSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effect", "7");
       }
-      srp.writePin(EFFECT_0_LOWER, LOW);
-      srp.writePin(EFFECT_1_LOWER, HIGH);
-      srp.writePin(EFFECT_2_LOWER, HIGH);
+      srp.writeField(EFFECT_0_LOWER, EFFECT_1_LOWER, EFFECT_2_LOWER, 0b110);
       if (wholemode) {
-        srp.writePin(EFFECT_O_UPPER, LOW);
-        srp.writePin(EFFECT_1_UPPER, HIGH);
-        srp.writePin(EFFECT_2_UPPER, HIGH);
+        srp.writeField(EFFECT_O_UPPER, EFFECT_1_UPPER, EFFECT_2_UPPER, 0b110);
       }
       midiCCOut72(CCeffectNumSW, 6);
       midiCCOut(CCeffectNumSW, 6);
@@ -2667,13 +1716,9 @@ void updateeffectNumSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effect", "8");
       }
-      srp.writePin(EFFECT_0_LOWER, HIGH);
-      srp.writePin(EFFECT_1_LOWER, HIGH);
-      srp.writePin(EFFECT_2_LOWER, HIGH);
+      srp.writeField(EFFECT_0_LOWER, EFFECT_1_LOWER, EFFECT_2_LOWER, 0b111);
       if (wholemode) {
-        srp.writePin(EFFECT_O_UPPER, HIGH);
-        srp.writePin(EFFECT_1_UPPER, HIGH);
-        srp.writePin(EFFECT_2_UPPER, HIGH);
+        srp.writeField(EFFECT_O_UPPER, EFFECT_1_UPPER, EFFECT_2_UPPER, 0b111);
       }
       midiCCOut72(CCeffectNumSW, 7);
       midiCCOut(CCeffectNumSW, 7);
@@ -2687,36 +1732,28 @@ void updateeffectBankSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effects", "Bank 1");
       }
-      srp.writePin(EFFECT_BANK_1_UPPER, LOW);
-      srp.writePin(EFFECT_BANK_2_UPPER, LOW);
-      srp.writePin(EFFECT_BANK_3_UPPER, LOW);
+      srp.writeField(EFFECT_BANK_1_UPPER, EFFECT_BANK_2_UPPER, EFFECT_BANK_3_UPPER, 0b000);
       midiCCOut72(CCeffectBankSW, 0);
       midiCCOut(CCeffectBankSW, 0);
     } else if (upperData[P_effectBank] == 1) {
       if (announce) {
         showCurrentParameterPage("Effects", "Bank 2");
       }
-      srp.writePin(EFFECT_BANK_1_UPPER, HIGH);
-      srp.writePin(EFFECT_BANK_2_UPPER, LOW);
-      srp.writePin(EFFECT_BANK_3_UPPER, LOW);
+      srp.writeField(EFFECT_BANK_1_UPPER, EFFECT_BANK_2_UPPER, EFFECT_BANK_3_UPPER, 0b001);
       midiCCOut72(CCeffectBankSW, 1);
       midiCCOut(CCeffectBankSW, 1);
     } else if (upperData[P_effectBank] == 2) {
       if (announce) {
         showCurrentParameterPage("Effects", "Bank 3");
       }
-      srp.writePin(EFFECT_BANK_1_UPPER, LOW);
-      srp.writePin(EFFECT_BANK_2_UPPER, HIGH);
-      srp.writePin(EFFECT_BANK_3_UPPER, LOW);
+      srp.writeField(EFFECT_BANK_1_UPPER, EFFECT_BANK_2_UPPER, EFFECT_BANK_3_UPPER, 0b010);
       midiCCOut72(CCeffectBankSW, 2);
       midiCCOut(CCeffectBankSW, 2);
     } else if (upperData[P_effectBank] == 3) {
       if (announce) {
         showCurrentParameterPage("Effects", "Bank 4");
       }
-      srp.writePin(EFFECT_BANK_1_UPPER, HIGH);
-      srp.writePin(EFFECT_BANK_2_UPPER, HIGH);
-      srp.writePin(EFFECT_BANK_3_UPPER, LOW);
+      srp.writeField(EFFECT_BANK_1_UPPER, EFFECT_BANK_2_UPPER, EFFECT_BANK_3_UPPER, 0b011);
       midiCCOut72(CCeffectBankSW, 3);
       midiCCOut(CCeffectBankSW, 3);
     }
@@ -2725,13 +1762,9 @@ void updateeffectBankSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effects", "Bank 1");
       }
-      srp.writePin(EFFECT_BANK_1_LOWER, LOW);
-      srp.writePin(EFFECT_BANK_2_LOWER, LOW);
-      srp.writePin(EFFECT_BANK_3_LOWER, LOW);
+      srp.writeField(EFFECT_BANK_1_LOWER, EFFECT_BANK_2_LOWER, EFFECT_BANK_3_LOWER, 0b000);
       if (wholemode) {
-        srp.writePin(EFFECT_BANK_1_UPPER, LOW);
-        srp.writePin(EFFECT_BANK_2_UPPER, LOW);
-        srp.writePin(EFFECT_BANK_3_UPPER, LOW);
+        srp.writeField(EFFECT_BANK_1_UPPER, EFFECT_BANK_2_UPPER, EFFECT_BANK_3_UPPER, 0b000);
       }
       midiCCOut72(CCeffectBankSW, 0);
       midiCCOut(CCeffectBankSW, 0);
@@ -2739,13 +1772,9 @@ void updateeffectBankSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effects", "Bank 2");
       }
-      srp.writePin(EFFECT_BANK_1_LOWER, HIGH);
-      srp.writePin(EFFECT_BANK_2_LOWER, LOW);
-      srp.writePin(EFFECT_BANK_3_LOWER, LOW);
+      srp.writeField(EFFECT_BANK_1_LOWER, EFFECT_BANK_2_LOWER, EFFECT_BANK_3_LOWER, 0b001);
       if (wholemode) {
-        srp.writePin(EFFECT_BANK_1_UPPER, HIGH);
-        srp.writePin(EFFECT_BANK_2_UPPER, LOW);
-        srp.writePin(EFFECT_BANK_3_UPPER, LOW);
+        srp.writeField(EFFECT_BANK_1_UPPER, EFFECT_BANK_2_UPPER, EFFECT_BANK_3_UPPER, 0b001);
       }
       midiCCOut72(CCeffectBankSW, 1);
       midiCCOut(CCeffectBankSW, 1);
@@ -2753,13 +1782,9 @@ void updateeffectBankSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effects", "Bank 3");
       }
-      srp.writePin(EFFECT_BANK_1_LOWER, LOW);
-      srp.writePin(EFFECT_BANK_2_LOWER, HIGH);
-      srp.writePin(EFFECT_BANK_3_LOWER, LOW);
+      srp.writeField(EFFECT_BANK_1_LOWER, EFFECT_BANK_2_LOWER, EFFECT_BANK_3_LOWER, 0b010);
       if (wholemode) {
-        srp.writePin(EFFECT_BANK_1_UPPER, LOW);
-        srp.writePin(EFFECT_BANK_2_UPPER, HIGH);
-        srp.writePin(EFFECT_BANK_3_UPPER, LOW);
+        srp.writeField(EFFECT_BANK_1_UPPER, EFFECT_BANK_2_UPPER, EFFECT_BANK_3_UPPER, 0b010);
       }
       midiCCOut72(CCeffectBankSW, 2);
       midiCCOut(CCeffectBankSW, 2);
@@ -2767,13 +1792,9 @@ void updateeffectBankSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Effects", "Bank 4");
       }
-      srp.writePin(EFFECT_BANK_1_LOWER, HIGH);
-      srp.writePin(EFFECT_BANK_2_LOWER, HIGH);
-      srp.writePin(EFFECT_BANK_3_LOWER, LOW);
+      srp.writeField(EFFECT_BANK_1_LOWER, EFFECT_BANK_2_LOWER, EFFECT_BANK_3_LOWER, 0b011);
       if (wholemode) {
-        srp.writePin(EFFECT_BANK_1_UPPER, HIGH);
-        srp.writePin(EFFECT_BANK_2_UPPER, HIGH);
-        srp.writePin(EFFECT_BANK_3_UPPER, LOW);
+        srp.writeField(EFFECT_BANK_1_UPPER, EFFECT_BANK_2_UPPER, EFFECT_BANK_3_UPPER, 0b011);
       }
       midiCCOut72(CCeffectBankSW, 3);
       midiCCOut(CCeffectBankSW, 3);
@@ -2782,126 +1803,22 @@ void updateeffectBankSW(boolean announce) {
 }
 
 void updatelfoMultiplier(boolean announce) {
+  int multiplier = upperSW ? upperData[P_lfoMultiplier] : lowerData[P_lfoMultiplier];
+  if (multiplier < 0 || multiplier >= LFO_MULTIPLIER_COUNT) return;
+  const LfoMultiplier &mode = LFO_MULTIPLIERS[multiplier];
+  if (announce) {
+    showCurrentParameterPage("LFO Multiplier", mode.label);
+  }
   if (upperSW) {
-    if (upperData[P_lfoMultiplier] == 0) {
-      if (announce) {
-        showCurrentParameterPage("LFO Multiplier", "x0.5");
-      }
-      srp.writePin(LFO_MULTI_BIT0_UPPER, LOW);
-      srp.writePin(LFO_MULTI_BIT1_UPPER, LOW);
-      srp.writePin(LFO_MULTI_BIT2_UPPER, LOW);
-      midiCCOut72(CClfoMult, 0);
-      midiCCOut(CClfoMult, 0);
-    } else if (upperData[P_lfoMultiplier] == 1) {
-      if (announce) {
-        showCurrentParameterPage("LFO Multiplier", "x1.0");
-      }
-      srp.writePin(LFO_MULTI_BIT0_UPPER, HIGH);
-      srp.writePin(LFO_MULTI_BIT1_UPPER, LOW);
-      srp.writePin(LFO_MULTI_BIT2_UPPER, LOW);
-      midiCCOut72(CClfoMult, 1);
-      midiCCOut(CClfoMult, 1);
-    } else if (upperData[P_lfoMultiplier] == 2) {
-      if (announce) {
-        showCurrentParameterPage("LFO Multiplier", "x1.5");
-      }
-      srp.writePin(LFO_MULTI_BIT0_UPPER, LOW);
-      srp.writePin(LFO_MULTI_BIT1_UPPER, HIGH);
-      srp.writePin(LFO_MULTI_BIT2_UPPER, LOW);
-      midiCCOut72(CClfoMult, 2);
-      midiCCOut(CClfoMult, 2);
-    } else if (upperData[P_lfoMultiplier] == 3) {
-      if (announce) {
-        showCurrentParameterPage("LFO Multiplier", "x2.0");
-      }
-      srp.writePin(LFO_MULTI_BIT0_UPPER, HIGH);
-      srp.writePin(LFO_MULTI_BIT1_UPPER, HIGH);
-      srp.writePin(LFO_MULTI_BIT2_UPPER, LOW);
-      midiCCOut72(CClfoMult, 3);
-      midiCCOut(CClfoMult, 3);
-    } else if (upperData[P_lfoMultiplier] == 4) {
-      if (announce) {
-        showCurrentParameterPage("LFO Multiplier", "x2.5");
-      }
-      srp.writePin(LFO_MULTI_BIT0_UPPER, LOW);
-      srp.writePin(LFO_MULTI_BIT1_UPPER, LOW);
-      srp.writePin(LFO_MULTI_BIT2_UPPER, HIGH);
-      midiCCOut72(CClfoMult, 4);
-      midiCCOut(CClfoMult, 4);
-    }
+    srp.writeField(LFO_MULTI_BIT0_UPPER, LFO_MULTI_BIT1_UPPER, LFO_MULTI_BIT2_UPPER, mode.bits);
   } else {
-    if (lowerData[P_lfoMultiplier] == 0) {
-      if (announce) {
-        showCurrentParameterPage("LFO Multiplier", "x0.5");
-      }
-      srp.writePin(LFO_MULTI_BIT0_LOWER, LOW);
-      srp.writePin(LFO_MULTI_BIT1_LOWER, LOW);
-      srp.writePin(LFO_MULTI_BIT2_LOWER, LOW);
-      if (wholemode) {
-        srp.writePin(LFO_MULTI_BIT0_UPPER, LOW);
-        srp.writePin(LFO_MULTI_BIT1_UPPER, LOW);
-        srp.writePin(LFO_MULTI_BIT2_UPPER, LOW);
-      }
-      midiCCOut72(CClfoMult, 0);
-      midiCCOut(CClfoMult, 0);
-    } else if (lowerData[P_lfoMultiplier] == 1) {
-      if (announce) {
-        showCurrentParameterPage("LFO Multiplier", "x1.0");
-      }
-      srp.writePin(LFO_MULTI_BIT0_LOWER, HIGH);
-      srp.writePin(LFO_MULTI_BIT1_LOWER, LOW);
-      srp.writePin(LFO_MULTI_BIT2_LOWER, LOW);
-      if (wholemode) {
-        srp.writePin(LFO_MULTI_BIT0_UPPER, HIGH);
-        srp.writePin(LFO_MULTI_BIT1_UPPER, LOW);
-        srp.writePin(LFO_MULTI_BIT2_UPPER, LOW);
-      }
-      midiCCOut72(CClfoMult, 1);
-      midiCCOut(CClfoMult, 1);
-    } else if (lowerData[P_lfoMultiplier] == 2) {
-      if (announce) {
-        showCurrentParameterPage("LFO Multiplier", "x1.5");
-      }
-      srp.writePin(LFO_MULTI_BIT0_LOWER, LOW);
-      srp.writePin(LFO_MULTI_BIT1_LOWER, HIGH);
-      srp.writePin(LFO_MULTI_BIT2_LOWER, LOW);
-      if (wholemode) {
-        srp.writePin(LFO_MULTI_BIT0_UPPER, LOW);
-        srp.writePin(LFO_MULTI_BIT1_UPPER, HIGH);
-        srp.writePin(LFO_MULTI_BIT2_UPPER, LOW);
-      }
-      midiCCOut72(CClfoMult, 2);
-      midiCCOut(CClfoMult, 2);
-    } else if (lowerData[P_lfoMultiplier] == 3) {
-      if (announce) {
-        showCurrentParameterPage("LFO Multiplier", "x2.0");
-      }
-      srp.writePin(LFO_MULTI_BIT0_LOWER, HIGH);
-      srp.writePin(LFO_MULTI_BIT1_LOWER, HIGH);
-      srp.writePin(LFO_MULTI_BIT2_LOWER, LOW);
-      if (wholemode) {
-        srp.writePin(LFO_MULTI_BIT0_UPPER, HIGH);
-        srp.writePin(LFO_MULTI_BIT1_UPPER, HIGH);
-        srp.writePin(LFO_MULTI_BIT2_UPPER, LOW);
-      }
-      midiCCOut72(CClfoMult, 3);
-      midiCCOut(CClfoMult, 3);
-    } else if (lowerData[P_lfoMultiplier] == 4) {
-      if (announce) {
-        showCurrentParameterPage("LFO Multiplier", "x2.5");
-      }
-      srp.writePin(LFO_MULTI_BIT0_LOWER, LOW);
-      srp.writePin(LFO_MULTI_BIT1_LOWER, LOW);
-      srp.writePin(LFO_MULTI_BIT2_LOWER, HIGH);
-      if (wholemode) {
-        srp.writePin(LFO_MULTI_BIT0_UPPER, LOW);
-        srp.writePin(LFO_MULTI_BIT1_UPPER, LOW);
-        srp.writePin(LFO_MULTI_BIT2_UPPER, HIGH);
-      }
-      midiCCOut72(CClfoMult, 4);
-      midiCCOut(CClfoMult, 4);
+    srp.writeField(LFO_MULTI_BIT0_LOWER, LFO_MULTI_BIT1_LOWER, LFO_MULTI_BIT2_LOWER, mode.bits);
+    if (wholemode) {
+      srp.writeField(LFO_MULTI_BIT0_UPPER, LFO_MULTI_BIT1_UPPER, LFO_MULTI_BIT2_UPPER, mode.bits);
     }
   }
+  midiCCOut72(CClfoMult, multiplier);
+  midiCCOut(CClfoMult, multiplier);
 }
 
 void updateglideSW(boolean announce) {
@@ -2910,14 +1827,14 @@ void updateglideSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Glide", "Off");
       }
-      midiCCOut62(CCglideSW, 0);
+      voiceParamOut(2, CCglideSW, 0);
       midiCCOut72(CCglideSW, 0);
     } else {
       if (announce) {
         showCurrentParameterPage("Glide", "On");
       }
-      midiCCOut62(CCglideTime, upperData[P_glideTime] >> midioutfrig);
-      midiCCOut62(CCglideSW, 127);
+      voiceLevelOut(2, CCglideTime, upperData[P_glideTime]);
+      voiceParamOut(2, CCglideSW, 127);
       midiCCOut71(CCglideTime, upperData[P_glideTime] >> midioutfrig);
       midiCCOut72(CCglideSW, 1);
     }
@@ -2926,22 +1843,22 @@ void updateglideSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Glide", "Off");
       }
-      midiCCOut61(CCglideSW, 0);
+      voiceParamOut(1, CCglideSW, 0);
       midiCCOut72(CCglideSW, 0);
       if (wholemode) {
-        midiCCOut62(CCglideSW, 0);
+        voiceParamOut(2, CCglideSW, 0);
       }
     } else {
       if (announce) {
         showCurrentParameterPage("Glide", "On");
       }
-      midiCCOut61(CCglideTime, lowerData[P_glideTime] >> midioutfrig);
-      midiCCOut61(CCglideSW, 127);
+      voiceLevelOut(1, CCglideTime, lowerData[P_glideTime]);
+      voiceParamOut(1, CCglideSW, 127);
       midiCCOut71(CCglideTime, lowerData[P_glideTime] >> midioutfrig);
       midiCCOut72(CCglideSW, 1);
       if (wholemode) {
-        midiCCOut62(CCglideTime, upperData[P_glideTime] >> midioutfrig);
-        midiCCOut62(CCglideSW, 1);
+        voiceLevelOut(2, CCglideTime, upperData[P_glideTime]);
+        voiceParamOut(2, CCglideSW, 1);
       }
     }
   }
@@ -3002,8 +1919,7 @@ void updatefilterLoop(boolean announce) {
         }
         midiCCOut72(CCFilterLoop, 0);
         midiCCOut(CCFilterLoop, 0);
-        srp.writePin(FILTER_MODE_BIT0_UPPER, LOW);
-        srp.writePin(FILTER_MODE_BIT1_UPPER, LOW);
+        srp.writeField(FILTER_MODE_BIT0_UPPER, FILTER_MODE_BIT1_UPPER, 0b00);
         break;
 
       case 1:
@@ -3012,8 +1928,7 @@ void updatefilterLoop(boolean announce) {
         }
         midiCCOut72(CCFilterLoop, 1);
         midiCCOut(CCFilterLoop, 63);
-        srp.writePin(FILTER_MODE_BIT0_UPPER, HIGH);
-        srp.writePin(FILTER_MODE_BIT1_UPPER, LOW);
+        srp.writeField(FILTER_MODE_BIT0_UPPER, FILTER_MODE_BIT1_UPPER, 0b01);
         break;
 
       case 2:
@@ -3022,8 +1937,7 @@ void updatefilterLoop(boolean announce) {
         }
         midiCCOut72(CCFilterLoop, 2);
         midiCCOut(CCFilterLoop, 127);
-        srp.writePin(FILTER_MODE_BIT0_UPPER, HIGH);
-        srp.writePin(FILTER_MODE_BIT1_UPPER, HIGH);
+        srp.writeField(FILTER_MODE_BIT0_UPPER, FILTER_MODE_BIT1_UPPER, 0b11);
         break;
     }
   } else {
@@ -3034,11 +1948,9 @@ void updatefilterLoop(boolean announce) {
         }
         midiCCOut72(CCFilterLoop, 0);
         midiCCOut(CCFilterLoop, 0);
-        srp.writePin(FILTER_MODE_BIT0_LOWER, LOW);
-        srp.writePin(FILTER_MODE_BIT1_LOWER, LOW);
+        srp.writeField(FILTER_MODE_BIT0_LOWER, FILTER_MODE_BIT1_LOWER, 0b00);
         if (wholemode) {
-          srp.writePin(FILTER_MODE_BIT0_UPPER, LOW);
-          srp.writePin(FILTER_MODE_BIT1_UPPER, LOW);
+          srp.writeField(FILTER_MODE_BIT0_UPPER, FILTER_MODE_BIT1_UPPER, 0b00);
         }
         break;
 
@@ -3048,11 +1960,9 @@ void updatefilterLoop(boolean announce) {
         }
         midiCCOut72(CCFilterLoop, 1);
         midiCCOut(CCFilterLoop, 63);
-        srp.writePin(FILTER_MODE_BIT0_LOWER, HIGH);
-        srp.writePin(FILTER_MODE_BIT1_LOWER, LOW);
+        srp.writeField(FILTER_MODE_BIT0_LOWER, FILTER_MODE_BIT1_LOWER, 0b01);
         if (wholemode) {
-          srp.writePin(FILTER_MODE_BIT0_UPPER, HIGH);
-          srp.writePin(FILTER_MODE_BIT1_UPPER, LOW);
+          srp.writeField(FILTER_MODE_BIT0_UPPER, FILTER_MODE_BIT1_UPPER, 0b01);
         }
         break;
 
@@ -3062,11 +1972,9 @@ void updatefilterLoop(boolean announce) {
         }
         midiCCOut72(CCFilterLoop, 2);
         midiCCOut(CCFilterLoop, 127);
-        srp.writePin(FILTER_MODE_BIT0_LOWER, HIGH);
-        srp.writePin(FILTER_MODE_BIT1_LOWER, HIGH);
+        srp.writeField(FILTER_MODE_BIT0_LOWER, FILTER_MODE_BIT1_LOWER, 0b11);
         if (wholemode) {
-          srp.writePin(FILTER_MODE_BIT0_UPPER, HIGH);
-          srp.writePin(FILTER_MODE_BIT1_UPPER, HIGH);
+          srp.writeField(FILTER_MODE_BIT0_UPPER, FILTER_MODE_BIT1_UPPER, 0b11);
         }
         break;
     }
@@ -3206,14 +2114,14 @@ void updatekeytrackSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Keytrack", "Off");
       }
-      midiCCOut62(WSkeytrackSW, 0);
+      voiceParamOut(2, WSkeytrackSW, 0);
       midiCCOut(CCkeyTrackSW, 0);
       midiCCOut72(CCkeyTrackSW, 0);
     } else {
       if (announce) {
         showCurrentParameterPage("Keytrack", "On");
       }
-      midiCCOut62(WSkeytrackSW, 127);
+      voiceParamOut(2, WSkeytrackSW, 127);
       midiCCOut(CCkeyTrackSW, 127);
       midiCCOut72(CCkeyTrackSW, 1);
     }
@@ -3222,21 +2130,21 @@ void updatekeytrackSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Keytrack", "Off");
       }
-      midiCCOut61(WSkeytrackSW, 0);
+      voiceParamOut(1, WSkeytrackSW, 0);
       midiCCOut(CCkeyTrackSW, 0);
       midiCCOut72(CCkeyTrackSW, 0);
       if (wholemode) {
-        midiCCOut62(WSkeytrackSW, 0);
+        voiceParamOut(2, WSkeytrackSW, 0);
       }
     } else {
       if (announce) {
         showCurrentParameterPage("Keytrack", "On");
       }
-      midiCCOut61(WSkeytrackSW, 127);
+      voiceParamOut(1, WSkeytrackSW, 127);
       midiCCOut(CCkeyTrackSW, 127);
       midiCCOut72(CCkeyTrackSW, 1);
       if (wholemode) {
-        midiCCOut62(WSkeytrackSW, 127);
+        voiceParamOut(2, WSkeytrackSW, 127);
       }
     }
   }
@@ -3248,7 +2156,7 @@ void updatesyncSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Sync", "Off");
       }
-      midiCCOut62(WSsyncW, 0);
+      voiceParamOut(2, WSsyncW, 0);
       midiCCOut(CCsyncSW, 0);
       midiCCOut72(CCsyncSW, 0);
       srp.writePin(SYNC_UPPER, LOW);
@@ -3256,7 +2164,7 @@ void updatesyncSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Sync", "On");
       }
-      midiCCOut62(WSsyncW, 127);
+      voiceParamOut(2, WSsyncW, 127);
       midiCCOut(CCsyncSW, 127);
       midiCCOut72(CCsyncSW, 1);
       srp.writePin(SYNC_UPPER, HIGH);
@@ -3266,24 +2174,24 @@ void updatesyncSW(boolean announce) {
       if (announce) {
         showCurrentParameterPage("Sync", "Off");
       }
-      midiCCOut61(WSsyncW, 0);
+      voiceParamOut(1, WSsyncW, 0);
       midiCCOut(CCsyncSW, 0);
       midiCCOut72(CCsyncSW, 0);
       srp.writePin(SYNC_LOWER, LOW);
       if (wholemode) {
-        midiCCOut62(WSsyncW, 0);
+        voiceParamOut(2, WSsyncW, 0);
         srp.writePin(SYNC_UPPER, LOW);
       }
     } else {
       if (announce) {
         showCurrentParameterPage("Sync", "On");
       }
-      midiCCOut61(WSsyncW, 127);
+      voiceParamOut(1, WSsyncW, 127);
       midiCCOut(CCsyncSW, 127);
       midiCCOut72(CCsyncSW, 1);
       srp.writePin(SYNC_LOWER, HIGH);
       if (wholemode) {
-        midiCCOut62(WSsyncW, 127);
+        voiceParamOut(2, WSsyncW, 127);
         srp.writePin(SYNC_UPPER, HIGH);
       }
     }
@@ -3482,8 +2390,7 @@ void updatevcaLoop(boolean announce) {
         }
         midiCCOut72(CCAmpLoop, 0);
         midiCCOut(CCAmpLoop, 0);
-        srp.writePin(AMP_MODE_BIT0_UPPER, LOW);
-        srp.writePin(AMP_MODE_BIT1_UPPER, LOW);
+        srp.writeField(AMP_MODE_BIT0_UPPER, AMP_MODE_BIT1_UPPER, 0b00);
         break;
 
       case 1:
@@ -3492,8 +2399,7 @@ void updatevcaLoop(boolean announce) {
         }
         midiCCOut72(CCAmpLoop, 1);
         midiCCOut(CCAmpLoop, 63);
-        srp.writePin(AMP_MODE_BIT0_UPPER, HIGH);
-        srp.writePin(AMP_MODE_BIT1_UPPER, LOW);
+        srp.writeField(AMP_MODE_BIT0_UPPER, AMP_MODE_BIT1_UPPER, 0b01);
         break;
 
       case 2:
@@ -3502,8 +2408,7 @@ void updatevcaLoop(boolean announce) {
         }
         midiCCOut72(CCAmpLoop, 2);
         midiCCOut(CCAmpLoop, 127);
-        srp.writePin(AMP_MODE_BIT0_UPPER, HIGH);
-        srp.writePin(AMP_MODE_BIT1_UPPER, HIGH);
+        srp.writeField(AMP_MODE_BIT0_UPPER, AMP_MODE_BIT1_UPPER, 0b11);
         break;
     }
   } else {
@@ -3514,11 +2419,9 @@ void updatevcaLoop(boolean announce) {
         }
         midiCCOut72(CCAmpLoop, 0);
         midiCCOut(CCAmpLoop, 0);
-        srp.writePin(AMP_MODE_BIT0_LOWER, LOW);
-        srp.writePin(AMP_MODE_BIT1_LOWER, LOW);
+        srp.writeField(AMP_MODE_BIT0_LOWER, AMP_MODE_BIT1_LOWER, 0b00);
         if (wholemode) {
-          srp.writePin(AMP_MODE_BIT0_UPPER, LOW);
-          srp.writePin(AMP_MODE_BIT1_UPPER, LOW);
+          srp.writeField(AMP_MODE_BIT0_UPPER, AMP_MODE_BIT1_UPPER, 0b00);
         }
         break;
 
@@ -3528,11 +2431,9 @@ void updatevcaLoop(boolean announce) {
         }
         midiCCOut72(CCAmpLoop, 1);
         midiCCOut(CCAmpLoop, 63);
-        srp.writePin(AMP_MODE_BIT0_LOWER, HIGH);
-        srp.writePin(AMP_MODE_BIT1_LOWER, LOW);
+        srp.writeField(AMP_MODE_BIT0_LOWER, AMP_MODE_BIT1_LOWER, 0b01);
         if (wholemode) {
-          srp.writePin(AMP_MODE_BIT0_UPPER, HIGH);
-          srp.writePin(AMP_MODE_BIT1_UPPER, LOW);
+          srp.writeField(AMP_MODE_BIT0_UPPER, AMP_MODE_BIT1_UPPER, 0b01);
         }
         break;
 
@@ -3542,11 +2443,9 @@ void updatevcaLoop(boolean announce) {
         }
         midiCCOut72(CCAmpLoop, 2);
         midiCCOut(CCAmpLoop, 127);
-        srp.writePin(AMP_MODE_BIT0_LOWER, HIGH);
-        srp.writePin(AMP_MODE_BIT1_LOWER, HIGH);
+        srp.writeField(AMP_MODE_BIT0_LOWER, AMP_MODE_BIT1_LOWER, 0b11);
         if (wholemode) {
-          srp.writePin(AMP_MODE_BIT0_UPPER, HIGH);
-          srp.writePin(AMP_MODE_BIT1_UPPER, HIGH);
+          srp.writeField(AMP_MODE_BIT0_UPPER, AMP_MODE_BIT1_UPPER, 0b11);
         }
         break;
     }
@@ -3746,602 +2645,235 @@ void updatePatchname() {
 }
 
 void myControlChange(byte channel, byte control, int value) {
+  POT_STAGE(POT_STAGE_CONTROL);
+  ccDispatch(upperData, lowerData, control, value, upperSW, wholemode);
 
   switch (control) {
+    case CCmodwheel:
+      modSource(MOD_SRC_WHEEL, value);
+      break;
+
     case CCpwLFO:
-      if (upperSW) {
-        upperData[P_pwLFO] = value;
-      } else {
-        lowerData[P_pwLFO] = value;
-        if (wholemode) {
-          upperData[P_pwLFO] = value;
-        }
-      }
       pwLFOstr = value >> midioutfrig;  // for display
       updatepwLFO(1);
       break;
 
     case CCfmDepth:
-      if (upperSW) {
-        upperData[P_fmDepth] = value;
-      } else {
-        lowerData[P_fmDepth] = value;
-        if (wholemode) {
-          upperData[P_fmDepth] = value;
-        }
-      }
       fmDepthstr = value >> midioutfrig;
       updatefmDepth(1);
       break;
 
     case CCosc2PW:
-      if (upperSW) {
-        upperData[P_osc2PW] = value;
-      } else {
-        lowerData[P_osc2PW] = value;
-        if (wholemode) {
-          upperData[P_osc2PW] = value;
-        }
-      }
       osc2PWstr = PULSEWIDTH[value >> midioutfrig];
       updateosc2PW(1);
       break;
 
     case CCosc2PWM:
-      if (upperSW) {
-        upperData[P_osc2PWM] = value;
-      } else {
-        lowerData[P_osc2PWM] = value;
-        if (wholemode) {
-          upperData[P_osc2PWM] = value;
-        }
-      }
       osc2PWMstr = value >> midioutfrig;
       updateosc2PWM(1);
       break;
 
     case CCosc1PW:
-      if (upperSW) {
-        upperData[P_osc1PW] = value;
-      } else {
-        lowerData[P_osc1PW] = value;
-        if (wholemode) {
-          upperData[P_osc1PW] = value;
-        }
-      }
       osc1PWstr = PULSEWIDTH[value >> midioutfrig];
       updateosc1PW(1);
       break;
 
     case CCosc1PWM:
-      if (upperSW) {
-        upperData[P_osc1PWM] = value;
-      } else {
-        lowerData[P_osc1PWM] = value;
-        if (wholemode) {
-          upperData[P_osc1PWM] = value;
-        }
-      }
       osc1PWMstr = value >> midioutfrig;
       updateosc1PWM(1);
       break;
 
     case CCosc1Oct:
-      if (upperSW) {
-        upperData[P_osc1Range] = value;
-      } else {
-        lowerData[P_osc1Range] = value;
-        if (wholemode) {
-          upperData[P_osc1Range] = value;
-        }
-      }
       updateosc1Range(1);
       break;
 
     case CCosc2Oct:
-      if (upperSW) {
-        upperData[P_osc2Range] = value;
-      } else {
-        lowerData[P_osc2Range] = value;
-        if (wholemode) {
-          upperData[P_osc2Range] = value;
-        }
-      }
       updateosc2Range(1);
       break;
 
     case CCglideTime:
-      if (upperSW) {
-        upperData[P_glideTime] = value;
-      } else {
-        lowerData[P_glideTime] = value;
-        if (wholemode) {
-          upperData[P_glideTime] = value;
-        }
-      }
       glideTimestr = LINEAR[value >> midioutfrig];
       updateglideTime(1);
       break;
 
     case CCosc2Detune:
-      if (upperSW) {
-        upperData[P_osc2Detune] = value;
-      } else {
-        lowerData[P_osc2Detune] = value;
-        if (wholemode) {
-          upperData[P_osc2Detune] = value;
-        }
-      }
       osc2Detunestr = PULSEWIDTH[value >> midioutfrig];
       updateosc2Detune(1);
       break;
 
     case CCosc2Interval:
-      if (upperSW) {
-        upperData[P_osc2Interval] = value;
-      } else {
-        lowerData[P_osc2Interval] = value;
-        if (wholemode) {
-          upperData[P_osc2Interval] = value;
-        }
-      }
       osc2Intervalstr = value;
       updateosc2Interval(1);
       break;
 
     case CCnoiseLevel:
-      if (upperSW) {
-        upperData[P_noiseLevel] = value;
-      } else {
-        lowerData[P_noiseLevel] = value;
-        if (wholemode) {
-          upperData[P_noiseLevel] = value;
-        }
-      }
       noiseLevelstr = LINEARCENTREZERO[value >> midioutfrig];
       updatenoiseLevel(1);
       break;
 
     case CCosc2SawLevel:
-      if (upperSW) {
-        upperData[P_osc2SawLevel] = value;
-      } else {
-        lowerData[P_osc2SawLevel] = value;
-        if (wholemode) {
-          upperData[P_osc2SawLevel] = value;
-        }
-      }
       osc2SawLevelstr = value >> midioutfrig;  // for display
       updateOsc2SawLevel(1);
       break;
 
     case CCosc1SawLevel:
-      if (upperSW) {
-        upperData[P_osc1SawLevel] = value;
-      } else {
-        lowerData[P_osc1SawLevel] = value;
-        if (wholemode) {
-          upperData[P_osc1SawLevel] = value;
-        }
-      }
       osc1SawLevelstr = value >> midioutfrig;  // for display
       updateOsc1SawLevel(1);
       break;
 
     case CCosc2PulseLevel:
-      if (upperSW) {
-        upperData[P_osc2PulseLevel] = value;
-      } else {
-        lowerData[P_osc2PulseLevel] = value;
-        if (wholemode) {
-          upperData[P_osc2PulseLevel] = value;
-        }
-      }
       osc2PulseLevelstr = value >> midioutfrig;  // for display
       updateOsc2PulseLevel(1);
       break;
 
     case CCosc1PulseLevel:
-      if (upperSW) {
-        upperData[P_osc1PulseLevel] = value;
-      } else {
-        lowerData[P_osc1PulseLevel] = value;
-        if (wholemode) {
-          upperData[P_osc1PulseLevel] = value;
-        }
-      }
       osc1PulseLevelstr = value >> midioutfrig;  // for display
       updateOsc1PulseLevel(1);
       break;
 
     case CCosc2TriangleLevel:
-      if (upperSW) {
-        upperData[P_osc2TriangleLevel] = value;
-      } else {
-        lowerData[P_osc2TriangleLevel] = value;
-        if (wholemode) {
-          upperData[P_osc2TriangleLevel] = value;
-        }
-      }
       osc2TriangleLevelstr = value >> midioutfrig;  // for display
       updateOsc2TriangleLevel(1);
       break;
 
     case CCosc1SubLevel:
-      if (upperSW) {
-        upperData[P_osc1SubLevel] = value;
-      } else {
-        lowerData[P_osc1SubLevel] = value;
-        if (wholemode) {
-          upperData[P_osc1SubLevel] = value;
-        }
-      }
       osc1SubLevelstr = value >> midioutfrig;  // for display
       updateOsc1SubLevel(1);
       break;
 
     case CCLFODelay:
-      if (upperSW) {
-        upperData[P_LFODelay] = value;
-      } else {
-        lowerData[P_LFODelay] = value;
-        if (wholemode) {
-          upperData[P_LFODelay] = value;
-        }
-      }
       LFODelaystr = value >> midioutfrig;  // for display
       updateLFODelay(1);
       break;
 
     case CCfilterCutoff:
-      if (upperSW) {
-        upperData[P_filterCutoff] = value;
-        oldfilterCutoffU = value;
-      } else {
-        lowerData[P_filterCutoff] = value;
-        oldfilterCutoffL = value;
-        if (wholemode) {
-          upperData[P_filterCutoff] = value;
-          oldfilterCutoffU = value;
-        }
-      }
+      if (upperSW || wholemode) oldfilterCutoffU = value;
+      if (!upperSW) oldfilterCutoffL = value;
       filterCutoffstr = FILTERCUTOFF[value >> midioutfrig];
       updateFilterCutoff(1);
       break;
 
     case CCfilterLFO:
-      if (upperSW) {
-        upperData[P_filterLFO] = value;
-      } else {
-        lowerData[P_filterLFO] = value;
-        if (wholemode) {
-          upperData[P_filterLFO] = value;
-        }
-      }
       filterLFOstr = value >> midioutfrig;
       updatefilterLFO(1);
       break;
 
     case CCfilterRes:
-      if (upperSW) {
-        upperData[P_filterRes] = value;
-      } else {
-        lowerData[P_filterRes] = value;
-        if (wholemode) {
-          upperData[P_filterRes] = value;
-        }
-      }
       filterResstr = int(value >> midioutfrig);
       updatefilterRes(1);
       break;
 
     case CCfilterType:
-      if (upperSW) {
-        upperData[P_filterType] = value;
-      } else {
-        lowerData[P_filterType] = value;
-        if (wholemode) {
-          upperData[P_filterType] = value;
-        }
-      }
       updateFilterType(1);
       break;
 
     case CCfilterEGlevel:
-      if (upperSW) {
-        upperData[P_filterEGlevel] = value;
-      } else {
-        lowerData[P_filterEGlevel] = value;
-        if (wholemode) {
-          upperData[P_filterEGlevel] = value;
-        }
-      }
       filterEGlevelstr = int(value >> midioutfrig);
       updatefilterEGlevel(1);
       break;
 
     case CCLFORate:
-      if (upperSW) {
-        upperData[P_LFORate] = value;
-      } else {
-        lowerData[P_LFORate] = value;
-        if (wholemode) {
-          upperData[P_LFORate] = value;
-        }
-      }
       LFORatestr = LFOTEMPO[value >> midioutfrig];  // for display
       updateLFORate(1);
       break;
 
     case CCmodWheelDepth:
-      if (upperSW) {
-        upperData[P_modWheelDepth] = value;
-      } else {
-        lowerData[P_modWheelDepth] = value;
-        if (wholemode) {
-          upperData[P_modWheelDepth] = value;
-        }
-      }
       modWheelDepthstr = value >> midioutfrig;  // for display
       updatemodWheelDepth(1);
       break;
 
     case CCPitchBend:
       Serial.println(value);
-      if (upperSW) {
-        upperData[P_PitchBendLevel] = value;
-      } else {
-        lowerData[P_PitchBendLevel] = value;
-        if (wholemode) {
-          upperData[P_PitchBendLevel] = value;
-        }
-      }
       PitchBendLevelstr = value;  // for display
       updatePitchBendDepth(1);
       break;
 
     case CCeffectPot1:
-      if (upperSW) {
-        upperData[P_effectPot1] = value;
-      } else {
-        lowerData[P_effectPot1] = value;
-        if (wholemode) {
-          upperData[P_effectPot1] = value;
-        }
-      }
       effectPot1str = value >> midioutfrig;  // for display
       updateeffectPot1(1);
       break;
 
     case CCeffectPot2:
-      if (upperSW) {
-        upperData[P_effectPot2] = value;
-      } else {
-        lowerData[P_effectPot2] = value;
-        if (wholemode) {
-          upperData[P_effectPot2] = value;
-        }
-      }
       effectPot2str = value >> midioutfrig;  // for display
       updateeffectPot2(1);
       break;
 
     case CCeffectPot3:
-      if (upperSW) {
-        upperData[P_effectPot3] = value;
-      } else {
-        lowerData[P_effectPot3] = value;
-        if (wholemode) {
-          upperData[P_effectPot3] = value;
-        }
-      }
       effectPot3str = value >> midioutfrig;  // for display
       updateeffectPot3(1);
       break;
 
     case CCeffectsMix:
-      if (upperSW) {
-        upperData[P_effectsMix] = value;
-      } else {
-        lowerData[P_effectsMix] = value;
-        if (wholemode) {
-          upperData[P_effectsMix] = value;
-        }
-      }
       effectsMixstr = value >> midioutfrig;  // for display
       updateeffectsMix(1);
       break;
 
     case CCLFOWaveform:
-      if (upperSW) {
-        upperData[P_LFOWaveform] = value;
-      } else {
-        lowerData[P_LFOWaveform] = value;
-        if (wholemode) {
-          upperData[P_LFOWaveform] = value;
-        }
-      }
       updateStratusLFOWaveform(1);
       break;
 
     case CCfilterAttack:
-      if (upperSW) {
-        upperData[P_filterAttack] = value;
-      } else {
-        lowerData[P_filterAttack] = value;
-        if (wholemode) {
-          upperData[P_filterAttack] = value;
-        }
-      }
       filterAttackstr = ENVTIMES[value >> midioutfrig];
       updatefilterAttack(1);
       break;
 
     case CCfilterDecay:
-      if (upperSW) {
-        upperData[P_filterDecay] = value;
-      } else {
-        lowerData[P_filterDecay] = value;
-        if (wholemode) {
-          upperData[P_filterDecay] = value;
-        }
-      }
       filterDecaystr = ENVTIMES[value >> midioutfrig];
       updatefilterDecay(1);
       break;
 
     case CCfilterSustain:
-      if (upperSW) {
-        upperData[P_filterSustain] = value;
-      } else {
-        lowerData[P_filterSustain] = value;
-        if (wholemode) {
-          upperData[P_filterSustain] = value;
-        }
-      }
       filterSustainstr = LINEAR_FILTERMIXERSTR[value >> midioutfrig];
       updatefilterSustain(1);
       break;
 
     case CCfilterRelease:
-      if (upperSW) {
-        upperData[P_filterRelease] = value;
-      } else {
-        lowerData[P_filterRelease] = value;
-        if (wholemode) {
-          upperData[P_filterRelease] = value;
-        }
-      }
       filterReleasestr = ENVTIMES[value >> midioutfrig];
       updatefilterRelease(1);
       break;
 
     case CCampAttack:
-      if (upperSW) {
-        upperData[P_ampAttack] = value;
-        upperData[P_oldampAttack] = value;
-      } else {
-        lowerData[P_ampAttack] = value;
-        lowerData[P_oldampAttack] = value;
-        if (wholemode) {
-          upperData[P_ampAttack] = value;
-          upperData[P_oldampAttack] = value;
-        }
-      }
       ampAttackstr = ENVTIMES[value >> midioutfrig];
       updateampAttack(1);
       break;
 
     case CCampDecay:
-      if (upperSW) {
-        upperData[P_ampDecay] = value;
-        upperData[P_oldampDecay] = value;
-      } else {
-        lowerData[P_ampDecay] = value;
-        lowerData[P_oldampDecay] = value;
-        if (wholemode) {
-          upperData[P_ampDecay] = value;
-          upperData[P_oldampDecay] = value;
-        }
-      }
       ampDecaystr = ENVTIMES[value >> midioutfrig];
       updateampDecay(1);
       break;
 
     case CCampSustain:
-      if (upperSW) {
-        upperData[P_ampSustain] = value;
-        upperData[P_oldampSustain] = value;
-      } else {
-        lowerData[P_ampSustain] = value;
-        lowerData[P_oldampSustain] = value;
-        if (wholemode) {
-          upperData[P_ampSustain] = value;
-          upperData[P_oldampSustain] = value;
-        }
-      }
       ampSustainstr = LINEAR_FILTERMIXERSTR[value >> midioutfrig];
       updateampSustain(1);
       break;
 
     case CCampRelease:
-      if (upperSW) {
-        upperData[P_ampRelease] = value;
-        upperData[P_oldampRelease] = value;
-      } else {
-        lowerData[P_ampRelease] = value;
-        lowerData[P_oldampRelease] = value;
-        if (wholemode) {
-          upperData[P_ampRelease] = value;
-          upperData[P_oldampRelease] = value;
-        }
-      }
       ampReleasestr = ENVTIMES[value >> midioutfrig];
       updateampRelease(1);
       break;
 
     case CCvolumeControl:
-      if (upperSW) {
-        upperData[P_volumeControl] = value;
-      } else {
-        lowerData[P_volumeControl] = value;
-        if (wholemode) {
-          upperData[P_volumeControl] = value;
-        }
-      }
       volumeControlstr = value >> midioutfrig;
       updatevolumeControl(1);
       break;
 
     case CCPM_DCO2:
-      if (upperSW) {
-        upperData[P_pmDCO2] = value;
-      } else {
-        lowerData[P_pmDCO2] = value;
-        if (wholemode) {
-          upperData[P_pmDCO2] = value;
-        }
-      }
       pmDCO2str = value >> midioutfrig;
       updatePM_DCO2(1);
       break;
 
     case CCPM_FilterEnv:
-      if (upperSW) {
-        upperData[P_pmFilterEnv] = value;
-      } else {
-        lowerData[P_pmFilterEnv] = value;
-        if (wholemode) {
-          upperData[P_pmFilterEnv] = value;
-        }
-      }
       pmFilterEnvstr = value >> midioutfrig;
       updatePM_FilterEnv(1);
       break;
 
     case CCkeyTrack:
-      if (upperSW) {
-        upperData[P_keytrack] = value;
-      } else {
-        lowerData[P_keytrack] = value;
-        if (wholemode) {
-          upperData[P_keytrack] = value;
-        }
-      }
       keytrackstr = value >> midioutfrig;
       updatekeytrack(1);
       break;
 
 
     case CCamDepth:
-      if (upperSW) {
-        upperData[P_amDepth] = value;
-      } else {
-        lowerData[P_amDepth] = value;
-        if (wholemode) {
-          upperData[P_amDepth] = value;
-        }
-      }
       amDepthstr = value >> midioutfrig;
       updateamDepth(1);
       break;
@@ -4353,11 +2885,6 @@ void myControlChange(byte channel, byte control, int value) {
       break;
 
     case CCNotePriority:
-      if (upperSW) {
-        upperData[P_NotePriority] = value;
-      } else {
-        lowerData[P_NotePriority] = value;
-      }
       updateNotePriority(1);
       break;
 
@@ -4371,110 +2898,50 @@ void myControlChange(byte channel, byte control, int value) {
       break;
 
     case CCglideSW:
-      if (upperSW) {
-        upperData[P_glideSW] = !upperData[P_glideSW];
-      } else {
-        lowerData[P_glideSW] = !lowerData[P_glideSW];
-      }
       updateglideSW(1);
       break;
 
     case CCfilterPoleSW:
-      if (upperSW) {
-        upperData[P_filterPoleSW] = value;
-      } else {
-        lowerData[P_filterPoleSW] = value;
-      }
       updatefilterPoleSwitch(1);
       break;
 
     case CCfilterVel:
-      if (upperSW) {
-        upperData[P_filterVel] = !upperData[P_filterVel];
-      } else {
-        lowerData[P_filterVel] = !lowerData[P_filterVel];
-      }
       updatefilterVel(1);
       break;
 
     case CCfilterEGinv:
-      if (upperSW) {
-        upperData[P_filterEGinv] = !upperData[P_filterEGinv];
-      } else {
-        lowerData[P_filterEGinv] = !lowerData[P_filterEGinv];
-      }
       updatefilterEGinv(1);
       break;
 
     case CCsyncSW:
-      if (upperSW) {
-        upperData[P_sync] = !upperData[P_sync];
-      } else {
-        lowerData[P_sync] = !lowerData[P_sync];
-      }
       updatesyncSW(1);
       break;
 
     case CCkeyTrackSW:
-      if (upperSW) {
-        upperData[P_keytrackSW] = !upperData[P_keytrackSW];
-      } else {
-        lowerData[P_keytrackSW] = !lowerData[P_keytrackSW];
-      }
       updatekeytrackSW(1);
       break;
 
     case CCpmDestDCO1SW:
-      if (upperSW) {
-        upperData[P_pmDestDCO1] = !upperData[P_pmDestDCO1];
-      } else {
-        lowerData[P_pmDestDCO1] = !lowerData[P_pmDestDCO1];
-      }
       updatepmDestDCO1(1);
       break;
 
     case CCpmDestFilterSW:
-      if (upperSW) {
-        upperData[P_pmDestFilter] = !upperData[P_pmDestFilter];
-      } else {
-        lowerData[P_pmDestFilter] = !lowerData[P_pmDestFilter];
-      }
       updatepmDestFilter(1);
       break;
 
     case CCfilterenvLinLogSW:
-      if (upperSW) {
-        upperData[P_filterLogLin] = !upperData[P_filterLogLin];
-      } else {
-        lowerData[P_filterLogLin] = !lowerData[P_filterLogLin];
-      }
       updatefilterenvLogLin(1);
       break;
 
     case CCampenvLinLogSW:
-      if (upperSW) {
-        upperData[P_ampLogLin] = !upperData[P_ampLogLin];
-      } else {
-        lowerData[P_ampLogLin] = !lowerData[P_ampLogLin];
-      }
       updateampenvLogLin(1);
       break;
 
     case CCFilterLoop:
-      if (upperSW) {
-        upperData[P_filterLoop] = value;
-      } else {
-        lowerData[P_filterLoop] = value;
-      }
       updatefilterLoop(1);
       break;
 
     case CCAmpLoop:
-      if (upperSW) {
-        upperData[P_vcaLoop] = value;
-      } else {
-        lowerData[P_vcaLoop] = value;
-      }
       updatevcaLoop(1);
       break;
 
@@ -4488,65 +2955,30 @@ void myControlChange(byte channel, byte control, int value) {
       break;
 
     case CCvcaVel:
-      if (upperSW) {
-        upperData[P_vcaVel] = !upperData[P_vcaVel];
-      } else {
-        lowerData[P_vcaVel] = !lowerData[P_vcaVel];
-      }
       updatevcaVel(1);
       break;
 
     case CCeffectBankSW:
-      if (upperSW) {
-        upperData[P_effectBank] = value;
-      } else {
-        lowerData[P_effectBank] = value;
-      }
       updateeffectBankSW(1);
       break;
 
     case CClfoMult:
-      if (upperSW) {
-        upperData[P_lfoMultiplier] = value;
-      } else {
-        lowerData[P_lfoMultiplier] = value;
-      }
       updatelfoMultiplier(1);
       break;
 
     case CCeffectNumSW:
-      if (upperSW) {
-        upperData[P_effectNum] = value;
-      } else {
-        lowerData[P_effectNum] = value;
-      }
       updateeffectNumSW(1);
       break;
 
     case CCvcaGate:
-      if (upperSW) {
-        upperData[P_vcaGate] = !upperData[P_vcaGate];
-      } else {
-        lowerData[P_vcaGate] = !lowerData[P_vcaGate];
-      }
       updatevcaGate(1);
       break;
 
     case CCmonoMulti:
-      if (upperSW) {
-        upperData[P_monoMulti] = !upperData[P_monoMulti];
-      } else {
-        lowerData[P_monoMulti] = !lowerData[P_monoMulti];
-      }
       updateMonoMulti(1);
       break;
 
     case CClfoAlt:
-      if (upperSW) {
-        upperData[P_lfoAlt] = !upperData[P_lfoAlt];
-      } else {
-        lowerData[P_lfoAlt] = !lowerData[P_lfoAlt];
-      }
       updatelfoAlt(1);
       break;
 
@@ -4636,64 +3068,29 @@ void myControlChange(byte channel, byte control, int value) {
 void myProgramChange(byte channel, byte program) {
   state = PATCH;
   patchNo = program + 1;
+#ifdef PATCH_TIMING
+  unsigned long recallStart = micros();
+#endif
   recallPatch(patchNo);
+#ifdef PATCH_TIMING
+  Serial.println("Program change " + String(patchNo) + " ready in " + String(micros() - recallStart) + "us");
+#endif
   state = PARAMETER;
 }
 
+//Only the latest pressure is kept, modTick() applies it
 void myAfterTouch(byte channel, byte value) {
-  // afterTouch = int(value * MIDICCTOPOT);
-  // switch (upperData[P_AfterTouchDest]) {
-  //   case 1:
-  //     upperData[P_fmDepth] = afterTouch;
-  //     break;
-  //   case 2:
-  //     upperData[P_filterCutoff] = (oldfilterCutoffU + afterTouch);
-  //     if (afterTouch < 10) {
-  //       upperData[P_filterCutoff] = oldfilterCutoffU;
-  //     }
-  //     if (upperData[P_filterCutoff] > 1023) {
-  //       upperData[P_filterCutoff] = 1023;
-  //     }
-  //     break;
-  //   case 3:
-  //     upperData[P_filterLFO] = afterTouch;
-  //     break;
-  //   case 4:
-  //     upperData[P_amDepth] = afterTouch;
-  //     break;
-  // }
-  // switch (lowerData[P_AfterTouchDest]) {
-  //   case 1:
-  //     lowerData[P_fmDepth] = afterTouch;
-  //     break;
-  //   case 2:
-  //     lowerData[P_filterCutoff] = (oldfilterCutoffL + afterTouch);
-  //     if (afterTouch < 10) {
-  //       lowerData[P_filterCutoff] = oldfilterCutoffL;
-  //     }
-  //     if (lowerData[P_filterCutoff] > 1023) {
-  //       lowerData[P_filterCutoff] = 1023;
-  //     }
-  //     break;
-  //   case 3:
-  //     lowerData[P_filterLFO] = afterTouch;
-  //     break;
-  //   case 4:
-  //     lowerData[P_amDepth] = afterTouch;
-  //     break;
-  // }
+  modSource(MOD_SRC_AFTERTOUCH, value << 3);
 }
 
 void recallPatch(int patchNo) {
+  PROFILE_SCOPE(PROFILE_RECALL);
   allNotesOff();
-  File patchFile = SD.open(String(patchNo).c_str());
-  if (!patchFile) {
-    //Serial.println("File not found");
+  PatchRecord *record = findPatch(patchNo);
+  if (!record) {
+    //Serial.println("Patch not found");
   } else {
-    String data[NO_OF_PARAMS];  //Array of data read in
-    recallPatchData(patchFile, data);
-    setCurrentPatchData(data);
-    patchFile.close();
+    setCurrentPatchData(*record);
     if (upperSW) {
       storeLastPatchU(patchNoU);
       upperpatchtag = patchNoU;
@@ -4704,327 +3101,38 @@ void recallPatch(int patchNo) {
   }
 }
 
-void setCurrentPatchData(String data[]) {
+//Patch values 1-73 line up with the P_ indexes so a layer loads with one pass
+void setCurrentPatchData(const PatchRecord &record) {
   if (upperSW) {
-    patchNameU = data[0];
+    patchNameU = record.name;
     upperData[0] = 1;
-    upperData[P_pwLFO] = data[1].toInt();               // pwLFOU
-    upperData[P_fmDepth] = data[2].toInt();             // fmDepthU
-    upperData[P_osc2PW] = data[3].toInt();              // osc2PWU
-    upperData[P_osc2PWM] = data[4].toInt();             // osc2PWMU
-    upperData[P_osc1PW] = data[5].toInt();              // osc1PWU
-    upperData[P_osc1PWM] = data[6].toInt();             // osc1PWMU
-    upperData[P_osc1Range] = data[7].toInt();           // osc1RangeU
-    upperData[P_osc2Range] = data[8].toInt();           // osc2RangeU
-    upperData[P_osc2Interval] = data[9].toInt();        // osc2IntervalU
-    upperData[P_glideTime] = data[10].toInt();          // glideTimeU
-    upperData[P_osc2Detune] = data[11].toInt();         // osc2DetuneU
-    upperData[P_noiseLevel] = data[12].toInt();         // noiseLevelU
-    upperData[P_osc2SawLevel] = data[13].toInt();       // osc2SawLevelU
-    upperData[P_osc1SawLevel] = data[14].toInt();       // osc1SawLevelU
-    upperData[P_osc2PulseLevel] = data[15].toInt();     // osc2PulseLevelU
-    upperData[P_osc1PulseLevel] = data[16].toInt();     // osc1PulseLevelU
-    upperData[P_filterCutoff] = data[17].toInt();       // filterCutoffU
-    upperData[P_filterLFO] = data[18].toInt();          // filterLFOU
-    upperData[P_filterRes] = data[19].toInt();          // filterResU
-    upperData[P_filterType] = data[20].toInt();         // filterTypeU
-    upperData[P_modWheelDepth] = data[21].toInt();      // P_modWheelDepthU
-    upperData[P_effectsMix] = data[22].toInt();         // effectsMixU
-    upperData[P_LFODelayGo] = data[23].toInt();         // LFODelayGoU
-    upperData[P_filterEGlevel] = data[24].toInt();      // filterEGlevelU
-    upperData[P_LFORate] = data[25].toInt();            // LFORateU
-    upperData[P_LFOWaveform] = data[26].toInt();        // LFOWaveformU
-    upperData[P_filterAttack] = data[27].toInt();       // filterAttackU
-    upperData[P_filterDecay] = data[28].toInt();        // filterDecayU
-    upperData[P_filterSustain] = data[29].toInt();      // filterSustainU
-    upperData[P_filterRelease] = data[30].toInt();      // filterReleaseU
-    upperData[P_ampAttack] = data[31].toInt();          // ampAttackU
-    upperData[P_ampDecay] = data[32].toInt();           // ampDecayU
-    upperData[P_ampSustain] = data[33].toInt();         // ampSustainU
-    upperData[P_ampRelease] = data[34].toInt();         // ampReleaseU
-    upperData[P_volumeControl] = data[35].toInt();      // volumeControlU
-    upperData[P_glideSW] = data[36].toInt();            // glideSWU
-    upperData[P_keytrack] = data[37].toInt();           // keytrackU
-    upperData[P_filterPoleSW] = data[38].toInt();       // filterPoleSWU
-    upperData[P_filterLoop] = data[39].toInt();         // filterLoopU
-    upperData[P_filterEGinv] = data[40].toInt();        // filterEGinvU
-    upperData[P_filterVel] = data[41].toInt();          // filterVelU
-    upperData[P_vcaLoop] = data[42].toInt();            // vcaLoopU
-    upperData[P_vcaVel] = data[43].toInt();             // vcaVelU
-    upperData[P_vcaGate] = data[44].toInt();            // vcaGateU
-    upperData[P_lfoAlt] = data[45].toInt();             // lfoAltU
-    upperData[P_pmDCO2] = data[46].toInt();             // pmDCO2U
-    upperData[P_pmFilterEnv] = data[47].toInt();        // pmFilterEnvU
-    upperData[P_monoMulti] = data[48].toInt();          // monoMultiU
-    upperData[P_modWheelLevel] = data[49].toInt();      // modWheelLevelU
-    upperData[P_PitchBendLevel] = data[50].toInt();     // PitchBendLevelU
-    upperData[P_amDepth] = data[51].toInt();            // amDepthU
-    upperData[P_sync] = data[52].toInt();               // syncU
-    upperData[P_effectPot1] = data[53].toInt();         // effectPot1U
-    upperData[P_effectPot2] = data[54].toInt();         // effectPot2U
-    upperData[P_effectPot3] = data[55].toInt();         // effectPot3U
-    upperData[P_oldampAttack] = data[56].toInt();       // oldampAttackU
-    upperData[P_oldampDecay] = data[57].toInt();        // oldampDecayU
-    upperData[P_oldampSustain] = data[58].toInt();      // oldampSustainU
-    upperData[P_oldampRelease] = data[59].toInt();      // oldampReleaseU
-    upperData[P_AfterTouchDest] = data[60].toInt();     // AfterTouchDestU
-    upperData[P_filterLogLin] = data[61].toInt();       // filterLogLinU
-    upperData[P_ampLogLin] = data[62].toInt();          // ampLogLinU
-    upperData[P_osc2TriangleLevel] = data[63].toInt();  // osc2TriangleLevelU
-    upperData[P_osc1SubLevel] = data[64].toInt();       // osc1SubLevelU
-    upperData[P_keyboardMode] = data[65].toInt();       // keyTrackSWU
-    upperData[P_LFODelay] = data[66].toInt();           // LFODelayU
-    upperData[P_effectNum] = data[67].toInt();          // effectNumU
-    upperData[P_effectBank] = data[68].toInt();         // effectBankU
-    upperData[P_pmDestDCO1] = data[69].toInt();         // pmDestDCO1U
-    upperData[P_pmDestFilter] = data[70].toInt();       // pmDestFilterU
-    upperData[P_lfoMultiplier] = data[71].toInt();      // lfoMultiplierU
-    upperData[P_NotePriority] = data[72].toInt();       // NotePriorityU
-    upperData[P_keytrackSW] = data[73].toInt();         // keyTrackSWU
-
+    patchRecordCopy(upperData, record);
     oldfilterCutoffU = upperData[P_filterCutoff];
 
   } else {
-    patchNameL = data[0];
+    patchNameL = record.name;
     lowerData[0] = 0;
-    lowerData[P_pwLFO] = data[1].toInt();               // pwLFOL
-    lowerData[P_fmDepth] = data[2].toInt();             // fmDepthL
-    lowerData[P_osc2PW] = data[3].toInt();              // osc2PWL
-    lowerData[P_osc2PWM] = data[4].toInt();             // osc2PWML
-    lowerData[P_osc1PW] = data[5].toInt();              // osc1PWL
-    lowerData[P_osc1PWM] = data[6].toInt();             // osc1PWML
-    lowerData[P_osc1Range] = data[7].toInt();           // osc1RangeL
-    lowerData[P_osc2Range] = data[8].toInt();           // osc2RangeL
-    lowerData[P_osc2Interval] = data[9].toInt();        // osc2IntervalL
-    lowerData[P_glideTime] = data[10].toInt();          // glideTimeL
-    lowerData[P_osc2Detune] = data[11].toInt();         // osc2DetuneL
-    lowerData[P_noiseLevel] = data[12].toInt();         // noiseLevelL
-    lowerData[P_osc2SawLevel] = data[13].toInt();       // osc2SawLevelL
-    lowerData[P_osc1SawLevel] = data[14].toInt();       // osc1SawLevelL
-    lowerData[P_osc2PulseLevel] = data[15].toInt();     // osc2PulseLevelL
-    lowerData[P_osc1PulseLevel] = data[16].toInt();     // osc1PulseLevelL
-    lowerData[P_filterCutoff] = data[17].toInt();       // filterCutoffL
-    lowerData[P_filterLFO] = data[18].toInt();          // filterLFOL
-    lowerData[P_filterRes] = data[19].toInt();          // filterResL
-    lowerData[P_filterType] = data[20].toInt();         // filterTypeL
-    lowerData[P_modWheelDepth] = data[21].toInt();      // modWheelDepthL
-    lowerData[P_effectsMix] = data[22].toInt();         // effectsMixL
-    lowerData[P_LFODelayGo] = data[23].toInt();         // LFODelayGoL
-    lowerData[P_filterEGlevel] = data[24].toInt();      // filterEGlevelL
-    lowerData[P_LFORate] = data[25].toInt();            // LFORateL
-    lowerData[P_LFOWaveform] = data[26].toInt();        // LFOWaveformL
-    lowerData[P_filterAttack] = data[27].toInt();       // filterAttackL
-    lowerData[P_filterDecay] = data[28].toInt();        // filterDecayL
-    lowerData[P_filterSustain] = data[29].toInt();      // filterSustainL
-    lowerData[P_filterRelease] = data[30].toInt();      // filterReleaseL
-    lowerData[P_ampAttack] = data[31].toInt();          // ampAttackL
-    lowerData[P_ampDecay] = data[32].toInt();           // ampDecayL
-    lowerData[P_ampSustain] = data[33].toInt();         // ampSustainL
-    lowerData[P_ampRelease] = data[34].toInt();         // ampReleaseL
-    lowerData[P_volumeControl] = data[35].toInt();      // volumeControlL
-    lowerData[P_glideSW] = data[36].toInt();            // glideSWL
-    lowerData[P_keytrack] = data[37].toInt();           // keytrackL
-    lowerData[P_filterPoleSW] = data[38].toInt();       // filterPoleSWL
-    lowerData[P_filterLoop] = data[39].toInt();         // filterLoopL
-    lowerData[P_filterEGinv] = data[40].toInt();        // filterEGinvL
-    lowerData[P_filterVel] = data[41].toInt();          // filterVelL
-    lowerData[P_vcaLoop] = data[42].toInt();            // vcaLoopL
-    lowerData[P_vcaVel] = data[43].toInt();             // vcaVelL
-    lowerData[P_vcaGate] = data[44].toInt();            // vcaGateL
-    lowerData[P_lfoAlt] = data[45].toInt();             // lfoAltL
-    lowerData[P_pmDCO2] = data[46].toInt();             // pmDCO2L
-    lowerData[P_pmFilterEnv] = data[47].toInt();        // pmFilterEnvL
-    lowerData[P_monoMulti] = data[48].toInt();          // monoMultiL
-    lowerData[P_modWheelLevel] = data[49].toInt();      // modWheelLevelL
-    lowerData[P_PitchBendLevel] = data[50].toInt();     // PitchBendLevelL
-    lowerData[P_amDepth] = data[51].toInt();            // amDepthL
-    lowerData[P_sync] = data[52].toInt();               // syncL
-    lowerData[P_effectPot1] = data[53].toInt();         // effectPot1L
-    lowerData[P_effectPot2] = data[54].toInt();         // effectPot2L
-    lowerData[P_effectPot3] = data[55].toInt();         // effectPot3L
-    lowerData[P_oldampAttack] = data[56].toInt();       // oldampAttackL
-    lowerData[P_oldampDecay] = data[57].toInt();        // oldampDecayL
-    lowerData[P_oldampSustain] = data[58].toInt();      // oldampSustainL
-    lowerData[P_oldampRelease] = data[59].toInt();      // oldampReleaseL
-    lowerData[P_AfterTouchDest] = data[60].toInt();     // AfterTouchDestL
-    lowerData[P_filterLogLin] = data[61].toInt();       // filterLogLinL
-    lowerData[P_ampLogLin] = data[62].toInt();          // ampLogLinL
-    lowerData[P_osc2TriangleLevel] = data[63].toInt();  // osc2TriangleLevelL
-    lowerData[P_osc1SubLevel] = data[64].toInt();       // osc1SubLevelL
-    lowerData[P_keyboardMode] = data[65].toInt();       // keyTrackSWL
-    lowerData[P_LFODelay] = data[66].toInt();           // LFODelayL
-    lowerData[P_effectNum] = data[67].toInt();          // effectNumL
-    lowerData[P_effectBank] = data[68].toInt();         // effectBankL
-    lowerData[P_pmDestDCO1] = data[69].toInt();         // pmDestDCO1L
-    lowerData[P_pmDestFilter] = data[70].toInt();       // pmDestFilterL
-    lowerData[P_lfoMultiplier] = data[71].toInt();      // lfoMultiplierL
-    lowerData[P_NotePriority] = data[72].toInt();       // NotePriorityL
-    lowerData[P_keytrackSW] = data[73].toInt();         // keyTrackSWL
-
+    patchRecordCopy(lowerData, record);
     oldfilterCutoffL = lowerData[P_filterCutoff];
 
     if (wholemode) {
-      patchNameU = data[0];
+      patchNameU = record.name;
       upperData[0] = 1;
-      upperData[P_pwLFO] = data[1].toInt();               //
-      upperData[P_fmDepth] = data[2].toInt();             // fmDepthU
-      upperData[P_osc2PW] = data[3].toInt();              // osc2PWU
-      upperData[P_osc2PWM] = data[4].toInt();             // osc2PWMU
-      upperData[P_osc1PW] = data[5].toInt();              // osc1PWU
-      upperData[P_osc1PWM] = data[6].toInt();             // osc1PWMU
-      upperData[P_osc1Range] = data[7].toInt();           // osc1RangeU
-      upperData[P_osc2Range] = data[8].toInt();           // osc2RangeU
-      upperData[P_osc2Interval] = data[9].toInt();        // osc2IntervalU
-      upperData[P_glideTime] = data[10].toInt();          // glideTimeU
-      upperData[P_osc2Detune] = data[11].toInt();         // osc2DetuneU
-      upperData[P_noiseLevel] = data[12].toInt();         // noiseLevelU
-      upperData[P_osc2SawLevel] = data[13].toInt();       // osc2SawLevelU
-      upperData[P_osc1SawLevel] = data[14].toInt();       // osc1SawLevelU
-      upperData[P_osc2PulseLevel] = data[15].toInt();     // osc2PulseLevelU
-      upperData[P_osc1PulseLevel] = data[16].toInt();     // osc1PulseLevelU
-      upperData[P_filterCutoff] = data[17].toInt();       // upperData[17]
-      upperData[P_filterLFO] = data[18].toInt();          // filterLFOU
-      upperData[P_filterRes] = data[19].toInt();          // filterResU
-      upperData[P_filterType] = data[20].toInt();         // filterTypeU
-      upperData[P_modWheelDepth] = data[21].toInt();      // modWheelDepthU
-      upperData[P_effectsMix] = data[22].toInt();         // effectsMixU
-      upperData[P_LFODelayGo] = data[23].toInt();         // LFODelayGoU
-      upperData[P_filterEGlevel] = data[24].toInt();      // filterEGlevelU
-      upperData[P_LFORate] = data[25].toInt();            // LFORateU
-      upperData[P_LFOWaveform] = data[26].toInt();        // LFOWaveformU
-      upperData[P_filterAttack] = data[27].toInt();       // filterAttackU
-      upperData[P_filterDecay] = data[28].toInt();        // filterDecayU
-      upperData[P_filterSustain] = data[29].toInt();      // filterSustainU
-      upperData[P_filterRelease] = data[30].toInt();      // filterReleaseU
-      upperData[P_ampAttack] = data[31].toInt();          // ampAttackU
-      upperData[P_ampDecay] = data[32].toInt();           // ampDecayU
-      upperData[P_ampSustain] = data[33].toInt();         // ampSustainU
-      upperData[P_ampRelease] = data[34].toInt();         // ampReleaseU
-      upperData[P_volumeControl] = data[35].toInt();      // volumeControlU
-      upperData[P_glideSW] = data[36].toInt();            // glideSWU
-      upperData[P_keytrack] = data[37].toInt();           // keytrackU
-      upperData[P_filterPoleSW] = data[38].toInt();       // filterPoleSWU
-      upperData[P_filterLoop] = data[39].toInt();         // filterLoopU
-      upperData[P_filterEGinv] = data[40].toInt();        // filterEGinvU
-      upperData[P_filterVel] = data[41].toInt();          // filterVelU
-      upperData[P_vcaLoop] = data[42].toInt();            // vcaLoopU
-      upperData[P_vcaVel] = data[43].toInt();             // vcaVelU
-      upperData[P_vcaGate] = data[44].toInt();            // vcaGateU
-      upperData[P_lfoAlt] = data[45].toInt();             // lfoAltU
-      upperData[P_pmDCO2] = data[46].toInt();             // pmDCO2U
-      upperData[P_pmFilterEnv] = data[47].toInt();        // pmFilterEnvU
-      upperData[P_monoMulti] = data[48].toInt();          // monoMultiU
-      upperData[P_modWheelLevel] = data[49].toInt();      // modWheelLevelU
-      upperData[P_PitchBendLevel] = data[50].toInt();     // PitchBendLevelU
-      upperData[P_amDepth] = data[51].toInt();            // amDepthU
-      upperData[P_sync] = data[52].toInt();               // syncU
-      upperData[P_effectPot1] = data[53].toInt();         // effectPot1U
-      upperData[P_effectPot2] = data[54].toInt();         // effectPot2U
-      upperData[P_effectPot3] = data[55].toInt();         // effectPot3U
-      upperData[P_oldampAttack] = data[56].toInt();       // oldampAttackU
-      upperData[P_oldampDecay] = data[57].toInt();        // oldampDecayU
-      upperData[P_oldampSustain] = data[58].toInt();      // oldampSustainU
-      upperData[P_oldampRelease] = data[59].toInt();      // oldampReleaseU
-      upperData[P_AfterTouchDest] = data[60].toInt();     // AfterTouchDestU
-      upperData[P_filterLogLin] = data[61].toInt();       // filterLogLinU
-      upperData[P_ampLogLin] = data[62].toInt();          // ampLogLinU
-      upperData[P_osc2TriangleLevel] = data[63].toInt();  // osc2TriangleLevelU
-      upperData[P_osc1SubLevel] = data[64].toInt();       // osc1SubLevelU
-      upperData[P_keyboardMode] = data[65].toInt();       // keyTrackSWU
-      upperData[P_LFODelay] = data[66].toInt();           // LFODelayU
-      upperData[P_effectNum] = data[67].toInt();          // effectNumU
-      upperData[P_effectBank] = data[68].toInt();         // effectBankU
-      upperData[P_pmDestDCO1] = data[69].toInt();         // pmDestDCO1U
-      upperData[P_pmDestFilter] = data[70].toInt();       // pmDestFilterU
-      upperData[P_lfoMultiplier] = data[71].toInt();      // lfoMultiplierU
-      upperData[P_NotePriority] = data[72].toInt();       // NotePriorityU
-      upperData[P_keytrackSW] = data[73].toInt();         // keyTrackSWU
-
+      patchRecordCopy(upperData, record);
       oldfilterCutoffU = upperData[P_filterCutoff];
     }
   }
-  // Convert and send the SysEx message
-  // convertData();
-  // sendSysExMessage();
   sendi2cMessage();
   updatePatchname();
 }
 
 void sendi2cMessage() {
-
-  if (upperSW) {
-
-    Wire.beginTransmission(8);
-    for (int i = 0; i < 76; i++) {
-      Wire.write((uint8_t)(upperData[i] >> 8));    // High byte
-      Wire.write((uint8_t)(upperData[i] & 0xFF));  // Low byte
-    }
-    Wire.endTransmission();
-
-  } else {
-
-    Wire.beginTransmission(8);
-    for (int i = 0; i < 76; i++) {
-      Wire.write((uint8_t)(lowerData[i] >> 8));    // High byte
-      Wire.write((uint8_t)(lowerData[i] & 0xFF));  // Low byte
-    }
-    Wire.endTransmission();
-  }
-}
-
-void sendSysExMessage() {
-
-  // SysEx start byte
-
-  byte startByte = 0xF0;
-  // SysEx end byte
-  byte endByte = 0xF7;
-  // Manufacturer ID (3 bytes for non-real-time messages)
-  byte manufacturerID[] = { 0x7D, 0x00, 0x00 };  // 0x7D is reserved for educational use
-
-  // Begin the SysEx message
-  //MIDI7.sendSysEx(startByte + sizeof(manufacturerID) + sysexDataLength + endByte, sysexData, true);
-
-  // Alternatively, you can construct the message manually:
-  Serial7.write(startByte);
-  Serial7.write(manufacturerID, sizeof(manufacturerID));
-  Serial7.write(sysexData, sysexDataLength);
-  Serial7.write(endByte);
-
-  Serial.println("SysEx message sent.");
-}
-
-void convertData() {
-
-  if (upperSW) {
-
-    sysexData[0] = upperData[0];
-
-    for (int i = 0; i < originalDataLength; i++) {
-
-      sysexData[2 * i] = (upperData[i] >> 8) & 0xFF;
-      Serial.print(sysexData[2 * i]);
-      Serial.print(" ");
-      // Low byte contains the lower 7 bits (7-0)
-      sysexData[2 * i + 1] = upperData[i] & 0xFF;
-      Serial.print(sysexData[2 * i + 1]);
-      Serial.print(" ");
-    }
-
-  } else {
-
-    sysexData[0] = lowerData[0];
-
-    for (int i = 0; i < originalDataLength; i++) {
-      sysexData[2 * i] = (lowerData[i] >> 7) & 0x7F;
-      Serial.print(sysexData[2 * i]);
-      Serial.print(" ");
-      // Low byte contains the lower 7 bits (7-0)
-      sysexData[2 * i + 1] = lowerData[i] & 0x7F;
-      Serial.print(sysexData[2 * i + 1]);
-      Serial.print(" ");
-    }
-  }
+  PROFILE_SCOPE(PROFILE_I2C);
+#ifdef VOICE_LINK_BINARY
+  voiceLinkSendLayer(upperSW ? 2 : 1, upperSW ? upperData : lowerData, VOICE_PARAMS);
+#else
+  pushVoiceLayer(upperSW ? 1 : 0);
+#endif
 }
 
 void setAllButtons() {
@@ -5039,51 +3147,23 @@ void setAllButtons() {
   // updateglideSW(0);
 }
 
-String getCurrentPatchData() {
+//Formats the active layer into a fixed buffer, valid until the next call
+const char *getCurrentPatchData() {
+  static char patchLine[PATCH_LINE_LEN];
   if (upperSW) {
-    return patchNameU + "," + String(upperData[P_pwLFO]) + "," + String(upperData[P_fmDepth]) + "," + String(upperData[P_osc2PW]) + "," + String(upperData[P_osc2PWM])
-           + "," + String(upperData[P_osc1PW]) + "," + String(upperData[P_osc1PWM]) + "," + String(upperData[P_osc1Range]) + "," + String(upperData[P_osc2Range]) + "," + String(upperData[P_osc2Interval])
-           + "," + String(upperData[P_glideTime]) + "," + String(upperData[P_osc2Detune]) + "," + String(upperData[P_noiseLevel]) + "," + String(upperData[P_osc2SawLevel])
-           + "," + String(upperData[P_osc1SawLevel]) + "," + String(upperData[P_osc2PulseLevel]) + "," + String(upperData[P_osc1PulseLevel]) + "," + String(upperData[P_filterCutoff])
-           + "," + String(upperData[P_filterLFO]) + "," + String(upperData[P_filterRes]) + "," + String(upperData[P_filterType]) + "," + String(upperData[P_modWheelDepth])
-           + "," + String(upperData[P_effectsMix]) + "," + String(upperData[P_LFODelayGo]) + "," + String(upperData[P_filterEGlevel]) + "," + String(upperData[P_LFORate])
-           + "," + String(upperData[P_LFOWaveform]) + "," + String(upperData[P_filterAttack]) + "," + String(upperData[P_filterDecay]) + "," + String(upperData[P_filterSustain])
-           + "," + String(upperData[P_filterRelease]) + "," + String(upperData[P_ampAttack]) + "," + String(upperData[P_ampDecay]) + "," + String(upperData[P_ampSustain])
-           + "," + String(upperData[P_ampRelease]) + "," + String(upperData[P_volumeControl]) + "," + String(upperData[P_glideSW]) + "," + String(upperData[P_keytrack])
-           + "," + String(upperData[P_filterPoleSW]) + "," + String(upperData[P_filterLoop]) + "," + String(upperData[P_filterEGinv]) + "," + String(upperData[P_filterVel])
-           + "," + String(upperData[P_vcaLoop]) + "," + String(upperData[P_vcaVel]) + "," + String(upperData[P_vcaGate]) + "," + String(upperData[P_lfoAlt]) + "," + String(upperData[P_pmDCO2])
-           + "," + String(upperData[P_pmFilterEnv]) + "," + String(upperData[P_monoMulti]) + "," + String(upperData[P_modWheelLevel]) + "," + String(upperData[P_PitchBendLevel])
-           + "," + String(upperData[P_amDepth]) + "," + String(upperData[P_sync]) + "," + String(upperData[P_effectPot1]) + "," + String(upperData[P_effectPot2]) + "," + String(upperData[P_effectPot3])
-           + "," + String(upperData[P_oldampAttack]) + "," + String(upperData[P_oldampDecay]) + "," + String(upperData[P_oldampSustain]) + "," + String(upperData[P_oldampRelease])
-           + "," + String(upperData[P_AfterTouchDest]) + "," + String(upperData[P_filterLogLin]) + "," + String(upperData[P_ampLogLin]) + "," + String(upperData[P_osc2TriangleLevel])
-           + "," + String(upperData[P_osc1SubLevel]) + "," + String(upperData[P_keyboardMode]) + "," + String(upperData[P_LFODelay]) + "," + String(upperData[P_effectNum]) + "," + String(upperData[P_effectBank])
-           + "," + String(upperData[P_pmDestDCO1]) + "," + String(upperData[P_pmDestFilter]) + "," + String(upperData[P_lfoMultiplier]) + "," + String(upperData[P_NotePriority]) + "," + String(upperData[P_keytrackSW]);
+    formatPatchCsv(patchLine, sizeof(patchLine), patchNameU.c_str(), upperData, P_keytrackSW + 1);
   } else {
-    return patchNameL + "," + String(upperData[P_pwLFO]) + "," + String(lowerData[P_fmDepth]) + "," + String(lowerData[P_osc2PW]) + "," + String(lowerData[P_osc2PWM])
-           + "," + String(lowerData[P_osc1PW]) + "," + String(lowerData[P_osc1PWM]) + "," + String(lowerData[P_osc1Range]) + "," + String(lowerData[P_osc2Range]) + "," + String(lowerData[P_osc2Interval])
-           + "," + String(lowerData[P_glideTime]) + "," + String(lowerData[P_osc2Detune]) + "," + String(lowerData[P_noiseLevel]) + "," + String(lowerData[P_osc2SawLevel])
-           + "," + String(lowerData[P_osc1SawLevel]) + "," + String(lowerData[P_osc2PulseLevel]) + "," + String(lowerData[P_osc1PulseLevel]) + "," + String(lowerData[P_filterCutoff])
-           + "," + String(lowerData[P_filterLFO]) + "," + String(lowerData[P_filterRes]) + "," + String(lowerData[P_filterType]) + "," + String(lowerData[P_modWheelDepth])
-           + "," + String(lowerData[P_effectsMix]) + "," + String(lowerData[P_LFODelayGo]) + "," + String(lowerData[P_filterEGlevel]) + "," + String(lowerData[P_LFORate])
-           + "," + String(lowerData[P_LFOWaveform]) + "," + String(lowerData[P_filterAttack]) + "," + String(lowerData[P_filterDecay]) + "," + String(lowerData[P_filterSustain])
-           + "," + String(lowerData[P_filterRelease]) + "," + String(lowerData[P_ampAttack]) + "," + String(lowerData[P_ampDecay]) + "," + String(lowerData[P_ampSustain])
-           + "," + String(lowerData[P_ampRelease]) + "," + String(lowerData[P_volumeControl]) + "," + String(lowerData[P_glideSW]) + "," + String(lowerData[P_keytrack])
-           + "," + String(lowerData[P_filterPoleSW]) + "," + String(lowerData[P_filterLoop]) + "," + String(lowerData[P_filterEGinv]) + "," + String(lowerData[P_filterVel])
-           + "," + String(lowerData[P_vcaLoop]) + "," + String(lowerData[P_vcaVel]) + "," + String(lowerData[P_vcaGate]) + "," + String(lowerData[P_lfoAlt]) + "," + String(lowerData[P_pmDCO2])
-           + "," + String(lowerData[P_pmFilterEnv]) + "," + String(lowerData[P_monoMulti]) + "," + String(lowerData[P_modWheelLevel]) + "," + String(lowerData[P_PitchBendLevel])
-           + "," + String(lowerData[P_amDepth]) + "," + String(lowerData[P_sync]) + "," + String(lowerData[P_effectPot1]) + "," + String(lowerData[P_effectPot2]) + "," + String(lowerData[P_effectPot3])
-           + "," + String(lowerData[P_oldampAttack]) + "," + String(lowerData[P_oldampDecay]) + "," + String(lowerData[P_oldampSustain]) + "," + String(lowerData[P_oldampRelease])
-           + "," + String(lowerData[P_AfterTouchDest]) + "," + String(lowerData[P_filterLogLin]) + "," + String(lowerData[P_ampLogLin]) + "," + String(lowerData[P_osc2TriangleLevel])
-           + "," + String(lowerData[P_osc1SubLevel]) + "," + String(lowerData[P_keyboardMode]) + "," + String(lowerData[P_LFODelay]) + "," + String(lowerData[P_effectNum]) + "," + String(lowerData[P_effectBank])
-           + "," + String(lowerData[P_pmDestDCO1]) + "," + String(lowerData[P_pmDestFilter]) + "," + String(lowerData[P_lfoMultiplier]) + "," + String(lowerData[P_NotePriority]) + "," + String(lowerData[P_keytrackSW]);
+    formatPatchCsv(patchLine, sizeof(patchLine), patchNameL.c_str(), lowerData, P_keytrackSW + 1);
   }
+  return patchLine;
 }
 
 void checkMux() {
+  PROFILE_SCOPE(PROFILE_MUX);
 
-  mux1Read = adc->adc1->analogRead(MUX1_S);
-  mux2Read = adc->adc1->analogRead(MUX2_S);
-  mux3Read = adc->adc1->analogRead(MUX3_S);
+  mux1Read = POT_READ(0, muxInput, hal.adc->read(MUX1_S));
+  mux2Read = POT_READ(1, muxInput, hal.adc->read(MUX2_S));
+  mux3Read = POT_READ(2, muxInput, hal.adc->read(MUX3_S));
 
   if (mux1Read > (mux1ValuesPrev[muxInput] + QUANTISE_FACTOR) || mux1Read < (mux1ValuesPrev[muxInput] - QUANTISE_FACTOR)) {
     mux1ValuesPrev[muxInput] = mux1Read;
@@ -5228,6 +3308,8 @@ void checkMux() {
     }
   }
 
+  POT_STAGE(POT_STAGE_PARAM);
+
   muxInput++;
   if (muxInput >= MUXCHANNELS)
     muxInput = 0;
@@ -5239,279 +3321,124 @@ void checkMux() {
 }
 
 void midiCCOut(byte cc, byte value) {
-  MIDI.sendControlChange(cc, value, midiChannel);  //MIDI DIN is set to Out
+  hal.midiDin->controlChange(cc, value, midiChannel);  //MIDI DIN is set to Out
 }
 
 void midiCCOut71(byte cc, byte value) {
   Serial.print("Sent on channel 1 from the controller ");
   Serial.println(value);
-  MIDI7.sendControlChange(cc, value, 1);  //MIDI DIN is set to Out
+  hal.midiPanel->controlChange(cc, value, 1);  //MIDI DIN is set to Out
 }
 
 void midiCCOut72(byte cc, byte value) {
   Serial.print("Sent on channel 2 from the controller ");
   Serial.println(value);
-  MIDI7.sendControlChange(cc, value, 2);  //MIDI DIN is set to Out
+  hal.midiPanel->controlChange(cc, value, 2);  //MIDI DIN is set to Out
 }
 
 void midiCCOut73(byte cc, byte value) {
   // Serial.print("Sent on channel 3 from the controller ");
   // Serial.println(value);
-  MIDI7.sendControlChange(cc, value, 3);  //MIDI DIN is set to Out
+  hal.midiPanel->controlChange(cc, value, 3);  //MIDI DIN is set to Out
 }
 
-void midiCCOut61(byte cc, byte value) {
-  MIDI6.sendControlChange(cc, value, 1);  //MIDI DIN is set to Out channel 1
+//Voice board controls, channel 1 is the lower layer and 2 the upper.
+//Levels are 10 bit panel values, sent whole on the binary link or scaled down to 7 bit CCs.
+void voiceLevelOut(byte channel, byte cc, int value) {
+#ifdef VOICE_LINK_BINARY
+  voiceLinkSendParam(VLINK_SPACE_CONTROL, channel, cc, value);
+#else
+  hal.midiVoices->controlChange(cc, value >> midioutfrig, channel);
+#endif
 }
 
-void midiCCOut62(byte cc, byte value) {
-  MIDI6.sendControlChange(cc, value, 2);  //MIDI DIN is set to Out channel 2
-}
-
-void outputDAC(int CHIP_SELECT, uint32_t sample_data1, uint32_t sample_data2, uint32_t sample_data3, uint32_t sample_data4) {
-  SPI.beginTransaction(SPISettings(20000000, MSBFIRST, SPI_MODE1));
-  digitalWriteFast(CHIP_SELECT, LOW);
-  SPI.transfer32(sample_data1);
-  digitalWriteFast(CHIP_SELECT, HIGH);
-  digitalWriteFast(CHIP_SELECT, LOW);
-  SPI.transfer32(sample_data2);
-  digitalWriteFast(CHIP_SELECT, HIGH);
-  digitalWriteFast(CHIP_SELECT, LOW);
-  SPI.transfer32(sample_data3);
-  digitalWriteFast(CHIP_SELECT, HIGH);
-  digitalWriteFast(CHIP_SELECT, LOW);
-  SPI.transfer32(sample_data4);
-  digitalWriteFast(CHIP_SELECT, HIGH);
-  SPI.endTransaction();
+//Switches, octaves and ranges that are already in CC form
+void voiceParamOut(byte channel, byte cc, int value) {
+#ifdef VOICE_LINK_BINARY
+  voiceLinkSendParam(VLINK_SPACE_CONTROL, channel, cc, value);
+#else
+  hal.midiVoices->controlChange(cc, value, channel);
+#endif
 }
 
+//One S&H channel at a time without waiting. The enable opened by one run stays open while the rest of
+//loop() goes on, the first run after DEMUX_HOLD_US closes it, moves to the next channel and opens that.
 void writeDemux() {
+  if (demuxOpen) {
+    if (hal.clock->micros() - demuxOpenedAt < DEMUX_HOLD_US) return;
+    hal.pins->write(DEMUX_EN_1, HIGH);
+    demuxOpen = false;
+
+    muxOutput++;
+    if (muxOutput >= DEMUXCHANNELS)
+
+      muxOutput = 0;
+
+    hal.pins->write(DEMUX_0, muxOutput & B0001);
+    hal.pins->write(DEMUX_1, muxOutput & B0010);
+    hal.pins->write(DEMUX_2, muxOutput & B0100);
+    hal.pins->write(DEMUX_3, muxOutput & B1000);
+  }
+  PROFILE_SCOPE(PROFILE_DEMUX);
+
+  uint32_t words[4];
+  demuxWords(muxOutput, upperData, lowerData, words);
+  modApply(muxOutput, words);
+  clockApply(muxOutput, words);
+  POT_DEMUX(muxOutput, words);
+  hal.dac->write(DAC_CS1, words, 4);
+  POT_STAGE(POT_STAGE_DAC);
+  hal.pins->write(DEMUX_EN_1, LOW);
+  demuxOpenedAt = hal.clock->micros();
+  demuxOpen = true;
+}
 
-  switch (muxOutput) {
-
-    case 0:
-      sample_data1 = (channel_a & 0xFFF0000F) | (((int(upperData[P_noiseLevel] * MULT2V)) & 0xFFFF) << 4);
-      sample_data2 = (channel_c & 0xFFF0000F) | (((int(lowerData[P_noiseLevel] * MULT2V)) & 0xFFFF) << 4);
-
-      sample_data3 = (channel_b & 0xFFF0000F) | (((int(upperData[P_filterAttack] * MULT5V)) & 0xFFFF) << 4);
-      sample_data4 = (channel_d & 0xFFF0000F) | (((int(lowerData[P_filterAttack] * MULT5V)) & 0xFFFF) << 4);
-      outputDAC(DAC_CS1, sample_data1, sample_data2, sample_data3, sample_data4);
-      digitalWriteFast(DEMUX_EN_1, LOW);
-      break;
-
-    case 1:
-      sample_data1 = (channel_a & 0xFFF0000F) | (((int(upperData[P_osc1SawLevel] * MULT2V)) & 0xFFFF) << 4);
-      sample_data2 = (channel_c & 0xFFF0000F) | (((int(lowerData[P_osc1SawLevel] * MULT2V)) & 0xFFFF) << 4);
-
-      sample_data3 = (channel_b & 0xFFF0000F) | (((int(upperData[P_filterDecay] * MULT5V)) & 0xFFFF) << 4);
-      sample_data4 = (channel_d & 0xFFF0000F) | (((int(lowerData[P_filterDecay] * MULT5V)) & 0xFFFF) << 4);
-      outputDAC(DAC_CS1, sample_data1, sample_data2, sample_data3, sample_data4);
-      digitalWriteFast(DEMUX_EN_1, LOW);
-      break;
-
-    case 2:
-      sample_data1 = (channel_a & 0xFFF0000F) | (((int(upperData[P_osc1PulseLevel] * MULT2V)) & 0xFFFF) << 4);
-      sample_data2 = (channel_c & 0xFFF0000F) | (((int(lowerData[P_osc1PulseLevel] * MULT2V)) & 0xFFFF) << 4);
-
-      sample_data3 = (channel_b & 0xFFF0000F) | (((int(upperData[P_filterSustain] * MULT5V)) & 0xFFFF) << 4);
-      sample_data4 = (channel_d & 0xFFF0000F) | (((int(lowerData[P_filterSustain] * MULT5V)) & 0xFFFF) << 4);
-      outputDAC(DAC_CS1, sample_data1, sample_data2, sample_data3, sample_data4);
-      digitalWriteFast(DEMUX_EN_1, LOW);
-      break;
-
-    case 3:
-      sample_data1 = (channel_a & 0xFFF0000F) | (((int(upperData[P_osc1SubLevel] * MULT2V)) & 0xFFFF) << 4);
-      sample_data2 = (channel_c & 0xFFF0000F) | (((int(lowerData[P_osc1SubLevel] * MULT2V)) & 0xFFFF) << 4);
-
-      sample_data3 = (channel_b & 0xFFF0000F) | (((int(upperData[P_filterRelease] * MULT5V)) & 0xFFFF) << 4);
-      sample_data4 = (channel_d & 0xFFF0000F) | (((int(lowerData[P_filterRelease] * MULT5V)) & 0xFFFF) << 4);
-      outputDAC(DAC_CS1, sample_data1, sample_data2, sample_data3, sample_data4);
-      digitalWriteFast(DEMUX_EN_1, LOW);
-      break;
-
-    case 4:
-      sample_data1 = (channel_a & 0xFFF0000F) | (((int(upperData[P_pmDCO2] * MULT2V)) & 0xFFFF) << 4);
-      sample_data2 = (channel_c & 0xFFF0000F) | (((int(lowerData[P_pmDCO2] * MULT2V)) & 0xFFFF) << 4);
-
-      sample_data3 = (channel_b & 0xFFF0000F) | (((int(upperData[P_ampAttack] * MULT5V)) & 0xFFFF) << 4);
-      sample_data4 = (channel_d & 0xFFF0000F) | (((int(lowerData[P_ampAttack] * MULT5V)) & 0xFFFF) << 4);
-      outputDAC(DAC_CS1, sample_data1, sample_data2, sample_data3, sample_data4);
-      digitalWriteFast(DEMUX_EN_1, LOW);
-      break;
-
-    case 5:
-      sample_data1 = (channel_a & 0xFFF0000F) | (((int(upperData[P_pmFilterEnv] * MULT2V)) & 0xFFFF) << 4);
-      sample_data2 = (channel_c & 0xFFF0000F) | (((int(lowerData[P_pmFilterEnv] * MULT2V)) & 0xFFFF) << 4);
-
-      sample_data3 = (channel_b & 0xFFF0000F) | (((int(upperData[P_ampDecay] * MULT5V)) & 0xFFFF) << 4);
-      sample_data4 = (channel_d & 0xFFF0000F) | (((int(lowerData[P_ampDecay] * MULT5V)) & 0xFFFF) << 4);
-      outputDAC(DAC_CS1, sample_data1, sample_data2, sample_data3, sample_data4);
-      digitalWriteFast(DEMUX_EN_1, LOW);
-      break;
-
-    case 6:
-      sample_data1 = (channel_a & 0xFFF0000F) | (((int(upperData[P_osc2SawLevel] * MULT2V)) & 0xFFFF) << 4);
-      sample_data2 = (channel_c & 0xFFF0000F) | (((int(lowerData[P_osc2SawLevel] * MULT2V)) & 0xFFFF) << 4);
-
-      sample_data3 = (channel_b & 0xFFF0000F) | (((int(upperData[P_ampSustain] * MULT5V)) & 0xFFFF) << 4);
-      sample_data4 = (channel_d & 0xFFF0000F) | (((int(lowerData[P_ampSustain] * MULT5V)) & 0xFFFF) << 4);
-      outputDAC(DAC_CS1, sample_data1, sample_data2, sample_data3, sample_data4);
-      digitalWriteFast(DEMUX_EN_1, LOW);
-      break;
-
-    case 7:
-      sample_data1 = (channel_a & 0xFFF0000F) | (((int(upperData[P_osc2PulseLevel] * MULT2V)) & 0xFFFF) << 4);
-      sample_data2 = (channel_c & 0xFFF0000F) | (((int(lowerData[P_osc2PulseLevel] * MULT2V)) & 0xFFFF) << 4);
-
-      sample_data3 = (channel_b & 0xFFF0000F) | (((int(upperData[P_ampRelease] * MULT5V)) & 0xFFFF) << 4);
-      sample_data4 = (channel_d & 0xFFF0000F) | (((int(lowerData[P_ampRelease] * MULT5V)) & 0xFFFF) << 4);
-      outputDAC(DAC_CS1, sample_data1, sample_data2, sample_data3, sample_data4);
-      digitalWriteFast(DEMUX_EN_1, LOW);
-      break;
-
-    case 8:
-      sample_data1 = (channel_a & 0xFFF0000F) | (((int(upperData[P_osc2TriangleLevel] * MULT2V)) & 0xFFFF) << 4);
-      sample_data2 = (channel_c & 0xFFF0000F) | (((int(lowerData[P_osc2TriangleLevel] * MULT2V)) & 0xFFFF) << 4);
-
-      sample_data3 = (channel_b & 0xFFF0000F) | (((int(upperData[P_filterEGlevel] * MULT5V)) & 0xFFFF) << 4);
-      sample_data4 = (channel_d & 0xFFF0000F) | (((int(lowerData[P_filterEGlevel] * MULT5V)) & 0xFFFF) << 4);
-      outputDAC(DAC_CS1, sample_data1, sample_data2, sample_data3, sample_data4);
-      digitalWriteFast(DEMUX_EN_1, LOW);
-      break;
-
-    case 9:
-      sample_data1 = (channel_a & 0xFFF0000F) | (((int(upperData[P_volumeControl] * MULT2V)) & 0xFFFF) << 4);
-      sample_data2 = (channel_c & 0xFFF0000F) | (((int(lowerData[P_volumeControl] * MULT2V)) & 0xFFFF) << 4);
-
-      sample_data3 = (channel_b & 0xFFF0000F) | (((int(upperData[P_filterCutoff] * MULT5V)) & 0xFFFF) << 4);
-      sample_data4 = (channel_d & 0xFFF0000F) | (((int(lowerData[P_filterCutoff] * MULT5V)) & 0xFFFF) << 4);
-      outputDAC(DAC_CS1, sample_data1, sample_data2, sample_data3, sample_data4);
-      digitalWriteFast(DEMUX_EN_1, LOW);
-      break;
-
-    case 10:
-      sample_data1 = (channel_a & 0xFFF0000F) | (((int(upperData[P_effectsMix] * MULT2V)) & 0xFFFF) << 4);
-      sample_data2 = (channel_c & 0xFFF0000F) | (((int(lowerData[P_effectsMix] * MULT2V)) & 0xFFFF) << 4);
-
-      sample_data3 = (channel_b & 0xFFF0000F) | (((int(upperData[P_filterRes] * MULT5V)) & 0xFFFF) << 4);
-      sample_data4 = (channel_d & 0xFFF0000F) | (((int(lowerData[P_filterRes] * MULT5V)) & 0xFFFF) << 4);
-      outputDAC(DAC_CS1, sample_data1, sample_data2, sample_data3, sample_data4);
-      digitalWriteFast(DEMUX_EN_1, LOW);
-      break;
-
-    case 11:
-      switch (upperData[P_LFODelayGo]) {
-        case 1:
-          sample_data1 = (channel_a & 0xFFF0000F) | (((int(upperData[P_fmDepth] * MULT2V)) & 0xFFFF) << 4);
-          break;
-
-        case 0:
-          sample_data1 = (channel_a & 0xFFF0000F) | ((0 & 0xFFFF) << 4);
-          break;
-      }
-      switch (lowerData[P_LFODelayGo]) {
-        case 1:
-          sample_data2 = (channel_c & 0xFFF0000F) | (((int(lowerData[P_fmDepth] * MULT2V)) & 0xFFFF) << 4);
-          break;
-
-        case 0:
-          sample_data2 = (channel_c & 0xFFF0000F) | ((0 & 0xFFFF) << 4);
-          break;
-      }
-
-      sample_data3 = (channel_b & 0xFFF0000F) | (((int(upperData[P_LFORate] * MULT5V)) & 0xFFFF) << 4);
-      sample_data4 = (channel_d & 0xFFF0000F) | (((int(lowerData[P_LFORate] * MULT5V)) & 0xFFFF) << 4);
-      outputDAC(DAC_CS1, sample_data1, sample_data2, sample_data3, sample_data4);
-      digitalWriteFast(DEMUX_EN_1, LOW);
-      break;
-
-    case 12:
-      switch (upperData[P_LFODelayGo]) {
-        case 1:
-          sample_data1 = (channel_a & 0xFFF0000F) | (((int(upperData[P_filterLFO] * MULT2V)) & 0xFFFF) << 4);
-          break;
-
-        case 0:
-          sample_data1 = (channel_a & 0xFFF0000F) | ((0 & 0xFFFF) << 4);
-          break;
-      }
-      switch (lowerData[P_LFODelayGo]) {
-        case 1:
-          sample_data2 = (channel_c & 0xFFF0000F) | (((int(lowerData[P_filterLFO] * MULT2V)) & 0xFFFF) << 4);
-          break;
-
-        case 0:
-          sample_data2 = (channel_c & 0xFFF0000F) | ((0 & 0xFFFF) << 4);
-          break;
-      }
-
-      sample_data3 = (channel_b & 0xFFF0000F) | (((int(upperData[P_LFOWaveform] * MULT5V)) & 0xFFFF) << 4);
-      sample_data4 = (channel_d & 0xFFF0000F) | (((int(lowerData[P_LFOWaveform] * MULT5V)) & 0xFFFF) << 4);
-      outputDAC(DAC_CS1, sample_data1, sample_data2, sample_data3, sample_data4);
-      digitalWriteFast(DEMUX_EN_1, LOW);
-      break;
-
-    case 13:
-      switch (upperData[P_LFODelayGo]) {
-        case 1:
-          sample_data1 = (channel_a & 0xFFF0000F) | (((int(upperData[P_amDepth] * MULT2V)) & 0xFFFF) << 4);
-          break;
-
-        case 0:
-          sample_data1 = (channel_a & 0xFFF0000F) | ((0 & 0xFFFF) << 4);
-          break;
-      }
-      switch (lowerData[P_LFODelayGo]) {
-        case 1:
-          sample_data2 = (channel_c & 0xFFF0000F) | (((int(lowerData[P_amDepth] * MULT2V)) & 0xFFFF) << 4);
-          break;
-
-        case 0:
-          sample_data2 = (channel_c & 0xFFF0000F) | ((0 & 0xFFFF) << 4);
-          break;
-      }
-
-      sample_data3 = (channel_b & 0xFFF0000F) | (((int(upperData[P_effectPot1] * MULT33V)) & 0xFFFF) << 4);
-      sample_data4 = (channel_d & 0xFFF0000F) | (((int(lowerData[P_effectPot1] * MULT33V)) & 0xFFFF) << 4);
-      outputDAC(DAC_CS1, sample_data1, sample_data2, sample_data3, sample_data4);
-      digitalWriteFast(DEMUX_EN_1, LOW);
-      break;
-
-    case 14:
-      sample_data1 = (channel_a & 0xFFF0000F) | ((0 & 0xFFFF) << 4);
-      sample_data2 = (channel_c & 0xFFF0000F) | ((0 & 0xFFFF) << 4);
-
-      sample_data3 = (channel_b & 0xFFF0000F) | (((int(upperData[P_effectPot2] * MULT33V)) & 0xFFFF) << 4);
-      sample_data4 = (channel_d & 0xFFF0000F) | (((int(lowerData[P_effectPot2] * MULT33V)) & 0xFFFF) << 4);
-      outputDAC(DAC_CS1, sample_data1, sample_data2, sample_data3, sample_data4);
-      digitalWriteFast(DEMUX_EN_1, LOW);
-      break;
-
-    case 15:
-      sample_data1 = (channel_a & 0xFFF0000F) | (((upperData[P_pwLFO] * MULT5V) & 0xFFFF) << 4);
-      sample_data2 = (channel_c & 0xFFF0000F) | (((upperData[P_pwLFO] * MULT5V) & 0xFFFF) << 4);
-
-      sample_data3 = (channel_b & 0xFFF0000F) | (((int(upperData[P_effectPot3] * MULT33V)) & 0xFFFF) << 4);
-      sample_data4 = (channel_d & 0xFFF0000F) | (((int(lowerData[P_effectPot3] * MULT33V)) & 0xFFFF) << 4);
-      outputDAC(DAC_CS1, sample_data1, sample_data2, sample_data3, sample_data4);
-      digitalWriteFast(DEMUX_EN_1, LOW);
-      break;
+void checkStorage() {
+  static unsigned long lastLoop = 0;
+  unsigned long now = micros();
+  if (storageBusy() && lastLoop != 0 && now - lastLoop > maxLoopStall) maxLoopStall = now - lastLoop;
+  lastLoop = now;
+
+  static StorageEvent event;
+  while (storageEvents.pop(event)) {
+    applyStorageEvent(event);
+    if (event.op == STORAGE_RECORD) continue;  //Part of a scan, the scan itself reports back
+    storagePending--;
+    switch (event.op) {
+      case STORAGE_LOAD:
+        //Recall again now the patch is in RAM, if it's still the one wanted on that layer
+        if (event.ok && event.upper == upperSW && event.patchNo == (upperSW ? patchNoU : patchNoL)) recallPatch(event.patchNo);
+        break;
+      case STORAGE_SAVE:
+      case STORAGE_DELETE:
+        Serial.println(String(event.op == STORAGE_SAVE ? "Saved patch " : "Deleted patch ") + String(event.patchNo) + ", longest loop " + String(maxLoopStall) + "us");
+        break;
+      case STORAGE_SCAN:
+      case STORAGE_REBUILD:
+        resetPatchesOrdering();
+        Serial.println(String("Rescanned, ") + patches.size() + " patches");
+        break;
+      case STORAGE_DUMP:
+        flightDumpDone();
+        Serial.println(event.ok ? String("Flight recorder written to ") + flightDumpName : String("Flight recorder dump failed"));
+        break;
+    }
+    if (!storageBusy()) maxLoopStall = 0;
   }
-  delayMicroseconds(800);
-  digitalWriteFast(DEMUX_EN_1, HIGH);
-
-  muxOutput++;
-  if (muxOutput >= DEMUXCHANNELS)
-
-    muxOutput = 0;
+}
 
-  digitalWriteFast(DEMUX_0, muxOutput & B0001);
-  digitalWriteFast(DEMUX_1, muxOutput & B0010);
-  digitalWriteFast(DEMUX_2, muxOutput & B0100);
-  digitalWriteFast(DEMUX_3, muxOutput & B1000);
+void checkFlightRecorder() {
+  if (!flightDumpDue()) return;
+  if (!cardStatus) {
+    flightDumpDone();
+    Serial.println("Flight recorder needs an SD card");
+    return;
+  }
+  postStorageRequest(STORAGE_DUMP, 0, NO_SLOT, upperSW, NULL);
 }
 
 void checkEeprom() {
+  flushSettings(false);
 
   // if (oldsplitTrans != splitTrans) {
   //   setTranspose(splitTrans);
@@ -5530,22 +3457,26 @@ void showSettingsPage() {
   showSettingsPage(settings::current_setting(), settings::current_setting_value(), state);
 }
 
-void checkSwitches() {
+//SAVE appends an INITPATCHNAME entry, it only stays if that is the patch that was saved
+void dropUnsavedNewPatch(int savedPatchNo) {
+  int last = patches.size() - 1;
+  if (last >= 0 && patches.at(last).patchNo != savedPatchNo) patches.removeAt(last);
+}
 
-  saveButton.update();
-  if (saveButton.held()) {
+void onSaveButton(uint8_t type) {
+  if (type == INPUT_HOLD) {
     switch (state) {
       case PARAMETER:
       case PATCH:
         state = DELETE;
         break;
     }
-  } else if (saveButton.numClicks() == 1) {
+  } else if (type == INPUT_CLICK) {
     switch (state) {
       case PARAMETER:
-        if (patches.size() < PATCHES_LIMIT) {
+        if (patches.size() < PATCHES_LIMIT && !storageScanning) {
           resetPatchesOrdering();  //Reset order of patches from first patch
-          patches.push({ patches.size() + 1, INITPATCHNAME });
+          patches.insert(patches.size() + 1, INITPATCHNAME);
           state = SAVE;
         }
         break;
@@ -5553,11 +3484,11 @@ void checkSwitches() {
         //Save as new patch with INITIALPATCH name or overwrite existing keeping name - bypassing patch renaming
         patchName = patches.last().patchName;
         state = PATCH;
-        savePatch(String(patches.last().patchNo).c_str(), getCurrentPatchData());
+        savePatch(patches.last().patchNo, getCurrentPatchData());
         //showPatchPage(patches.last().patchNo, patches.last().patchName);
         showPatchPage(patches.last().patchNo, patches.last().patchName, "", "");
         patchNo = patches.last().patchNo;
-        loadPatches();  //Get rid of pushed patch if it wasn't saved
+        dropUnsavedNewPatch(patchNo);
         setPatchesOrdering(patchNo);
         renamedPatch = "";
         state = PARAMETER;
@@ -5565,25 +3496,26 @@ void checkSwitches() {
       case PATCHNAMING:
         if (renamedPatch.length() > 0) patchName = renamedPatch;  //Prevent empty strings
         state = PATCH;
-        savePatch(String(patches.last().patchNo).c_str(), getCurrentPatchData());
+        savePatch(patches.last().patchNo, getCurrentPatchData());
         showPatchPage(patches.last().patchNo, patches.last().patchName, "", "");
         //showPatchPage(patches.last().patchNo, patchName);
         patchNo = patches.last().patchNo;
-        loadPatches();  //Get rid of pushed patch if it wasn't saved
+        dropUnsavedNewPatch(patchNo);
         setPatchesOrdering(patchNo);
         renamedPatch = "";
         state = PARAMETER;
         break;
     }
   }
+}
 
-  settingsButton.update();
-  if (settingsButton.held()) {
+void onSettingsButton(uint8_t type) {
+  if (type == INPUT_HOLD) {
     //If recall held, set current patch to match current hardware state
     //Reinitialise all hardware values to force them to be re-read if different
     state = REINITIALISE;
     reinitialiseToPanel();
-  } else if (settingsButton.numClicks() == 1) {
+  } else if (type == INPUT_CLICK) {
     switch (state) {
       case PARAMETER:
         state = SETTINGS;
@@ -5598,20 +3530,25 @@ void checkSwitches() {
         break;
     }
   }
+}
 
-  backButton.update();
-  if (backButton.held()) {
+void onBackButton(uint8_t type) {
+  if (type == INPUT_HOLD) {
     //If Back button held, Panic - all notes off
-  } else if (backButton.numClicks() == 1) {
+  } else if (type == INPUT_CLICK) {
     switch (state) {
       case RECALL:
         setPatchesOrdering(patchNo);
         state = PARAMETER;
         break;
+      case BROWSE:
+        setPatchesOrdering(browseFromPatch);
+        state = PARAMETER;
+        break;
       case SAVE:
         renamedPatch = "";
         state = PARAMETER;
-        loadPatches();  //Remove patch that was to be saved
+        patches.removeAt(patches.size() - 1);  //Remove new slot that was to be saved
         setPatchesOrdering(patchNo);
         break;
       case PATCHNAMING:
@@ -5632,10 +3569,11 @@ void checkSwitches() {
         break;
     }
   }
+}
 
-  //Encoder switch
-  recallButton.update();
-  if (recallButton.held()) {
+//Encoder switch
+void onRecallButton(uint8_t type) {
+  if (type == INPUT_HOLD) {
     //If Recall button held, return to current patch setting
     //which clears any changes made
     state = PATCH;
@@ -5643,11 +3581,14 @@ void checkSwitches() {
     patchNo = patches.first().patchNo;
     recallPatch(patchNo);
     state = PARAMETER;
-  } else if (recallButton.numClicks() == 1) {
+  } else if (type == INPUT_CLICK) {
     switch (state) {
       case PARAMETER:
         state = RECALL;  //show patch list
         break;
+      case BROWSE:
+        commitBrowse();
+        break;
       case RECALL:
         state = PATCH;
         //Recall the current patch
@@ -5670,15 +3611,12 @@ void checkSwitches() {
         }
         break;
       case DELETE:
-        //Don't delete final patch
-        if (patches.size() > 1) {
+        //Don't delete final patch, or while a rescan is replacing the directory
+        if (patches.size() > 1 && !storageScanning) {
           state = DELETEMSG;
-          patchNo = patches.first().patchNo;     //PatchNo to delete from SD card
-          patches.shift();                       //Remove patch from circular buffer
-          deletePatch(String(patchNo).c_str());  //Delete from SD card
-          loadPatches();                         //Repopulate circular buffer to start from lowest Patch No
-          renumberPatchesOnSD();
-          loadPatches();                      //Repopulate circular buffer again after delete
+          patchNo = patches.first().patchNo;  //PatchNo to delete
+          deletePatch(patchNo);               //Drop from slot table, later patches move down one
+          resetPatchesOrdering();
           patchNo = patches.first().patchNo;  //Go back to 1
           recallPatch(patchNo);               //Load first patch
         }
@@ -5711,31 +3649,20 @@ void reinitialiseToPanel() {
   showPatchPage("Initial", "Panel Settings", "", "");
 }
 
-void checkEncoder() {
-  //Encoder works with relative inc and dec values
-  //Detent encoder goes up in 4 steps, hence +/-3
-
-  long encRead = encoder.read();
-  if ((encCW && encRead > encPrevious + 3) || (!encCW && encRead < encPrevious - 3)) {
+void onEncoderDetent(int direction, uint32_t time) {
+  //Encoder works with relative inc and dec values, one event per detent
+  if (!encCW) direction = -direction;
+  if (direction > 0) {
     switch (state) {
       case PARAMETER:
-        state = PATCH;
-        if (upperSW) {
-          patches.push(patches.shift());
-          patchNoU = patches.first().patchNo;
-          recallPatch(patchNoU);
-        } else {
-          patches.push(patches.shift());
-          patchNoL = patches.first().patchNo;
-          recallPatch(patchNoL);
-        }
-        state = PARAMETER;
+      case BROWSE:
+        browsePatches(1, time);
         break;
       case RECALL:
-        patches.push(patches.shift());
+        patches.next();
         break;
       case SAVE:
-        patches.push(patches.shift());
+        patches.next();
         break;
       case PATCHNAMING:
         if (charIndex == TOTALCHARS) charIndex = 0;  //Wrap around
@@ -5743,7 +3670,7 @@ void checkEncoder() {
         showRenamingPage(renamedPatch + currentCharacter);
         break;
       case DELETE:
-        patches.push(patches.shift());
+        patches.next();
         break;
       case SETTINGS:
         settings::increment_setting();
@@ -5754,27 +3681,17 @@ void checkEncoder() {
         showSettingsPage();
         break;
     }
-    encPrevious = encRead;
-  } else if ((encCW && encRead < encPrevious - 3) || (!encCW && encRead > encPrevious + 3)) {
+  } else {
     switch (state) {
       case PARAMETER:
-        state = PATCH;
-        if (upperSW) {
-          patches.unshift(patches.pop());
-          patchNoU = patches.first().patchNo;
-          recallPatch(patchNoU);
-        } else {
-          patches.unshift(patches.pop());
-          patchNoL = patches.first().patchNo;
-          recallPatch(patchNoL);
-        }
-        state = PARAMETER;
+      case BROWSE:
+        browsePatches(-1, time);
         break;
       case RECALL:
-        patches.unshift(patches.pop());
+        patches.prev();
         break;
       case SAVE:
-        patches.unshift(patches.pop());
+        patches.prev();
         break;
       case PATCHNAMING:
         if (charIndex == -1)
@@ -5783,7 +3700,7 @@ void checkEncoder() {
         showRenamingPage(renamedPatch + currentCharacter);
         break;
       case DELETE:
-        patches.unshift(patches.pop());
+        patches.prev();
         break;
       case SETTINGS:
         settings::decrement_setting();
@@ -5794,7 +3711,80 @@ void checkEncoder() {
         showSettingsPage();
         break;
     }
-    encPrevious = encRead;
+  }
+}
+
+//Encoder in PARAMETER only moves through the directory, names come from RAM so nothing is read
+//or sent to the voices until checkBrowse() or a click commits. Fast turns skip several patches.
+void browsePatches(int direction, uint32_t time) {
+  if (state != BROWSE) {
+    state = BROWSE;
+    browseFromPatch = patches.first().patchNo;
+    browseDetents = 0;
+    browseReads = storageReads;
+    browseLastDetent = time - BROWSE_MEDIUM_US;
+  }
+  uint32_t gap = time - browseLastDetent;
+  int steps = gap < BROWSE_FAST_US ? 10 : gap < BROWSE_MEDIUM_US ? 3 : 1;
+  for (int i = 0; i < steps; i++) {
+    if (direction > 0) {
+      patches.next();
+    } else {
+      patches.prev();
+    }
+  }
+  browseLastDetent = time;
+  browseLastMove = millis();
+  browseDetents++;
+}
+
+void commitBrowse() {
+  state = PATCH;
+  if (upperSW) {
+    patchNoU = patches.first().patchNo;
+    recallPatch(patchNoU);
+  } else {
+    patchNoL = patches.first().patchNo;
+    recallPatch(patchNoL);
+  }
+  state = PARAMETER;
+  browseReport = true;
+}
+
+void checkBrowse() {
+  if (state == BROWSE && millis() - browseLastMove >= BROWSE_COMMIT_MS) commitBrowse();
+  //Report once any load the recall queued has finished
+  if (browseReport && !storageBusy()) {
+    browseReport = false;
+    Serial.println("Browse " + String(browseDetents) + " detents, " + String(storageReads - browseReads) + " SD reads");
+  }
+}
+
+//Drains the scanner's event queue, see InputScanner.h
+void checkInput() {
+  InputEvent event;
+  while (popInputEvent(event)) {
+    if (event.index == INPUT_ENCODER) {
+      onEncoderDetent(event.value, event.time);
+      continue;
+    }
+    switch (event.index) {
+      case INPUT_RECALL:
+        onRecallButton(event.type);
+        break;
+      case INPUT_SAVE:
+        onSaveButton(event.type);
+        break;
+      case INPUT_SETTINGS:
+        onSettingsButton(event.type);
+        break;
+      case INPUT_BACK:
+        onBackButton(event.type);
+        break;
+      default:
+        if (event.type == INPUT_PRESS) onButtonPress(event.index, ROX_PRESSED);
+        break;
+    }
   }
 }
 
@@ -5833,7 +3823,7 @@ void onButtonPress(uint16_t btnIndex, uint8_t btnType) {
 
   if (btnIndex == FILTER_TYPE_SW && btnType == ROX_PRESSED) {
     panelData[P_filterType] = panelData[P_filterType] + 1;
-    if (panelData[P_filterType] > 7) {
+    if (panelData[P_filterType] >= FILTER_MODE_COUNT) {
       panelData[P_filterType] = 0;
     }
     myControlChange(midiChannel, CCfilterType, panelData[P_filterType]);
@@ -5846,7 +3836,7 @@ void onButtonPress(uint16_t btnIndex, uint8_t btnType) {
 
   if (btnIndex == LFO_MULT_SW && btnType == ROX_PRESSED) {
     panelData[P_lfoMultiplier] = panelData[P_lfoMultiplier] + 1;
-    if (panelData[P_lfoMultiplier] > 4) {
+    if (panelData[P_lfoMultiplier] >= LFO_MULTIPLIER_COUNT) {
       panelData[P_lfoMultiplier] = 0;
     }
     myControlChange(midiChannel, CClfoMult, panelData[P_lfoMultiplier]);
@@ -5854,7 +3844,7 @@ void onButtonPress(uint16_t btnIndex, uint8_t btnType) {
 
   if (btnIndex == LFO_WAVEFORM_SW && btnType == ROX_PRESSED) {
     panelData[P_LFOWaveform] = panelData[P_LFOWaveform] + 1;
-    if (panelData[P_LFOWaveform] > 7) {
+    if (panelData[P_LFOWaveform] >= LFO_WAVEFORM_COUNT) {
       panelData[P_LFOWaveform] = 0;
     }
     myControlChange(midiChannel, CCLFOWaveform, panelData[P_LFOWaveform]);
@@ -5996,17 +3986,254 @@ void onButtonPress(uint16_t btnIndex, uint8_t btnType) {
   }
 }
 
-void loop() {
-  checkSwitches();
-  checkEeprom();
-  writeDemux();
-  checkMux();
-  checkEncoder();
-  MIDI.read(midiChannel);
+//Same channel filter and null velocity note off as the MIDI library gave the DIN input
+float lfoMultiplierFactor(int multiplier) {
+  return multiplier >= 0 && multiplier < LFO_MULTIPLIER_COUNT ? LFO_MULTIPLIERS[multiplier].factor : 1;
+}
+
+//Clock bytes keep the drain timer's timestamp, they only get this far while midiClockWanted is set
+void midiClockMessage(const MidiMessage &msg) {
+  switch (msg.status) {
+    case 0xF8:
+      midiClock.tick(msg.time);
+      clockUpdateRates(LFOTEMPO, upperData, lowerData, lfoMultiplierFactor(upperData[P_lfoMultiplier]), lfoMultiplierFactor(lowerData[P_lfoMultiplier]));
+      break;
+    case 0xFA:
+      midiClock.start();
+      break;
+    case 0xFB:
+      midiClock.resume();
+      break;
+    case 0xFC:
+      midiClock.stop();
+      break;
+  }
+  MIDIClkSignal = midiClock.isLocked();
+}
+
+void checkMidiClock() {
+  midiClock.poll(micros());
+  MIDIClkSignal = midiClock.isLocked();
+}
+
+void dispatchDinMidi(const MidiMessage &msg) {
+  if (msg.status == 0xF0) {
+    dinSysEx(dinSysex, dinSysexLength);
+    releaseDinSysex();
+    return;
+  }
+  if (midiClassOf(msg.status) == MIDI_CLASS_CLOCK) {
+    midiClockMessage(msg);
+    return;
+  }
+  if (msg.status >= 0xF0) return;
+  byte channel = (msg.status & 0x0F) + 1;
+  if (midiChannel != MIDI_CHANNEL_OMNI && channel != midiChannel) return;
+  switch (msg.status & 0xF0) {
+    case 0x80:
+      myNoteOff(channel, msg.data1, msg.data2);
+      break;
+    case 0x90:
+      //Only a note on reaches flightNoteSent(), a stamp left by a velocity 0 note off would time the next USB note
+      if (msg.data2) {
+        flightNoteArrived(msg.time);
+        myNoteOn(channel, msg.data1, msg.data2);
+      } else {
+        myNoteOff(channel, msg.data1, 0);
+      }
+      break;
+    case 0xB0:
+      editControlChange(channel, msg.data1, msg.data2);
+      break;
+    case 0xC0:
+      myProgramChange(channel, msg.data1);
+      break;
+    case 0xD0:
+      myAfterTouch(channel, msg.data1);
+      break;
+    case 0xE0:
+      DinHandlePitchBend(channel, (msg.data1 | msg.data2 << 7) + MIDI_PITCHBEND_MIN);
+      break;
+  }
+}
+
+void readMidi() {
+  PROFILE_SCOPE(PROFILE_MIDI);
+  flightMidiPoll();
+  MidiMessage msg;
+  while (popDinMidi(msg)) dispatchDinMidi(msg);
   MIDI6.read(midiChannel);
   MIDI7.read();
   usbMIDI.read(midiChannel);
-  octoswitch.update();  // read all the buttons for the Synth
-  srp.update();         // update all the LEDs in the buttons
-  LFODelayHandle();
-}
\ No newline at end of file
+}
+
+void checkVoices() {
+  checkVoiceI2C();
+  checkVoiceLink();
+}
+
+void checkTransfers() {
+  checkSysexDump();
+  checkUsbTransfer();
+}
+
+void checkPanel() {
+  if (!storageScanning) checkInput();
+  checkBrowse();
+}
+
+#ifdef LOOP_PROFILER
+void printSerialLine(const char *line) {
+  Serial.println(line);
+}
+
+void profileCommand(const char *args) {
+  if (strcmp(args, "reset") == 0) {
+    profileReset();
+    Serial.println("Profile reset");
+  } else {
+    profileReport(printSerialLine);
+  }
+}
+#endif
+
+#ifdef POT_LATENCY
+void printPotLine(const char *line) {
+  Serial.println(line);
+}
+
+//"pot sweep N" steps every control N times, "pot reset" clears the figures, "pot" prints them
+void potCommand(const char *args) {
+  if (strncmp(args, "sweep", 5) == 0) {
+    int steps = atoi(args + 5);
+    potLatencySweep(steps > 0 ? steps : 1);
+    Serial.println("Pot sweep started");
+  } else if (strcmp(args, "reset") == 0) {
+    potLatencyReset();
+    Serial.println("Pot latency reset");
+  } else {
+    potLatencyReport(printPotLine);
+  }
+}
+#endif
+
+//"thru notes control sysex clock" sets what the DIN soft thru sends on, "thru off" stops it
+void thruCommand(const char *args) {
+  static const char *const names[] = { "notes", "control", "sysex", "clock", "common", "sensing" };
+  if (*args) {
+    uint8_t mask = 0;
+    for (int i = 0; i < 6; i++) {
+      if (strstr(args, names[i])) mask |= 1 << i;
+    }
+    midiThruMask = mask;
+  }
+  Serial.print("Thru:");
+  for (int i = 0; i < 6; i++) {
+    if (midiThruMask & (1 << i)) Serial.print(String(" ") + names[i]);
+  }
+  Serial.println(String(midiThruMask ? "" : " off") + ", filtered " + dinFiltered + ", dropped " + dinDropped + ", thru dropped " + thruDropped);
+}
+
+void modulationTick() {
+  modTick(upperData, lowerData);
+}
+
+int modLookup(const char *const *names, int count, const char *name) {
+  for (int i = 0; i < count; i++) {
+    if (strcmp(names[i], name) == 0) return i;
+  }
+  return -1;
+}
+
+//"mod upper wheel cutoff 128" routes a source to a destination, 256 is full depth and negative inverts,
+//"mod" lists the routes. The patch aftertouch destination is applied as well.
+void modCommand(const char *args) {
+  char layer[8], source[12], dest[8];
+  int amount;
+  if (sscanf(args, "%7s %11s %7s %d", layer, source, dest, &amount) == 4) {
+    int l = strcmp(layer, "upper") == 0 ? 0 : strcmp(layer, "lower") == 0 ? 1 : -1;
+    int s = modLookup(MOD_SOURCE_NAMES, MOD_SOURCES, source);
+    int d = modLookup(MOD_DEST_NAMES, MOD_DESTS, dest);
+    if (l < 0 || s < 0 || d < 0) {
+      Serial.println("mod upper|lower aftertouch|wheel|velocity|key dco|cutoff|vcf|vca amount");
+      return;
+    }
+    modRoute(l, s, d, amount);
+  }
+  for (int l = 0; l < MOD_LAYERS; l++) {
+    for (int s = 0; s < MOD_SOURCES; s++) {
+      for (int d = 0; d < MOD_DESTS; d++) {
+        if (modAmounts[l][s][d]) Serial.println(String(l ? "lower " : "upper ") + MOD_SOURCE_NAMES[s] + " " + MOD_DEST_NAMES[d] + " " + modAmounts[l][s][d]);
+      }
+    }
+  }
+  Serial.println(String("Aftertouch to ") + upperData[P_AfterTouchDest] + " upper, " + lowerData[P_AfterTouchDest] + " lower");
+}
+
+//"clock sync" has the LFO rate follow MIDI clock on the DIN input, "clock off" gives it back to the pot,
+//"clock" reports tempo and jitter
+void clockCommand(const char *args) {
+  if (strcmp(args, "sync") == 0) {
+    clockSync = true;
+    midiClockWanted = true;
+  } else if (strcmp(args, "off") == 0) {
+    clockSync = false;
+    midiClockWanted = false;
+  }
+  float rms, peak;
+  midiClock.jitter(rms, peak);
+  Serial.println(String("Clock ") + (clockSync ? "sync" : "off") + ", " + (midiClock.isLocked() ? String(midiClock.bpm(), 2) + " BPM" : String("no clock"))
+                 + (midiClock.isRunning() ? ", running" : ", stopped") + ", jitter " + String(rms, 0) + " us rms " + String(peak, 0) + " us peak, relocks " + midiClock.relocks);
+}
+
+#ifdef VOICE_LINK_BINARY
+void printVoiceLinkLine(const char *line) {
+  Serial.println(line);
+}
+
+//"link" prints the voice link counters
+void voiceLinkCommand(const char *args) {
+  voiceLinkReport(printVoiceLinkLine);
+}
+#endif
+
+//"rescan" reloads the directory and bank after the card has been changed somewhere else, "rescan rebuild"
+//makes a new slot table from the patch files
+void rescanCommand(const char *args) {
+  if (!cardStatus) {
+    Serial.println("No SD card");
+    return;
+  }
+  Serial.println(rescanPatches(strcmp(args, "rebuild") == 0) ? "Rescan queued" : "Rescan already running");
+}
+
+void flightCommand(const char *args) {
+  flightTrigger(FLIGHT_REASON_USER, 0);
+  Serial.println("Flight recorder dump queued");
+}
+
+//Name, function, period us (0 every pass), priority (0 is MIDI only), budget us
+void setupTasks() {
+  addTask("midi", readMidi, 0, 0, 100);
+  addTask("voices", checkVoices, 0, 1, 100);
+  addTask("demux", writeDemux, 0, 2, 50);
+  addTask("mux", checkMux, 0, 2, 150);
+  addTask("panel", checkPanel, 1000, 3, 300);
+  addTask("lfo delay", LFODelayHandle, 1000, 3, 20);
+  addTask("mod", modulationTick, MOD_TICK_US, 2, 30);
+  addTask("clock", checkMidiClock, 10000, 3, 10);
+  addTask("storage", checkStorage, 0, 4, 200);
+  addTask("transfers", checkTransfers, 0, 4, 200);
+  addTask("eeprom", checkEeprom, 10000, 5, 2000);
+  addTask("flight", checkFlightRecorder, 10000, 5, 50);
+#ifdef POT_LATENCY
+  addTask("pot latency", potLatencyTask, 1000, 5, 20);
+#endif
+#ifdef SCHEDULER_REPORT
+  addTask("report", reportScheduler, 5000000, 6, 5000);
+#endif
+}
+
+void loop() {
+  runScheduler();
+}
@@ -0,0 +1,123 @@
+#include "CcDispatch.h"
+
+#include <stdint.h>
+#include "MidiCC.h"
+#include "ParameterIds.h"
+
+struct CcRoute {
+  uint8_t control;
+  int8_t param;
+  uint8_t kind;
+  int8_t shadow;  //Stored along with param, the amp envelope keeps its old value, -1 for none
+};
+
+//The layer values myControlChange() handles, in its order
+static const CcRoute CC_ROUTES[] = {
+  { CCpwLFO, P_pwLFO, CC_WHOLE, -1 },
+  { CCfmDepth, P_fmDepth, CC_WHOLE, -1 },
+  { CCosc2PW, P_osc2PW, CC_WHOLE, -1 },
+  { CCosc2PWM, P_osc2PWM, CC_WHOLE, -1 },
+  { CCosc1PW, P_osc1PW, CC_WHOLE, -1 },
+  { CCosc1PWM, P_osc1PWM, CC_WHOLE, -1 },
+  { CCosc1Oct, P_osc1Range, CC_WHOLE, -1 },
+  { CCosc2Oct, P_osc2Range, CC_WHOLE, -1 },
+  { CCglideTime, P_glideTime, CC_WHOLE, -1 },
+  { CCosc2Detune, P_osc2Detune, CC_WHOLE, -1 },
+  { CCosc2Interval, P_osc2Interval, CC_WHOLE, -1 },
+  { CCnoiseLevel, P_noiseLevel, CC_WHOLE, -1 },
+  { CCosc2SawLevel, P_osc2SawLevel, CC_WHOLE, -1 },
+  { CCosc1SawLevel, P_osc1SawLevel, CC_WHOLE, -1 },
+  { CCosc2PulseLevel, P_osc2PulseLevel, CC_WHOLE, -1 },
+  { CCosc1PulseLevel, P_osc1PulseLevel, CC_WHOLE, -1 },
+  { CCosc2TriangleLevel, P_osc2TriangleLevel, CC_WHOLE, -1 },
+  { CCosc1SubLevel, P_osc1SubLevel, CC_WHOLE, -1 },
+  { CCLFODelay, P_LFODelay, CC_WHOLE, -1 },
+  { CCfilterCutoff, P_filterCutoff, CC_WHOLE, -1 },
+  { CCfilterLFO, P_filterLFO, CC_WHOLE, -1 },
+  { CCfilterRes, P_filterRes, CC_WHOLE, -1 },
+  { CCfilterType, P_filterType, CC_WHOLE, -1 },
+  { CCfilterEGlevel, P_filterEGlevel, CC_WHOLE, -1 },
+  { CCLFORate, P_LFORate, CC_WHOLE, -1 },
+  { CCmodWheelDepth, P_modWheelDepth, CC_WHOLE, -1 },
+  { CCPitchBend, P_PitchBendLevel, CC_WHOLE, -1 },
+  { CCeffectPot1, P_effectPot1, CC_WHOLE, -1 },
+  { CCeffectPot2, P_effectPot2, CC_WHOLE, -1 },
+  { CCeffectPot3, P_effectPot3, CC_WHOLE, -1 },
+  { CCeffectsMix, P_effectsMix, CC_WHOLE, -1 },
+  { CCLFOWaveform, P_LFOWaveform, CC_WHOLE, -1 },
+  { CCfilterAttack, P_filterAttack, CC_WHOLE, -1 },
+  { CCfilterDecay, P_filterDecay, CC_WHOLE, -1 },
+  { CCfilterSustain, P_filterSustain, CC_WHOLE, -1 },
+  { CCfilterRelease, P_filterRelease, CC_WHOLE, -1 },
+  { CCampAttack, P_ampAttack, CC_WHOLE, P_oldampAttack },
+  { CCampDecay, P_ampDecay, CC_WHOLE, P_oldampDecay },
+  { CCampSustain, P_ampSustain, CC_WHOLE, P_oldampSustain },
+  { CCampRelease, P_ampRelease, CC_WHOLE, P_oldampRelease },
+  { CCvolumeControl, P_volumeControl, CC_WHOLE, -1 },
+  { CCPM_DCO2, P_pmDCO2, CC_WHOLE, -1 },
+  { CCPM_FilterEnv, P_pmFilterEnv, CC_WHOLE, -1 },
+  { CCkeyTrack, P_keytrack, CC_WHOLE, -1 },
+  { CCamDepth, P_amDepth, CC_WHOLE, -1 },
+  { CCNotePriority, P_NotePriority, CC_LAYER, -1 },
+  { CCglideSW, P_glideSW, CC_TOGGLE, -1 },
+  { CCfilterPoleSW, P_filterPoleSW, CC_LAYER, -1 },
+  { CCfilterVel, P_filterVel, CC_TOGGLE, -1 },
+  { CCfilterEGinv, P_filterEGinv, CC_TOGGLE, -1 },
+  { CCsyncSW, P_sync, CC_TOGGLE, -1 },
+  { CCkeyTrackSW, P_keytrackSW, CC_TOGGLE, -1 },
+  { CCpmDestDCO1SW, P_pmDestDCO1, CC_TOGGLE, -1 },
+  { CCpmDestFilterSW, P_pmDestFilter, CC_TOGGLE, -1 },
+  { CCfilterenvLinLogSW, P_filterLogLin, CC_TOGGLE, -1 },
+  { CCampenvLinLogSW, P_ampLogLin, CC_TOGGLE, -1 },
+  { CCFilterLoop, P_filterLoop, CC_LAYER, -1 },
+  { CCAmpLoop, P_vcaLoop, CC_LAYER, -1 },
+  { CCvcaVel, P_vcaVel, CC_TOGGLE, -1 },
+  { CCeffectBankSW, P_effectBank, CC_LAYER, -1 },
+  { CClfoMult, P_lfoMultiplier, CC_LAYER, -1 },
+  { CCeffectNumSW, P_effectNum, CC_LAYER, -1 },
+  { CCvcaGate, P_vcaGate, CC_TOGGLE, -1 },
+  { CCmonoMulti, P_monoMulti, CC_TOGGLE, -1 },
+  { CClfoAlt, P_lfoAlt, CC_TOGGLE, -1 },
+};
+
+//Index into CC_ROUTES plus 1 by control number, filled on first use
+static uint8_t routeIndex[128];
+static bool routesIndexed = false;
+
+static const CcRoute *ccRoute(int control) {
+  if (!routesIndexed) {
+    for (unsigned i = 0; i < sizeof(CC_ROUTES) / sizeof(CC_ROUTES[0]); i++) routeIndex[CC_ROUTES[i].control] = i + 1;
+    routesIndexed = true;
+  }
+  if (control < 0 || control > 127 || !routeIndex[control]) return nullptr;
+  return &CC_ROUTES[routeIndex[control] - 1];
+}
+
+static void store(int *data, const CcRoute &route, int value) {
+  data[route.param] = value;
+  if (route.shadow >= 0) data[route.shadow] = value;
+}
+
+int ccDispatch(int *upper, int *lower, int control, int value, bool upperSelected, bool whole) {
+  const CcRoute *route = ccRoute(control);
+  if (!route) return CC_NONE;
+  int *data = upperSelected ? upper : lower;
+  switch (route->kind) {
+    case CC_WHOLE:
+      store(data, *route, value);
+      if (!upperSelected && whole) store(upper, *route, value);
+      break;
+    case CC_LAYER:
+      store(data, *route, value);
+      break;
+    case CC_TOGGLE:
+      data[route->param] = !data[route->param];
+      break;
+  }
+  return route->kind;
+}
+
+int ccParam(int control) {
+  const CcRoute *route = ccRoute(control);
+  return route ? route->param : -1;
+}
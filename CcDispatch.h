@@ -0,0 +1,15 @@
+//What a control change does to upperData and lowerData, no Arduino so it can be run on a PC.
+//myControlChange() stores through ccDispatch() first, then updates the display and the hardware.
+
+#pragma once
+
+#define CC_NONE 0    //Not a layer value, the sketch handles it
+#define CC_WHOLE 1   //Into the selected layer, in whole mode the lower value goes to the upper layer too
+#define CC_LAYER 2   //Into the selected layer only
+#define CC_TOGGLE 3  //Switch that flips in the selected layer, the value is ignored
+
+//Apply control to the layers as the panel edits them. Returns its CC_ kind.
+int ccDispatch(int *upper, int *lower, int control, int value, bool upperSelected, bool whole);
+
+//P_ index control stores into, -1 for CC_NONE
+int ccParam(int control);
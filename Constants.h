@@ -31,7 +31,10 @@ const float PULSEWIDTH[128] = {0, 0, 0, 1, 1, 2, 2, 3, 3, 3, 4, 4, 4, 5, 5, 6, 6
 #define NO_OF_VOICES 8
 #define NO_OF_PARAMS 77
 const char* INITPATCHNAME = "Initial Patch";
-const uint32_t CLICK_DURATION = 250;
 #define HOLD_DURATION 1000
+#define BROWSE_COMMIT_MS 400 //Encoder idle time before a browsed patch is recalled
+#define BROWSE_MEDIUM_US 80000 //Detents closer than this move 3 patches
+#define BROWSE_FAST_US 30000 //and closer than this move 10
 #define PATCHES_LIMIT 999
-const String INITPATCH = "Solina,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1";
+#define PATCH_NAME_LEN 20 //Longest patch name plus terminator
+const char *INITPATCH = "Solina,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1,1,1,10,1,1,1,1,1,1,1";
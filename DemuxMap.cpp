@@ -0,0 +1,52 @@
+#include "DemuxMap.h"
+
+const DemuxChannel DEMUX_MAP[16] = {
+  { { P_noiseLevel, 0, MULT2V }, { P_filterAttack, 0, MULT5V } },
+  { { P_osc1SawLevel, 0, MULT2V }, { P_filterDecay, 0, MULT5V } },
+  { { P_osc1PulseLevel, 0, MULT2V }, { P_filterSustain, 0, MULT5V } },
+  { { P_osc1SubLevel, 0, MULT2V }, { P_filterRelease, 0, MULT5V } },
+  { { P_pmDCO2, 0, MULT2V }, { P_ampAttack, 0, MULT5V } },
+  { { P_pmFilterEnv, 0, MULT2V }, { P_ampDecay, 0, MULT5V } },
+  { { P_osc2SawLevel, 0, MULT2V }, { P_ampSustain, 0, MULT5V } },
+  { { P_osc2PulseLevel, 0, MULT2V }, { P_ampRelease, 0, MULT5V } },
+  { { P_osc2TriangleLevel, 0, MULT2V }, { P_filterEGlevel, 0, MULT5V } },
+  { { P_volumeControl, 0, MULT2V }, { P_filterCutoff, 0, MULT5V } },
+  { { P_effectsMix, 0, MULT2V }, { P_filterRes, 0, MULT5V } },
+  { { P_fmDepth, DEMUX_LFO_GATED, MULT2V }, { P_LFORate, 0, MULT5V } },
+  { { P_filterLFO, DEMUX_LFO_GATED, MULT2V }, { P_LFOWaveform, 0, MULT5V } },
+  { { P_amDepth, DEMUX_LFO_GATED, MULT2V }, { P_effectPot1, 0, MULT33V } },
+  { { DEMUX_ZERO, 0, 0 }, { P_effectPot2, 0, MULT33V } },
+  { { P_pwLFO, DEMUX_UPPER_ONLY, MULT5V }, { P_effectPot3, 0, MULT33V } },
+};
+
+uint32_t demuxValueWord(uint32_t channel, const DemuxSource &source, int value, const int *data) {
+  int scaled = 0;
+  if (source.param != DEMUX_ZERO && !((source.flags & DEMUX_LFO_GATED) && data[P_LFODelayGo] == 0)) {
+    scaled = int(value * source.scale);
+  }
+  return (channel & 0xFFF0000F) | ((scaled & 0xFFFF) << 4);
+}
+
+static uint32_t demuxWord(uint32_t channel, const DemuxSource &source, const int *data, const int *upper) {
+  int value = source.param == DEMUX_ZERO ? 0 : (source.flags & DEMUX_UPPER_ONLY ? upper : data)[source.param];
+  return demuxValueWord(channel, source, value, data);
+}
+
+bool demuxLocate(int param, int &channel, bool &onB) {
+  for (int ch = 0; ch < 16; ch++) {
+    if (DEMUX_MAP[ch].a.param == param || DEMUX_MAP[ch].b.param == param) {
+      channel = ch;
+      onB = DEMUX_MAP[ch].b.param == param;
+      return true;
+    }
+  }
+  return false;
+}
+
+void demuxWords(int channel, const int *upper, const int *lower, uint32_t words[4]) {
+  const DemuxChannel &map = DEMUX_MAP[channel];
+  words[0] = demuxWord(DAC_CHANNEL_A, map.a, upper, upper);
+  words[1] = demuxWord(DAC_CHANNEL_C, map.a, lower, upper);
+  words[2] = demuxWord(DAC_CHANNEL_B, map.b, upper, upper);
+  words[3] = demuxWord(DAC_CHANNEL_D, map.b, lower, upper);
+}
@@ -0,0 +1,43 @@
+//Which parameters go out on each of the 16 demux channels. Every channel loads all four DAC outputs,
+//A and C get the "a" source for the upper and lower layer, B and D the "b" source. writeDemux() in the
+//sketch sends the words, DemuxMap.cpp builds them and needs no Arduino.
+
+#pragma once
+
+#include <stdint.h>
+#include "ParameterIds.h"
+
+#define MULT2V 25.9
+#define MULT5V 32
+#define MULT33V 21.3
+
+#define DEMUX_ZERO -1       //Source that is always 0
+#define DEMUX_LFO_GATED 1   //0 until the layer's delayed LFO has started
+#define DEMUX_UPPER_ONLY 2  //Both layers take the upper value
+
+#define DAC_CHANNEL_A 0b00000010000000000000000000000000
+#define DAC_CHANNEL_B 0b00000010000100000000000000000000
+#define DAC_CHANNEL_C 0b00000010001000000000000000000000
+#define DAC_CHANNEL_D 0b00000010001100000000000000000000
+
+struct DemuxSource {
+  int8_t param;
+  uint8_t flags;
+  double scale;  //Same double maths as the literals gave before
+};
+
+struct DemuxChannel {
+  DemuxSource a;
+  DemuxSource b;
+};
+
+extern const DemuxChannel DEMUX_MAP[16];
+
+//value is the 0-1023 parameter, data the layer it goes out on for the LFO delay gate
+uint32_t demuxValueWord(uint32_t channel, const DemuxSource &source, int value, const int *data);
+
+//Demux channel and source a or b carrying param, false if it isn't on the demux
+bool demuxLocate(int param, int &channel, bool &onB);
+
+//Words for DAC outputs A to D in the order they are sent: A upper, C lower, B upper, D lower
+void demuxWords(int channel, const int *upper, const int *lower, uint32_t words[4]);
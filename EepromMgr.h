@@ -1,5 +1,11 @@
-#include <EEPROM.h>
+#include "Hal.h"
 
+//Settings live in a RAM record, getters never touch EEPROM. Changes are written behind once the
+//settings have been quiet for SETTINGS_QUIET_MS, each write going to the next slot of a small journal
+//so no single EEPROM location takes every change. At boot the newest slot with a good CRC wins. The
+//EEPROM is reached through hal.nv.
+
+//Original single byte layout, only read now to migrate older units
 #define EEPROM_MIDI_CH 0
 #define EEPROM_SPLITTRANS 1
 #define EEPROM_ENCODER_DIR 2
@@ -19,82 +25,223 @@
 #define EEPROM_MONOMULTI_L 16
 #define EEPROM_MONOMULTI_U 17
 
+#define SETTINGS_VERSION 1
+#define SETTINGS_JOURNAL_BASE 32
+#define SETTINGS_JOURNAL_SLOTS 64
+#define SETTINGS_QUIET_MS 2000
+
+struct SettingsRecord {
+  uint8_t midiChannel;
+  uint8_t splitTrans;
+  uint8_t encoderDir;
+  uint8_t modWheelDepth;
+  uint8_t filterEnvU;
+  uint8_t filterEnvL;
+  uint8_t ampEnvU;
+  uint8_t ampEnvL;
+  uint16_t lastPatchU;  //16 bit, the old single byte lost patches above 255
+  uint16_t lastPatchL;
+  uint8_t afterTouchU;
+  uint8_t afterTouchL;
+  uint8_t splitPoint;
+  uint8_t keytrackU;
+  uint8_t keytrackL;
+  uint8_t pitchBend;
+  uint8_t monoMultiL;
+  uint8_t monoMultiU;
+};
+
+struct SettingsSlot {
+  uint8_t version;
+  uint8_t reserved;
+  uint16_t seq;
+  SettingsRecord record;
+  uint16_t crc;
+};
+
+#define SETTINGS_SLOT_SIZE sizeof(SettingsSlot)
+
+SettingsRecord settingsRecord;
+uint16_t settingsSeq = 0;
+int settingsSlot = SETTINGS_JOURNAL_SLOTS - 1;
+bool settingsDirty = false;
+unsigned long settingsChangedAt = 0;
+unsigned long settingsWriteMicros = 0;  //Time the last journal write held up loop()
+
+uint16_t settingsCrc(const SettingsSlot &slot) {
+  return crc16((const uint8_t *)&slot, offsetof(SettingsSlot, crc));
+}
+
+int settingsSlotAddress(int slot) {
+  return SETTINGS_JOURNAL_BASE + slot * SETTINGS_SLOT_SIZE;
+}
+
+//EEPROM.get() and put() over hal.nv, the Teensy backend only writes the bytes that change
+void nvGet(int address, void *data, size_t size) {
+  uint8_t *bytes = (uint8_t *)data;
+  for (size_t i = 0; i < size; i++) bytes[i] = hal.nv->read(address + i);
+}
+
+void nvPut(int address, const void *data, size_t size) {
+  const uint8_t *bytes = (const uint8_t *)data;
+  for (size_t i = 0; i < size; i++) hal.nv->write(address + i, bytes[i]);
+}
+
+void markSettingsDirty() {
+  settingsDirty = true;
+  settingsChangedAt = millis();
+}
+
+void migrateLegacySettings() {
+  memset(&settingsRecord, 0, sizeof(settingsRecord));
+  settingsRecord.midiChannel = hal.nv->read(EEPROM_MIDI_CH);
+  settingsRecord.splitTrans = hal.nv->read(EEPROM_SPLITTRANS);
+  settingsRecord.encoderDir = hal.nv->read(EEPROM_ENCODER_DIR);
+  settingsRecord.modWheelDepth = hal.nv->read(EEPROM_MODWHEEL_DEPTH);
+  settingsRecord.filterEnvU = hal.nv->read(EEPROM_FILTERENV_U);
+  settingsRecord.filterEnvL = hal.nv->read(EEPROM_FILTERENV_L);
+  settingsRecord.ampEnvU = hal.nv->read(EEPROM_AMPENV_U);
+  settingsRecord.ampEnvL = hal.nv->read(EEPROM_AMPENV_L);
+  settingsRecord.lastPatchU = hal.nv->read(EEPROM_LAST_PATCHU);
+  settingsRecord.lastPatchL = hal.nv->read(EEPROM_LAST_PATCHL);
+  settingsRecord.afterTouchU = hal.nv->read(EEPROM_AFTERTOUCH_U);
+  settingsRecord.afterTouchL = hal.nv->read(EEPROM_AFTERTOUCH_L);
+  settingsRecord.splitPoint = hal.nv->read(EEPROM_SPLITPOINT);
+  settingsRecord.keytrackU = hal.nv->read(EEPROM_KEYTRACK_U);
+  settingsRecord.keytrackL = hal.nv->read(EEPROM_KEYTRACK_L);
+  settingsRecord.pitchBend = hal.nv->read(EEPROM_PITCHBEND);
+  settingsRecord.monoMultiL = hal.nv->read(EEPROM_MONOMULTI_L);
+  settingsRecord.monoMultiU = hal.nv->read(EEPROM_MONOMULTI_U);
+}
+
+//Call once at the start of setup(), before any of the getters
+void loadSettings() {
+  SettingsSlot slot;
+  int newest = -1;
+  uint16_t newestSeq = 0;
+  for (int i = 0; i < SETTINGS_JOURNAL_SLOTS; i++) {
+    nvGet(settingsSlotAddress(i), &slot, sizeof(slot));
+    if (slot.version != SETTINGS_VERSION || slot.crc != settingsCrc(slot)) continue;
+    //Sequence numbers wrap, compare by difference
+    if (newest < 0 || (int16_t)(slot.seq - newestSeq) > 0) {
+      newest = i;
+      newestSeq = slot.seq;
+      settingsRecord = slot.record;
+    }
+  }
+  if (newest < 0) {
+    //Nothing journalled yet, bring the old byte layout across on the first flush
+    migrateLegacySettings();
+    markSettingsDirty();
+    return;
+  }
+  settingsSlot = newest;
+  settingsSeq = newestSeq;
+}
+
+//Called from loop() via checkEeprom(), writes one journal slot once the settings have settled
+void flushSettings(bool force) {
+  if (!settingsDirty) return;
+  if (!force && millis() - settingsChangedAt < SETTINGS_QUIET_MS) return;
+  unsigned long started = micros();
+  SettingsSlot slot;
+  memset(&slot, 0, sizeof(slot));
+  slot.version = SETTINGS_VERSION;
+  slot.seq = ++settingsSeq;
+  slot.record = settingsRecord;
+  slot.crc = settingsCrc(slot);
+  settingsSlot = (settingsSlot + 1) % SETTINGS_JOURNAL_SLOTS;
+  nvPut(settingsSlotAddress(settingsSlot), &slot, sizeof(slot));
+  settingsDirty = false;
+  settingsWriteMicros = micros() - started;  //No print, this also runs from handleUsbFrame() mid binary frame
+}
+
 int getMIDIChannel() {
-  byte midiChannel = EEPROM.read(EEPROM_MIDI_CH);
+  byte midiChannel = settingsRecord.midiChannel;
   if (midiChannel < 0 || midiChannel > 16) midiChannel = MIDI_CHANNEL_OMNI;  //If EEPROM has no MIDI channel stored
   return midiChannel;
 }
 
 void storeMidiChannel(byte channel) {
-  EEPROM.update(EEPROM_MIDI_CH, channel);
+  settingsRecord.midiChannel = channel;
+  markSettingsDirty();
 }
 
 float getSplitPoint() {
-  byte sp = EEPROM.read(EEPROM_SPLITPOINT);
+  byte sp = settingsRecord.splitPoint;
   if (sp < 0 || sp > 24) sp = 12;
   return sp;
 }
 
 void storeSplitPoint(byte type) {
-  EEPROM.update(EEPROM_SPLITPOINT, type);
+  settingsRecord.splitPoint = type;
+  markSettingsDirty();
 }
 
 float getSplitTrans() {
-  int st = EEPROM.read(EEPROM_SPLITTRANS);
+  int st = settingsRecord.splitTrans;
   if (st < 0 || st > 4) st = 2;
   return st;  //If EEPROM has no key tracking stored
 }
 
 void storeSplitTrans(byte type) {
-  EEPROM.update(EEPROM_SPLITTRANS, type);
+  settingsRecord.splitTrans = type;
+  markSettingsDirty();
 }
 
 float getAfterTouchU() {
-  upperData[60] = EEPROM.read(EEPROM_AFTERTOUCH_U);
+  upperData[60] = settingsRecord.afterTouchU;
   if (upperData[60] < 0 || upperData[60] > 4) upperData[60] = 0;
   return upperData[60];  //If EEPROM has no key tracking stored
 }
 
 void storeAfterTouchU(byte AfterTouchDestL) {
-  EEPROM.update(EEPROM_AFTERTOUCH_U, AfterTouchDestL);
+  settingsRecord.afterTouchU = AfterTouchDestL;
+  markSettingsDirty();
 }
 
 float getAfterTouchL() {
-  byte AfterTouchDestL = EEPROM.read(EEPROM_AFTERTOUCH_L);
+  byte AfterTouchDestL = settingsRecord.afterTouchL;
   if (AfterTouchDestL < 0 || AfterTouchDestL > 4) AfterTouchDestL = 0;
   return AfterTouchDestL;  //If EEPROM has no key tracking stored
 }
 
 void storeAfterTouchL(byte AfterTouchDestL) {
-  EEPROM.update(EEPROM_AFTERTOUCH_L, AfterTouchDestL);
+  settingsRecord.afterTouchL = AfterTouchDestL;
+  markSettingsDirty();
 }
 
 boolean getEncoderDir() {
-  byte ed = EEPROM.read(EEPROM_ENCODER_DIR);
+  byte ed = settingsRecord.encoderDir;
   if (ed < 0 || ed > 1) return true;  //If EEPROM has no encoder direction stored
   return ed == 1 ? true : false;
 }
 
 void storeEncoderDir(byte encoderDir) {
-  EEPROM.update(EEPROM_ENCODER_DIR, encoderDir);
+  settingsRecord.encoderDir = encoderDir;
+  markSettingsDirty();
 }
 
 int getLastPatchU() {
-  int lastPatchNumberU = EEPROM.read(EEPROM_LAST_PATCHU);
-  if (lastPatchNumberU < 1 || lastPatchNumberU > 999) lastPatchNumberU = 1;
+  int lastPatchNumberU = settingsRecord.lastPatchU;
+  if (lastPatchNumberU < 1 || lastPatchNumberU > PATCHES_LIMIT) lastPatchNumberU = 1;
   return lastPatchNumberU;
 }
 
 int getLastPatchL() {
-  int lastPatchNumberL = EEPROM.read(EEPROM_LAST_PATCHL);
-  if (lastPatchNumberL < 1 || lastPatchNumberL > 999) lastPatchNumberL = 1;
+  int lastPatchNumberL = settingsRecord.lastPatchL;
+  if (lastPatchNumberL < 1 || lastPatchNumberL > PATCHES_LIMIT) lastPatchNumberL = 1;
   return lastPatchNumberL;
 }
 
 void storeLastPatchU(int lastPatchNumber) {
-  EEPROM.update(EEPROM_LAST_PATCHU, lastPatchNumber);
+  if (settingsRecord.lastPatchU == lastPatchNumber) return;
+  settingsRecord.lastPatchU = lastPatchNumber;
+  markSettingsDirty();
 }
 
 void storeLastPatchL(int lastPatchNumber) {
-  EEPROM.update(EEPROM_LAST_PATCHL, lastPatchNumber);
+  if (settingsRecord.lastPatchL == lastPatchNumber) return;
+  settingsRecord.lastPatchL = lastPatchNumber;
+  markSettingsDirty();
 }
@@ -0,0 +1,151 @@
+//Flight recorder for note latency problems that only show up now and then. Note on/off in, voice
+//allocation, the note going out to the voices, scheduler overruns and SD card work are kept in a RAM ring
+//with micros() timestamps, a few seconds of history when playing. "flight" on the USB serial, or a note
+//taking longer than FLIGHT_LATENCY_US to reach the voices, writes the ring to FLIGHTnn.BIN on the SD card
+//FLIGHT_POST_US after the trigger. extras/flight_decode turns the file into a timeline.
+//
+//DIN notes are timed from when the drain timer took them off the UART, see MidiInput.h. USB notes are
+//timed from the MIDI poll before the one that read them, the earliest they can have arrived, so a stalled
+//loop() shows up either way.
+
+#include "Hal.h"
+
+#define FLIGHT_EVENTS 4096         //Power of two, 8 bytes each in RAM2
+#define FLIGHT_LATENCY_US 5000     //Note on to voices, longer than this dumps the ring
+#define FLIGHT_POST_US 200000      //Keep recording this long after a trigger before dumping
+#define FLIGHT_HOLDOFF_US 10000000 //At most one automatic dump in this time
+#define FLIGHT_OVERRUN_GAP_US 100000 //A task's overruns after the first in this time are only counted
+#define FLIGHT_VERSION 2
+#define FLIGHT_TASK_NAME_LEN 12  //Per task in the dump, padded with zeros
+#define FLIGHT_TASKS_MAX 16      //Names written, as many as MAX_TASKS in Scheduler.h
+
+#define FLIGHT_NOTE_ON 1     //a note, value channel << 8 | velocity
+#define FLIGHT_NOTE_OFF 2    //a note, value channel << 8 | velocity
+#define FLIGHT_VOICE 3       //a note, value voice number, 0 if none free
+#define FLIGHT_NOTE_SENT 4   //a note, value latency us
+#define FLIGHT_OVERRUN 5     //a task number, value run time us
+#define FLIGHT_SD_START 6    //a storage op, value patch number
+#define FLIGHT_SD_END 7      //a storage op, value 1 ok
+#define FLIGHT_TRIGGER 8     //a reason, value latency us for FLIGHT_REASON_LATENCY
+#define FLIGHT_OVERRUN_REPEAT 9  //a task number, value overruns since its last FLIGHT_OVERRUN that weren't recorded
+
+#define FLIGHT_REASON_USER 0
+#define FLIGHT_REASON_LATENCY 1
+
+struct FlightEvent {
+  uint32_t time;  //micros()
+  uint8_t type;
+  uint8_t a;
+  uint16_t value;
+};
+
+//File header, followed by the scheduler's task names in task number order so the decoder can name
+//overruns whatever the build's task table, then count events oldest first. Little endian, as the Teensy
+//writes it. Version 1 files had no task names.
+struct FlightDumpHeader {
+  char magic[4];  //"FLT1"
+  uint8_t version;
+  uint8_t eventSize;
+  uint16_t count;
+  uint32_t triggerTime;
+  uint8_t reason;
+  uint8_t tasks;  //Task names that follow the header
+  uint8_t reserved[2];
+  uint32_t dropped;  //Events lost while the ring was frozen for earlier dumps
+};
+
+const char *taskName(int index);  //Scheduler.h, NULL past the last task
+
+DMAMEM FlightEvent flightRing[FLIGHT_EVENTS];
+volatile uint32_t flightNext = 0;  //Total events recorded, the ring index is the low bits
+volatile bool flightFrozen = false;  //Set while the storage worker writes the ring out
+volatile uint32_t flightDropped = 0;
+bool flightTriggered = false;
+uint32_t flightTriggerAt = 0;
+uint32_t flightLastDump = 0;
+bool flightDumped = false;
+uint8_t flightReason = 0;
+uint32_t flightPollAt = 0;    //Start of the current MIDI poll
+uint32_t flightLastPoll = 0;  //Start of the one before
+uint32_t flightArrival = 0;   //Timestamp of the DIN note being handled, 0 for USB
+char flightDumpName[16];
+
+//Called from loop() and the storage thread, the slot is claimed atomically so neither can overwrite the other
+void flightRecord(uint8_t type, uint8_t a, uint32_t value) {
+  if (flightFrozen) {
+    flightDropped++;
+    return;
+  }
+  uint32_t n = __atomic_fetch_add(&flightNext, 1, __ATOMIC_RELAXED);
+  flightRing[n & (FLIGHT_EVENTS - 1)] = { micros(), type, a, (uint16_t)(value > 0xFFFF ? 0xFFFF : value) };
+}
+
+void flightMidiPoll() {
+  flightLastPoll = flightPollAt;
+  flightPollAt = micros();
+}
+
+void flightTrigger(uint8_t reason, uint32_t value) {
+  if (flightTriggered || flightFrozen) return;
+  uint32_t now = micros();
+  if (reason != FLIGHT_REASON_USER && flightDumped && now - flightLastDump < FLIGHT_HOLDOFF_US) return;
+  flightRecord(FLIGHT_TRIGGER, reason, value);
+  flightTriggered = true;
+  flightTriggerAt = now;
+  flightReason = reason;
+}
+
+void flightNoteArrived(uint32_t time) {
+  flightArrival = time;
+}
+
+//After the note has gone out to the voices
+void flightNoteSent(uint8_t note) {
+  uint32_t latency = micros() - (flightArrival ? flightArrival : flightLastPoll ? flightLastPoll : flightPollAt);
+  flightArrival = 0;
+  flightRecord(FLIGHT_NOTE_SENT, note, latency);
+  if (latency > FLIGHT_LATENCY_US) flightTrigger(FLIGHT_REASON_LATENCY, latency);
+}
+
+//True once the post trigger time is up, the ring is then frozen until flightDumpDone()
+bool flightDumpDue() {
+  if (!flightTriggered || micros() - flightTriggerAt < FLIGHT_POST_US) return false;
+  flightTriggered = false;
+  flightFrozen = true;
+  return true;
+}
+
+void flightDumpDone() {
+  flightLastDump = micros();
+  flightDumped = true;
+  flightFrozen = false;
+}
+
+//Storage thread, the ring is frozen so it can be read without a copy
+bool writeFlightDump() {
+  int number = 0;
+  do {
+    snprintf(flightDumpName, sizeof(flightDumpName), "FLIGHT%02d.BIN", number);
+  } while (hal.storage->exists(flightDumpName) && ++number < 100);
+  if (number == 100) strcpy(flightDumpName, "FLIGHT00.BIN");
+  uint32_t total = flightNext;
+  uint32_t count = total < FLIGHT_EVENTS ? total : FLIGHT_EVENTS;
+  uint32_t first = (total - count) & (FLIGHT_EVENTS - 1);
+  uint8_t tasks = 0;
+  while (tasks < FLIGHT_TASKS_MAX && taskName(tasks)) tasks++;
+  //Header and task names in one write, it replaces an old dump of the same name
+  static uint8_t head[sizeof(FlightDumpHeader) + FLIGHT_TASKS_MAX * FLIGHT_TASK_NAME_LEN];
+  FlightDumpHeader header = { { 'F', 'L', 'T', '1' }, FLIGHT_VERSION, sizeof(FlightEvent), (uint16_t)count, flightTriggerAt, flightReason, tasks, { 0 }, flightDropped };
+  memcpy(head, &header, sizeof(header));
+  size_t size = sizeof(header);
+  for (int i = 0; i < tasks; i++, size += FLIGHT_TASK_NAME_LEN) {
+    memset(&head[size], 0, FLIGHT_TASK_NAME_LEN);
+    strncpy((char *)&head[size], taskName(i), FLIGHT_TASK_NAME_LEN - 1);
+  }
+  if (!hal.storage->write(flightDumpName, head, size)) return false;
+  //Oldest events run from first to the end of the ring, then wrap to the start
+  uint32_t tail = first + count > FLIGHT_EVENTS ? FLIGHT_EVENTS - first : count;
+  if (!hal.storage->append(flightDumpName, (const uint8_t *)&flightRing[first], tail * sizeof(FlightEvent))) return false;
+  if (tail < count && !hal.storage->append(flightDumpName, (const uint8_t *)flightRing, (count - tail) * sizeof(FlightEvent))) return false;
+  return true;
+}
@@ -2,8 +2,6 @@
 // It must be defined before Encoder.h is included.
 #define ENCODER_OPTIMIZE_INTERRUPTS
 #include <Encoder.h>
-#include <Bounce.h>
-#include "TButton.h"
 #include <ADC.h>
 #include <ADC_util.h>
 
@@ -28,9 +26,7 @@ ADC *adc = new ADC();
 
 
 //Note DAC
-#define MULT2V 25.9
-#define MULT5V 32
-#define MULT33V 21.3
+#include "DemuxMap.h"  //MULT2V, MULT5V and MULT33V
 #define DACMULT 25.9
 #define MIDICCTOPOT 8.62
 
@@ -291,12 +287,13 @@ ADC *adc = new ADC();
 
 #define MUXCHANNELS 16
 #define DEMUXCHANNELS 16
+#define DEMUX_HOLD_US 800  //S&H capacitors charge through the demux for this long
 #define QUANTISE_FACTOR 12
 
-#define DEBOUNCE 30
-
 static byte muxInput = 0;
 static byte muxOutput = 0;
+static bool demuxOpen = false;
+static uint32_t demuxOpenedAt = 0;
 
 static int mux1ValuesPrev[MUXCHANNELS] = {};
 static int mux2ValuesPrev[MUXCHANNELS] = {};
@@ -307,13 +304,6 @@ static int mux2Read = 0;
 static int mux3Read = 0;
 
 
-static long encPrevious = 0;
-
-TButton saveButton{ SAVE_SW, LOW, HOLD_DURATION, DEBOUNCE, CLICK_DURATION };
-TButton settingsButton{ SETTINGS_SW, LOW, HOLD_DURATION, DEBOUNCE, CLICK_DURATION };
-TButton backButton{ BACK_SW, LOW, HOLD_DURATION, DEBOUNCE, CLICK_DURATION };
-TButton recallButton{ RECALL_SW, LOW, HOLD_DURATION, DEBOUNCE, CLICK_DURATION };  //On encoder
-
 Encoder encoder(ENCODER_PINB, ENCODER_PINA);//This often needs the pins swapping depending on the encoder
 
 void setupHardware()
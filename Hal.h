@@ -0,0 +1,103 @@
+//Hardware interfaces for the controller logic. HalTeensy.h has the backends the synth runs on, the
+//logic that doesn't need the real hardware (voice allocation, the demux channel table, the MIDI parser,
+//the patch codec, the voice board I2C link, MIDI out to the voices and panel, the patch files, the slot
+//table, the flight recorder dumps and the settings journal) only talks to these, so it can also be built
+//on a PC against extras/host/HalMock.h. Nothing Arduino in here. The display isn't behind one, its pages
+//draw with ST7735_t3 fonts and primitives directly.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+class HalClock {
+  public:
+    virtual uint32_t micros() = 0;
+    virtual uint32_t millis() = 0;
+};
+
+//DAC8564 style 32 bit words, each one framed by the chip select
+class HalDac {
+  public:
+    virtual void write(int chipSelect, const uint32_t *words, int count) = 0;
+};
+
+class HalPins {
+  public:
+    virtual void write(int pin, bool level) = 0;
+};
+
+//Asynchronous master writes, data has to stay untouched until finished()
+class HalI2c {
+  public:
+    virtual void writeAsync(uint8_t address, const uint8_t *data, size_t length) = 0;
+    virtual bool finished() = 0;
+    virtual bool failed() = 0;  //The last transfer, once it has finished
+};
+
+//Raw bytes out of a MIDI port, already framed. The channel messages go out whole with no running
+//status, as the MIDI library sends them, channels are 1 to 16 and anything else isn't sent.
+class HalMidiOut {
+  public:
+    virtual void send(const uint8_t *data, size_t length) = 0;
+
+    void noteOn(uint8_t note, uint8_t velocity, uint8_t channel) {
+      channelMessage(0x90, note, velocity, channel);
+    }
+    void noteOff(uint8_t note, uint8_t velocity, uint8_t channel) {
+      channelMessage(0x80, note, velocity, channel);
+    }
+    void controlChange(uint8_t control, uint8_t value, uint8_t channel) {
+      channelMessage(0xB0, control, value, channel);
+    }
+    void pitchBend(int value, uint8_t channel) {  //-8192 to 8191
+      unsigned bend = (unsigned)(value + 8192);
+      channelMessage(0xE0, bend & 0x7F, (bend >> 7) & 0x7F, channel);
+    }
+
+  private:
+    void channelMessage(uint8_t status, uint8_t data1, uint8_t data2, uint8_t channel) {
+      if (channel < 1 || channel > 16) return;
+      uint8_t message[3] = { (uint8_t)(status | (channel - 1)), (uint8_t)(data1 & 0x7F), (uint8_t)(data2 & 0x7F) };
+      send(message, sizeof(message));
+    }
+};
+
+typedef void (*HalFileFound)(const char *name, void *context);
+
+class HalStorage {
+  public:
+    virtual bool exists(const char *name) = 0;
+    virtual int read(const char *name, uint8_t *data, size_t size) = 0;  //Bytes read, -1 if it can't be opened
+    virtual bool write(const char *name, const uint8_t *data, size_t length) = 0;  //Replaces the file
+    virtual bool append(const char *name, const uint8_t *data, size_t length) = 0;
+    virtual bool remove(const char *name) = 0;
+    virtual bool rename(const char *from, const char *to) = 0;
+    virtual void list(HalFileFound found, void *context) = 0;  //Files in the root, directories are skipped
+};
+
+class HalNvStore {
+  public:
+    virtual uint8_t read(int address) = 0;
+    virtual void write(int address, uint8_t value) = 0;
+};
+
+class HalAdc {
+  public:
+    virtual int read(int pin) = 0;  //10 bit
+};
+
+struct Hal {
+  HalClock *clock;
+  HalDac *dac;
+  HalPins *pins;
+  HalI2c *i2c;
+  HalMidiOut *midiDin;
+  HalMidiOut *midiVoices;
+  HalMidiOut *midiPanel;
+  HalStorage *storage;
+  HalNvStore *nv;
+  HalAdc *adc;
+};
+
+extern Hal hal;
@@ -0,0 +1,138 @@
+//Teensy backends for Hal.h. The DIN port goes through beginDinSend() so the soft thru can't cut into it.
+
+#include "Hal.h"
+
+#include <EEPROM.h>
+
+class TeensyClock : public HalClock {
+  public:
+    uint32_t micros() override {
+      return ::micros();
+    }
+    uint32_t millis() override {
+      return ::millis();
+    }
+};
+
+class TeensyDac : public HalDac {
+  public:
+    void write(int chipSelect, const uint32_t *words, int count) override {
+      SPI.beginTransaction(SPISettings(20000000, MSBFIRST, SPI_MODE1));
+      for (int i = 0; i < count; i++) {
+        digitalWriteFast(chipSelect, LOW);
+        SPI.transfer32(words[i]);
+        digitalWriteFast(chipSelect, HIGH);
+      }
+      SPI.endTransaction();
+    }
+};
+
+class TeensyPins : public HalPins {
+  public:
+    void write(int pin, bool level) override {
+      digitalWriteFast(pin, level);
+    }
+};
+
+//i2c_driver's asynchronous master, Wire in i2c_driver_wire.h sits on the same one
+class TeensyI2c : public HalI2c {
+  public:
+    void writeAsync(uint8_t address, const uint8_t *data, size_t length) override {
+      Master.write_async(address, const_cast<uint8_t *>(data), length, true);
+    }
+    bool finished() override {
+      return Master.finished();
+    }
+    bool failed() override {
+      return Master.has_error();
+    }
+};
+
+class TeensyMidiOut : public HalMidiOut {
+  public:
+    TeensyMidiOut(HardwareSerial &port, bool din) : port(port), din(din) {}
+    void send(const uint8_t *data, size_t length) override {
+      if (din) beginDinSend();
+      port.write(data, length);
+      if (din) endDinSend();
+    }
+  private:
+    HardwareSerial &port;
+    bool din;
+};
+
+class TeensyStorage : public HalStorage {
+  public:
+    bool exists(const char *name) override {
+      return SD.exists(name);
+    }
+    int read(const char *name, uint8_t *data, size_t size) override {
+      File file = SD.open(name);
+      if (!file) return -1;
+      int n = file.read(data, size);
+      file.close();
+      return n;
+    }
+    bool write(const char *name, const uint8_t *data, size_t length) override {
+      SD.remove(name);
+      return append(name, data, length);
+    }
+    bool append(const char *name, const uint8_t *data, size_t length) override {
+      File file = SD.open(name, FILE_WRITE);  //Opens at the end
+      if (!file) return false;
+      bool ok = file.write(data, length) == length;
+      file.close();
+      return ok;
+    }
+    bool remove(const char *name) override {
+      return SD.remove(name);
+    }
+    bool rename(const char *from, const char *to) override {
+      return SD.rename(from, to);
+    }
+    //Each entry is closed before found() runs, so it can open the file
+    void list(HalFileFound found, void *context) override {
+      File root = SD.open("/");
+      if (!root) return;
+      while (File entry = root.openNextFile()) {
+        char name[64];
+        strncpy(name, entry.name(), sizeof(name) - 1);
+        name[sizeof(name) - 1] = '\0';
+        bool directory = entry.isDirectory();
+        entry.close();
+        if (!directory) found(name, context);
+      }
+      root.close();
+    }
+};
+
+class TeensyNvStore : public HalNvStore {
+  public:
+    uint8_t read(int address) override {
+      return EEPROM.read(address);
+    }
+    void write(int address, uint8_t value) override {
+      EEPROM.update(address, value);
+    }
+};
+
+class TeensyAdc : public HalAdc {
+  public:
+    int read(int pin) override {
+      return adc->adc1->analogRead(pin);
+    }
+};
+
+TeensyClock teensyClock;
+TeensyDac teensyDac;
+TeensyPins teensyPins;
+TeensyI2c teensyI2c;
+TeensyMidiOut teensyMidiDin(Serial1, true);
+TeensyMidiOut teensyMidiVoices(Serial6, false);
+TeensyMidiOut teensyMidiPanel(Serial7, false);
+TeensyStorage teensyStorage;
+TeensyNvStore teensyNvStore;
+TeensyAdc teensyAdc;
+
+Hal hal = { &teensyClock, &teensyDac, &teensyPins, &teensyI2c, &teensyMidiDin, &teensyMidiVoices, &teensyMidiPanel,
+            &teensyStorage, &teensyNvStore, &teensyAdc };
@@ -0,0 +1,136 @@
+//Front panel input scanner. An IntervalTimer samples the 74HC165 switch chain, the four system
+//buttons and the encoder at a fixed rate so debounce and hold timing no longer depend on how long
+//loop() takes. Every switch is one bit of a 64 bit word and is debounced together with a 3 bit
+//vertical counter, a bit has to read the same for 8 scans before it changes.
+//Timestamped events go into a queue that loop() drains through checkInput(). The same tick shifts
+//the 74HC595 LED chain out when it has changed, see ShiftRegOut.h.
+
+#define INPUT_SCAN_US 2000  //500Hz, 16ms debounce
+#define INPUT_QUEUE_SIZE 32
+#define ENCODER_DETENT 4  //Detent encoder goes up in 4 steps
+
+//Bit numbers in the input word, 0-31 are the 74HC165 chain in shift order
+#define INPUT_PANEL_BITS (OCTO_TOTAL * 8)
+#define INPUT_RECALL (INPUT_PANEL_BITS + 0)  //On encoder
+#define INPUT_SAVE (INPUT_PANEL_BITS + 1)
+#define INPUT_SETTINGS (INPUT_PANEL_BITS + 2)
+#define INPUT_BACK (INPUT_PANEL_BITS + 3)
+#define INPUT_BITS (INPUT_PANEL_BITS + 4)
+
+#define INPUT_PRESS 0
+#define INPUT_RELEASE 1
+#define INPUT_CLICK 2  //Released before HOLD_DURATION
+#define INPUT_HOLD 3   //Once per press, after HOLD_DURATION
+#define INPUT_DETENT 4
+
+#define INPUT_ENCODER 0xFF
+
+struct InputEvent {
+  uint32_t time;  //micros() when the scan saw it
+  uint8_t type;
+  uint8_t index;  //Input bit, or INPUT_ENCODER
+  int8_t value;   //Detent direction, +1 or -1
+};
+
+IntervalTimer inputTimer;
+InputEvent inputQueue[INPUT_QUEUE_SIZE];
+volatile uint8_t inputHead = 0;
+volatile uint8_t inputTail = 0;
+volatile uint32_t inputOverflows = 0;
+
+uint64_t inputState = 0;  //Debounced, 1 is pressed
+uint64_t inputCount0 = 0, inputCount1 = 0, inputCount2 = 0;
+uint64_t inputHeld = 0;
+uint32_t inputPressedAt[INPUT_BITS];
+long inputEncoderLast = 0;
+
+void pushInputEvent(uint32_t now, uint8_t type, uint8_t index, int8_t value) {
+  uint8_t next = (inputHead + 1) % INPUT_QUEUE_SIZE;
+  if (next == inputTail) {
+    inputOverflows++;
+    return;
+  }
+  inputQueue[inputHead] = { now, type, index, value };
+  inputHead = next;
+}
+
+bool popInputEvent(InputEvent &event) {
+  if (inputTail == inputHead) return false;
+  event = inputQueue[inputTail];
+  inputTail = (inputTail + 1) % INPUT_QUEUE_SIZE;
+  return true;
+}
+
+uint64_t readInputs() {
+  uint64_t sample = 0;
+  digitalWriteFast(PIN_LOAD, LOW);
+  delayNanoseconds(100);
+  digitalWriteFast(PIN_LOAD, HIGH);
+  for (int i = 0; i < INPUT_PANEL_BITS; i++) {
+    if (!digitalReadFast(PIN_DATA)) sample |= 1ULL << i;  //Switches pull low
+    digitalWriteFast(PIN_CLK, HIGH);
+    delayNanoseconds(100);
+    digitalWriteFast(PIN_CLK, LOW);
+  }
+  if (!digitalReadFast(RECALL_SW)) sample |= 1ULL << INPUT_RECALL;
+  if (!digitalReadFast(SAVE_SW)) sample |= 1ULL << INPUT_SAVE;
+  if (!digitalReadFast(SETTINGS_SW)) sample |= 1ULL << INPUT_SETTINGS;
+  if (!digitalReadFast(BACK_SW)) sample |= 1ULL << INPUT_BACK;
+  return sample;
+}
+
+void scanInputs() {
+  uint32_t now = micros();
+  uint64_t delta = readInputs() ^ inputState;
+  //Vertical counter, counts scans each bit has disagreed and clears when it agrees again
+  inputCount2 = (inputCount2 ^ (inputCount1 & inputCount0)) & delta;
+  inputCount1 = (inputCount1 ^ inputCount0) & delta;
+  inputCount0 = ~inputCount0 & delta;
+  uint64_t toggled = delta & ~(inputCount0 | inputCount1 | inputCount2);
+  inputState ^= toggled;
+
+  while (toggled) {
+    int i = __builtin_ctzll(toggled);
+    toggled &= toggled - 1;
+    if (inputState & (1ULL << i)) {
+      inputPressedAt[i] = now;
+      pushInputEvent(now, INPUT_PRESS, i, 0);
+    } else {
+      pushInputEvent(now, INPUT_RELEASE, i, 0);
+      if (!(inputHeld & (1ULL << i))) pushInputEvent(now, INPUT_CLICK, i, 0);
+      inputHeld &= ~(1ULL << i);
+    }
+  }
+
+  uint64_t waiting = inputState & ~inputHeld;
+  while (waiting) {
+    int i = __builtin_ctzll(waiting);
+    waiting &= waiting - 1;
+    if (now - inputPressedAt[i] >= HOLD_DURATION * 1000UL) {
+      inputHeld |= 1ULL << i;
+      pushInputEvent(now, INPUT_HOLD, i, 0);
+    }
+  }
+
+  long position = encoder.read();
+  while (position - inputEncoderLast >= ENCODER_DETENT) {
+    inputEncoderLast += ENCODER_DETENT;
+    pushInputEvent(now, INPUT_DETENT, INPUT_ENCODER, 1);
+  }
+  while (inputEncoderLast - position >= ENCODER_DETENT) {
+    inputEncoderLast -= ENCODER_DETENT;
+    pushInputEvent(now, INPUT_DETENT, INPUT_ENCODER, -1);
+  }
+
+  srp.flush();  //LED chain goes out on the same tick, only when its image changed
+}
+
+void startInputScanner() {
+  pinMode(PIN_DATA, INPUT);
+  pinMode(PIN_LOAD, OUTPUT);
+  pinMode(PIN_CLK, OUTPUT);
+  digitalWrite(PIN_LOAD, HIGH);
+  digitalWrite(PIN_CLK, LOW);
+  inputEncoderLast = encoder.read();
+  inputTimer.begin(scanInputs, INPUT_SCAN_US);  //Priority is set once for IRQ_PIT in startDinMidi()
+}
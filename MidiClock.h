@@ -0,0 +1,207 @@
+//MIDI clock recovery for the tempo synced LFO. Clock bytes are timestamped by the DIN drain timer in
+//MidiInput.h, MidiClockTracker runs an alpha-beta-gamma filter on them: each tick is compared with the
+//one it predicted, the error pulls the phase by CLOCK_ALPHA, the period by CLOCK_BETA and the period's
+//drift by CLOCK_GAMMA, so a tempo ramp is followed without lagging behind. The first ticks after locking
+//use the growing memory least squares gains so a new tempo settles in a beat or two. Start,
+//stop and continue keep the song position in ticks, the error history gives the jitter report.
+//
+//With sync on the LFO rate pot picks a note length from LFOTEMPOSTR and clockRateValue() turns the
+//tempo into the LFO rate CV for it. The words go out through clockApply() in writeDemux(), the patch
+//values are left alone. Nothing Arduino in here.
+
+#include "DemuxMap.h"
+
+#include <math.h>
+
+#define CLOCK_PPQN 24
+#define CLOCK_ALPHA 0.05f
+#define CLOCK_BETA 0.00128f        //ALPHA^2 / (2 - ALPHA), critically damped
+#define CLOCK_GAMMA 0.0000082f     //BETA^2 / (4 ALPHA)
+#define CLOCK_TIMEOUT_US 250000    //No clock for this long and the tracker lets go, about 10 BPM
+#define CLOCK_RELOCK_ERROR 0.5f    //Of a period, a tick this far out starts again from the new tempo
+#define CLOCK_HISTORY 96           //Ticks of error kept for the jitter figures, 4 beats
+#define CLOCK_DIVISIONS 16
+
+//Ticks per LFO cycle for each LFOTEMPOSTR note length, 1/32 to 6 bars
+const float CLOCK_DIVISION_TICKS[CLOCK_DIVISIONS] = { 3, 4.5, 6, 9, 12, 18, 24, 36, 48, 72, 96, 144, 192, 288, 384, 576 };
+
+class MidiClockTracker {
+  public:
+    void tick(uint32_t time) {
+      if (locked && (uint32_t)(time - lastTick) > CLOCK_TIMEOUT_US) locked = false;
+      lastTick = time;
+      if (running) songTicks++;
+      if (!locked) {
+        if (ticks == 0 || (uint32_t)(time - estimate) > CLOCK_TIMEOUT_US) {
+          estimate = time;
+          estimateFrac = 0;
+          ticks = 1;
+          return;
+        }
+        period = (float)(time - estimate);  //Second tick, a first guess to filter from
+        drift = 0;
+        estimate = time;
+        estimateFrac = 0;
+        ticks = 2;
+        locked = true;
+        return;
+      }
+      float error = (float)(int32_t)(time - estimate) - estimateFrac - period - drift / 2;
+      if (fabsf(error) > period * CLOCK_RELOCK_ERROR) {
+        relocks++;
+        period = (float)(int32_t)(time - estimate) - estimateFrac;
+        if (period <= 0) period = 1;
+        drift = 0;
+        estimate = time;
+        estimateFrac = 0;
+        ticks = 2;
+        return;
+      }
+      ticks++;
+      float n = ticks > 1000 ? 1000 : (float)ticks;
+      float n3 = n * (n + 1) * (n + 2);
+      float alpha = 3 * (3 * n * n - 3 * n + 2) / n3;
+      float beta = 18 * (2 * n - 1) / n3;
+      float gamma = 30 / n3;
+      if (alpha < CLOCK_ALPHA) alpha = CLOCK_ALPHA;
+      if (beta < CLOCK_BETA) beta = CLOCK_BETA;
+      if (gamma < CLOCK_GAMMA) gamma = CLOCK_GAMMA;
+      float advance = estimateFrac + period + drift / 2 + alpha * error;
+      uint32_t whole = (uint32_t)floorf(advance);
+      estimate += whole;
+      estimateFrac = advance - whole;
+      period += drift + beta * error;
+      drift += 2 * gamma * error;
+      errors[errorIndex] = error;
+      errorIndex = (errorIndex + 1) % CLOCK_HISTORY;
+      if (errorCount < CLOCK_HISTORY) errorCount++;
+    }
+
+    //The first clock after a start is the downbeat
+    void start() {
+      songTicks = -1;
+      running = true;
+    }
+
+    void stop() {
+      running = false;
+    }
+
+    void resume() {
+      running = true;
+    }
+
+    //From loop(), so a clock that stops is noticed without another tick
+    void poll(uint32_t now) {
+      if (locked && (uint32_t)(now - lastTick) > CLOCK_TIMEOUT_US) {
+        locked = false;
+        ticks = 0;
+      }
+    }
+
+    bool isLocked() const {
+      return locked;
+    }
+
+    bool isRunning() const {
+      return running;
+    }
+
+    float bpm() const {
+      return locked ? 60000000.0f / (period * CLOCK_PPQN) : 0;
+    }
+
+    float periodUs() const {
+      return period;
+    }
+
+    //Filtered time of the last tick, us
+    double tickTime() const {
+      return (double)estimate + estimateFrac;
+    }
+
+    //Position in an LFO cycle of ticksPerCycle ticks, 0 to 1, counted from the last start
+    float phase(uint32_t now, float ticksPerCycle) const {
+      if (!locked || songTicks < 0) return 0;
+      float sinceTick = ((float)(int32_t)(now - estimate) - estimateFrac) / period;
+      float position = fmodf((float)songTicks + sinceTick, ticksPerCycle);
+      return position < 0 ? position / ticksPerCycle + 1 : position / ticksPerCycle;
+    }
+
+    //Tick timing error against the prediction over the last CLOCK_HISTORY ticks, us
+    void jitter(float &rms, float &peak) const {
+      double sum = 0;
+      peak = 0;
+      for (int i = 0; i < errorCount; i++) {
+        sum += (double)errors[i] * errors[i];
+        if (fabsf(errors[i]) > peak) peak = fabsf(errors[i]);
+      }
+      rms = errorCount ? (float)sqrt(sum / errorCount) : 0;
+    }
+
+    uint32_t relocks = 0;
+
+  private:
+    bool locked = false;
+    bool running = false;
+    uint32_t ticks = 0;      //Since locking, sets the filter gains
+    int32_t songTicks = -1;  //Since the last start
+    uint32_t lastTick = 0;
+    uint32_t estimate = 0;   //Filtered tick time, whole us
+    float estimateFrac = 0;
+    float period = 0;        //us per tick
+    float drift = 0;         //Change in period per tick
+    float errors[CLOCK_HISTORY];
+    int errorIndex = 0;
+    int errorCount = 0;
+};
+
+//Note length for an LFO rate pot value
+static inline float clockDivisionTicks(int rateValue) {
+  int division = rateValue >> 6;
+  return CLOCK_DIVISION_TICKS[division < 0 ? 0 : division >= CLOCK_DIVISIONS ? CLOCK_DIVISIONS - 1 : division];
+}
+
+//LFO rate CV for hz, table is LFOTEMPO, the rate in Hz for each CV step of 8. Between steps it
+//interpolates, outside the table it stops at the ends.
+static inline int clockRateValue(const float *table, float hz) {
+  if (hz <= table[0]) return 0;
+  for (int i = 1; i < 128; i++) {
+    if (table[i] >= hz) {
+      float span = table[i] - table[i - 1];
+      float fraction = span > 0 ? (hz - table[i - 1]) / span : 1;
+      return (int)((i - 1 + fraction) * 8 + 0.5f);
+    }
+  }
+  return 1023;
+}
+
+MidiClockTracker midiClock;
+bool clockSync = false;                //LFO rate follows the clock
+uint32_t clockRateWords[2];            //Upper, lower
+int clockRateChannel = -1;
+bool clockRateOnB = false;
+
+void clockBegin() {
+  if (!demuxLocate(P_LFORate, clockRateChannel, clockRateOnB)) clockRateChannel = -1;
+}
+
+//LFO rate words for the tempo, multipliers are each layer's LFO_MULTIPLIERS factor
+void clockUpdateRates(const float *table, const int *upper, const int *lower, float upperMultiplier, float lowerMultiplier) {
+  if (clockRateChannel < 0 || !midiClock.isLocked()) return;
+  const DemuxSource &source = clockRateOnB ? DEMUX_MAP[clockRateChannel].b : DEMUX_MAP[clockRateChannel].a;
+  for (int layer = 0; layer < 2; layer++) {
+    const int *data = layer ? lower : upper;
+    float multiplier = layer ? lowerMultiplier : upperMultiplier;
+    float hz = 1000000.0f / (midiClock.periodUs() * clockDivisionTicks(data[P_LFORate]) * multiplier);
+    uint32_t channel = clockRateOnB ? (layer ? DAC_CHANNEL_D : DAC_CHANNEL_B) : (layer ? DAC_CHANNEL_C : DAC_CHANNEL_A);
+    clockRateWords[layer] = demuxValueWord(channel, source, clockRateValue(table, hz), data);
+  }
+}
+
+//After demuxWords(), only while synced to a clock that is there
+void clockApply(int channel, uint32_t words[4]) {
+  if (!clockSync || !midiClock.isLocked() || channel != clockRateChannel) return;
+  words[clockRateOnB ? 2 : 0] = clockRateWords[0];
+  words[clockRateOnB ? 3 : 1] = clockRateWords[1];
+}
@@ -0,0 +1,113 @@
+//DIN MIDI input off the loop(). An IntervalTimer takes bytes off Serial1 every MIDI_DRAIN_US, well inside
+//one byte time at 31250 baud, and runs them through MidiParser. Everything goes through one queue in the
+//order it arrived, so a note never overtakes the program change, CC or pitch bend sent before it, and
+//readMidi() empties it every pass. Active sensing, MTC and song position are dropped here, clock only
+//gets through when something has asked for it with midiClockWanted.
+//
+//The soft thru forwards whole messages of the classes in midiThruMask to the DIN out from the timer,
+//a few microseconds after the last byte arrives. Sends from loop() go between beginDinSend() and
+//endDinSend() so a thru message can't land in the middle of them, it is held and sent afterwards.
+
+#include "MidiParser.h"
+
+#define MIDI_DRAIN_US 100
+#define MIDI_DIN_QUEUE 128
+#define MIDI_THRU_HOLD 64  //Bytes of thru held while loop() is sending
+#define MIDI_THRU_DEFAULT 0  //Classes sent on by the soft thru at power up, eg MIDI_CLASS_NOTE | MIDI_CLASS_CONTROL
+
+IntervalTimer dinMidiTimer;
+MidiParser dinParser;
+MidiQueue<MIDI_DIN_QUEUE> dinQueue;
+
+//The one SysEx waiting for loop(), a second one arriving before it is handled is dropped
+uint8_t dinSysex[MIDI_SYSEX_MAX];
+uint16_t dinSysexLength = 0;
+volatile bool dinSysexReady = false;
+
+volatile bool midiClockWanted = false;
+volatile uint8_t midiThruMask = MIDI_THRU_DEFAULT;
+volatile bool dinSending = false;
+uint8_t thruHold[MIDI_THRU_HOLD];
+volatile uint8_t thruHoldLength = 0;
+
+volatile uint32_t dinFiltered = 0;
+volatile uint32_t dinDropped = 0;      //Queue or SysEx slot full
+volatile uint32_t thruDropped = 0;     //No room in the UART buffer or the hold buffer
+
+void thruDinMidi(const MidiMessage &msg) {
+  uint8_t bytes[3] = { msg.status, msg.data1, msg.data2 };
+  const uint8_t *data = msg.status == 0xF0 ? dinParser.sysex() : bytes;
+  uint16_t length = msg.status == 0xF0 ? dinParser.sysexSize() : msg.length;
+  if (dinSending) {
+    if (thruHoldLength + length > MIDI_THRU_HOLD) {
+      thruDropped++;
+      return;
+    }
+    memcpy(&thruHold[thruHoldLength], data, length);
+    thruHoldLength += length;
+  } else if (Serial1.availableForWrite() >= length) {
+    Serial1.write(data, length);
+  } else {
+    thruDropped++;
+  }
+}
+
+void drainDinMidi() {
+  while (Serial1.available()) {
+    MidiMessage msg;
+    if (!dinParser.feed(Serial1.read(), msg)) continue;
+    msg.time = micros();
+    uint8_t type = midiClassOf(msg.status);
+    if (midiThruMask & type) thruDinMidi(msg);
+    if (type == MIDI_CLASS_SENSING || type == MIDI_CLASS_COMMON || (type == MIDI_CLASS_CLOCK && !midiClockWanted)) {
+      dinFiltered++;
+      continue;
+    }
+    if (type == MIDI_CLASS_SYSEX) {
+      if (dinSysexReady) {
+        dinDropped++;
+        continue;
+      }
+      dinSysexLength = dinParser.sysexSize();
+      memcpy(dinSysex, dinParser.sysex(), dinSysexLength);
+    }
+    if (!dinQueue.push(msg)) {
+      dinDropped++;
+      continue;
+    }
+    if (type == MIDI_CLASS_SYSEX) dinSysexReady = true;  //Only once it's queued, or the slot stays taken
+  }
+}
+
+bool popDinMidi(MidiMessage &msg) {
+  return dinQueue.pop(msg);
+}
+
+void releaseDinSysex() {
+  dinSysexReady = false;
+}
+
+void beginDinSend() {
+  dinSending = true;
+}
+
+//Serial1.write() turns interrupts back on, so hold the timers at the NVIC instead. The input scanner waits too.
+void endDinSend() {
+  NVIC_DISABLE_IRQ(IRQ_PIT);
+  if (thruHoldLength && Serial1.availableForWrite() >= thruHoldLength) {
+    Serial1.write(thruHold, thruHoldLength);
+  } else if (thruHoldLength) {
+    thruDropped++;
+  }
+  thruHoldLength = 0;
+  dinSending = false;
+  NVIC_ENABLE_IRQ(IRQ_PIT);
+}
+
+//After MIDI.begin() has set Serial1 up
+void startDinMidi() {
+  dinMidiTimer.begin(drainDinMidi, MIDI_DRAIN_US);
+  //Every IntervalTimer shares IRQ_PIT, so this is the priority of the input scanner too. Above loop() and
+  //below the UART, a scan running when the drain is due only delays it by the scan.
+  dinMidiTimer.priority(96);
+}
@@ -0,0 +1,146 @@
+//Byte at a time MIDI parser for the DIN input, fed from the drain timer in MidiInput.h. Keeps running
+//status, lets real time bytes through in the middle of other messages and collects SysEx into its own
+//buffer. Nothing Arduino in here, so recorded byte streams can be pushed through it on a PC.
+
+#include <stdint.h>
+#include <string.h>
+
+#define MIDI_SYSEX_MAX 256  //Same as the MIDI library instance, room for a patch dump message
+
+//Message classes, used for the filters and the soft thru mask
+#define MIDI_CLASS_NOTE 0x01
+#define MIDI_CLASS_CONTROL 0x02  //CC, program change, aftertouch, pitch bend
+#define MIDI_CLASS_SYSEX 0x04
+#define MIDI_CLASS_CLOCK 0x08    //Clock, start, continue, stop
+#define MIDI_CLASS_COMMON 0x10   //MTC, song position, song select, tune request
+#define MIDI_CLASS_SENSING 0x20  //Active sensing and reset
+
+struct MidiMessage {
+  uint32_t time;   //When the last byte was taken off the UART
+  uint8_t status;  //Channel included, 0xF0 for a complete SysEx
+  uint8_t data1;
+  uint8_t data2;
+  uint8_t length;  //Bytes on the wire without running status, 0 for SysEx
+};
+
+static inline uint8_t midiClassOf(uint8_t status) {
+  if (status < 0xA0) return MIDI_CLASS_NOTE;
+  if (status < 0xF0) return MIDI_CLASS_CONTROL;
+  if (status == 0xF0) return MIDI_CLASS_SYSEX;
+  if (status == 0xF8 || (status >= 0xFA && status <= 0xFC)) return MIDI_CLASS_CLOCK;
+  if (status == 0xFE || status == 0xFF) return MIDI_CLASS_SENSING;
+  return MIDI_CLASS_COMMON;
+}
+
+static inline uint8_t midiDataBytes(uint8_t status) {
+  switch (status & 0xF0) {
+    case 0xC0:
+    case 0xD0:
+      return 1;
+    case 0xF0:
+      return status == 0xF2 ? 2 : (status == 0xF1 || status == 0xF3) ? 1 : 0;
+    default:
+      return 2;
+  }
+}
+
+class MidiParser {
+  public:
+    //True when b completes a message. SysEx is then in sysex() until the next F0.
+    bool feed(uint8_t b, MidiMessage &msg) {
+      if (b >= 0xF8) {  //Real time, can turn up anywhere and leaves the rest alone
+        msg = { 0, b, 0, 0, 1 };
+        return true;
+      }
+      if (b == 0xF0) {
+        inSysex = true;
+        sysexLength = 0;
+        status = 0;
+        putSysex(b);
+        return false;
+      }
+      if (b == 0xF7) {
+        if (!inSysex) return false;
+        inSysex = false;
+        putSysex(b);
+        if (sysexLength > MIDI_SYSEX_MAX) {
+          sysexOverflows++;
+          return false;
+        }
+        msg = { 0, 0xF0, 0, 0, 0 };
+        return true;
+      }
+      if (b & 0x80) {
+        inSysex = false;  //An unterminated SysEx is thrown away
+        status = b;
+        count = 0;
+        if (b >= 0xF0 && midiDataBytes(b) == 0) {  //Tune request
+          status = 0;
+          msg = { 0, b, 0, 0, 1 };
+          return true;
+        }
+        return false;
+      }
+      if (inSysex) {
+        putSysex(b);
+        return false;
+      }
+      if (!status) return false;  //Data without a status to go with it
+      data[count++] = b;
+      uint8_t needed = midiDataBytes(status);
+      if (count < needed) return false;
+      msg = { 0, status, data[0], needed > 1 ? data[1] : (uint8_t)0, (uint8_t)(1 + needed) };
+      count = 0;
+      if (status >= 0xF0) status = 0;  //Only channel messages have running status
+      return true;
+    }
+
+    const uint8_t *sysex() const {
+      return sysexData;
+    }
+
+    uint16_t sysexSize() const {
+      return sysexLength;
+    }
+
+    uint32_t sysexOverflows = 0;
+
+  private:
+    void putSysex(uint8_t b) {
+      if (sysexLength < MIDI_SYSEX_MAX) sysexData[sysexLength] = b;
+      if (sysexLength <= MIDI_SYSEX_MAX) sysexLength++;
+    }
+
+    uint8_t status = 0;
+    uint8_t data[2];
+    uint8_t count = 0;
+    bool inSysex = false;
+    uint8_t sysexData[MIDI_SYSEX_MAX];
+    uint16_t sysexLength = 0;
+};
+
+//Single producer, single consumer, SIZE a power of two
+template<int SIZE>
+class MidiQueue {
+  public:
+    bool push(const MidiMessage &msg) {
+      uint32_t h = head;
+      if (h - tail == SIZE) return false;
+      items[h & (SIZE - 1)] = msg;
+      head = h + 1;
+      return true;
+    }
+
+    bool pop(MidiMessage &msg) {
+      uint32_t t = tail;
+      if (t == head) return false;
+      msg = items[t & (SIZE - 1)];
+      tail = t + 1;
+      return true;
+    }
+
+  private:
+    MidiMessage items[SIZE];
+    volatile uint32_t head = 0;
+    volatile uint32_t tail = 0;
+};
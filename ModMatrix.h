@@ -0,0 +1,92 @@
+//Control rate modulation. Aftertouch, mod wheel, velocity and key go through a small fixed point matrix
+//per layer onto DCO mod, cutoff, VCF mod and VCA mod. upperData/lowerData keep the patch values, modTick()
+//adds the offsets every MOD_TICK_US and keeps the modulated DAC words for those outputs in modWords, which
+//writeDemux() swaps in with modApply(). Controllers only store their latest value, so a tick costs the
+//same however fast they arrive. Velocity and key are from the last note played, the demux CVs are per
+//layer not per voice. Nothing Arduino in here.
+
+#include "DemuxMap.h"
+
+#define MOD_TICK_US 1000
+
+#define MOD_SRC_AFTERTOUCH 0
+#define MOD_SRC_WHEEL 1
+#define MOD_SRC_VELOCITY 2
+#define MOD_SRC_KEY 3
+#define MOD_SOURCES 4
+
+#define MOD_DEST_DCO 0     //FM depth
+#define MOD_DEST_CUTOFF 1
+#define MOD_DEST_VCF 2     //Filter LFO depth
+#define MOD_DEST_VCA 3     //AM depth
+#define MOD_DESTS 4
+
+#define MOD_LAYERS 2       //0 upper, 1 lower
+#define MOD_UNITY 256      //Amounts are 8.8 fixed point, -MOD_UNITY to MOD_UNITY
+
+const int8_t MOD_DEST_PARAMS[MOD_DESTS] = { P_fmDepth, P_filterCutoff, P_filterLFO, P_amDepth };
+const char *const MOD_SOURCE_NAMES[MOD_SOURCES] = { "aftertouch", "wheel", "velocity", "key" };
+const char *const MOD_DEST_NAMES[MOD_DESTS] = { "dco", "cutoff", "vcf", "vca" };
+
+int16_t modAmounts[MOD_LAYERS][MOD_SOURCES][MOD_DESTS];  //Routes set with the "mod" command
+volatile int16_t modSources[MOD_SOURCES];                //0-1023, one keyboard so both layers share them
+uint32_t modWords[MOD_LAYERS][MOD_DESTS];
+int8_t modChannel[MOD_DESTS];  //Where each destination sits in DEMUX_MAP
+bool modOnB[MOD_DESTS];
+volatile bool modReady = false;
+
+void modBegin() {
+  for (int d = 0; d < MOD_DESTS; d++) {
+    int channel;
+    modChannel[d] = demuxLocate(MOD_DEST_PARAMS[d], channel, modOnB[d]) ? channel : -1;
+  }
+}
+
+//value 0-1023
+void modSource(int source, int value) {
+  modSources[source] = value < 0 ? 0 : value > 1023 ? 1023 : value;
+}
+
+void modNote(uint8_t note, uint8_t velocity) {
+  modSource(MOD_SRC_VELOCITY, velocity << 3);
+  modSource(MOD_SRC_KEY, note << 3);
+}
+
+void modRoute(int layer, int source, int dest, int amount) {
+  modAmounts[layer][source][dest] = amount < -MOD_UNITY ? -MOD_UNITY : amount > MOD_UNITY ? MOD_UNITY : amount;
+}
+
+//Patch value plus the summed offsets for every destination of both layers. P_AfterTouchDest 1-4 is the
+//patch's own aftertouch route at full depth on top of the matrix.
+void modTick(const int *upper, const int *lower) {
+  int16_t sources[MOD_SOURCES];
+  for (int s = 0; s < MOD_SOURCES; s++) sources[s] = modSources[s];
+  for (int layer = 0; layer < MOD_LAYERS; layer++) {
+    const int *data = layer ? lower : upper;
+    int32_t offsets[MOD_DESTS] = { 0 };
+    for (int s = 0; s < MOD_SOURCES; s++) {
+      for (int d = 0; d < MOD_DESTS; d++) offsets[d] += sources[s] * modAmounts[layer][s][d];
+    }
+    int patchDest = data[P_AfterTouchDest] - 1;
+    if (patchDest >= 0 && patchDest < MOD_DESTS) offsets[patchDest] += sources[MOD_SRC_AFTERTOUCH] * MOD_UNITY;
+    for (int d = 0; d < MOD_DESTS; d++) {
+      if (modChannel[d] < 0) continue;
+      int value = data[MOD_DEST_PARAMS[d]] + offsets[d] / MOD_UNITY;
+      value = value < 0 ? 0 : value > 1023 ? 1023 : value;
+      const DemuxChannel &map = DEMUX_MAP[modChannel[d]];
+      uint32_t channel = modOnB[d] ? (layer ? DAC_CHANNEL_D : DAC_CHANNEL_B) : (layer ? DAC_CHANNEL_C : DAC_CHANNEL_A);
+      modWords[layer][d] = demuxValueWord(channel, modOnB[d] ? map.b : map.a, value, data);
+    }
+  }
+  modReady = true;
+}
+
+//After demuxWords(), the same A upper, C lower, B upper, D lower order
+void modApply(int channel, uint32_t words[4]) {
+  if (!modReady) return;
+  for (int d = 0; d < MOD_DESTS; d++) {
+    if (modChannel[d] != channel) continue;
+    words[modOnB[d] ? 2 : 0] = modWords[0][d];
+    words[modOnB[d] ? 3 : 1] = modWords[1][d];
+  }
+}
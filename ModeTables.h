@@ -0,0 +1,53 @@
+//Front panel mode tables, one row per mode. A mode change is a lookup plus one masked shift register
+//write and a new mode only needs a new row. The row index is also the CC value sent for the mode.
+
+struct FilterMode {
+  const char *label;      //Pole switch off
+  const char *poleLabel;  //Pole switch on, adds the 1 pole low pass
+  uint8_t bits;           //FILTERA/B/C
+};
+
+constexpr FilterMode FILTER_MODES[] = {
+  { "4P LowPass", "3P LowPass", 0b000 },
+  { "2P LowPass", "1P LowPass", 0b001 },
+  { "4P HighPass", "3P HP + 1P LP", 0b010 },
+  { "2P HighPass", "1P HP + 1P LP", 0b011 },
+  { "4P BandPass", "2P HP + 1P LP", 0b100 },
+  { "2P BandPass", "2P BP + 1P LP", 0b101 },
+  { "3P AllPass", "3P AP + 1P LP", 0b110 },
+  { "Notch", "2P Notch + LP", 0b111 },
+};
+#define FILTER_MODE_COUNT int(sizeof(FILTER_MODES) / sizeof(FILTER_MODES[0]))
+
+struct LfoWaveform {
+  const char *label;
+  const char *altLabel;  //LFO Alt on
+  int cv;                //Level written to the layer's P_LFOWaveform
+};
+
+constexpr LfoWaveform LFO_WAVEFORMS[] = {
+  { "Sawtooth Up", "Saw +Oct", 40 },
+  { "Sawtooth Down", "Quad Saw", 160 },
+  { "Squarewave", "Quad Pulse", 280 },
+  { "Triangle", "Tri Step", 400 },
+  { "Sinewave", "Sine +Oct", 592 },
+  { "Sweeps", "Sine +3rd", 720 },
+  { "Lumps", "Sine +4th", 840 },
+  { "Sample & Hold", "Rand Slopes", 968 },
+};
+#define LFO_WAVEFORM_COUNT int(sizeof(LFO_WAVEFORMS) / sizeof(LFO_WAVEFORMS[0]))
+
+struct LfoMultiplier {
+  const char *label;
+  uint8_t bits;  //LFO_MULTI_BIT0/1/2
+  float factor;  //On the rate the LFO rate CV sets
+};
+
+constexpr LfoMultiplier LFO_MULTIPLIERS[] = {
+  { "x0.5", 0b000, 0.5 },
+  { "x1.0", 0b001, 1.0 },
+  { "x1.5", 0b010, 1.5 },
+  { "x2.0", 0b011, 2.0 },
+  { "x2.5", 0b100, 2.5 },
+};
+#define LFO_MULTIPLIER_COUNT int(sizeof(LFO_MULTIPLIERS) / sizeof(LFO_MULTIPLIERS[0]))
@@ -0,0 +1,138 @@
+#include "NoteHandler.h"
+#include "Hal.h"
+
+#define UNISON_VOICES 8
+
+static int wrapOrder(int a) {
+  int r = a % KEY_ORDER;
+  return r < 0 ? r + KEY_ORDER : r;
+}
+
+static void commandNote(KeyState &keys, int note) {
+  hal.midiVoices->noteOn(note, keys.noteVel, 1);
+}
+
+static void commandNoteUni(KeyState &keys, int note) {
+  for (int voice = 1; voice <= UNISON_VOICES; voice++) hal.midiVoices->noteOn(note, keys.noteVel, voice);
+}
+
+static void commandTopNote(KeyState &keys, bool unison) {
+  int topNote = 0;
+  bool noteActive = false;
+
+  for (int i = 0; i < 128; i++) {
+    if (keys.notes[i]) {
+      topNote = i;
+      noteActive = true;
+    }
+  }
+
+  if (noteActive) {
+    if (unison) commandNoteUni(keys, topNote);
+    else commandNote(keys, topNote);
+  } else {  // All notes are off, turn off gate
+    for (int voice = 1; voice <= (unison ? UNISON_VOICES : 1); voice++) hal.midiVoices->noteOff(keys.noteMsg, 0, voice);
+  }
+}
+
+static void commandBottomNote(KeyState &keys, bool unison) {
+  int bottomNote = 0;
+  bool noteActive = false;
+
+  for (int i = 127; i >= 0; i--) {
+    if (keys.notes[i]) {
+      bottomNote = i;
+      noteActive = true;
+    }
+  }
+
+  if (noteActive) {
+    if (unison) commandNoteUni(keys, bottomNote);
+    else commandNote(keys, bottomNote);
+  } else {  // All notes are off, turn off gate
+    for (int voice = 1; voice <= (unison ? UNISON_VOICES : 1); voice++) hal.midiVoices->noteOff(keys.noteMsg, 0, voice);
+  }
+}
+
+static void commandLastNote(KeyState &keys, bool unison) {
+  int8_t noteIndx = 0;
+
+  for (int i = 0; i < KEY_ORDER; i++) {
+    noteIndx = keys.noteOrder[wrapOrder(keys.orderIndx - i)];
+    if (keys.notes[noteIndx]) {
+      if (unison) commandNoteUni(keys, noteIndx);
+      else commandNote(keys, noteIndx);
+      return;
+    }
+  }
+  //Voice 1 gets the note just released, the unison voices the oldest one remembered as before
+  hal.midiVoices->noteOff(keys.noteMsg, 0, 1);
+  if (unison) {
+    for (int voice = 2; voice <= UNISON_VOICES; voice++) hal.midiVoices->noteOff(noteIndx, 0, voice);
+  }
+}
+
+static void commandPriority(KeyState &keys, int priority, bool unison) {
+  if (priority == 0) {  // Highest note priority
+    commandTopNote(keys, unison);
+  } else if (priority == 1) {  // Lowest note priority
+    commandBottomNote(keys, unison);
+  } else {                      // Last note priority
+    if (keys.notes[keys.noteMsg]) {  // If note is on and using last note priority, add to ordered list
+      keys.orderIndx = (keys.orderIndx + 1) % KEY_ORDER;
+      keys.noteOrder[keys.orderIndx] = keys.noteMsg;
+    }
+    commandLastNote(keys, unison);
+  }
+}
+
+int keyNoteOn(KeyState &keys, int mode, int priority, int note, int velocity, long now) {
+  switch (mode) {
+    case 0:
+    case 1:
+      {
+        int voice = polyNoteOn(keys.voices, keys.voiceCount, mode, keys.lastUsedVoice, note, velocity, now);
+        if (voice) {
+          if (keys.updateVoice) keys.updateVoice(voice);
+          hal.midiVoices->noteOn(note, velocity, voice);
+        }
+        return voice;
+      }
+
+    case 2:
+    case 3:
+      keys.noteMsg = note;
+      keys.noteVel = velocity;
+      keys.notes[note] = velocity != 0;
+      commandPriority(keys, priority, mode == 3);
+      break;
+  }
+  return 0;
+}
+
+int keyNoteOff(KeyState &keys, int mode, int priority, int note, int velocity) {
+  switch (mode) {
+    case 0:
+    case 1:
+      {
+        int released;
+        int voice = polyNoteOff(keys.voices, keys.voiceCount, note, released);
+        hal.midiVoices->noteOn(released, 0, voice);
+        return voice;
+      }
+
+    case 2:
+    case 3:
+      keys.noteMsg = note;
+      //Only velocity 0 and the default release velocity 64 let the key go, as before
+      keys.notes[note] = !(velocity == 0 || velocity == 64);
+      commandPriority(keys, priority, mode == 3);
+      break;
+  }
+  return 0;
+}
+
+void keyPitchBend(int pitch) {
+  hal.midiVoices->pitchBend(pitch, 1);
+  hal.midiVoices->pitchBend(pitch, 2);
+}
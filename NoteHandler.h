@@ -0,0 +1,35 @@
+//Key handling for the four keyboard modes, no Arduino so it can be run on a PC. Modes 0 and 1 are poly
+//through VoiceAllocator, 2 is mono on voice 1 and 3 unison on all 8, both with top, bottom or last note
+//priority. Notes and pitch bend go to the voices through hal.midiVoices, a voice number is the MIDI6
+//channel it listens on. myNoteOn(), myNoteOff() and DinHandlePitchBend() wrap these.
+
+#pragma once
+
+#include "VoiceAllocator.h"
+
+#include <stdint.h>
+
+#define KEY_ORDER 40  //Notes remembered for last note priority
+
+struct KeyState {
+  VoiceAndNote *voices;
+  int voiceCount;
+  void (*updateVoice)(int voice);  //CVs for a poly voice before its note goes out, may be NULL
+  int lastUsedVoice;
+  //Mono and unison
+  bool notes[128];
+  int8_t noteOrder[KEY_ORDER];
+  int8_t orderIndx;
+  int noteMsg;
+  int noteVel;
+};
+
+//priority is P_NotePriority, 0 top, 1 bottom, 2 last. Returns the voice in modes 0 and 1, 0 otherwise
+//or if mode 0 found none.
+int keyNoteOn(KeyState &keys, int mode, int priority, int note, int velocity, long now);
+
+//Returns the voice freed in modes 0 and 1, 0 otherwise
+int keyNoteOff(KeyState &keys, int mode, int priority, int note, int velocity);
+
+//To both layers' voice channels
+void keyPitchBend(int pitch);
@@ -0,0 +1,102 @@
+//RAM copy of every patch on the SD card so recalls never wait on the card.
+//Indexed by slot (physical file number), so deleting and renumbering patches doesn't move anything.
+//999 patches are about 170KB, which goes in RAM2, or PSRAM when fitted and PATCHBANK_IN_PSRAM is defined.
+
+#include "Hal.h"
+#include "PatchCodec.h"
+
+#define PATCH_VALUES 74 //Fields 1-73 of a patch file line up with the P_ indexes, 0 is unused
+
+struct PatchRecord
+{
+  char name[PATCH_NAME_LEN];
+  int16_t values[PATCH_VALUES];
+  bool valid;
+};
+
+#ifdef PATCHBANK_IN_PSRAM
+EXTMEM PatchRecord patchBank[PATCHES_LIMIT];
+#else
+DMAMEM PatchRecord patchBank[PATCHES_LIMIT];
+#endif
+
+//DMAMEM and EXTMEM aren't zeroed at startup
+void patchBankClear()
+{
+  for (int i = 0; i < PATCHES_LIMIT; i++) patchBank[i].valid = false;
+}
+
+PatchRecord *patchBankRecord(uint16_t slot)
+{
+  if (slot < 1 || slot > PATCHES_LIMIT || !patchBank[slot - 1].valid) return NULL;
+  return &patchBank[slot - 1];
+}
+
+//Parse a patch from an open patch file or anything else with read()
+template <typename Source>
+bool patchRecordLoad(PatchRecord &record, Source &source)
+{
+  PatchCsvReader<Source> reader(source);
+  record.valid = reader.readPatch(record.name, PATCH_NAME_LEN, record.values, PATCH_VALUES);
+  return record.valid;
+}
+
+//Parse a patch straight into its slot
+template <typename Source>
+PatchRecord *patchBankLoad(uint16_t slot, Source &source)
+{
+  if (slot < 1 || slot > PATCHES_LIMIT) return NULL;
+  PatchRecord &record = patchBank[slot - 1];
+  return patchRecordLoad(record, source) ? &record : NULL;
+}
+
+//Into upperData or lowerData, what a recall does once the record is there
+void patchRecordCopy(int *layerData, const PatchRecord &record)
+{
+  for (int i = 1; i < PATCH_VALUES; i++) layerData[i] = record.values[i];
+}
+
+//A record parsed somewhere else, such as the storage worker, copied into its slot
+void patchBankPut(uint16_t slot, const PatchRecord &record)
+{
+  if (slot >= 1 && slot <= PATCHES_LIMIT) patchBank[slot - 1] = record;
+}
+
+//From a whole patch line as written to the card
+PatchRecord *patchBankStore(uint16_t slot, const char *line)
+{
+  PatchLineSource source(line);
+  return patchBankLoad(slot, source);
+}
+
+//A patch file is one CSV line, read and written whole through hal.storage. The buffers are static, so
+//only from the storage worker, or at startup before it runs.
+bool patchFileLoad(PatchRecord &record, const char *name)
+{
+  static char line[PATCH_LINE_LEN + 3]; //Line, CR LF and the terminator
+  record.valid = false;
+  int n = hal.storage->read(name, (uint8_t *)line, sizeof(line) - 1);
+  if (n < 0) return false;
+  line[n] = '\0';
+  PatchLineSource source(line);
+  return patchRecordLoad(record, source);
+}
+
+bool patchFileLoad(PatchRecord &record, uint16_t slot)
+{
+  char name[8];
+  snprintf(name, sizeof(name), "%u", slot);
+  return patchFileLoad(record, name);
+}
+
+//Replaces the file, the line ends in CR LF as println() wrote it
+bool patchFileSave(const char *name, const char *line)
+{
+  static char file[PATCH_LINE_LEN + 2];
+  size_t length = strlen(line);
+  if (length > PATCH_LINE_LEN) length = PATCH_LINE_LEN;
+  memcpy(file, line, length);
+  file[length++] = '\r';
+  file[length++] = '\n';
+  return hal.storage->write(name, (const uint8_t *)file, length);
+}
@@ -0,0 +1,87 @@
+#include "PatchCodec.h"
+
+inline int PatchCsvParser::next()
+{
+  if (pos == len)
+  {
+    int got = readBlock(source, buffer, sizeof(buffer));
+    if (got <= 0) return -1;
+    len = got;
+    pos = 0;
+  }
+  return buffer[pos++];
+}
+
+bool PatchCsvParser::readPatch(char *name, size_t nameSize, int16_t *values, int count)
+{
+  int ch = next();
+  if (ch < 0) return false;
+  size_t n = 0;
+  while (ch >= 0 && ch != ',' && ch != '\n')
+  {
+    if (ch != '\r' && n + 1 < nameSize) name[n++] = ch;
+    ch = next();
+  }
+  name[n] = '\0';
+
+  memset(values, 0, count * sizeof(int16_t));
+  for (int i = 1; i < count && ch == ','; i++)
+  {
+    int value = 0;
+    bool negative = false;
+    ch = next();
+    if (ch == '-')
+    {
+      negative = true;
+      ch = next();
+    }
+    while (ch >= '0' && ch <= '9')
+    {
+      value = value * 10 + (ch - '0');
+      ch = next();
+    }
+    //Skip anything else up to the delimiter
+    while (ch >= 0 && ch != ',' && ch != '\n') ch = next();
+    values[i] = negative ? -value : value;
+  }
+  //Drop any extra fields so the next read starts on a new line
+  while (ch >= 0 && ch != '\n') ch = next();
+  return true;
+}
+
+template <typename T>
+static size_t formatValues(char *out, size_t size, const char *name, const T *values, int count)
+{
+  size_t n = strlen(name);
+  if (n >= size) return 0;
+  memcpy(out, name, n);
+  for (int i = 1; i < count; i++)
+  {
+    char digits[12];
+    int d = 0;
+    long value = values[i];
+    bool negative = value < 0;
+    unsigned long v = negative ? -value : value;
+    do
+    {
+      digits[d++] = '0' + (v % 10);
+      v /= 10;
+    } while (v);
+    if (n + d + (negative ? 2 : 1) >= size) return 0;
+    out[n++] = ',';
+    if (negative) out[n++] = '-';
+    while (d) out[n++] = digits[--d];
+  }
+  out[n] = '\0';
+  return n;
+}
+
+size_t formatPatchCsv(char *out, size_t size, const char *name, const int16_t *values, int count)
+{
+  return formatValues(out, size, name, values, count);
+}
+
+size_t formatPatchCsv(char *out, size_t size, const char *name, const int *values, int count)
+{
+  return formatValues(out, size, name, values, count);
+}
@@ -0,0 +1,70 @@
+//Patch file CSV codec: "name,v1,v2,...,v73" per line.
+//Reads through one block buffer and formats into a fixed char buffer, so nothing touches the heap.
+//No Arduino dependencies, the source only needs int read(void *buf, size_t n) like File. The parsing and
+//formatting live in PatchCodec.cpp, PatchCsvReader only adapts the source.
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PATCH_BLOCK_SIZE 512
+#define PATCH_LINE_LEN 512  //Name plus 73 comma separated values
+
+class PatchCsvParser
+{
+  public:
+    //Fill name and values[1..count-1] from the next line, values[0] is left 0.
+    //Missing or non numeric fields read as 0 like String::toInt(). Returns false at end of input.
+    bool readPatch(char *name, size_t nameSize, int16_t *values, int count);
+
+  protected:
+    typedef int (*ReadBlock)(void *source, void *buf, size_t n);
+
+    PatchCsvParser(ReadBlock readBlock, void *source) : readBlock(readBlock), source(source) {}
+
+  private:
+    int next();
+
+    ReadBlock readBlock;
+    void *source;
+    uint8_t buffer[PATCH_BLOCK_SIZE];
+    int pos = 0;
+    int len = 0;
+};
+
+template <typename Source>
+class PatchCsvReader : public PatchCsvParser
+{
+  public:
+    PatchCsvReader(Source &source) : PatchCsvParser(read, &source) {}
+
+  private:
+    static int read(void *source, void *buf, size_t n)
+    {
+      return static_cast<Source *>(source)->read(buf, n);
+    }
+};
+
+//Source over a line already in memory
+struct PatchLineSource
+{
+  const char *text;
+  size_t left;
+
+  PatchLineSource(const char *line) : text(line), left(strlen(line)) {}
+
+  int read(void *buf, size_t n)
+  {
+    if (n > left) n = left;
+    memcpy(buf, text, n);
+    text += n;
+    left -= n;
+    return n;
+  }
+};
+
+//Write "name,v1,...,v[count-1]" without a line ending. Returns the length, or 0 if it doesn't fit.
+size_t formatPatchCsv(char *out, size_t size, const char *name, const int16_t *values, int count);
+size_t formatPatchCsv(char *out, size_t size, const char *name, const int *values, int count);
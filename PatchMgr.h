@@ -15,10 +15,13 @@
   SAVE
   Save will save the current settings to a new patch at the end of the list or you can use the encoder to overwrite an existing patch.
   Press Save again to save it. If you want to name/rename the patch, press the encoder enter button and use the encoder and enter button to choose an alphanumeric name.
-  Holding Save for 1.5s will go into a patch deletion mode. Use encoder and enter button to choose and delete patch. Patch numbers will be changed on the SD card to be consecutive again.
+  Holding Save for 1.5s will go into a patch deletion mode. Use encoder and enter button to choose and delete patch. Patch numbers close up to be consecutive again.
+
+  Patch numbers are logical. SLOTS.TBL on the SD card maps each patch number to the physical file (slot) holding it,
+  so deleting or renumbering only rewrites the table. Slots freed by a delete are left on the card and reused by the next new patch.
 */
-//Agileware CircularBuffer available in libraries manager
-#include <CircularBuffer.hpp>
+#include "Hal.h"
+#include "PatchBank.h"
 
 #define TOTALCHARS 63
 
@@ -27,175 +30,323 @@ int charIndex = 0;
 char currentCharacter = 0;
 String renamedPatch = "";
 
+#define SLOT_TABLE_FILE "SLOTS.TBL"
+#define SLOT_TABLE_TMP "SLOTS.TMP"
+#define SLOT_TABLE_MAGIC 0x534C4F54 //'SLOT'
+#define SLOT_TABLE_VERSION 1
+#define SLOT_TABLE_HEADER 7 //Magic, version and count
+#define NO_SLOT 0
+
 struct PatchNoAndName
 {
   int patchNo;
-  String patchName;
+  uint16_t slot; //Physical file number on SD, NO_SLOT until first saved
+  char patchName[PATCH_NAME_LEN];
 };
 
-CircularBuffer<PatchNoAndName, PATCHES_LIMIT> patches;
-
-size_t readField(File *file, char *str, size_t size, const char *delim)
+//Patch directory kept as an array sorted by patchNo plus a browse cursor.
+//first(), last() and [] are relative to the cursor, so the display still sees the
+//browsed patch at the head like the old rotated buffer, but moving is O(1).
+class PatchDirectory
 {
-  char ch;
-  size_t n = 0;
-  while ((n + 1) < size && file->read(&ch, 1) == 1)
-  {
-    // Delete CR.
-    if (ch == '\r')
+  public:
+    int size() const { return count; }
+
+    PatchNoAndName &first() { return entries[cursor]; }
+    PatchNoAndName &last() { return entries[wrap(cursor - 1)]; }
+    PatchNoAndName &operator[](int i) { return entries[wrap(cursor + i)]; }
+    //Absolute position in patchNo order, ignoring the cursor
+    PatchNoAndName &at(int index) { return entries[index]; }
+    int cursorIndex() const { return cursor; }
+
+    void clear()
     {
-      continue;
+      count = 0;
+      cursor = 0;
     }
-    str[n++] = ch;
-    if (strchr(delim, ch))
+
+    void next() { cursor = wrap(cursor + 1); }
+    void prev() { cursor = wrap(cursor - 1); }
+
+    //Binary search, -1 if not found
+    int indexOf(int patchNo) const
     {
-      break;
+      int index = lowerBound(patchNo);
+      return (index < count && entries[index].patchNo == patchNo) ? index : -1;
     }
-  }
-  str[n] = '\0';
-  return n;
-}
 
-void recallPatchData(File patchFile, String data[])
-{
-  //Read patch data from file and set current patch parameters
-  size_t n;     // Length of returned field with delimiter.
-  char str[20]; // Must hold longest field with delimiter and zero byte.
-  int i = 0;
-  while (patchFile.available() && i < NO_OF_PARAMS)
-  {
-    n = readField(&patchFile, str, sizeof(str), ",\n");
-    // done if Error or at EOF.
-    if (n == 0)
-      break;
-    // Print the type of delimiter.
-    if (str[n - 1] == ',' || str[n - 1] == '\n')
+    bool setCursor(int patchNo)
     {
-      // Remove the delimiter.
-      str[n - 1] = 0;
+      int index = indexOf(patchNo);
+      if (index < 0) return false;
+      cursor = index;
+      return true;
     }
-    else
+
+    //Unordered add for bulk loading, call sort() when done
+    bool append(int patchNo, const char *name, uint16_t slot)
     {
-      // At eof, too long, or read error.  Too long is error.
-      Serial.print(patchFile.available() ? F("error: ") : F("eof:   "));
+      if (count >= PATCHES_LIMIT) return false;
+      setEntry(entries[count], patchNo, name);
+      entries[count++].slot = slot;
+      return true;
     }
-    // Print the field.
-    //    Serial.print(i);
-    //    Serial.print(" - ");
-    //    Serial.println(str);
-    data[i++] = String(str);
-  }
-}
 
-int compare(const void *a, const void *b) {
-  return ((PatchNoAndName*)a)->patchNo - ((PatchNoAndName*)b)->patchNo;
-}
+    //Ordered insert, or rename if patchNo is already there.
+    //New patches take the next number so this is normally an append.
+    bool insert(int patchNo, const char *name)
+    {
+      int index = lowerBound(patchNo);
+      if (index < count && entries[index].patchNo == patchNo) {
+        setEntry(entries[index], patchNo, name);
+        return true;
+      }
+      if (count >= PATCHES_LIMIT) return false;
+      memmove(&entries[index + 1], &entries[index], (count - index) * sizeof(PatchNoAndName));
+      setEntry(entries[index], patchNo, name);
+      entries[index].slot = NO_SLOT;
+      count++;
+      if (count > 1 && index <= cursor) cursor++;
+      return true;
+    }
 
-void sortPatches()
-{
-  int arraySize = patches.size();
-  //Sort patches buffer to be consecutive ascending patchNo order
-  struct PatchNoAndName arrayToSort[arraySize];
+    void removeAt(int index)
+    {
+      if (index < 0 || index >= count) return;
+      memmove(&entries[index], &entries[index + 1], (count - index - 1) * sizeof(PatchNoAndName));
+      count--;
+      if (index < cursor) cursor--;
+      if (cursor >= count) cursor = 0;
+    }
 
-  for (int i = 0; i < arraySize; ++i)
-  {
-    arrayToSort[i] = patches[i];
-  }
-  qsort(arrayToSort, arraySize, sizeof(PatchNoAndName), compare);
-  patches.clear();
+    //Close up patch numbers after a delete, slots are untouched
+    void renumber()
+    {
+      for (int i = 0; i < count; i++) entries[i].patchNo = i + 1;
+    }
 
-  for (int i = 0; i < arraySize; ++i)
-  {
-    patches.push(arrayToSort[i]);
-  }
-}
+    void sort()
+    {
+      qsort(entries, count, sizeof(PatchNoAndName), compareEntries);
+      cursor = 0;
+    }
 
-void loadPatches()
-{
-  File file = SD.open("/");
-  patches.clear();
-  while (true)
-  {
-    String data[NO_OF_PARAMS]; //Array of data read in
-    File patchFile = file.openNextFile();
-    if (!patchFile)
+  private:
+    PatchNoAndName entries[PATCHES_LIMIT];
+    int count = 0;
+    int cursor = 0;
+
+    int wrap(int index) const
+    {
+      if (count == 0) return 0;
+      if (index < 0) return index + count;
+      if (index >= count) return index - count;
+      return index;
+    }
+
+    int lowerBound(int patchNo) const
     {
-      break;
+      int lo = 0;
+      int hi = count;
+      while (lo < hi) {
+        int mid = (lo + hi) >> 1;
+        if (entries[mid].patchNo < patchNo) {
+          lo = mid + 1;
+        } else {
+          hi = mid;
+        }
+      }
+      return lo;
     }
-    if (patchFile.isDirectory())
+
+    static void setEntry(PatchNoAndName &entry, int patchNo, const char *name)
     {
-      Serial.println("Ignoring Dir");
+      entry.patchNo = patchNo;
+      strncpy(entry.patchName, name, PATCH_NAME_LEN - 1);
+      entry.patchName[PATCH_NAME_LEN - 1] = '\0';
     }
-    else
+
+    static int compareEntries(const void *a, const void *b)
     {
-      recallPatchData(patchFile, data);
-      patches.push(PatchNoAndName{atoi(patchFile.name()), data[0]});
-      Serial.println(String(patchFile.name()) + ":" + data[0]);
+      return ((const PatchNoAndName *)a)->patchNo - ((const PatchNoAndName *)b)->patchNo;
     }
-    patchFile.close();
+};
+
+PatchDirectory patches;
+
+uint16_t slotTableChecksum(const uint16_t *slots, int count)
+{
+  //Fletcher-16 over the slot numbers
+  uint16_t sum1 = 0;
+  uint16_t sum2 = 0;
+  for (int i = 0; i < count; i++)
+  {
+    sum1 = (sum1 + (slots[i] & 0xFF)) % 255;
+    sum2 = (sum2 + sum1) % 255;
+    sum1 = (sum1 + (slots[i] >> 8)) % 255;
+    sum2 = (sum2 + sum1) % 255;
   }
-  sortPatches();
+  return (sum2 << 8) | sum1;
 }
 
-void savePatch(const char *patchNo, String patchData)
+//Whole slot table file, read and written in one go through hal.storage
+uint8_t slotTableFile[SLOT_TABLE_HEADER + PATCHES_LIMIT * 2 + 2];
+
+//Read a slot table into slots[], returns the number of patches or -1 if missing or corrupt
+int readSlotTable(const char *fileName, uint16_t *slots)
+{
+  int size = hal.storage->read(fileName, slotTableFile, sizeof(slotTableFile));
+  if (size < SLOT_TABLE_HEADER) return -1;
+  uint32_t magic;
+  uint16_t count;
+  uint16_t checksum;
+  memcpy(&magic, slotTableFile, 4);
+  memcpy(&count, &slotTableFile[5], 2);
+  if (magic != SLOT_TABLE_MAGIC || slotTableFile[4] != SLOT_TABLE_VERSION || count > PATCHES_LIMIT
+      || size < SLOT_TABLE_HEADER + count * 2 + 2)
+  {
+    return -1;
+  }
+  memcpy(slots, &slotTableFile[SLOT_TABLE_HEADER], count * 2);
+  memcpy(&checksum, &slotTableFile[SLOT_TABLE_HEADER + count * 2], 2);
+  return checksum == slotTableChecksum(slots, count) ? count : -1;
+}
+
+//Slots in patch number order, as stored in the table
+uint16_t copySlotTable(PatchDirectory &directory, uint16_t *slots)
+{
+  uint16_t count = directory.size();
+  for (int i = 0; i < count; i++) slots[i] = directory.at(i).slot;
+  return count;
+}
+
+uint16_t copySlotTable(uint16_t *slots)
+{
+  return copySlotTable(patches, slots);
+}
+
+//Write the patch number to slot mapping. Goes to a temp file first so a power cut leaves one good copy.
+void writeSlotTable(const uint16_t *slots, uint16_t count)
 {
-  // Serial.print("savePatch Patch No:");
-  //  Serial.println(patchNo);
-  //Overwrite existing patch by deleting
-  if (SD.exists(patchNo))
+  uint32_t magic = SLOT_TABLE_MAGIC;
+  uint8_t version = SLOT_TABLE_VERSION;
+  uint16_t checksum = slotTableChecksum(slots, count);
+
+  memcpy(slotTableFile, &magic, 4);
+  slotTableFile[4] = version;
+  memcpy(&slotTableFile[5], &count, 2);
+  memcpy(&slotTableFile[SLOT_TABLE_HEADER], slots, count * 2);
+  memcpy(&slotTableFile[SLOT_TABLE_HEADER + count * 2], &checksum, 2);
+  if (!hal.storage->write(SLOT_TABLE_TMP, slotTableFile, SLOT_TABLE_HEADER + count * 2 + 2))
   {
-    SD.remove(patchNo);
+    Serial.println("Error writing slot table");
+    return;
   }
-  File patchFile = SD.open(patchNo, FILE_WRITE);
-  if (patchFile)
+  if (hal.storage->exists(SLOT_TABLE_FILE)) hal.storage->remove(SLOT_TABLE_FILE);
+  hal.storage->rename(SLOT_TABLE_TMP, SLOT_TABLE_FILE);
+}
+
+void writeSlotTable(PatchDirectory &directory)
+{
+  static uint16_t slots[PATCHES_LIMIT];
+  writeSlotTable(slots, copySlotTable(directory, slots));
+}
+
+//Lowest slot not used by any patch. Files left behind by deletes are overwritten here.
+uint16_t allocateSlot()
+{
+  static uint8_t used[(PATCHES_LIMIT + 8) / 8];
+  memset(used, 0, sizeof(used));
+  for (int i = 0; i < patches.size(); i++)
   {
-    //    Serial.print("Writing Patch No:");
-    //    Serial.println(patchNo);
-    //Serial.println(patchData);
-    patchFile.println(patchData);
-    patchFile.close();
+    uint16_t slot = patches.at(i).slot;
+    if (slot != NO_SLOT && slot <= PATCHES_LIMIT) used[(slot - 1) >> 3] |= 1 << ((slot - 1) & 7);
   }
-  else
+  for (int slot = 1; slot <= PATCHES_LIMIT; slot++)
   {
-    Serial.print("Error writing Patch file:");
-    Serial.println(patchNo);
+    if (!(used[(slot - 1) >> 3] & (1 << ((slot - 1) & 7)))) return slot;
   }
+  return NO_SLOT;
 }
 
-void savePatch(const char *patchNo, String patchData[])
+//Scans hand every patch file they read to one of these, so at startup they go straight into the RAM
+//bank and from the storage worker they go back to the main loop
+typedef void (*PatchScanned)(uint16_t slot, const PatchRecord &record);
+
+void patchBankScanned(uint16_t slot, const PatchRecord &record)
+{
+  patchBankPut(slot, record);
+}
+
+struct PatchFileScan
+{
+  PatchDirectory *directory;
+  PatchScanned scanned;
+};
+
+void patchFileFound(const char *name, void *context)
+{
+  static PatchRecord record;
+  PatchFileScan &scan = *static_cast<PatchFileScan *>(context);
+  int fileNo = atoi(name);
+  if (fileNo <= 0 || fileNo > PATCHES_LIMIT) return;
+  patchFileLoad(record, name);
+  scan.scanned(fileNo, record);
+  scan.directory->append(fileNo, record.valid ? record.name : "", fileNo);
+  Serial.println(String(name) + ":" + (record.valid ? record.name : ""));
+}
+
+//Old cards have no table, patches are files named by number. Map them in number order.
+void scanPatchFiles(PatchDirectory &directory, PatchScanned scanned)
+{
+  PatchFileScan scan = { &directory, scanned };
+  directory.clear();
+  hal.storage->list(patchFileFound, &scan);
+  directory.sort();
+  directory.renumber();
+  writeSlotTable(directory);
+}
+
+void loadPatches(PatchDirectory &directory, PatchScanned scanned)
 {
-  String dataString = patchData[0];
-  for (int i = 1; i < NO_OF_PARAMS; i++)
+  static uint16_t slots[PATCHES_LIMIT];
+  static PatchRecord record;
+  directory.clear();
+  int count = readSlotTable(SLOT_TABLE_FILE, slots);
+  if (count < 0) count = readSlotTable(SLOT_TABLE_TMP, slots);
+  if (count < 0)
+  {
+    scanPatchFiles(directory, scanned);
+    return;
+  }
+  for (int i = 0; i < count; i++)
   {
-    dataString = dataString + "," + patchData[i];
+    patchFileLoad(record, slots[i]);
+    scanned(slots[i], record);
+    directory.append(i + 1, record.valid ? record.name : "", slots[i]);
   }
-  savePatch(patchNo, dataString);
 }
 
-void deletePatch(const char *patchNo)
+//At startup, before the storage worker runs
+void loadPatches()
 {
-  if (SD.exists(patchNo)) SD.remove(patchNo);
+  patchBankClear();
+  loadPatches(patches, patchBankScanned);
 }
 
-void renumberPatchesOnSD() {
-  for (int i = 0; i < patches.size(); i++)
+bool savePatch(const char *patchNo, const char *patchData)
+{
+  if (!patchFileSave(patchNo, patchData))
   {
-    String data[NO_OF_PARAMS]; //Array of data read in
-    File file = SD.open(String(patches[i].patchNo).c_str());
-    if (file) {
-      recallPatchData(file, data);
-      file.close();
-      savePatch(String(i + 1).c_str(), data);
-    }
+    Serial.print("Error writing Patch file:");
+    Serial.println(patchNo);
+    return false;
   }
-  deletePatch(String(patches.size() + 1).c_str()); //Delete final patch which is duplicate of penultimate patch
+  return true;
 }
 
 void setPatchesOrdering(int no) {
-  if (patches.size() < 2)return;
-  while (patches.first().patchNo != no) {
-    patches.push(patches.shift());
-  }
+  patches.setCursor(no);
 }
 
 void resetPatchesOrdering() {
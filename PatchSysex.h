@@ -0,0 +1,206 @@
+//Patch and bank dumps over DIN or USB MIDI SysEx.
+//One patch per message, so a whole bank is sent and received a patch at a time and never buffered.
+//A receiver that ACKs each patch sets the pace, one that doesn't gets a patch every SYSEX_CHUNK_TIMEOUT.
+//
+//  F0 7D 01 cmd seq ... F7
+//  SYSEX_REQUEST  patch hi, patch lo           Patch 0 asks for the whole bank
+//  SYSEX_PATCH    patch hi, patch lo, packed name and values, checksum
+//  SYSEX_ACK                                   seq of the message being acknowledged
+//  SYSEX_END      count hi, count lo           End of a dump, the number of patches sent
+//  SYSEX_NAK      patch hi, patch lo           The requested patch doesn't exist
+//
+//Patch data is the 20 byte name then 73 big endian int16 values, 7 bit packed like the voice link frames.
+
+#include "VoiceLinkFrame.h"
+
+#define SYSEX_MODEL 0x01
+#define SYSEX_REQUEST 0x01
+#define SYSEX_PATCH 0x02
+#define SYSEX_ACK 0x03
+#define SYSEX_END 0x04
+#define SYSEX_NAK 0x05
+
+#define SYSEX_DIN 0
+#define SYSEX_USB 1
+
+#define SYSEX_HEADER 5                                      //F0 7D model cmd seq
+#define SYSEX_PATCH_RAW (PATCH_NAME_LEN + (PATCH_VALUES - 1) * 2)
+#define SYSEX_PATCH_PACKED ((SYSEX_PATCH_RAW / 7) * 8 + (SYSEX_PATCH_RAW % 7 ? SYSEX_PATCH_RAW % 7 + 1 : 0))
+#define SYSEX_PATCH_SIZE (SYSEX_HEADER + 2 + SYSEX_PATCH_PACKED + 2)
+#define SYSEX_CHUNK_TIMEOUT 50                              //ms to wait for an ACK before sending the next patch
+
+struct SysexTransfer {
+  bool active;
+  uint8_t port;
+  int next;   //Index into the patch directory
+  int end;    //Index past the last patch of a dump
+  int count;
+  uint8_t seq;
+  bool waitingAck;
+  unsigned long sentAt;
+  unsigned long startedAt;
+  unsigned long bytes;
+};
+
+SysexTransfer sysexDump;     //Outgoing
+SysexTransfer sysexRestore;  //Incoming
+
+void sendSysex(uint8_t port, uint8_t *message, unsigned size) {
+  if (port == SYSEX_USB) {
+    usbMIDI.sendSysEx(size, message, true);
+  } else {
+    hal.midiDin->send(message, size);
+  }
+}
+
+//Request and end messages carry a 14 bit patch number or count
+void sendSysexShort(uint8_t port, uint8_t cmd, uint8_t seq, int value) {
+  uint8_t message[] = { 0xF0, 0x7D, SYSEX_MODEL, cmd, seq, (uint8_t)((value >> 7) & 0x7F), (uint8_t)(value & 0x7F), 0xF7 };
+  sendSysex(port, message, sizeof(message));
+}
+
+void sendSysexAck(uint8_t port, uint8_t seq) {
+  uint8_t message[] = { 0xF0, 0x7D, SYSEX_MODEL, SYSEX_ACK, seq, 0xF7 };
+  sendSysex(port, message, sizeof(message));
+}
+
+uint8_t sysexChecksum(const uint8_t *data, size_t len) {
+  uint8_t sum = 0;
+  for (size_t i = 0; i < len; i++) sum += data[i];
+  return (0x80 - (sum & 0x7F)) & 0x7F;
+}
+
+unsigned sendSysexPatch(uint8_t port, uint8_t seq, int patchNo, const PatchRecord &record) {
+  uint8_t raw[SYSEX_PATCH_RAW];
+  uint8_t message[SYSEX_PATCH_SIZE];
+  memcpy(raw, record.name, PATCH_NAME_LEN);
+  for (int i = 1; i < PATCH_VALUES; i++) {
+    raw[PATCH_NAME_LEN + (i - 1) * 2] = (uint16_t)record.values[i] >> 8;
+    raw[PATCH_NAME_LEN + (i - 1) * 2 + 1] = record.values[i] & 0xFF;
+  }
+  unsigned n = 0;
+  message[n++] = 0xF0;
+  message[n++] = 0x7D;
+  message[n++] = SYSEX_MODEL;
+  message[n++] = SYSEX_PATCH;
+  message[n++] = seq;
+  message[n++] = (patchNo >> 7) & 0x7F;
+  message[n++] = patchNo & 0x7F;
+  size_t packed = pack7(raw, SYSEX_PATCH_RAW, &message[n]);
+  message[n + packed] = sysexChecksum(&message[n], packed);
+  n += packed + 1;
+  message[n++] = 0xF7;
+  sendSysex(port, message, n);
+  return n;
+}
+
+void reportSysexRate(const char *what, const SysexTransfer &transfer) {
+  unsigned long elapsed = millis() - transfer.startedAt;
+  Serial.println(String(what) + " " + String(transfer.count) + " patches, " + String(transfer.bytes) + " bytes in "
+                 + String(elapsed) + "ms, " + String(elapsed ? transfer.bytes * 1000 / elapsed : 0) + " bytes/s");
+}
+
+void startSysexDump(uint8_t port, int patchNo) {
+  int index = 0;
+  if (patchNo > 0) {
+    index = patches.indexOf(patchNo);
+    if (index < 0) {
+      sendSysexShort(port, SYSEX_NAK, 0, patchNo);
+      return;
+    }
+  }
+  sysexDump.active = true;
+  sysexDump.port = port;
+  sysexDump.next = index;
+  sysexDump.end = patchNo > 0 ? index + 1 : patches.size();
+  sysexDump.count = sysexDump.end - index;
+  sysexDump.waitingAck = false;
+  sysexDump.startedAt = millis();
+  sysexDump.bytes = 0;
+}
+
+//Sends the next patch of a dump once the last one is acknowledged or timed out. Waits while a rescan
+//is replacing the bank so a dump never mixes the old and new cards.
+void checkSysexDump() {
+  if (!sysexDump.active || storageScanning) return;
+  if (sysexDump.waitingAck && millis() - sysexDump.sentAt < SYSEX_CHUNK_TIMEOUT) return;
+  if (sysexDump.next >= sysexDump.end) {
+    sendSysexShort(sysexDump.port, SYSEX_END, sysexDump.seq, sysexDump.count);
+    sysexDump.active = false;
+    reportSysexRate("SysEx dump", sysexDump);
+    return;
+  }
+  PatchNoAndName &entry = patches.at(sysexDump.next);
+  PatchRecord *record = patchBankRecord(entry.slot);
+  sysexDump.seq = (sysexDump.seq + 1) & 0x7F;
+  if (record) {
+    sysexDump.bytes += sendSysexPatch(sysexDump.port, sysexDump.seq, entry.patchNo, *record);
+    sysexDump.waitingAck = true;
+    sysexDump.sentAt = millis();
+  }
+  sysexDump.next++;
+}
+
+//Store one received patch and acknowledge it
+void receiveSysexPatch(uint8_t port, const uint8_t *message, unsigned size) {
+  if (size != SYSEX_PATCH_SIZE) return;
+  const uint8_t *packed = &message[SYSEX_HEADER + 2];
+  if (sysexChecksum(packed, SYSEX_PATCH_PACKED) != packed[SYSEX_PATCH_PACKED]) {
+    Serial.println("SysEx patch checksum error");
+    return;
+  }
+  int patchNo = (message[SYSEX_HEADER] << 7) | message[SYSEX_HEADER + 1];
+  uint8_t raw[SYSEX_PATCH_RAW + 7];
+  unpack7(packed, SYSEX_PATCH_PACKED, raw);
+  char name[PATCH_NAME_LEN];
+  int16_t values[PATCH_VALUES];
+  memcpy(name, raw, PATCH_NAME_LEN);
+  name[PATCH_NAME_LEN - 1] = '\0';
+  values[0] = 0;
+  for (int i = 1; i < PATCH_VALUES; i++) {
+    values[i] = (int16_t)((raw[PATCH_NAME_LEN + (i - 1) * 2] << 8) | raw[PATCH_NAME_LEN + (i - 1) * 2 + 1]);
+  }
+
+  if (!storeIncomingPatch(patchNo, name, values)) return;
+
+  if (!sysexRestore.active) {
+    sysexRestore.active = true;
+    sysexRestore.port = port;
+    sysexRestore.count = 0;
+    sysexRestore.bytes = 0;
+    sysexRestore.startedAt = millis();
+  }
+  sysexRestore.count++;
+  sysexRestore.bytes += size;
+  sendSysexAck(port, message[4]);
+}
+
+void receiveSysex(uint8_t port, const uint8_t *message, unsigned size) {
+  if (size < SYSEX_HEADER + 1 || message[0] != 0xF0 || message[1] != 0x7D || message[2] != SYSEX_MODEL) return;
+  if (storageScanning) return;
+  switch (message[3]) {
+    case SYSEX_REQUEST:
+      if (size >= SYSEX_HEADER + 3) startSysexDump(port, (message[SYSEX_HEADER] << 7) | message[SYSEX_HEADER + 1]);
+      break;
+    case SYSEX_PATCH:
+      receiveSysexPatch(port, message, size);
+      break;
+    case SYSEX_ACK:
+      if (sysexDump.active && port == sysexDump.port && message[4] == sysexDump.seq) sysexDump.waitingAck = false;
+      break;
+    case SYSEX_END:
+      if (sysexRestore.active) {
+        sysexRestore.active = false;
+        reportSysexRate("SysEx restore", sysexRestore);
+      }
+      break;
+  }
+}
+
+void dinSysEx(byte *message, unsigned size) {
+  receiveSysex(SYSEX_DIN, message, size);
+}
+
+void usbSysEx(byte *message, unsigned size) {
+  receiveSysex(SYSEX_USB, message, size);
+}
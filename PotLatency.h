@@ -0,0 +1,213 @@
+//Pot to CV latency. A probe holds one mux input at a step value and timestamps the path it takes:
+//checkMux() reading it, myControlChange() starting, checkMux() finishing with the value in
+//upperData/lowerData, writeDemux() reaching a channel whose DAC words have changed and the DAC write.
+//Each control keeps the time to every stage and a histogram of the whole path. Only talks to hal, so
+//extras/pot_latency runs the same code on a PC. With POT_LATENCY_PIN defined that pin toggles at every
+//stage for a scope. Compiled in when POT_LATENCY is defined, otherwise the hooks are empty.
+
+#include "Hal.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#ifdef POT_LATENCY
+
+#define POT_MUXES 3
+#define POT_CHANNELS 16
+#define POT_CONTROLS (POT_MUXES * POT_CHANNELS)
+
+#define POT_STAGE_SCAN 0     //checkMux() read the step
+#define POT_STAGE_CONTROL 1  //myControlChange() entered
+#define POT_STAGE_PARAM 2    //checkMux() done, the value is stored
+#define POT_STAGE_SLOT 3     //writeDemux() on a channel with changed words
+#define POT_STAGE_DAC 4      //Those words sent to the DAC
+#define POT_STAGES 5
+
+#define POT_BUCKET_US 500
+#define POT_BUCKETS 80              //The last bucket holds everything over 40ms
+#define POT_TIMEOUT_US 100000       //Controls that never reach the demux give up here
+#define POT_SWEEP_GAP_US 20000      //Between probes, so the scan and demux pointers are somewhere new each time
+
+const char *const POT_STAGE_NAMES[POT_STAGES] = { "scan", "control", "param", "slot", "dac" };
+
+//Controls with no demux output, they go to the voices over MIDI6: glide, osc1 pw and pwm, osc2 detune,
+//interval, pw and pwm, keytrack, bend depth, lfo delay and mod wheel. Sweeps pass over them and the report
+//shows n/a, so lost only counts probes that really timed out.
+const uint8_t POT_MIDI6[] = { 0, 3, 4, 5, 6, 12, 13, POT_CHANNELS + 9, 2 * POT_CHANNELS, 2 * POT_CHANNELS + 9,
+                              2 * POT_CHANNELS + 10 };
+
+bool potMidi6(int control) {
+  for (size_t i = 0; i < sizeof(POT_MIDI6); i++) {
+    if (POT_MIDI6[i] == control) return true;
+  }
+  return false;
+}
+
+struct PotControl {
+  uint32_t count;
+  uint32_t timeouts;
+  uint32_t max;
+  uint64_t stageTotal[POT_STAGES];  //us from the step to each stage
+  uint16_t histogram[POT_BUCKETS];  //Step to DAC
+};
+
+struct PotProbe {
+  bool active;
+  int control;
+  int value;
+  uint32_t start;
+  uint32_t stages[POT_STAGES];
+  int reached;  //Stages done so far, they only happen in order
+};
+
+PotControl potControls[POT_CONTROLS];
+PotProbe potProbe;
+bool potForced[POT_CONTROLS];   //Probed controls are held at their step until the sweep ends
+int potOverride[POT_CONTROLS];
+int potValue[POT_CONTROLS];     //Last value checkMux() was given
+uint32_t potSentWords[POT_CHANNELS][4];
+uint32_t potSweepLeft = 0;      //Probes still to run
+int potSweepControl = 0;
+uint32_t potLastProbe = 0;
+bool potPinLevel = false;
+
+void potLatencyReset() {
+  for (int i = 0; i < POT_CONTROLS; i++) {
+    potControls[i] = PotControl();
+    potForced[i] = false;
+  }
+  potProbe.active = false;
+  potSweepLeft = 0;
+}
+
+//Step away from where the control is now, far enough to get past QUANTISE_FACTOR
+void potLatencyStart(int control) {
+  potProbe.active = true;
+  potProbe.control = control;
+  potProbe.value = potValue[control] < 512 ? 1023 : 0;
+  potProbe.start = hal.clock->micros();
+  potProbe.reached = 0;
+  potForced[control] = true;
+  potOverride[control] = potProbe.value;
+}
+
+void potLatencyFinish(bool timedOut) {
+  PotControl &c = potControls[potProbe.control];
+  potProbe.active = false;
+  if (timedOut) {
+    c.timeouts++;
+    return;
+  }
+  for (int s = 0; s < POT_STAGES; s++) c.stageTotal[s] += potProbe.stages[s] - potProbe.start;
+  uint32_t total = potProbe.stages[POT_STAGE_DAC] - potProbe.start;
+  int bucket = total / POT_BUCKET_US;
+  c.histogram[bucket < POT_BUCKETS ? bucket : POT_BUCKETS - 1]++;
+  if (total > c.max) c.max = total;
+  c.count++;
+}
+
+void potLatencyStage(int stage) {
+  if (!potProbe.active || potProbe.reached != stage) return;
+  potProbe.stages[stage] = hal.clock->micros();
+  potProbe.reached = stage + 1;
+#ifdef POT_LATENCY_PIN
+  potPinLevel = !potPinLevel;
+  hal.pins->write(POT_LATENCY_PIN, potPinLevel);
+#endif
+  if (stage == POT_STAGE_DAC) potLatencyFinish(false);
+}
+
+//mux 0-2, in place of the ADC value checkMux() is about to use
+int potLatencyRead(int mux, int channel, int value) {
+  int control = mux * POT_CHANNELS + channel;
+  if (potForced[control]) value = potOverride[control];
+  potValue[control] = value;
+  if (potProbe.active && potProbe.control == control) potLatencyStage(POT_STAGE_SCAN);
+  return value;
+}
+
+//writeDemux() after demuxWords(), before the DAC write
+void potLatencyDemux(int channel, const uint32_t *words) {
+  if (memcmp(potSentWords[channel], words, sizeof(potSentWords[channel])) == 0) return;
+  memcpy(potSentWords[channel], words, sizeof(potSentWords[channel]));
+  potLatencyStage(POT_STAGE_SLOT);
+}
+
+//From a task, starts the next probe of a sweep and gives up on ones that went nowhere
+void potLatencyTask() {
+  uint32_t now = hal.clock->micros();
+  if (potProbe.active) {
+    if (now - potProbe.start > POT_TIMEOUT_US) potLatencyFinish(true);
+    return;
+  }
+  if (!potSweepLeft) {
+    for (int i = 0; i < POT_CONTROLS; i++) potForced[i] = false;  //The pots take over again
+    return;
+  }
+  if (now - potLastProbe < POT_SWEEP_GAP_US) return;
+  int control = potSweepControl;
+  potSweepControl = (potSweepControl + 1) % POT_CONTROLS;
+  potSweepLeft--;
+  if (potMidi6(control)) return;  //Nothing to time, the next control goes on the next run
+  potLastProbe = now;
+  potLatencyStart(control);
+}
+
+//Every control in turn, steps probes each
+void potLatencySweep(uint32_t steps) {
+  potSweepControl = 0;
+  potSweepLeft = steps * POT_CONTROLS;
+}
+
+//Upper edge of the bucket the percent point falls in
+uint32_t potLatencyPercentile(const PotControl &c, int percent) {
+  if (!c.count) return 0;
+  uint32_t wanted = ((uint64_t)c.count * percent + 99) / 100;
+  uint32_t seen = 0;
+  for (int b = 0; b < POT_BUCKETS; b++) {
+    seen += c.histogram[b];
+    if (seen >= wanted) return b == POT_BUCKETS - 1 ? c.max : (b + 1) * POT_BUCKET_US;
+  }
+  return c.max;
+}
+
+void potLatencyHeader(char *line, size_t size) {
+  snprintf(line, size, "mux ch  count  lost    p50    p99    max  %7s %7s %7s %7s %7s", POT_STAGE_NAMES[0],
+           POT_STAGE_NAMES[1], POT_STAGE_NAMES[2], POT_STAGE_NAMES[3], POT_STAGE_NAMES[4]);
+}
+
+//The stage columns are averages from the step in us
+void potLatencyLine(int control, char *line, size_t size) {
+  const PotControl &c = potControls[control];
+  if (potMidi6(control)) {
+    snprintf(line, size, "%3d %2d  n/a (MIDI6)", control / POT_CHANNELS + 1, control % POT_CHANNELS);
+    return;
+  }
+  int n = snprintf(line, size, "%3d %2d %6lu %5lu %6lu %6lu %6lu ", control / POT_CHANNELS + 1, control % POT_CHANNELS,
+                   (unsigned long)c.count, (unsigned long)c.timeouts, (unsigned long)potLatencyPercentile(c, 50),
+                   (unsigned long)potLatencyPercentile(c, 99), (unsigned long)c.max);
+  for (int s = 0; s < POT_STAGES && c.count && n < (int)size; s++) {
+    n += snprintf(line + n, size - n, " %7lu", (unsigned long)(c.stageTotal[s] / c.count));
+  }
+}
+
+//One line per control that has been probed, and the MIDI6 ones
+void potLatencyReport(void (*print)(const char *line)) {
+  char line[112];
+  potLatencyHeader(line, sizeof(line));
+  print(line);
+  for (int i = 0; i < POT_CONTROLS; i++) {
+    if (!potControls[i].count && !potControls[i].timeouts && !potMidi6(i)) continue;
+    potLatencyLine(i, line, sizeof(line));
+    print(line);
+  }
+}
+
+#define POT_READ(mux, channel, value) potLatencyRead(mux, channel, value)
+#define POT_STAGE(stage) potLatencyStage(stage)
+#define POT_DEMUX(channel, words) potLatencyDemux(channel, words)
+#else
+#define POT_READ(mux, channel, value) (value)
+#define POT_STAGE(stage)
+#define POT_DEMUX(channel, words)
+#endif
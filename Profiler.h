@@ -0,0 +1,104 @@
+//Per-stage timing for loop() and the display thread. PROFILE_SCOPE(stage) at the top of a function
+//samples the DWT cycle counter on entry and exit. Each stage keeps count, min, max, total and a log2
+//histogram in fixed memory, the p99 comes from the histogram so it is the upper edge of its bucket.
+//On a host build the same macros time with std::chrono in nanoseconds, so the units are "ticks".
+//Compiled in when LOOP_PROFILER is defined, otherwise the macros are empty.
+
+#include <stdint.h>
+#include <stdio.h>
+
+#define PROFILE_DEMUX 0
+#define PROFILE_MUX 1
+#define PROFILE_MIDI 2
+#define PROFILE_RECALL 3
+#define PROFILE_I2C 4
+#define PROFILE_DISPLAY 5
+#define PROFILE_STAGES 6
+
+#define PROFILE_BUCKETS 32
+
+#if defined(__IMXRT1062__)
+#define PROFILE_TICKS_PER_US (F_CPU_ACTUAL / 1000000)
+static inline uint32_t profileTicks() {
+  return ARM_DWT_CYCCNT;
+}
+#else
+#include <chrono>
+#define PROFILE_TICKS_PER_US 1000
+static inline uint32_t profileTicks() {
+  return (uint32_t)std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+#endif
+
+const char *const PROFILE_NAMES[PROFILE_STAGES] = { "demux", "mux", "midi", "recall", "i2c", "display" };
+
+struct ProfileStage {
+  uint32_t count;
+  uint32_t min;
+  uint32_t max;
+  uint64_t total;
+  uint32_t histogram[PROFILE_BUCKETS];  //Bucket n holds samples of 2^n to 2^(n+1)-1 ticks
+};
+
+ProfileStage profileStages[PROFILE_STAGES];
+
+static inline int profileBucket(uint32_t ticks) {
+  return ticks ? 31 - __builtin_clz(ticks) : 0;
+}
+
+void profileRecord(int stage, uint32_t ticks) {
+  ProfileStage &s = profileStages[stage];
+  if (s.count == 0 || ticks < s.min) s.min = ticks;
+  if (ticks > s.max) s.max = ticks;
+  s.count++;
+  s.total += ticks;
+  s.histogram[profileBucket(ticks)]++;
+}
+
+void profileReset() {
+  for (int i = 0; i < PROFILE_STAGES; i++) profileStages[i] = ProfileStage();
+}
+
+uint32_t profilePercentile(const ProfileStage &s, int percent) {
+  uint64_t wanted = ((uint64_t)s.count * percent + 99) / 100;
+  uint64_t seen = 0;
+  for (int b = 0; b < PROFILE_BUCKETS; b++) {
+    seen += s.histogram[b];
+    if (seen >= wanted) return b == 31 ? 0xFFFFFFFF : (2u << b) - 1;
+  }
+  return s.max;
+}
+
+//One line per stage in microseconds, then the non-empty histogram buckets
+void profileReport(void (*print)(const char *line)) {
+  char line[96];
+  print("stage       count     min     avg     max     p99  (us)");
+  for (int i = 0; i < PROFILE_STAGES; i++) {
+    const ProfileStage &s = profileStages[i];
+    if (!s.count) continue;
+    snprintf(line, sizeof(line), "%-8s %8lu %7.1f %7.1f %7.1f %7.1f", PROFILE_NAMES[i], (unsigned long)s.count,
+             (float)s.min / PROFILE_TICKS_PER_US, (float)s.total / s.count / PROFILE_TICKS_PER_US,
+             (float)s.max / PROFILE_TICKS_PER_US, (float)profilePercentile(s, 99) / PROFILE_TICKS_PER_US);
+    print(line);
+    int n = snprintf(line, sizeof(line), "  log2:");
+    for (int b = 0; b < PROFILE_BUCKETS && n < (int)sizeof(line) - 12; b++) {
+      if (s.histogram[b]) n += snprintf(line + n, sizeof(line) - n, " %d:%lu", b, (unsigned long)s.histogram[b]);
+    }
+    print(line);
+  }
+}
+
+class ProfileScope {
+  public:
+    ProfileScope(int stage) : stage(stage), start(profileTicks()) {}
+    ~ProfileScope() { profileRecord(stage, profileTicks() - start); }
+  private:
+    int stage;
+    uint32_t start;
+};
+
+#ifdef LOOP_PROFILER
+#define PROFILE_SCOPE(stage) ProfileScope profileScope##stage(stage)
+#else
+#define PROFILE_SCOPE(stage)
+#endif
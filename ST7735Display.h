@@ -413,9 +413,20 @@ void showSettingsPage(const char *option, const char *value, int settingsPart) {
   currentSettingsPart = settingsPart;
 }
 
+//Shown over any page while the SD card is being written
+void renderStorageBusy() {
+  tft.fillRect(288, 0, 32, 18, ST7735_RED);
+  tft.setFont(&FreeSans9pt7b);
+  tft.setTextSize(1);
+  tft.setTextColor(ST7735_WHITE);
+  tft.setCursor(292, 14);
+  tft.print("SD");
+}
+
 void displayThread() {
   threads.delay(2000);  //Give bootup page chance to display
   while (1) {
+    PROFILE_SCOPE(PROFILE_DISPLAY);  //Includes time the thread was switched out
     switch (state) {
       case PARAMETER:
         if ((millis() - timer) > DISPLAYTIMEOUT) {
@@ -425,6 +436,7 @@ void displayThread() {
         }
         break;
       case RECALL:
+      case BROWSE:
         renderRecallPage();
         break;
       case SAVE:
@@ -453,6 +465,7 @@ void displayThread() {
         renderSettingsPage();
         break;
     }
+    if (storageBusy()) renderStorageBusy();
     tft.updateScreen();
   }
 }
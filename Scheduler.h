@@ -0,0 +1,125 @@
+//Cooperative scheduler for loop(). Each task has a period (0 runs every pass), a priority (lower runs
+//first) and a worst case budget in microseconds. Priority 0 tasks are the MIDI inputs, they run at the
+//start of every pass and again after every other task so a slow stage never holds incoming MIDI for
+//longer than that one task. Once a pass has used SCHEDULER_PASS_US the remaining due tasks are deferred
+//and go first next pass. Runs over budget are counted, reportScheduler() prints each task's CPU share.
+//Only the first overrun of a task in FLIGHT_OVERRUN_GAP_US goes in the flight recorder, the ones after
+//it are counted and recorded as one FLIGHT_OVERRUN_REPEAT, so a task that overruns every pass can't
+//push everything else out of the ring.
+
+#define MAX_TASKS 16
+#define SCHEDULER_PASS_US 1000
+
+struct Task {
+  const char *name;
+  void (*run)();
+  uint32_t periodUs;
+  uint8_t priority;
+  uint32_t budgetUs;
+  uint32_t lastRun;
+  bool deferred;
+  //Since the last report
+  uint32_t busyUs;
+  uint32_t runs;
+  uint32_t worstUs;
+  uint32_t overruns;
+  //Flight recorder
+  uint32_t overrunRecordedAt;
+  uint16_t overrunsHeld;
+};
+
+Task tasks[MAX_TASKS];
+int taskCount = 0;
+uint32_t schedulerWindowStart = 0;
+
+//Kept in priority order, tasks of equal priority run in the order they were added
+bool addTask(const char *name, void (*run)(), uint32_t periodUs, uint8_t priority, uint32_t budgetUs) {
+  if (taskCount >= MAX_TASKS) return false;
+  int i = taskCount++;
+  while (i > 0 && tasks[i - 1].priority > priority) {
+    tasks[i] = tasks[i - 1];
+    i--;
+  }
+  tasks[i] = { name, run, periodUs, priority, budgetUs, micros(), false, 0, 0, 0, 0, micros() - FLIGHT_OVERRUN_GAP_US, 0 };
+  return true;
+}
+
+const char *taskName(int index) {
+  return index < taskCount ? tasks[index].name : NULL;
+}
+
+bool taskDue(const Task &task, uint32_t now) {
+  return task.periodUs == 0 || now - task.lastRun >= task.periodUs;
+}
+
+void runTask(Task &task) {
+  uint32_t start = micros();
+  task.lastRun = start;
+  task.run();
+  uint32_t elapsed = micros() - start;
+  task.busyUs += elapsed;
+  task.runs++;
+  if (elapsed > task.worstUs) task.worstUs = elapsed;
+  if (task.overrunsHeld && start - task.overrunRecordedAt >= FLIGHT_OVERRUN_GAP_US) {
+    flightRecord(FLIGHT_OVERRUN_REPEAT, &task - tasks, task.overrunsHeld);
+    task.overrunsHeld = 0;
+  }
+  if (elapsed > task.budgetUs) {
+    task.overruns++;
+    if (start - task.overrunRecordedAt >= FLIGHT_OVERRUN_GAP_US) {
+      flightRecord(FLIGHT_OVERRUN, &task - tasks, elapsed);
+      task.overrunRecordedAt = start;
+    } else if (task.overrunsHeld < 0xFFFF) {
+      task.overrunsHeld++;
+    }
+  }
+}
+
+void runCriticalTasks() {
+  uint32_t now = micros();
+  for (int i = 0; i < taskCount && tasks[i].priority == 0; i++) {
+    if (taskDue(tasks[i], now)) runTask(tasks[i]);
+  }
+}
+
+void runScheduler() {
+  uint32_t passStart = micros();
+  bool ranAny = false;
+  runCriticalTasks();
+  //First sweep catches up tasks deferred last pass, second runs the rest in priority order
+  for (int sweep = 0; sweep < 2; sweep++) {
+    for (int i = 0; i < taskCount; i++) {
+      Task &task = tasks[i];
+      if (task.priority == 0 || task.deferred != (sweep == 0)) continue;
+      uint32_t now = micros();
+      if (!taskDue(task, now)) continue;
+      if (ranAny && now - passStart + task.budgetUs > SCHEDULER_PASS_US) {
+        task.deferred = true;
+        continue;
+      }
+      task.deferred = false;
+      runTask(task);
+      ranAny = true;
+      runCriticalTasks();
+    }
+  }
+}
+
+void reportScheduler() {
+  uint32_t now = micros();
+  uint32_t window = now - schedulerWindowStart;
+  if (window == 0) return;
+  Serial.println("Task            CPU%   runs  worst  budget  overruns");
+  for (int i = 0; i < taskCount; i++) {
+    Task &task = tasks[i];
+    char line[80];
+    snprintf(line, sizeof(line), "%-14s %5.1f %6lu %6lu %7lu %9lu", task.name, task.busyUs * 100.0f / window,
+             (unsigned long)task.runs, (unsigned long)task.worstUs, (unsigned long)task.budgetUs, (unsigned long)task.overruns);
+    Serial.println(line);
+    task.busyUs = 0;
+    task.runs = 0;
+    task.worstUs = 0;
+    task.overruns = 0;
+  }
+  schedulerWindowStart = now;
+}
@@ -0,0 +1,55 @@
+//Plain text commands typed into the USB serial monitor, one per line. Bytes that aren't part of a
+//UsbFrame are passed here by checkUsbTransfer(), so the backup client and typed commands share Serial.
+//Handlers get whatever follows the command word, "help" lists what is registered.
+
+#define SERIAL_COMMAND_LEN 64
+#define MAX_SERIAL_COMMANDS 8
+
+struct SerialCommand {
+  const char *name;
+  void (*handler)(const char *args);
+};
+
+SerialCommand serialCommands[MAX_SERIAL_COMMANDS];
+int serialCommandCount = 0;
+char serialLine[SERIAL_COMMAND_LEN];
+int serialLineLength = 0;
+
+bool addSerialCommand(const char *name, void (*handler)(const char *args)) {
+  if (serialCommandCount >= MAX_SERIAL_COMMANDS) return false;
+  serialCommands[serialCommandCount++] = { name, handler };
+  return true;
+}
+
+void runSerialCommand(char *line) {
+  char *args = strchr(line, ' ');
+  if (args) {
+    *args++ = '\0';
+    while (*args == ' ') args++;
+  } else {
+    args = line + strlen(line);
+  }
+  for (int i = 0; i < serialCommandCount; i++) {
+    if (strcmp(line, serialCommands[i].name) == 0) {
+      serialCommands[i].handler(args);
+      return;
+    }
+  }
+  Serial.print("Commands:");
+  for (int i = 0; i < serialCommandCount; i++) {
+    Serial.print(" ");
+    Serial.print(serialCommands[i].name);
+  }
+  Serial.println();
+}
+
+void serialCommandByte(uint8_t c) {
+  if (c == '\r' || c == '\n') {
+    if (serialLineLength == 0) return;
+    serialLine[serialLineLength] = '\0';
+    serialLineLength = 0;
+    runSerialCommand(serialLine);
+  } else if (c >= ' ' && c < 0x7F && serialLineLength < SERIAL_COMMAND_LEN - 1) {
+    serialLine[serialLineLength++] = c;
+  }
+}
@@ -1,14 +1,15 @@
 #include "SettingsService.h"
 #include <stdint.h>
+#include <stdio.h>
 #include <vector>
 
 // global settings buffer
 std::vector<settings::SettingsOption> settingsOptions;
 //CircularBuffer<settings::SettingsOption, SETTINGSOPTIONSNO>  settingsOptions;
 
-// currently selected settings option value index
+// currently selected settings option value
 int selectedSettingIndex = 0;
-int selectedSettingValueIndex = 0;
+int selectedSettingValue = 0;
 
 // Helpers
 
@@ -27,8 +28,48 @@ int prevSettingIndex() {
   return selectedSettingIndex - 1;
 }
 
+int clampValue(const settings::SettingsOption& option, int value) {
+  if (value < option.minimum) return option.minimum;
+  if (value > option.maximum) return option.maximum;
+  return value;
+}
+
 void refresh_current_value_index() {
-  selectedSettingValueIndex = settingsOptions[currentSettingIndex()].currentIndex();
+  const settings::SettingsOption& option = settingsOptions[currentSettingIndex()];
+  selectedSettingValue = clampValue(option, option.currentValue());
+}
+
+// Formats into one of a few rotating buffers so several values can be on screen at once
+const char* formatValue(const settings::SettingsOption& option, int value) {
+  static char buffers[4][12];
+  static int next = 0;
+  switch (option.type) {
+    case settings::ENUM:
+      return option.labels[value - option.minimum];
+    case settings::BOOL:
+      return option.labels[value ? 1 : 0];
+    case settings::RANGE:
+    default:
+      if (value == option.minimum && option.minLabel) return option.minLabel;
+      char* buffer = buffers[next];
+      next = (next + 1) % 4;
+      snprintf(buffer, sizeof(buffers[0]), "%d", value + option.displayOffset);
+      return buffer;
+  }
+}
+
+// Option builders
+
+settings::SettingsOption settings::rangeOption(const char* option, int minimum, int maximum, int step, int displayOffset, const char* minLabel, updater updateHandler, current currentValue) {
+  return SettingsOption{ option, RANGE, minimum, maximum, step, displayOffset, minLabel, nullptr, updateHandler, currentValue };
+}
+
+settings::SettingsOption settings::enumOption(const char* option, const char* const* labels, int count, updater updateHandler, current currentValue) {
+  return SettingsOption{ option, ENUM, 0, count - 1, 1, 0, nullptr, labels, updateHandler, currentValue };
+}
+
+settings::SettingsOption settings::boolOption(const char* option, const char* const* labels, updater updateHandler, current currentValue) {
+  return SettingsOption{ option, BOOL, 0, 1, 1, 0, nullptr, labels, updateHandler, currentValue };
 }
 
 // Add new option
@@ -63,28 +104,32 @@ const char* settings::next_setting() {
 // Values
 
 const char* settings::previous_setting_value() {
-  return settingsOptions[prevSettingIndex()].value[settingsOptions[prevSettingIndex()].currentIndex()];
+  const SettingsOption& option = settingsOptions[prevSettingIndex()];
+  return formatValue(option, clampValue(option, option.currentValue()));
 }
 const char* settings::next_setting_value() {
-  return settingsOptions[nextSettingIndex()].value[settingsOptions[nextSettingIndex()].currentIndex()];
+  const SettingsOption& option = settingsOptions[nextSettingIndex()];
+  return formatValue(option, clampValue(option, option.currentValue()));
 }
 
 const char* settings::current_setting_value() {
-  return settingsOptions[currentSettingIndex()].value[selectedSettingValueIndex];
+  return formatValue(settingsOptions[currentSettingIndex()], selectedSettingValue);
 }
 
 const char* settings::current_setting_previous_value() {
-  if (selectedSettingValueIndex == 0) {
+  const SettingsOption& option = settingsOptions[currentSettingIndex()];
+  if (selectedSettingValue - option.step < option.minimum) {
     return "";
   }
-  return settingsOptions[currentSettingIndex()].value[selectedSettingValueIndex - 1];
+  return formatValue(option, selectedSettingValue - option.step);
 }
 
 const char* settings::current_setting_next_value() {
-  if (settingsOptions[currentSettingIndex()].value[selectedSettingValueIndex + 1][0] == '\0') {
+  const SettingsOption& option = settingsOptions[currentSettingIndex()];
+  if (selectedSettingValue + option.step > option.maximum) {
     return "";
   }
-  return settingsOptions[currentSettingIndex()].value[selectedSettingValueIndex - 1];
+  return formatValue(option, selectedSettingValue + option.step);
 }
 
 // Change settings
@@ -102,19 +147,21 @@ void settings::decrement_setting() {
 // Change setting values
 
 void settings::increment_setting_value() {
-  if (settingsOptions[currentSettingIndex()].value[selectedSettingValueIndex + 1][0] == '\0') {
+  const SettingsOption& option = settingsOptions[currentSettingIndex()];
+  if (selectedSettingValue + option.step > option.maximum) {
     return;
   }
-  selectedSettingValueIndex++;
+  selectedSettingValue += option.step;
 }
 
 void settings::decrement_setting_value() {
-  if (selectedSettingValueIndex == 0) {
+  const SettingsOption& option = settingsOptions[currentSettingIndex()];
+  if (selectedSettingValue - option.step < option.minimum) {
     return;
   }
-  selectedSettingValueIndex--;
+  selectedSettingValue -= option.step;
 }
 
 void settings::save_current_value() {
-  settingsOptions[currentSettingIndex()].updateHandler(selectedSettingValueIndex, current_setting_value());
-}
\ No newline at end of file
+  settingsOptions[currentSettingIndex()].updateHandler(selectedSettingValue);
+}
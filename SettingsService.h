@@ -4,34 +4,52 @@
 // as part of the menu system. Callbacks are used to manage initializing and
 // setting values.
 //
+// Each option holds an integer value between minimum and maximum. How it is
+// shown depends on the type:
+// - RANGE  the number plus displayOffset, with minLabel optionally replacing
+//          the minimum (e.g. "All" for MIDI channel 0)
+// - ENUM   labels[value], value runs from 0 to the label count - 1
+// - BOOL   labels[0] for false, labels[1] for true
+// Labels are formatted on demand so options don't need value tables.
+//
 // Some features which are currently planned:
-// - Different types of SettingsOptions. Currently there is a single "Array"
-//   option. It would be nice to have a "text" input type which allowed for
-//   editing text instead of selecting a value.
+// - A "text" input type which allowed for editing text instead of selecting
+//   a value.
 // - Multiple menus. For example "settings" opens the current menu, the encoder
 //   opens the patch menu, holding the encoder opens the timbre menu.
 
 #pragma once
 
 #define SETTINGSOPTIONSNO 6//No of options
-#define SETTINGSVALUESNO 26//Maximum number of settings option values needed
 
 namespace settings {
 
-//Function to handle the values for this settings option
-typedef void (*updater)(int index, const char* value);
+enum OptionType { RANGE, ENUM, BOOL };
+
+//Function to handle the new value for this settings option
+typedef void (*updater)(int value);
 
-//Function to array index of current value for this settings option
-typedef int (*index)();
+//Function to return the current value for this settings option
+typedef int (*current)();
 
 struct SettingsOption
 {
   const char * option;//Settings option string
-  const char * value[SETTINGSVALUESNO];//Array of strings of settings option values
+  OptionType type;
+  int minimum;
+  int maximum;
+  int step;
+  int displayOffset;//RANGE only
+  const char * minLabel;//RANGE only, shown instead of the minimum if set
+  const char * const * labels;//ENUM and BOOL
   updater updateHandler;
-  index currentIndex;
+  current currentValue;
 };
 
+SettingsOption rangeOption(const char* option, int minimum, int maximum, int step, int displayOffset, const char* minLabel, updater updateHandler, current currentValue);
+SettingsOption enumOption(const char* option, const char* const* labels, int count, updater updateHandler, current currentValue);
+SettingsOption boolOption(const char* option, const char* const* labels, updater updateHandler, current currentValue);
+
 // setting names
 const char* current_setting();
 const char* previous_setting();
@@ -55,4 +73,4 @@ void save_current_value();
 void append(SettingsOption option);
 void reset();
 
-}
\ No newline at end of file
+}
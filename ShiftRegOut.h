@@ -0,0 +1,85 @@
+//74HC595 LED and control chain driven from a shadow image. Writes only touch the image and mark it
+//dirty, the chain is shifted out by the input scanner tick (InputScanner.h) when something changed,
+//so the 595 and 165 chains share one timer and loop() never shifts. Multi-bit fields such as the
+//filter type or LFO multiplier change in one step so the outputs never show a half written value.
+//The chain is on pins 6/7/8 which aren't hardware SPI pins on the Teensy 4.1, so it is bit banged.
+//Pin n is bit n%8 of register n/8, the last register is shifted first as with Rox74HC595.
+
+template<uint8_t REGISTERS>
+class ShiftRegOut {
+  public:
+    void begin(uint8_t data, uint8_t latch, uint8_t clk, int8_t pwm) {
+      dataPin = data;
+      latchPin = latch;
+      clkPin = clk;
+      pinMode(dataPin, OUTPUT);
+      pinMode(latchPin, OUTPUT);
+      pinMode(clkPin, OUTPUT);
+      if (pwm >= 0) {
+        pinMode(pwm, OUTPUT);
+        digitalWrite(pwm, LOW);  //Output enable, active low
+      }
+      started = true;
+      dirty = true;
+      flush();
+    }
+
+    void writePin(uint8_t pin, bool state) {
+      writeMasked(1ULL << pin, state ? 1ULL << pin : 0);
+    }
+
+    //Bits of value go to the given pins in order, bit 0 to pin0
+    void writeField(uint8_t pin0, uint8_t pin1, uint8_t value) {
+      writeMasked((1ULL << pin0) | (1ULL << pin1), fieldBit(pin0, value, 0) | fieldBit(pin1, value, 1));
+    }
+
+    void writeField(uint8_t pin0, uint8_t pin1, uint8_t pin2, uint8_t value) {
+      writeMasked((1ULL << pin0) | (1ULL << pin1) | (1ULL << pin2),
+                  fieldBit(pin0, value, 0) | fieldBit(pin1, value, 1) | fieldBit(pin2, value, 2));
+    }
+
+    void writeMasked(uint64_t mask, uint64_t bits) {
+      noInterrupts();
+      uint64_t next = (image & ~mask) | (bits & mask);
+      if (next != image) {
+        image = next;
+        dirty = true;
+      }
+      interrupts();
+    }
+
+    bool readPin(uint8_t pin) {
+      return image & (1ULL << pin);
+    }
+
+    //Shifts the image out if it changed, called from the scanner tick
+    void flush() {
+      if (!dirty || !started) return;
+      dirty = false;
+      uint64_t out = image;
+      for (int i = REGISTERS * 8 - 1; i >= 0; i--) {
+        digitalWriteFast(dataPin, (out >> i) & 1);
+        digitalWriteFast(clkPin, HIGH);
+        delayNanoseconds(50);
+        digitalWriteFast(clkPin, LOW);
+      }
+      digitalWriteFast(latchPin, HIGH);
+      delayNanoseconds(50);
+      digitalWriteFast(latchPin, LOW);
+      flushes++;
+    }
+
+    volatile uint32_t flushes = 0;
+
+  private:
+    static uint64_t fieldBit(uint8_t pin, uint8_t value, uint8_t bit) {
+      return (value >> bit) & 1 ? 1ULL << pin : 0;
+    }
+
+    volatile uint64_t image = 0;
+    volatile bool dirty = false;
+    bool started = false;
+    uint8_t dataPin = 0;
+    uint8_t latchPin = 0;
+    uint8_t clkPin = 0;
+};
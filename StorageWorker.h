@@ -0,0 +1,269 @@
+//SD card access runs on its own thread so MIDI and the S&H refresh keep going during saves and deletes.
+//The main loop updates the patch directory and RAM bank itself, then posts a request so the worker
+//only has to touch the card. Completions come back as events picked up by checkStorage(). The worker
+//never writes the directory or the bank: loads come back with the patch in the event, scans build a
+//directory of their own and send each patch they read, and applyStorageEvent() puts them in place.
+//Until startStorageWorker() is called requests run straight away, which is what setup() relies on.
+
+#include "TeensyThreads.h"
+
+#define STORAGE_LOAD 0     //Read a slot into the RAM bank
+#define STORAGE_SAVE 1     //Write a patch line to a slot
+#define STORAGE_DELETE 2   //Write the slot table after a delete
+#define STORAGE_SCAN 3     //Reload the directory and bank from the slot table
+#define STORAGE_REBUILD 4  //Rebuild the slot table from the patch files
+#define STORAGE_DUMP 5     //Write the flight recorder ring out
+#define STORAGE_RECORD 6   //Event only, a patch read by a scan
+
+#define STORAGE_QUEUE_SIZE 8
+#define STORAGE_STACK_SIZE 8192
+
+struct StorageRequest
+{
+  uint8_t op;
+  int patchNo;
+  uint16_t slot;
+  bool upper;  //Layer a load was asked for
+  char line[PATCH_LINE_LEN];
+};
+
+struct StorageEvent
+{
+  uint8_t op;
+  int patchNo;
+  bool upper;
+  bool ok;
+  uint16_t slot;
+  PatchRecord record;  //Loads and scanned patches
+};
+
+template <typename T, int SIZE>
+class StorageQueue
+{
+  public:
+    bool push(const T &item)
+    {
+      Threads::Scope scope(lock);
+      if (count == SIZE) return false;
+      items[(head + count) % SIZE] = item;
+      count++;
+      return true;
+    }
+
+    bool pop(T &item)
+    {
+      Threads::Scope scope(lock);
+      if (count == 0) return false;
+      item = items[head];
+      head = (head + 1) % SIZE;
+      count--;
+      return true;
+    }
+
+  private:
+    T items[SIZE];
+    int head = 0;
+    int count = 0;
+    Threads::Mutex lock;
+};
+
+StorageQueue<StorageRequest, STORAGE_QUEUE_SIZE> storageRequests;
+StorageQueue<StorageEvent, STORAGE_QUEUE_SIZE> storageEvents;
+
+//Slot table copy handed from the main loop to the worker
+Threads::Mutex slotTableLock;
+uint16_t pendingSlots[PATCHES_LIMIT];
+uint16_t pendingSlotCount = 0;
+bool slotTableDirty = false;
+
+PatchDirectory scanDirectory;  //Built by the worker during a scan, copied to patches when it's done
+
+volatile int storagePending = 0;  //Requests posted but not yet reported back
+volatile bool storageScanning = false;
+bool storageStarted = false;
+unsigned long maxLoopStall = 0;  //Longest loop() pass while requests were outstanding
+volatile uint32_t storageReads = 0;  //Patch files read from SD
+
+bool storageBusy() {
+  return storagePending > 0;
+}
+
+void queueSlotTable() {
+  Threads::Scope scope(slotTableLock);
+  pendingSlotCount = copySlotTable(pendingSlots);
+  slotTableDirty = true;
+}
+
+void writePendingSlotTable() {
+  static uint16_t slots[PATCHES_LIMIT];
+  uint16_t count;
+  {
+    Threads::Scope scope(slotTableLock);
+    if (!slotTableDirty) return;
+    count = pendingSlotCount;
+    memcpy(slots, pendingSlots, count * sizeof(uint16_t));
+    slotTableDirty = false;
+  }
+  writeSlotTable(slots, count);
+}
+
+//Main loop side of a finished request
+void applyStorageEvent(const StorageEvent &event) {
+  switch (event.op) {
+    case STORAGE_LOAD:
+      //A save of the slot since the load was posted has already put a newer copy in the bank
+      if (event.ok && !patchBankRecord(event.slot)) patchBankPut(event.slot, event.record);
+      break;
+    case STORAGE_RECORD:
+      patchBankPut(event.slot, event.record);  //No saves while scanning, so this is the card's copy
+      break;
+    case STORAGE_SCAN:
+    case STORAGE_REBUILD:
+      patches = scanDirectory;
+      storageScanning = false;
+      break;
+  }
+}
+
+//Each patch a scan reads goes back to the main loop as it's read
+void storageScanned(uint16_t slot, const PatchRecord &record) {
+  static StorageEvent event;
+  event.op = STORAGE_RECORD;
+  event.patchNo = 0;
+  event.ok = record.valid;
+  event.slot = slot;
+  event.record = record;
+  if (!storageStarted) {
+    applyStorageEvent(event);
+    return;
+  }
+  while (!storageEvents.push(event)) threads.yield();
+}
+
+void runStorageRequest(const StorageRequest &request, StorageEvent &event) {
+  event.op = request.op;
+  event.patchNo = request.patchNo;
+  event.upper = request.upper;
+  event.slot = request.slot;
+  event.ok = true;
+  if (request.op != STORAGE_DUMP) flightRecord(FLIGHT_SD_START, request.op, request.patchNo);
+  switch (request.op) {
+    case STORAGE_LOAD:
+      storageReads++;
+      event.ok = patchFileLoad(event.record, request.slot);
+      break;
+    case STORAGE_SAVE:
+      event.ok = savePatch(String(request.slot).c_str(), request.line);
+      break;
+    case STORAGE_DELETE:
+      break;
+    case STORAGE_SCAN:
+      loadPatches(scanDirectory, storageScanned);
+      break;
+    case STORAGE_REBUILD:
+      scanPatchFiles(scanDirectory, storageScanned);
+      break;
+    case STORAGE_DUMP:
+      event.ok = writeFlightDump();
+      break;
+  }
+  writePendingSlotTable();
+  if (request.op != STORAGE_DUMP) flightRecord(FLIGHT_SD_END, request.op, event.ok);
+}
+
+void storageThread() {
+  static StorageRequest request;
+  static StorageEvent event;
+  while (1) {
+    if (!storageRequests.pop(request)) {
+      threads.yield();
+      continue;
+    }
+    runStorageRequest(request, event);
+    while (!storageEvents.push(event)) threads.yield();
+  }
+}
+
+void postStorageRequest(uint8_t op, int patchNo, uint16_t slot, bool upper, const char *line) {
+  static StorageRequest request;
+  request.op = op;
+  request.patchNo = patchNo;
+  request.slot = slot;
+  request.upper = upper;
+  strncpy(request.line, line ? line : "", PATCH_LINE_LEN - 1);
+  request.line[PATCH_LINE_LEN - 1] = '\0';
+  if (!storageStarted) {
+    static StorageEvent event;
+    runStorageRequest(request, event);
+    applyStorageEvent(event);
+    return;
+  }
+  if (op == STORAGE_SCAN || op == STORAGE_REBUILD) storageScanning = true;
+  storagePending++;
+  while (!storageRequests.push(request)) threads.yield();  //Queue full, wait for the worker
+}
+
+void startStorageWorker() {
+  storageStarted = true;
+  threads.addThread(storageThread, 0, STORAGE_STACK_SIZE);
+}
+
+//Patch from the RAM bank. A slot that isn't cached is queued for loading and recalled when it arrives.
+PatchRecord *findPatch(int patchNo) {
+  if (storageScanning) return NULL;
+  int index = patches.indexOf(patchNo);
+  if (index < 0 || patches.at(index).slot == NO_SLOT) return NULL;
+  PatchRecord *record = patchBankRecord(patches.at(index).slot);
+  if (!record) postStorageRequest(STORAGE_LOAD, patchNo, patches.at(index).slot, upperSW, NULL);
+  return record;
+}
+
+//Save to the slot behind a patch number, giving new patches a slot and recording it in the table.
+//The RAM bank and directory name are updated here, the file is written in the background. A load of
+//the slot still queued finds the slot filled when it comes back and is dropped, see applyStorageEvent().
+//Refused while a rescan is running, the directory it brings back would replace the edit.
+bool savePatch(int patchNo, const char *patchData) {
+  if (storageScanning) return false;
+  int index = patches.indexOf(patchNo);
+  if (index < 0) return false;
+  PatchNoAndName &entry = patches.at(index);
+  if (entry.slot == NO_SLOT) {
+    entry.slot = allocateSlot();
+    if (entry.slot == NO_SLOT) return false;
+    queueSlotTable();
+  }
+  PatchRecord *record = patchBankStore(entry.slot, patchData);
+  if (record) patches.insert(patchNo, record->name);
+  postStorageRequest(STORAGE_SAVE, patchNo, entry.slot, upperSW, patchData);
+  return true;
+}
+
+//Remove a patch from the table. Its file stays on the card until the slot is reused. Refused while a
+//rescan is running, like savePatch().
+bool deletePatch(int patchNo) {
+  if (storageScanning) return false;
+  int index = patches.indexOf(patchNo);
+  if (index < 0) return false;
+  patches.removeAt(index);
+  patches.renumber();
+  queueSlotTable();
+  postStorageRequest(STORAGE_DELETE, patchNo, NO_SLOT, upperSW, NULL);
+  return true;
+}
+
+//Patch arriving from a dump. Existing numbers are overwritten, the number after the last patch adds one.
+bool storeIncomingPatch(int patchNo, const char *name, const int16_t values[]) {
+  static char line[PATCH_LINE_LEN];
+  if (storageScanning || patchNo < 1 || patchNo > patches.size() + 1 || patchNo > PATCHES_LIMIT) return false;
+  if (!formatPatchCsv(line, sizeof(line), name, values, PATCH_VALUES)) return false;
+  if (patchNo == patches.size() + 1) patches.insert(patchNo, name);
+  return savePatch(patchNo, line);
+}
+
+//Reload the directory and bank from the card, or rebuild the slot table from the patch files. Patches
+//stay where they are until the new directory is swapped in, false if a scan is already running.
+bool rescanPatches(bool rebuildTable) {
+  if (storageScanning) return false;
+  postStorageRequest(rebuildTable ? STORAGE_REBUILD : STORAGE_SCAN, 0, NO_SLOT, upperSW, NULL);
+  return true;
+}
@@ -0,0 +1,113 @@
+//USB serial bank transfer framing, shared by the synth and the host client in extras/usb_bank.
+//No Arduino dependencies. Frames can sit between ordinary Serial text, the parser skips anything
+//that isn't a frame and drops frames that fail the CRC.
+//
+//  A5 5A cmd len lo len hi payload crc32 (4 bytes LE, over cmd, len and payload)
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+#define USB_SYNC1 0xA5
+#define USB_SYNC2 0x5A
+#define USB_MAX_PAYLOAD 256
+#define USB_FRAME_OVERHEAD 9
+
+#define USB_HELLO 0x01         //-> USB_INFO
+#define USB_INFO 0x02          //version, patch count u16, settings size u16
+#define USB_GET_BANK 0x03      //-> USB_PATCH for every patch then USB_END
+#define USB_PATCH 0x04         //patch no u16, name, 73 int16 values. Sent to the synth to restore.
+#define USB_END 0x05           //patch count u16
+#define USB_GET_SETTINGS 0x06  //-> USB_SETTINGS
+#define USB_SETTINGS 0x07      //settings bytes, either way
+#define USB_ACK 0x08           //cmd acknowledged, u16 patch no or 0
+#define USB_NAK 0x09           //cmd refused, u16 patch no or 0
+
+#define USB_PROTOCOL_VERSION 1
+#define USB_NAME_LEN 20
+#define USB_PATCH_VALUES 73
+#define USB_PATCH_PAYLOAD (2 + USB_NAME_LEN + USB_PATCH_VALUES * 2)
+
+#define USB_FRAME_IDLE 0   //Byte wasn't part of a frame
+#define USB_FRAME_BUSY 1   //Byte taken into a frame
+#define USB_FRAME_READY 2  //A complete, checked frame is waiting
+
+inline void putU16(uint8_t *out, uint16_t value) {
+  out[0] = value & 0xFF;
+  out[1] = value >> 8;
+}
+
+inline uint16_t getU16(const uint8_t *in) {
+  return in[0] | (in[1] << 8);
+}
+
+inline uint32_t crc32(const uint8_t *data, size_t len, uint32_t crc = 0) {
+  crc = ~crc;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= data[i];
+    for (int b = 0; b < 8; b++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+  }
+  return ~crc;
+}
+
+inline size_t encodeUsbFrame(uint8_t cmd, const uint8_t *payload, uint16_t len, uint8_t *out) {
+  if (len > USB_MAX_PAYLOAD) return 0;
+  out[0] = USB_SYNC1;
+  out[1] = USB_SYNC2;
+  out[2] = cmd;
+  putU16(&out[3], len);
+  if (len) memcpy(&out[5], payload, len);
+  uint32_t crc = crc32(&out[2], 3 + len);
+  for (int i = 0; i < 4; i++) out[5 + len + i] = crc >> (8 * i);
+  return USB_FRAME_OVERHEAD + len;
+}
+
+class UsbFrameParser {
+  public:
+    int feed(uint8_t byte) {
+      switch (stage) {
+        case 0:
+          if (byte != USB_SYNC1) return USB_FRAME_IDLE;
+          stage = 1;
+          return USB_FRAME_BUSY;
+        case 1:
+          stage = byte == USB_SYNC2 ? 2 : 0;
+          return byte == USB_SYNC2 ? USB_FRAME_BUSY : USB_FRAME_IDLE;
+        default:
+          buffer[count++] = byte;
+          if (count == 3) {
+            length = getU16(&buffer[1]);
+            if (length > USB_MAX_PAYLOAD) {
+              errors++;
+              reset();
+            }
+          } else if (count == 3 + length + 4) {
+            uint32_t crc = 0;
+            for (int i = 0; i < 4; i++) crc |= (uint32_t)buffer[3 + length + i] << (8 * i);
+            bool ok = crc == crc32(buffer, 3 + length);
+            if (!ok) errors++;
+            reset();
+            return ok ? USB_FRAME_READY : USB_FRAME_BUSY;
+          }
+          return USB_FRAME_BUSY;
+      }
+    }
+
+    uint8_t cmd() const { return buffer[0]; }
+    const uint8_t *payload() const { return &buffer[3]; }
+    uint16_t payloadLength() const { return getU16(&buffer[1]); }
+    unsigned long crcErrors() const { return errors; }
+
+  private:
+    void reset() {
+      stage = 0;
+      count = 0;
+      length = 0;
+    }
+
+    uint8_t buffer[3 + USB_MAX_PAYLOAD + 4];
+    int stage = 0;
+    int count = 0;
+    int length = 0;
+    unsigned long errors = 0;
+};
@@ -0,0 +1,112 @@
+//Whole bank and settings backup and restore over USB serial, driven by the host client in extras/usb_bank.
+//Frames share Serial with the debug prints, see UsbFrame.h. Bank dumps stream from loop() as fast as
+//the USB buffer takes them, restores are acknowledged patch by patch.
+
+#include "UsbFrame.h"
+#include "SerialCommands.h"
+
+UsbFrameParser usbParser;
+bool usbDumpActive = false;
+int usbDumpNext = 0;
+
+void sendUsbFrame(uint8_t cmd, const uint8_t *payload, uint16_t len) {
+  static uint8_t frame[USB_MAX_PAYLOAD + USB_FRAME_OVERHEAD];
+  size_t n = encodeUsbFrame(cmd, payload, len, frame);
+  Serial.write(frame, n);
+}
+
+void sendUsbReply(uint8_t cmd, uint8_t ackCmd, uint16_t value) {
+  uint8_t payload[3] = { ackCmd };
+  putU16(&payload[1], value);
+  sendUsbFrame(cmd, payload, sizeof(payload));
+}
+
+void sendUsbPatch(int patchNo, const PatchRecord &record) {
+  uint8_t payload[USB_PATCH_PAYLOAD];
+  putU16(payload, patchNo);
+  memcpy(&payload[2], record.name, USB_NAME_LEN);
+  for (int i = 1; i < PATCH_VALUES; i++) putU16(&payload[2 + USB_NAME_LEN + (i - 1) * 2], record.values[i]);
+  sendUsbFrame(USB_PATCH, payload, sizeof(payload));
+}
+
+void receiveUsbPatch(const uint8_t *payload, uint16_t len) {
+  int patchNo = len == USB_PATCH_PAYLOAD ? getU16(payload) : 0;
+  char name[PATCH_NAME_LEN];
+  int16_t values[PATCH_VALUES];
+  memcpy(name, &payload[2], PATCH_NAME_LEN);
+  name[PATCH_NAME_LEN - 1] = '\0';
+  values[0] = 0;
+  for (int i = 1; i < PATCH_VALUES; i++) values[i] = (int16_t)getU16(&payload[2 + USB_NAME_LEN + (i - 1) * 2]);
+  if (patchNo > 0 && storeIncomingPatch(patchNo, name, values)) {
+    sendUsbReply(USB_ACK, USB_PATCH, patchNo);
+  } else {
+    sendUsbReply(USB_NAK, USB_PATCH, patchNo);
+  }
+}
+
+void handleUsbFrame() {
+  const uint8_t *payload = usbParser.payload();
+  uint16_t len = usbParser.payloadLength();
+  switch (usbParser.cmd()) {
+    case USB_HELLO:
+      {
+        uint8_t info[5] = { USB_PROTOCOL_VERSION };
+        putU16(&info[1], patches.size());
+        putU16(&info[3], 1 + sizeof(SettingsRecord));
+        sendUsbFrame(USB_INFO, info, sizeof(info));
+      }
+      break;
+    case USB_GET_BANK:
+      usbDumpActive = true;
+      usbDumpNext = 0;
+      break;
+    case USB_PATCH:
+      receiveUsbPatch(payload, len);
+      break;
+    case USB_GET_SETTINGS:
+      {
+        uint8_t blob[1 + sizeof(SettingsRecord)] = { SETTINGS_VERSION };
+        memcpy(&blob[1], &settingsRecord, sizeof(SettingsRecord));
+        sendUsbFrame(USB_SETTINGS, blob, sizeof(blob));
+      }
+      break;
+    case USB_SETTINGS:
+      //Takes effect from the next power up, so write it straight away rather than waiting for the quiet period
+      if (len == 1 + sizeof(SettingsRecord) && payload[0] == SETTINGS_VERSION) {
+        memcpy(&settingsRecord, &payload[1], sizeof(SettingsRecord));
+        markSettingsDirty();
+        flushSettings(true);
+        sendUsbReply(USB_ACK, USB_SETTINGS, 0);
+      } else {
+        sendUsbReply(USB_NAK, USB_SETTINGS, 0);
+      }
+      break;
+  }
+}
+
+void checkUsbTransfer() {
+  while (Serial.available()) {
+    uint8_t c = Serial.read();
+    switch (usbParser.feed(c)) {
+      case USB_FRAME_READY:
+        handleUsbFrame();
+        break;
+      case USB_FRAME_IDLE:
+        serialCommandByte(c);  //Not a frame, typed text
+        break;
+    }
+  }
+  //Stream the bank without blocking, only as much as the USB buffer has room for, not during a rescan
+  while (usbDumpActive && !storageScanning && Serial.availableForWrite() >= USB_PATCH_PAYLOAD + USB_FRAME_OVERHEAD) {
+    if (usbDumpNext >= patches.size()) {
+      uint8_t end[2];
+      putU16(end, patches.size());
+      sendUsbFrame(USB_END, end, sizeof(end));
+      usbDumpActive = false;
+      break;
+    }
+    PatchNoAndName &entry = patches.at(usbDumpNext++);
+    PatchRecord *record = patchBankRecord(entry.slot);
+    if (record) sendUsbPatch(entry.patchNo, *record);
+  }
+}
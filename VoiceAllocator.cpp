@@ -0,0 +1,59 @@
+#include "VoiceAllocator.h"
+
+int oldestVoice(const VoiceAndNote *voices, int count, long now) {
+  int voice = -1;
+  long earliest = now;
+  for (int i = 0; i < count; i++) {
+    if (voices[i].note == -1 && voices[i].timeOn < earliest) {
+      earliest = voices[i].timeOn;
+      voice = i;
+    }
+  }
+  if (voice == -1) {
+    //No free voices, need to steal oldest sounding voice
+    earliest = now;
+    for (int i = 0; i < count; i++) {
+      if (voices[i].timeOn < earliest) {
+        earliest = voices[i].timeOn;
+        voice = i;
+      }
+    }
+  }
+  return voice + 1;
+}
+
+int nextFreeVoice(const VoiceAndNote *voices, int count, int lastUsed) {
+  if (voices[lastUsed].note == -1) return lastUsed + 1;
+  for (int i = 0; i < count; i++) {
+    if (voices[i].note == -1) return i + 1;
+  }
+  int oldest = 0;
+  for (int i = 1; i < count; i++) {
+    if (voices[i].timeOn < voices[oldest].timeOn) oldest = i;
+  }
+  return oldest + 1;
+}
+
+int voiceForNote(const VoiceAndNote *voices, int count, int note) {
+  for (int i = 0; i < count; i++) {
+    if (voices[i].note == note) return i + 1;
+  }
+  return 1;
+}
+
+int polyNoteOn(VoiceAndNote *voices, int count, int mode, int lastUsed, int note, int velocity, long now) {
+  int voice = mode == 0 ? oldestVoice(voices, count, now) : nextFreeVoice(voices, count, lastUsed);
+  if (voice < 1) return 0;
+  VoiceAndNote &v = voices[voice - 1];
+  v.note = note;
+  v.velocity = velocity;
+  v.timeOn = now;
+  return voice;
+}
+
+int polyNoteOff(VoiceAndNote *voices, int count, int note, int &released) {
+  int voice = voiceForNote(voices, count, note);
+  released = voices[voice - 1].note;
+  voices[voice - 1].note = -1;
+  return voice;
+}
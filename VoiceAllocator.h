@@ -0,0 +1,33 @@
+//Voice allocation for the poly modes, no Arduino so it can be run on a PC. Voice numbers are 1 based
+//like the MIDI6 channels the voices listen on. A voice with note -1 is free.
+
+#pragma once
+
+struct VoiceAndNote {
+  int note;
+  int velocity;
+  long timeOn;
+  bool sustained;  // Sustain flag
+  bool keyDown;
+  double noteFreq;  // Note frequency
+  int position;
+  bool noteOn;
+};
+
+//Free voice that was started longest ago (it may still be releasing), otherwise steal the oldest.
+//0 if every voice started at now.
+int oldestVoice(const VoiceAndNote *voices, int count, long now);
+
+//lastUsed if it is free, then the lowest free voice, otherwise steal the oldest
+int nextFreeVoice(const VoiceAndNote *voices, int count, int lastUsed);
+
+//Voice playing note, 1 if none is
+int voiceForNote(const VoiceAndNote *voices, int count, int note);
+
+//Note on in keyboard modes 0 and 1, the oldest voice or the next free one after lastUsed. Fills the
+//voice in and returns it, 0 if mode 0 found none.
+int polyNoteOn(VoiceAndNote *voices, int count, int mode, int lastUsed, int note, int velocity, long now);
+
+//Note off in keyboard modes 0 and 1. Frees the voice playing note and returns it, released is the note
+//it had for the MIDI6 note off.
+int polyNoteOff(VoiceAndNote *voices, int count, int note, int &released);
@@ -0,0 +1,132 @@
+//I2C link to the voice board at address 8.
+//Keeps a shadow of the values the board already holds for each layer, through hal.i2c, the i2c_driver
+//asynchronous master on the Teensy, so loop() keeps going while the bytes go out. A push that changes
+//nothing isn't sent. With VOICE_I2C_DELTA only the runs that changed are sent, which needs voice board
+//firmware that takes delta frames, otherwise every push is a full frame as the boards in the field expect.
+//
+//Full frame:  76 big endian words, word 0 is the layer flag (1 upper, 0 lower) as before.
+//Delta frame: 0x80 | layer, then runs of start index, count and count big endian words.
+
+#include "Hal.h"
+
+#define VOICE_I2C_ADDRESS 8
+#define VOICE_PARAMS 76
+#define VOICE_FULL_FRAME (VOICE_PARAMS * 2)
+#define VOICE_DELTA_FLAG 0x80
+#define VOICE_RUN_GAP 2  //Unchanged values worth sending to avoid starting a new run
+#define VOICE_RETRIES 3  //Full frames after a failed transfer before waiting for the next push
+
+struct VoiceShadow {
+  int values[VOICE_PARAMS];
+  bool valid;
+};
+
+VoiceShadow voiceShadow[2];        //Index by layer flag
+uint8_t voiceFrame[VOICE_FULL_FRAME];  //Must stay untouched until the transfer finishes
+bool voicePushPending[2] = { false, false };
+int voiceSendingLayer = -1;
+int voiceRetries[2] = { 0, 0 };
+unsigned long voiceFullFrames = 0;
+unsigned long voiceDeltaFrames = 0;
+
+int *voiceLayerData(int layer) {
+  return layer ? upperData : lowerData;
+}
+
+void putVoiceWord(uint8_t *out, int value) {
+  out[0] = (uint8_t)(value >> 8);
+  out[1] = (uint8_t)(value & 0xFF);
+}
+
+size_t buildFullFrame(const int *data) {
+  for (int i = 0; i < VOICE_PARAMS; i++) putVoiceWord(&voiceFrame[i * 2], data[i]);
+  return VOICE_FULL_FRAME;
+}
+
+#ifdef VOICE_I2C_DELTA
+//Returns 0 if nothing changed, or the frame size. Falls back to a full frame when that is no bigger.
+size_t buildDeltaFrame(int layer, const int *data) {
+  const int *shadow = voiceShadow[layer].values;
+  size_t n = 1;
+  voiceFrame[0] = VOICE_DELTA_FLAG | layer;
+  int i = 0;
+  while (i < VOICE_PARAMS) {
+    if (data[i] == shadow[i]) {
+      i++;
+      continue;
+    }
+    //Extend the run over changed values and short gaps
+    int start = i;
+    int end = i;
+    for (int j = i + 1; j < VOICE_PARAMS && j <= end + VOICE_RUN_GAP + 1; j++) {
+      if (data[j] != shadow[j]) end = j;
+    }
+    int count = end - start + 1;
+    if (n + 2 + count * 2 >= VOICE_FULL_FRAME) return buildFullFrame(data);
+    voiceFrame[n++] = start;
+    voiceFrame[n++] = count;
+    for (int k = start; k <= end; k++, n += 2) putVoiceWord(&voiceFrame[n], data[k]);
+    i = end + 1;
+  }
+  return n > 1 ? n : 0;
+}
+#endif
+
+void startVoicePush(int layer) {
+  const int *data = voiceLayerData(layer);
+  size_t size;
+#ifdef VOICE_I2C_DELTA
+  if (voiceShadow[layer].valid) {
+    size = buildDeltaFrame(layer, data);
+  } else {
+    size = buildFullFrame(data);
+  }
+#else
+  if (voiceShadow[layer].valid && memcmp(voiceShadow[layer].values, data, sizeof(voiceShadow[layer].values)) == 0) {
+    size = 0;
+  } else {
+    size = buildFullFrame(data);
+  }
+#endif
+  voicePushPending[layer] = false;
+  if (size == 0) return;
+  if (size == VOICE_FULL_FRAME) {
+    voiceFullFrames++;
+  } else {
+    voiceDeltaFrames++;
+  }
+  //Shadow follows what was sent, a failed transfer invalidates it again in checkVoiceI2C()
+  memcpy(voiceShadow[layer].values, data, sizeof(voiceShadow[layer].values));
+  voiceShadow[layer].valid = true;
+  voiceSendingLayer = layer;
+  hal.i2c->writeAsync(VOICE_I2C_ADDRESS, voiceFrame, size);
+}
+
+//Queue the layer, it goes out now if the bus is free or from checkVoiceI2C() when it is
+void pushVoiceLayer(int layer) {
+  voicePushPending[layer] = true;
+  voiceRetries[layer] = 0;
+  if (voiceSendingLayer < 0) startVoicePush(layer);
+}
+
+void invalidateVoiceShadow() {
+  voiceShadow[0].valid = false;
+  voiceShadow[1].valid = false;
+}
+
+void checkVoiceI2C() {
+  if (voiceSendingLayer >= 0) {
+    if (!hal.i2c->finished()) return;
+    //The board may have taken none, some or all of it, so the layer goes again as a full frame
+    if (hal.i2c->failed()) {
+      voiceShadow[voiceSendingLayer].valid = false;
+      if (voiceRetries[voiceSendingLayer]++ < VOICE_RETRIES) voicePushPending[voiceSendingLayer] = true;
+    }
+    voiceSendingLayer = -1;
+  }
+  if (voicePushPending[1]) {
+    startVoicePush(1);
+  } else if (voicePushPending[0]) {
+    startVoicePush(0);
+  }
+}
@@ -0,0 +1,156 @@
+//Framed binary parameter link to the voice boards on Serial6, enabled with VOICE_LINK_BINARY.
+//Carries 16 bit control and patch values with a sequence number and CRC. The voice board acknowledges
+//each frame, anything not acknowledged in VOICE_LINK_TIMEOUT is resent up to VOICE_LINK_RETRIES times.
+//A new value for a parameter replaces any frame for it still waiting on an acknowledgement, so a resend
+//can never put an older value back after a newer one. Sends through hal, extras/voice_link runs it on a PC.
+
+#include "Hal.h"
+#include "VoiceLinkFrame.h"
+
+#include <stdio.h>
+
+#define VOICE_LINK_BAUD 1000000
+#define VOICE_LINK_WINDOW 16  //A layer recall with a pot moving fits, extras/voice_link overflowed 8
+#define VOICE_LINK_TIMEOUT 20  //ms
+#define VOICE_LINK_RETRIES 3
+
+struct VoiceLinkPending {
+  bool used;
+  uint8_t seq;
+  uint8_t retries;
+  uint32_t key;  //What the frame sets, 0 for frames nothing replaces
+  unsigned long sentAt;
+  uint8_t size;
+  uint8_t sysex[VLINK_MAX_SYSEX];
+};
+
+struct VoiceLinkStats {
+  unsigned long sent;
+  unsigned long acked;
+  unsigned long resent;
+  unsigned long superseded;  //Replaced by a newer value before being acknowledged
+  unsigned long overflowed;  //Given up unacknowledged to make room in a full window
+  unsigned long dropped;     //Not acknowledged after every retry
+  unsigned long badFrames;
+  unsigned long bytes;
+};
+
+VoiceLinkPending voiceLinkWindow[VOICE_LINK_WINDOW];
+VoiceLinkStats voiceLinkStats;
+uint8_t voiceLinkSeq = 0;
+bool voiceLinkActive = false;
+uint8_t voiceLinkTxBuffer[512];  //Added to Serial6 in setup()
+
+void voiceLinkBegin() {
+  voiceLinkActive = true;
+}
+
+//A parameter frame sets space, channel and param, a batch the same run of a layer each time
+uint32_t voiceLinkKey(uint8_t type, const uint8_t *payload, size_t len) {
+  if (type == VLINK_PARAM && len >= 3) return 1UL << 24 | (uint32_t)payload[0] << 16 | payload[1] << 8 | payload[2];
+  if (type == VLINK_BATCH && len >= 4) return 2UL << 24 | (uint32_t)payload[0] << 16 | payload[1] << 8 | payload[3];
+  return 0;
+}
+
+void voiceLinkSend(uint8_t type, const uint8_t *payload, size_t len) {
+  uint32_t key = voiceLinkKey(type, payload, len);
+  for (int i = 0; key && i < VOICE_LINK_WINDOW; i++) {
+    if (voiceLinkWindow[i].used && voiceLinkWindow[i].key == key) {
+      voiceLinkWindow[i].used = false;
+      voiceLinkStats.superseded++;
+    }
+  }
+  //Use a free window slot, or give up on the oldest unacknowledged frame
+  int slot = 0;
+  for (int i = 0; i < VOICE_LINK_WINDOW; i++) {
+    if (!voiceLinkWindow[i].used) {
+      slot = i;
+      break;
+    }
+    if (voiceLinkWindow[i].sentAt < voiceLinkWindow[slot].sentAt) slot = i;
+  }
+  VoiceLinkPending &pending = voiceLinkWindow[slot];
+  if (pending.used) voiceLinkStats.overflowed++;
+  pending.seq = voiceLinkSeq++;
+  pending.size = encodeVoiceFrame(pending.seq, type, payload, len, pending.sysex);
+  if (pending.size == 0) {
+    pending.used = false;
+    return;
+  }
+  pending.used = true;
+  pending.retries = 0;
+  pending.key = key;
+  pending.sentAt = hal.clock->millis();
+  hal.midiVoices->send(pending.sysex, pending.size);
+  voiceLinkStats.sent++;
+  voiceLinkStats.bytes += pending.size;
+}
+
+void voiceLinkSendParam(uint8_t space, uint8_t channel, uint8_t param, int value) {
+  uint8_t payload[5] = { space, channel, param, (uint8_t)(value >> 8), (uint8_t)(value & 0xFF) };
+  voiceLinkSend(VLINK_PARAM, payload, sizeof(payload));
+}
+
+//A whole layer as batches of patch parameters
+void voiceLinkSendLayer(uint8_t channel, const int *data, int count) {
+  uint8_t payload[VLINK_MAX_PAYLOAD];
+  for (int start = 0; start < count; start += VLINK_BATCH_PARAMS) {
+    int batch = count - start < VLINK_BATCH_PARAMS ? count - start : VLINK_BATCH_PARAMS;
+    size_t n = 0;
+    payload[n++] = VLINK_SPACE_PATCH;
+    payload[n++] = channel;
+    payload[n++] = batch;
+    for (int i = start; i < start + batch; i++) {
+      payload[n++] = i;
+      payload[n++] = data[i] >> 8;
+      payload[n++] = data[i] & 0xFF;
+    }
+    voiceLinkSend(VLINK_BATCH, payload, n);
+  }
+}
+
+//SysEx handler for MIDI6, picks up acknowledgements from the voice boards
+void voiceLinkSysEx(uint8_t *array, unsigned size) {
+  uint8_t seq;
+  uint8_t type;
+  uint8_t payload[VLINK_MAX_PAYLOAD];
+  size_t len;
+  if (!decodeVoiceFrame(array, size, seq, type, payload, len)) {
+    voiceLinkStats.badFrames++;
+    return;
+  }
+  if (type != VLINK_ACK || len < 1) return;
+  for (int i = 0; i < VOICE_LINK_WINDOW; i++) {
+    if (voiceLinkWindow[i].used && voiceLinkWindow[i].seq == payload[0]) {
+      voiceLinkWindow[i].used = false;
+      voiceLinkStats.acked++;
+    }
+  }
+}
+
+void checkVoiceLink() {
+  if (!voiceLinkActive) return;
+  unsigned long now = hal.clock->millis();
+  for (int i = 0; i < VOICE_LINK_WINDOW; i++) {
+    VoiceLinkPending &pending = voiceLinkWindow[i];
+    if (!pending.used || now - pending.sentAt < VOICE_LINK_TIMEOUT) continue;
+    if (pending.retries == VOICE_LINK_RETRIES) {
+      pending.used = false;
+      voiceLinkStats.dropped++;
+      continue;
+    }
+    pending.retries++;
+    pending.sentAt = now;
+    hal.midiVoices->send(pending.sysex, pending.size);
+    voiceLinkStats.resent++;
+    voiceLinkStats.bytes += pending.size;
+  }
+}
+
+void voiceLinkReport(void (*print)(const char *line)) {
+  char line[160];
+  snprintf(line, sizeof(line), "Voice link sent %lu acked %lu resent %lu superseded %lu overflowed %lu dropped %lu bad %lu bytes %lu",
+           voiceLinkStats.sent, voiceLinkStats.acked, voiceLinkStats.resent, voiceLinkStats.superseded, voiceLinkStats.overflowed,
+           voiceLinkStats.dropped, voiceLinkStats.badFrames, voiceLinkStats.bytes);
+  print(line);
+}
@@ -0,0 +1,90 @@
+//Voice board link framing, no Arduino dependencies so it can be exercised on a PC.
+//A frame is seq, type, payload length, payload and CRC-16/CCITT, packed 8 to 7 bits and sent as
+//SysEx (F0 7D ... F7) so it can share the MIDI stream to the voice boards with notes.
+
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#define VLINK_SYSEX_ID 0x7D  //Non-commercial ID, frames never leave the synth
+#define VLINK_PARAM 1        //space, channel, param, value hi, value lo
+#define VLINK_BATCH 2        //space, channel, count, then param, value hi, value lo for each
+#define VLINK_ACK 3          //seq of the frame being acknowledged
+
+#define VLINK_SPACE_CONTROL 0  //WS control numbers
+#define VLINK_SPACE_PATCH 1    //P_ patch parameter indexes
+
+#define VLINK_MAX_PAYLOAD 64
+#define VLINK_BATCH_PARAMS 20  //3 byte header plus 3 bytes per parameter fits the payload
+#define VLINK_MAX_RAW (3 + VLINK_MAX_PAYLOAD + 2)
+#define VLINK_MAX_SYSEX (3 + (VLINK_MAX_RAW * 8 + 6) / 7)
+
+inline uint16_t crc16(const uint8_t *data, size_t len) {
+  uint16_t crc = 0xFFFF;
+  for (size_t i = 0; i < len; i++) {
+    crc ^= (uint16_t)data[i] << 8;
+    for (int b = 0; b < 8; b++) crc = (crc & 0x8000) ? (crc << 1) ^ 0x1021 : crc << 1;
+  }
+  return crc;
+}
+
+//Groups of 7 bytes become a byte of their top bits followed by the 7 low parts
+inline size_t pack7(const uint8_t *in, size_t len, uint8_t *out) {
+  size_t n = 0;
+  for (size_t i = 0; i < len; i += 7) {
+    size_t msbIndex = n++;
+    out[msbIndex] = 0;
+    for (size_t j = 0; j < 7 && i + j < len; j++) {
+      out[msbIndex] |= (in[i + j] >> 7) << j;
+      out[n++] = in[i + j] & 0x7F;
+    }
+  }
+  return n;
+}
+
+inline size_t unpack7(const uint8_t *in, size_t len, uint8_t *out) {
+  size_t n = 0;
+  for (size_t i = 0; i < len; i += 8) {
+    uint8_t msbs = in[i];
+    for (size_t j = 0; j < 7 && i + 1 + j < len; j++) {
+      out[n++] = in[i + 1 + j] | (((msbs >> j) & 1) << 7);
+    }
+  }
+  return n;
+}
+
+//Returns the SysEx length written to out, 0 if the payload is too big
+inline size_t encodeVoiceFrame(uint8_t seq, uint8_t type, const uint8_t *payload, size_t len, uint8_t *out) {
+  if (len > VLINK_MAX_PAYLOAD) return 0;
+  uint8_t raw[VLINK_MAX_RAW];
+  raw[0] = seq;
+  raw[1] = type;
+  raw[2] = len;
+  for (size_t i = 0; i < len; i++) raw[3 + i] = payload[i];
+  uint16_t crc = crc16(raw, 3 + len);
+  raw[3 + len] = crc >> 8;
+  raw[4 + len] = crc & 0xFF;
+  out[0] = 0xF0;
+  out[1] = VLINK_SYSEX_ID;
+  size_t n = 2 + pack7(raw, 5 + len, &out[2]);
+  out[n++] = 0xF7;
+  return n;
+}
+
+//False if it isn't one of our frames or the CRC doesn't match
+inline bool decodeVoiceFrame(const uint8_t *sysex, size_t len, uint8_t &seq, uint8_t &type, uint8_t *payload, size_t &payloadLen) {
+  if (len < 4 || sysex[0] != 0xF0 || sysex[1] != VLINK_SYSEX_ID || sysex[len - 1] != 0xF7) return false;
+  if (len - 3 > (VLINK_MAX_RAW * 8 + 6) / 7) return false;
+  uint8_t raw[VLINK_MAX_RAW + 7];
+  size_t n = unpack7(&sysex[2], len - 3, raw);
+  if (n < 5 || raw[2] > VLINK_MAX_PAYLOAD || n < (size_t)raw[2] + 5) return false;
+  size_t dataLen = raw[2];
+  uint16_t crc = (raw[3 + dataLen] << 8) | raw[4 + dataLen];
+  if (crc != crc16(raw, 3 + dataLen)) return false;
+  seq = raw[0];
+  type = raw[1];
+  for (size_t i = 0; i < dataLen; i++) payload[i] = raw[3 + i];
+  payloadLen = dataLen;
+  return true;
+}
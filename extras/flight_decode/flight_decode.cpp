@@ -0,0 +1,141 @@
+/*
+  Decoder for the flight recorder dumps (FlightRecorder.h on the synth).
+
+  Build:  g++ -O2 -std=c++11 -o flight_decode flight_decode.cpp
+  Usage:  flight_decode FLIGHT00.BIN
+
+  Prints one line per event, times in ms relative to the trigger, with the gap since the previous event.
+  Notes that reached the voices later than the synth's FLIGHT_LATENCY_US are marked, followed by a
+  summary of note latency and the tasks that ran over budget. Task names come from the dump, version 1
+  dumps didn't carry them and get the default build's task table.
+*/
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define HEADER_SIZE 20
+#define TASK_NAME_LEN 12
+#define LATENCY_US 5000
+
+static const char *const STORAGE_OPS[] = { "load", "save", "delete", "scan", "rebuild", "dump" };
+//Version 1 dumps only, task numbers are positions in the default build's scheduler table
+static const char *const TASKS_V1[] = { "midi", "voices", "demux", "mux", "mod", "panel", "lfo delay", "clock",
+                                        "storage", "transfers", "eeprom", "flight", "report" };
+
+static uint16_t getU16(const uint8_t *p) {
+  return p[0] | p[1] << 8;
+}
+
+static uint32_t getU32(const uint8_t *p) {
+  return p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24;
+}
+
+static const char *lookup(const char *const names[], size_t count, unsigned index) {
+  return index < count ? names[index] : "?";
+}
+
+static const char *taskName(const std::vector<std::string> &tasks, unsigned index) {
+  return index < tasks.size() ? tasks[index].c_str() : "?";
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: flight_decode <file>\n");
+    return 1;
+  }
+  FILE *f = fopen(argv[1], "rb");
+  if (!f) {
+    perror(argv[1]);
+    return 1;
+  }
+  std::vector<uint8_t> data;
+  uint8_t buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) data.insert(data.end(), buffer, buffer + n);
+  fclose(f);
+
+  if (data.size() < HEADER_SIZE || data[0] != 'F' || data[1] != 'L' || data[2] != 'T' || data[3] != '1') {
+    fprintf(stderr, "%s: not a flight recorder dump\n", argv[1]);
+    return 1;
+  }
+  unsigned version = data[4], eventSize = data[5], count = getU16(&data[6]);
+  uint32_t triggerTime = getU32(&data[8]);
+  unsigned reason = data[12];
+  unsigned taskCount = version >= 2 ? data[13] : 0;
+  uint32_t dropped = getU32(&data[16]);
+  size_t events = HEADER_SIZE + (size_t)taskCount * TASK_NAME_LEN;
+  if (version < 1 || version > 2 || eventSize != 8 || data.size() < events + (size_t)count * eventSize) {
+    fprintf(stderr, "%s: version %u, event size %u, %u events doesn't match the file\n", argv[1], version, eventSize, count);
+    return 1;
+  }
+  std::vector<std::string> tasks;
+  if (version == 1) {
+    tasks.assign(TASKS_V1, TASKS_V1 + sizeof(TASKS_V1) / sizeof(TASKS_V1[0]));
+  } else {
+    for (unsigned i = 0; i < taskCount; i++) {
+      const char *name = (const char *)&data[HEADER_SIZE + i * TASK_NAME_LEN];
+      tasks.push_back(std::string(name, strnlen(name, TASK_NAME_LEN)));
+    }
+  }
+  printf("%u events, trigger %s, %lu dropped\n", count, reason == 0 ? "user" : "latency", (unsigned long)dropped);
+
+  unsigned notes = 0, late = 0, worst = 0;
+  std::vector<unsigned> overruns(tasks.size() + 1);  //Last one for unknown task numbers
+  uint32_t previous = 0;
+  for (unsigned i = 0; i < count; i++) {
+    const uint8_t *e = &data[events + i * eventSize];
+    uint32_t time = getU32(e);
+    unsigned type = e[4], a = e[5], value = getU16(&e[6]);
+    //Times are micros() on the synth, the differences stay right across a wrap
+    double ms = (int32_t)(time - triggerTime) / 1000.0;
+    double gap = i ? (time - previous) / 1000.0 : 0;
+    previous = time;
+    printf("%10.3f %+9.3f  ", ms, gap);
+    switch (type) {
+      case 1:
+      case 2:
+        printf("%-9s ch %2u note %3u vel %3u\n", type == 1 ? "note on" : "note off", value >> 8, a, value & 0xFF);
+        break;
+      case 3:
+        if (value) printf("voice     note %3u voice %u\n", a, value);
+        else printf("voice     note %3u no voice\n", a);
+        break;
+      case 4:
+        printf("sent      note %3u %6u us%s\n", a, value, value > LATENCY_US ? "  LATE" : "");
+        notes++;
+        if (value > LATENCY_US) late++;
+        if (value > worst) worst = value;
+        break;
+      case 5:
+        printf("overrun   %-10s %6u us\n", taskName(tasks, a), value);
+        overruns[a < tasks.size() ? a : tasks.size()]++;
+        break;
+      case 9:
+        printf("overrun   %-10s %6u more not recorded\n", taskName(tasks, a), value);
+        overruns[a < tasks.size() ? a : tasks.size()] += value;
+        break;
+      case 6:
+        printf("sd start  %-8s patch %u\n", lookup(STORAGE_OPS, sizeof(STORAGE_OPS) / sizeof(STORAGE_OPS[0]), a), value);
+        break;
+      case 7:
+        printf("sd end    %-8s %s\n", lookup(STORAGE_OPS, sizeof(STORAGE_OPS) / sizeof(STORAGE_OPS[0]), a), value ? "ok" : "failed");
+        break;
+      case 8:
+        if (a == 1) printf("TRIGGER   latency %u us\n", value);
+        else printf("TRIGGER   user\n");
+        break;
+      default:
+        printf("unknown type %u\n", type);
+        break;
+    }
+  }
+
+  printf("\n%u notes sent, %u over %u us, worst %u us\n", notes, late, LATENCY_US, worst);
+  for (size_t i = 0; i < overruns.size(); i++) {
+    if (overruns[i]) printf("%-10s %u overruns\n", taskName(tasks, i), overruns[i]);
+  }
+  return 0;
+}
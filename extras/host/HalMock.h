@@ -0,0 +1,143 @@
+/*
+  Host backends for Hal.h, for building the controller logic on a PC.
+
+  The clock only moves when advance() is called, outputs are kept in vectors so a run can be checked
+  or measured afterwards. Include this once, it defines the hal instance.
+*/
+
+#pragma once
+
+#include "../../Hal.h"
+
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+class MockClock : public HalClock {
+  public:
+    uint32_t micros() override {
+      return now;
+    }
+    uint32_t millis() override {
+      return now / 1000;
+    }
+    void advance(uint32_t us) {
+      now += us;
+    }
+    uint32_t now = 0;
+};
+
+class MockDac : public HalDac {
+  public:
+    void write(int chipSelect, const uint32_t *words, int count) override {
+      (void)chipSelect;
+      this->words.insert(this->words.end(), words, words + count);
+    }
+    std::vector<uint32_t> words;
+};
+
+class MockPins : public HalPins {
+  public:
+    void write(int pin, bool level) override {
+      levels[pin] = level;
+      writes++;
+    }
+    std::map<int, bool> levels;
+    unsigned long writes = 0;
+};
+
+//Every transfer finishes at once and succeeds
+class MockI2c : public HalI2c {
+  public:
+    void writeAsync(uint8_t address, const uint8_t *data, size_t length) override {
+      (void)address;
+      bytes.insert(bytes.end(), data, data + length);
+    }
+    bool finished() override {
+      return true;
+    }
+    bool failed() override {
+      return false;
+    }
+    std::vector<uint8_t> bytes;
+};
+
+class MockMidiOut : public HalMidiOut {
+  public:
+    void send(const uint8_t *data, size_t length) override {
+      bytes.insert(bytes.end(), data, data + length);
+    }
+    std::vector<uint8_t> bytes;
+};
+
+class MockStorage : public HalStorage {
+  public:
+    bool exists(const char *name) override {
+      return files.count(name) > 0;
+    }
+    int read(const char *name, uint8_t *data, size_t size) override {
+      auto it = files.find(name);
+      if (it == files.end()) return -1;
+      size_t n = it->second.size() < size ? it->second.size() : size;
+      memcpy(data, it->second.data(), n);
+      return (int)n;
+    }
+    bool write(const char *name, const uint8_t *data, size_t length) override {
+      files[name].assign(data, data + length);
+      return true;
+    }
+    bool append(const char *name, const uint8_t *data, size_t length) override {
+      files[name].insert(files[name].end(), data, data + length);
+      return true;
+    }
+    bool remove(const char *name) override {
+      return files.erase(name) > 0;
+    }
+    bool rename(const char *from, const char *to) override {
+      auto it = files.find(from);
+      if (it == files.end() || files.count(to)) return false;
+      files[to].swap(it->second);
+      files.erase(from);
+      return true;
+    }
+    void list(HalFileFound found, void *context) override {
+      std::vector<std::string> names;  //found() may add or remove files
+      for (const auto &file : files) names.push_back(file.first);
+      for (const std::string &name : names) found(name.c_str(), context);
+    }
+    std::map<std::string, std::vector<uint8_t>> files;
+};
+
+class MockNvStore : public HalNvStore {
+  public:
+    uint8_t read(int address) override {
+      return memory[address];
+    }
+    void write(int address, uint8_t value) override {
+      memory[address] = value;
+    }
+    uint8_t memory[4096] = { 0 };
+};
+
+class MockAdc : public HalAdc {
+  public:
+    int read(int pin) override {
+      return values[pin & 63];
+    }
+    int values[64] = { 0 };
+};
+
+MockClock mockClock;
+MockDac mockDac;
+MockPins mockPins;
+MockI2c mockI2c;
+MockMidiOut mockMidiDin;
+MockMidiOut mockMidiVoices;
+MockMidiOut mockMidiPanel;
+MockStorage mockStorage;
+MockNvStore mockNvStore;
+MockAdc mockAdc;
+
+Hal hal = { &mockClock, &mockDac, &mockPins, &mockI2c, &mockMidiDin, &mockMidiVoices, &mockMidiPanel,
+            &mockStorage, &mockNvStore, &mockAdc };
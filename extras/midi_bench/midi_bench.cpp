@@ -0,0 +1,397 @@
+/*
+  MIDI replay benchmark for the note, CC and pitch bend paths, run on a PC.
+
+  Build:  g++ -O2 -std=c++11 -o midi_bench midi_bench.cpp ../../NoteHandler.cpp ../../VoiceAllocator.cpp ../../CcDispatch.cpp ../../DemuxMap.cpp
+  Usage:  midi_bench [options] <stream>...
+
+  A stream is a Standard MIDI File or one of the built in stress streams:
+    chords    8 note chords, 4 a second
+    arp       a note every 20ms
+    ccsweep   four panel CCs and the mod wheel swept up and down as fast as the wire allows
+    bend      pitch bend as fast as the wire allows
+
+  Options:
+    --seconds N      length of the built in streams (10)
+    --mode N         keyboard mode, 0 oldest voice, 1 lowest free voice, 2 mono or 3 unison (0)
+    --priority N     note priority for modes 2 and 3, 0 top, 1 bottom or 2 last (0)
+    --loop-us N      loop() pass the messages are handled on (1000)
+    --voice-baud N   MIDI6 speed, 31250 or the binary voice link rate (31250)
+    --max-p99 N      exit 1 if any stream's p99 note latency is over N us
+
+  Bytes arrive on a virtual 31250 baud DIN wire and go through MidiParser and the sketch's own key
+  handlers in NoteHandler.cpp: keyNoteOn(), keyNoteOff() and keyPitchBend() are what myNoteOn(),
+  myNoteOff() and DinHandlePitchBend() call, in whole mode. CCs go through ccDispatch() and the mod
+  wheel to modSource() as in myControlChange(), its display and hardware updates stay in the sketch.
+  What the handlers write to MIDI6, MIDI7 and DIN out is queued on virtual wires at each port's speed.
+  modTick() runs every MOD_TICK_US and the DAC gets one demux channel per loop pass, with modApply()
+  and clockApply() on top as writeDemux() does.
+  Latency is from the last input byte to the last output byte leaving its wire, in virtual time, so
+  the figures are the same on every run and can be used as a regression gate. Events per second is
+  the host time spent in the handlers and does vary.
+*/
+
+#include "../host/HalMock.h"
+#include "../../CcDispatch.h"
+#include "../../DemuxMap.h"
+#include "../../MidiCC.h"
+#include "../../MidiClock.h"
+#include "../../MidiParser.h"
+#include "../../ModMatrix.h"
+#include "../../NoteHandler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#define VOICES 8
+#define DIN_BYTE_US 320  //10 bits at 31250 baud
+
+struct TimedMessage {
+  uint64_t time;  //us
+  uint8_t bytes[3];
+  uint8_t length;
+};
+
+static int mode = 0;
+static int priority = 0;
+static uint32_t loopUs = 1000;
+static uint32_t voiceBaud = 31250;
+
+//A serial output, bytes queue behind each other at the port's speed
+struct Wire {
+  uint32_t byteUs;
+  uint64_t freeAt;
+  const std::vector<uint8_t> *bytes;  //What the handlers wrote to the port
+  size_t queued;
+
+  //Queues the bytes written since the last drain, returns when they have all left, 0 if there were none
+  uint64_t drain(uint64_t now) {
+    size_t length = bytes->size() - queued;
+    if (!length) return 0;
+    queued = bytes->size();
+    freeAt = std::max(freeAt, now) + length * byteUs;
+    return freeAt;
+  }
+};
+
+struct Run {
+  std::vector<uint32_t> noteLatency;
+  std::vector<uint32_t> ccLatency;
+  std::vector<uint32_t> dacLatency;  //CC in to its demux channel being written
+  std::vector<uint32_t> bendLatency;
+  uint64_t handlerNs = 0;
+  unsigned long messages = 0;
+};
+
+static VoiceAndNote voices[VOICES];
+static KeyState keys;
+static int upperData[76], lowerData[76];
+static Wire voiceWire, panelWire, dinWire;
+
+static void resetSynth() {
+  for (auto &v : voices) v = { -1, -1, 0, false, false, 0, -1, false };
+  keys = KeyState();
+  keys.voices = voices;
+  keys.voiceCount = VOICES;
+  for (int i = 0; i < 76; i++) upperData[i] = lowerData[i] = 0;
+  for (int s = 0; s < MOD_SOURCES; s++) modSources[s] = 0;
+  modReady = false;
+  mockMidiVoices.bytes.clear();
+  mockMidiPanel.bytes.clear();
+  mockMidiDin.bytes.clear();
+  mockDac.words.clear();
+  voiceWire = { 10000000 / voiceBaud, 0, &mockMidiVoices.bytes, 0 };
+  panelWire = { DIN_BYTE_US, 0, &mockMidiPanel.bytes, 0 };
+  dinWire = { DIN_BYTE_US, 0, &mockMidiDin.bytes, 0 };
+}
+
+//dacChannel is the demux channel a CC's value goes out on, -1 for none
+static void handle(const MidiMessage &msg, int &dacChannel) {
+  uint8_t type = msg.status & 0xF0;
+  dacChannel = -1;
+  if (type == 0x90 && msg.data2) {
+    modNote(msg.data1, msg.data2);
+    keyNoteOn(keys, mode, priority, msg.data1, msg.data2, hal.clock->millis());
+  } else if (type == 0x80 || type == 0x90) {
+    keyNoteOff(keys, mode, priority, msg.data1, msg.data2);
+  } else if (type == 0xB0) {
+    int value = msg.data2 << 3;  //editControlChange()
+    bool stored = ccDispatch(upperData, lowerData, msg.data1, value, false, true) != CC_NONE;
+    if (msg.data1 == CCmodwheel) modSource(MOD_SRC_WHEEL, value);
+    if (!stored) return;
+    hal.midiDin->controlChange(msg.data1, value >> 3, 1);  //midiCCOut() and midiCCOut71()
+    hal.midiPanel->controlChange(msg.data1, value >> 3, 1);
+    bool onB;
+    if (!demuxLocate(ccParam(msg.data1), dacChannel, onB)) dacChannel = -1;
+  } else if (type == 0xE0) {
+    keyPitchBend((msg.data2 << 7 | msg.data1) - 8192);
+  }
+}
+
+static void writeDemux(int channel) {
+  uint32_t words[4];
+  demuxWords(channel, upperData, lowerData, words);
+  modApply(channel, words);
+  clockApply(channel, words);
+  hal.dac->write(10, words, 4);
+}
+
+static void runStream(const std::vector<TimedMessage> &stream, Run &run) {
+  resetSynth();
+  MidiParser parser;
+  struct Pending {
+    MidiMessage msg;
+    uint64_t arrived;
+  };
+  std::vector<Pending> waiting;
+  struct DacWait {
+    int channel;
+    uint64_t since;
+  };
+  std::vector<DacWait> dacWaits;
+  uint64_t wireFree = 0;
+  size_t next = 0;
+  uint64_t pass = 0;
+  int demuxChannel = 0;
+  uint64_t modDue = 0;
+  uint64_t end = stream.empty() ? 0 : stream.back().time + 1000000;
+  std::vector<std::pair<uint64_t, uint8_t>> bytes;  //Arrival time of each input byte
+  for (const TimedMessage &m : stream) {
+    uint64_t t = std::max(m.time, wireFree);
+    for (int i = 0; i < m.length; i++) {
+      t += DIN_BYTE_US;
+      bytes.push_back({ t, m.bytes[i] });
+    }
+    wireFree = t;
+  }
+  end = std::max(end, wireFree + 1000000);
+
+  for (pass = 0; pass * loopUs < end; pass++) {
+    uint64_t now = pass * loopUs;
+    mockClock.now = (uint32_t)now;
+    //Bytes that arrived since the last pass, parsed as they came off the wire
+    for (; next < bytes.size() && bytes[next].first <= now; next++) {
+      MidiMessage msg;
+      if (parser.feed(bytes[next].second, msg) && msg.status < 0xF0) waiting.push_back({ msg, bytes[next].first });
+    }
+    //In arrival order, as readMidi() takes them
+    for (const Pending &p : waiting) {
+      int dacChannel;
+      auto start = std::chrono::steady_clock::now();
+      handle(p.msg, dacChannel);
+      run.handlerNs += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+      run.messages++;
+      //Latency to the last byte of whatever it sent
+      uint64_t done = std::max({ voiceWire.drain(now), panelWire.drain(now), dinWire.drain(now) });
+      if (!done) continue;
+      uint32_t latency = (uint32_t)(done - p.arrived);
+      switch (p.msg.status & 0xF0) {
+        case 0x80:
+        case 0x90:
+          run.noteLatency.push_back(latency);
+          break;
+        case 0xB0:
+          run.ccLatency.push_back(latency);
+          if (dacChannel >= 0) dacWaits.push_back({ dacChannel, p.arrived });
+          break;
+        case 0xE0:
+          run.bendLatency.push_back(latency);
+          break;
+      }
+    }
+    waiting.clear();
+    if (now >= modDue) {
+      modTick(upperData, lowerData);
+      modDue = now + MOD_TICK_US;
+    }
+    //One demux channel a pass, like writeDemux() in the scheduler
+    writeDemux(demuxChannel);
+    for (size_t i = 0; i < dacWaits.size();) {
+      if (dacWaits[i].channel == demuxChannel) {
+        run.dacLatency.push_back((uint32_t)(now + loopUs - dacWaits[i].since));
+        dacWaits[i] = dacWaits.back();
+        dacWaits.pop_back();
+      } else {
+        i++;
+      }
+    }
+    demuxChannel = (demuxChannel + 1) % 16;
+  }
+}
+
+static uint32_t percentile(std::vector<uint32_t> v, int percent) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  size_t index = (v.size() * percent + 99) / 100;
+  return v[index ? index - 1 : 0];
+}
+
+//Standard MIDI File, all tracks merged, meta events and SysEx skipped
+static bool readSmf(const char *path, std::vector<TimedMessage> &stream) {
+  FILE *f = fopen(path, "rb");
+  if (!f) return false;
+  std::vector<uint8_t> d;
+  uint8_t buffer[4096];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) d.insert(d.end(), buffer, buffer + n);
+  fclose(f);
+  auto u16 = [&](size_t p) { return (uint32_t)(d[p] << 8 | d[p + 1]); };
+  auto u32 = [&](size_t p) { return (uint32_t)d[p] << 24 | d[p + 1] << 16 | d[p + 2] << 8 | d[p + 3]; };
+  if (d.size() < 14 || memcmp(d.data(), "MThd", 4) != 0) return false;
+  uint32_t tracks = u16(10);
+  int16_t division = (int16_t)u16(12);
+
+  struct Event {
+    uint64_t tick;
+    uint32_t tempo;  //Non zero for a tempo change
+    TimedMessage msg;
+  };
+  std::vector<Event> events;
+  size_t p = 8 + u32(4);
+  for (uint32_t t = 0; t < tracks && p + 8 <= d.size(); t++) {
+    if (memcmp(&d[p], "MTrk", 4) != 0) return false;
+    size_t end = std::min(d.size(), p + 8 + u32(p + 4));
+    p += 8;
+    uint64_t tick = 0;
+    uint8_t status = 0;
+    while (p < end) {
+      uint32_t delta = 0;
+      do delta = delta << 7 | (d[p] & 0x7F);
+      while (d[p++] & 0x80 && p < end);
+      tick += delta;
+      if (p >= end) break;
+      uint8_t b = d[p];
+      if (b == 0xFF || b == 0xF0 || b == 0xF7) {
+        uint8_t meta = b == 0xFF ? d[p + 1] : 0;
+        p += b == 0xFF ? 2 : 1;
+        uint32_t length = 0;
+        do length = length << 7 | (d[p] & 0x7F);
+        while (d[p++] & 0x80 && p < end);
+        if (meta == 0x51 && length == 3 && p + 3 <= end) {
+          events.push_back({ tick, (uint32_t)(d[p] << 16 | d[p + 1] << 8 | d[p + 2]), {} });
+        }
+        p += length;
+        continue;
+      }
+      if (b & 0x80) {
+        status = b;
+        p++;
+      }
+      uint8_t needed = midiDataBytes(status);
+      TimedMessage m = { 0, { status, 0, 0 }, (uint8_t)(1 + needed) };
+      for (int i = 0; i < needed && p < end; i++) m.bytes[1 + i] = d[p++];
+      events.push_back({ tick, 0, m });
+    }
+    p = end;
+  }
+  std::stable_sort(events.begin(), events.end(), [](const Event &a, const Event &b) { return a.tick < b.tick; });
+  double usPerTick = division < 0 ? 1000000.0 / (-(division >> 8) * (division & 0xFF)) : 500000.0 / division;
+  uint64_t lastTick = 0;
+  double us = 0;
+  for (const Event &e : events) {
+    us += (e.tick - lastTick) * usPerTick;
+    lastTick = e.tick;
+    if (e.tempo) {
+      if (division > 0) usPerTick = (double)e.tempo / division;
+      continue;
+    }
+    TimedMessage m = e.msg;
+    m.time = (uint64_t)us;
+    stream.push_back(m);
+  }
+  return true;
+}
+
+static void addMessage(std::vector<TimedMessage> &s, uint64_t time, uint8_t status, uint8_t d1, uint8_t d2) {
+  s.push_back({ time, { status, d1, d2 }, (uint8_t)(1 + midiDataBytes(status)) });
+}
+
+static bool synthetic(const std::string &name, uint32_t seconds, std::vector<TimedMessage> &s) {
+  uint64_t end = (uint64_t)seconds * 1000000;
+  if (name == "chords") {
+    static const int shape[8] = { 0, 4, 7, 11, 12, 16, 19, 23 };
+    for (uint64_t t = 0, i = 0; t < end; t += 250000, i++) {
+      int root = 36 + i % 12;
+      for (int n : shape) addMessage(s, t, 0x90, root + n, 100);
+      for (int n : shape) addMessage(s, t + 200000, 0x80, root + n, 0);
+    }
+  } else if (name == "arp") {
+    static const int steps[4] = { 0, 3, 7, 12 };
+    for (uint64_t t = 0, i = 0; t < end; t += 20000, i++) {
+      int note = 48 + steps[i % 4] + 12 * (i / 4 % 3);
+      addMessage(s, t, 0x90, note, 90);
+      addMessage(s, t + 15000, 0x80, note, 0);
+    }
+  } else if (name == "ccsweep") {
+    static const uint8_t ccs[5] = { CCfilterCutoff, CCfilterRes, CCnoiseLevel, CCampAttack, CCmodwheel };
+    for (uint64_t t = 0, i = 0; t < end; t += 3 * DIN_BYTE_US, i++) {
+      int step = i / 5 % 254;
+      addMessage(s, t, 0xB0, ccs[i % 5], step < 127 ? step : 254 - step);
+    }
+  } else if (name == "bend") {
+    for (uint64_t t = 0, i = 0; t < end; t += 3 * DIN_BYTE_US, i++) {
+      int value = 8192 + (int)(8191 * ((i % 200) < 100 ? (i % 100) / 100.0 : 1 - (i % 100) / 100.0));
+      addMessage(s, t, 0xE0, value & 0x7F, value >> 7);
+    }
+  } else {
+    return false;
+  }
+  std::stable_sort(s.begin(), s.end(), [](const TimedMessage &a, const TimedMessage &b) { return a.time < b.time; });
+  return true;
+}
+
+static void printLatency(const char *name, const std::vector<uint32_t> &v) {
+  if (v.empty()) return;
+  printf("  %-6s %7zu  p50 %7u us  p99 %7u us  max %7u us\n", name, v.size(), percentile(v, 50), percentile(v, 99),
+         *std::max_element(v.begin(), v.end()));
+}
+
+int main(int argc, char **argv) {
+  uint32_t seconds = 10;
+  long maxP99 = -1;
+  std::vector<std::string> streams;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 < argc && arg == "--seconds") seconds = atoi(argv[++i]);
+    else if (i + 1 < argc && arg == "--mode") mode = atoi(argv[++i]);
+    else if (i + 1 < argc && arg == "--priority") priority = atoi(argv[++i]);
+    else if (i + 1 < argc && arg == "--loop-us") loopUs = atoi(argv[++i]);
+    else if (i + 1 < argc && arg == "--voice-baud") voiceBaud = atoi(argv[++i]);
+    else if (i + 1 < argc && arg == "--max-p99") maxP99 = atol(argv[++i]);
+    else streams.push_back(arg);
+  }
+  if (streams.empty() || loopUs == 0 || voiceBaud == 0 || mode < 0 || mode > 3) {
+    fprintf(stderr, "Usage: midi_bench [--seconds N] [--mode 0-3] [--priority 0-2] [--loop-us N] [--voice-baud N] [--max-p99 N] <file.mid|chords|arp|ccsweep|bend>...\n");
+    return 1;
+  }
+
+  modBegin();
+  clockBegin();
+  bool failed = false;
+  for (const std::string &name : streams) {
+    std::vector<TimedMessage> stream;
+    if (!synthetic(name, seconds, stream) && !readSmf(name.c_str(), stream)) {
+      fprintf(stderr, "%s: not a stream name or a MIDI file\n", name.c_str());
+      return 1;
+    }
+    Run run;
+    runStream(stream, run);
+    double perSecond = run.handlerNs ? run.messages * 1e9 / run.handlerNs : 0;
+    printf("%s: %lu messages, %.0f events/s in the handlers\n", name.c_str(), run.messages, perSecond);
+    printLatency("note", run.noteLatency);
+    printLatency("cc", run.ccLatency);
+    printLatency("dac", run.dacLatency);
+    printLatency("bend", run.bendLatency);
+    printf("  bytes  MIDI6 %zu  MIDI7 %zu  DIN out %zu  DAC words %zu\n", mockMidiVoices.bytes.size(), mockMidiPanel.bytes.size(),
+           mockMidiDin.bytes.size(), mockDac.words.size());
+    if (maxP99 >= 0 && percentile(run.noteLatency, 99) > (uint32_t)maxP99) {
+      printf("  FAIL note p99 over %ld us\n", maxP99);
+      failed = true;
+    }
+  }
+  return failed ? 1 : 0;
+}
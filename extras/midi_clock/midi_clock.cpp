@@ -0,0 +1,189 @@
+/*
+  MIDI clock tracker test, run on a PC against MidiClock.h with synthetic jittered clock streams.
+
+  Build:  g++ -O2 -std=c++11 -o midi_clock midi_clock.cpp ../../DemuxMap.cpp
+  Usage:  midi_clock [options]
+
+  Options:
+    --jitter-us N     clock ticks arrive up to N us either side of the beat grid (1000)
+    --max-phase-us N  exit 1 if a stream's worst phase error after settling is over N us (1000)
+    --max-bpm-error N exit 1 if a steady stream's tempo is out by more than N percent (0.5)
+    --seed N          random seed (1)
+
+  Streams:
+    steady    120 BPM for 60s
+    slow      40 BPM for 60s
+    fast      240 BPM for 60s
+    ramp      90 to 150 BPM over 60s
+    jump      100 BPM, 140 BPM from 20s
+    dropout   120 BPM, no clock from 20s to 21s
+    transport start, stop at 10s, continue at 12s, clocks all the way through
+
+  Tick times also get rounded up to the 100 us DIN drain timer as in MidiInput.h. Phase error is the
+  filtered tick time against the true one, measured from two beats after each lock or tempo jump.
+*/
+
+#include "../../MidiClock.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#define DRAIN_US 100
+
+struct Tick {
+  double truth;   //On the beat grid, us
+  uint32_t time;  //As timestamped
+  bool settle;    //Lock or tempo change, don't measure the next two beats
+  uint8_t status; //0xF8, or 0xFA, 0xFB, 0xFC just before the tick
+};
+
+struct Result {
+  double rmsPhase = 0;
+  double maxPhase = 0;
+  float bpm = 0;
+  float jitterRms = 0;
+  float jitterPeak = 0;
+  uint32_t relocks = 0;
+  int32_t songTicks = 0;
+};
+
+static uint32_t seed = 1;
+static double jitterUs = 1000;
+
+static double uniform() {
+  seed = seed * 1664525 + 1013904223;
+  return (seed >> 8) / 16777216.0 * 2 - 1;
+}
+
+static uint32_t timestamp(double truth) {
+  double t = truth + uniform() * jitterUs + 1000000;  //Clear of 0 so jitter can't go negative
+  return ((uint32_t)t / DRAIN_US + 1) * DRAIN_US;
+}
+
+//bpmAt gives the tempo at a time in seconds, gaps is a list of silent spans
+static std::vector<Tick> stream(double seconds, double (*bpmAt)(double), double gapFrom = -1, double gapTo = -1) {
+  std::vector<Tick> ticks;
+  double t = 0;
+  double lastBpm = bpmAt(0);
+  bool settle = true;
+  while (t < seconds * 1e6) {
+    double bpm = bpmAt(t / 1e6);
+    if (bpm - lastBpm > 5 || lastBpm - bpm > 5) settle = true;
+    lastBpm = bpm;
+    if (t >= gapFrom * 1e6 && t < gapTo * 1e6) {
+      settle = true;
+    } else {
+      ticks.push_back({ t + 1000000, timestamp(t), settle, 0xF8 });
+      settle = false;
+    }
+    t += 60e6 / (bpm * CLOCK_PPQN);
+  }
+  return ticks;
+}
+
+static Result run(const std::vector<Tick> &ticks) {
+  MidiClockTracker tracker;
+  Result r;
+  double sum = 0;
+  int count = 0;
+  int skip = 0;
+  for (const Tick &tick : ticks) {
+    tracker.poll(tick.time);
+    if (tick.status == 0xFA) tracker.start();
+    if (tick.status == 0xFB) tracker.resume();
+    if (tick.status == 0xFC) tracker.stop();
+    if (tick.settle) skip = 2 * CLOCK_PPQN + 2;
+    uint32_t relocks = tracker.relocks;
+    tracker.tick(tick.time);
+    if (tracker.relocks != relocks) skip = 2 * CLOCK_PPQN;
+    if (skip > 0) {
+      skip--;
+      continue;
+    }
+    double error = tracker.tickTime() - tick.truth - DRAIN_US / 2.0;  //The drain rounding is a fixed delay
+    sum += error * error;
+    count++;
+    if (error > r.maxPhase || -error > r.maxPhase) r.maxPhase = error < 0 ? -error : error;
+  }
+  r.rmsPhase = count ? sqrt(sum / count) : 0;
+  r.bpm = tracker.bpm();
+  tracker.jitter(r.jitterRms, r.jitterPeak);
+  r.relocks = tracker.relocks;
+  r.songTicks = tracker.isRunning() ? 1 : 0;
+  return r;
+}
+
+int main(int argc, char **argv) {
+  double maxPhase = 1000, maxBpmError = 0.5;
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string arg = argv[i];
+    if (arg == "--jitter-us") jitterUs = atof(argv[i + 1]);
+    else if (arg == "--max-phase-us") maxPhase = atof(argv[i + 1]);
+    else if (arg == "--max-bpm-error") maxBpmError = atof(argv[i + 1]);
+    else if (arg == "--seed") seed = atoi(argv[i + 1]);
+    else {
+      fprintf(stderr, "Unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+
+  struct Case {
+    const char *name;
+    std::vector<Tick> ticks;
+    double bpm;  //At the end, 0 if it isn't steady
+  };
+  std::vector<Case> cases;
+  cases.push_back({ "steady", stream(60, [](double) { return 120.0; }), 120 });
+  cases.push_back({ "slow", stream(60, [](double) { return 40.0; }), 40 });
+  cases.push_back({ "fast", stream(60, [](double) { return 240.0; }), 240 });
+  cases.push_back({ "ramp", stream(60, [](double t) { return 90 + t; }), 0 });
+  cases.push_back({ "jump", stream(60, [](double t) { return t < 20 ? 100.0 : 140.0; }), 140 });
+  cases.push_back({ "dropout", stream(60, [](double) { return 120.0; }, 20, 21), 120 });
+
+  std::vector<Tick> transport = stream(20, [](double) { return 120.0; });
+  int started = 0, stopped = 0, resumed = 0;
+  for (Tick &tick : transport) {
+    if (!started && tick.truth >= 1000000 + 2e6) started = 1, tick.status = 0xFA;
+    if (!stopped && tick.truth >= 1000000 + 10e6) stopped = 1, tick.status = 0xFC;
+    if (!resumed && tick.truth >= 1000000 + 12e6) resumed = 1, tick.status = 0xFB;
+  }
+  cases.push_back({ "transport", transport, 120 });
+
+  printf("jitter +-%.0f us, drain %d us\n", jitterUs, DRAIN_US);
+  printf("stream     phase rms   max us    bpm    want  jitter rms  peak us  relocks\n");
+  int failed = 0;
+  for (const Case &c : cases) {
+    Result r = run(c.ticks);
+    bool bad = r.maxPhase > maxPhase;
+    if (c.bpm && fabs(r.bpm - c.bpm) / c.bpm * 100 > maxBpmError) bad = true;
+    printf("%-10s %9.1f %8.1f %7.2f %7.1f %10.1f %8.1f %8u%s\n", c.name, r.rmsPhase, r.maxPhase, r.bpm, c.bpm,
+           r.jitterRms, r.jitterPeak, r.relocks, bad ? "  FAIL" : "");
+    failed |= bad;
+  }
+
+  //Song position through start, stop and continue: ticks while stopped don't count
+  MidiClockTracker tracker;
+  int expected = -1;
+  bool running = false;
+  for (const Tick &tick : transport) {
+    if (tick.status == 0xFA) tracker.start(), expected = -1, running = true;
+    if (tick.status == 0xFC) tracker.stop(), running = false;
+    if (tick.status == 0xFB) tracker.resume(), running = true;
+    tracker.tick(tick.time);
+    if (running) expected++;
+  }
+  float position = tracker.phase(transport.back().time, 1e9f) * 1e9f;
+  bool positionBad = position < expected - 0.5f || position > expected + 1.5f;
+  printf("transport song position %.1f ticks, want %d%s\n", position, expected, positionBad ? "  FAIL" : "");
+  failed |= positionBad;
+
+  //The rate CV lookup against a straight line table
+  float table[128];
+  for (int i = 0; i < 128; i++) table[i] = 0.1f * (i + 1);
+  bool rateBad = clockRateValue(table, 0.1f) != 0 || clockRateValue(table, 6.45f) != 508 || clockRateValue(table, 50) != 1023;
+  printf("rate lookup %s\n", rateBad ? "FAIL" : "ok");
+  failed |= rateBad;
+  return failed;
+}
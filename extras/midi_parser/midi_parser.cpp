@@ -0,0 +1,114 @@
+/*
+  MidiParser fixture test, run on a PC against MidiParser.h.
+
+  Build:  g++ -O2 -std=c++11 -o midi_parser midi_parser.cpp
+  Usage:  midi_parser [-v]
+
+  Each fixture is a byte stream as it would come off the DIN UART and the messages the parser must emit
+  for it, in order. SysEx comes out as its whole message from F0 to F7, everything else as the status
+  and data bytes. Covers running status, real time bytes in the middle of messages and SysEx, SysEx
+  that is too long or never terminated, and system common cancelling running status. -v prints what
+  each fixture emitted.
+*/
+
+#include "../../MidiParser.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+struct Fixture {
+  const char *name;
+  std::vector<uint8_t> bytes;
+  std::vector<std::string> want;
+  uint32_t overflows;  //sysexOverflows at the end
+};
+
+static std::string hex(const uint8_t *data, size_t length) {
+  std::string s;
+  char b[4];
+  for (size_t i = 0; i < length; i++) {
+    snprintf(b, sizeof(b), i ? " %02X" : "%02X", data[i]);
+    s += b;
+  }
+  return s;
+}
+
+static std::string describe(const MidiParser &parser, const MidiMessage &msg) {
+  if (msg.status == 0xF0) return hex(parser.sysex(), parser.sysexSize());
+  uint8_t bytes[3] = { msg.status, msg.data1, msg.data2 };
+  return hex(bytes, msg.length);
+}
+
+//F0, n data bytes counting up, F7
+static std::vector<uint8_t> sysex(int n) {
+  std::vector<uint8_t> s(1, 0xF0);
+  for (int i = 0; i < n; i++) s.push_back(i & 0x7F);
+  s.push_back(0xF7);
+  return s;
+}
+
+static std::vector<uint8_t> join(std::vector<uint8_t> a, const std::vector<uint8_t> &b) {
+  a.insert(a.end(), b.begin(), b.end());
+  return a;
+}
+
+int main(int argc, char **argv) {
+  bool verbose = argc > 1 && std::string(argv[1]) == "-v";
+  std::vector<uint8_t> longest = sysex(MIDI_SYSEX_MAX - 2);
+  std::vector<Fixture> fixtures = {
+    { "note on and off", { 0x90, 0x3C, 0x64, 0x80, 0x3C, 0x00 }, { "90 3C 64", "80 3C 00" }, 0 },
+    { "running status", { 0x91, 0x3C, 0x64, 0x40, 0x64, 0x3C, 0x00 }, { "91 3C 64", "91 40 64", "91 3C 00" }, 0 },
+    { "running status, one data byte", { 0xC0, 0x05, 0x06, 0xD0, 0x30 }, { "C0 05", "C0 06", "D0 30" }, 0 },
+    { "running status across types", { 0xB0, 0x07, 0x64, 0x01, 0x20, 0xE0, 0x00, 0x40, 0x10, 0x40 },
+      { "B0 07 64", "B0 01 20", "E0 00 40", "E0 10 40" }, 0 },
+    { "real time inside a note", { 0x90, 0xF8, 0x3C, 0xFE, 0x64 }, { "F8", "FE", "90 3C 64" }, 0 },
+    { "real time inside running status", { 0x90, 0x3C, 0x64, 0x3E, 0xFA, 0x64, 0xF8 }, { "90 3C 64", "FA", "90 3E 64", "F8" }, 0 },
+    { "real time inside SysEx", { 0xF0, 0x7D, 0xF8, 0x01, 0xFC, 0x02, 0xF7 }, { "F8", "FC", "F0 7D 01 02 F7" }, 0 },
+    { "running status after SysEx", { 0x90, 0x3C, 0x64, 0xF0, 0x7D, 0xF7, 0x3E, 0x64 }, { "90 3C 64", "F0 7D F7" }, 0 },
+    { "SysEx the longest that fits", join(longest, { 0x90, 0x3C, 0x64 }),
+      { hex(longest.data(), longest.size()), "90 3C 64" }, 0 },
+    { "SysEx overflow", join(sysex(MIDI_SYSEX_MAX - 1), { 0x90, 0x3C, 0x64 }), { "90 3C 64" }, 1 },
+    { "SysEx far too long", join(join(sysex(1000), { 0xB0, 0x07, 0x10 }), sysex(2)), { "B0 07 10", "F0 00 01 F7" }, 1 },
+    { "unterminated SysEx", { 0xF0, 0x7D, 0x01, 0x02, 0x90, 0x3C, 0x64, 0xF7, 0x3E, 0x64 }, { "90 3C 64", "90 3E 64" }, 0 },
+    { "SysEx cut by SysEx", { 0xF0, 0x7D, 0x01, 0xF0, 0x7E, 0xF7 }, { "F0 7E F7" }, 0 },
+    { "stray F7", { 0xF7, 0x90, 0x3C, 0x64 }, { "90 3C 64" }, 0 },
+    { "data before any status", { 0x3C, 0x64, 0x90, 0x3C, 0x64 }, { "90 3C 64" }, 0 },
+    { "system common cancels running status", { 0x90, 0x3C, 0x64, 0xF2, 0x01, 0x02, 0x3E, 0x64, 0xF3, 0x05, 0x06 },
+      { "90 3C 64", "F2 01 02", "F3 05" }, 0 },
+    { "tune request", { 0x90, 0x3C, 0xF6, 0x64, 0x3C, 0x64 }, { "F6" }, 0 },
+    { "status cuts a message short", { 0x90, 0x3C, 0xB0, 0x07, 0x64 }, { "B0 07 64" }, 0 },
+  };
+
+  int failed = 0;
+  for (const Fixture &f : fixtures) {
+    MidiParser parser;
+    std::vector<std::string> got;
+    for (uint8_t b : f.bytes) {
+      MidiMessage msg;
+      if (parser.feed(b, msg)) got.push_back(describe(parser, msg));
+    }
+    bool ok = got == f.want && parser.sysexOverflows == f.overflows;
+    printf("  %-38s %s\n", f.name, ok ? "ok" : "FAIL");
+    if (!ok || verbose) {
+      for (const std::string &s : got) printf("      got  %.60s%s\n", s.c_str(), s.size() > 60 ? "..." : "");
+      if (!ok) {
+        for (const std::string &s : f.want) printf("      want %.60s%s\n", s.c_str(), s.size() > 60 ? "..." : "");
+        printf("      overflows %u, want %u\n", parser.sysexOverflows, f.overflows);
+      }
+    }
+    failed |= !ok;
+  }
+
+  //The queue between the drain timer and loop() keeps arrival order and refuses when full
+  MidiQueue<4> queue;
+  bool ok = true;
+  for (uint8_t i = 0; i < 4; i++) ok &= queue.push({ 0, (uint8_t)(0x90 | i), i, 0, 3 });
+  ok &= !queue.push({ 0, 0xB0, 0, 0, 3 });
+  MidiMessage msg;
+  for (uint8_t i = 0; i < 4; i++) ok &= queue.pop(msg) && msg.data1 == i;
+  ok &= !queue.pop(msg);
+  printf("  %-38s %s\n", "queue order and full", ok ? "ok" : "FAIL");
+  failed |= !ok;
+  return failed;
+}
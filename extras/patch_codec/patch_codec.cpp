@@ -0,0 +1,303 @@
+/*
+  Patch CSV codec benchmark and round trip test, run on a PC against PatchCodec.h.
+
+  Build:  g++ -O2 -std=c++11 -o patch_codec patch_codec.cpp ../../PatchCodec.cpp
+  Usage:  patch_codec [options]
+
+  Options:
+    --patches N   patches in the bank (999)
+    --rounds N    times the bank is written and read for the timings (20)
+    --seed N      random seed (1)
+
+  A bank of random patches is formatted with formatPatchCsv() into one buffer laid out like the patch
+  files, "\r\n" after each line as File::println() writes them, then read back with PatchCsvReader.
+  The reader is timed over a source that hands out whole blocks like File::read() and over one that
+  gives a byte per call like the old readField(), and every patch must come back the same. Fixed lines
+  check the parsing rules: missing fields are 0, junk after a number is skipped, extra fields are
+  dropped and long names are cut. Allocations are counted around the codec calls, there must be none.
+
+  Recall times a program change's work once the patch is chosen, from PatchBank.h. From the card the
+  line is parsed a byte a read into a record as recalls did before the RAM bank, from the bank the
+  record is already there. Both then copy it into the layer. Card access time comes on top of the
+  card figure and isn't modelled.
+
+  Patch files go through hal.storage, here the host mock, and must read back what was saved.
+*/
+
+#define DMAMEM
+#define PATCHES_LIMIT 999  //Constants.h
+#define PATCH_NAME_LEN 20  //Constants.h
+
+#include "../host/HalMock.h"
+#include "../../PatchBank.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+static unsigned long allocations = 0;
+
+void *operator new(size_t size) {
+  allocations++;
+  void *p = malloc(size ? size : 1);
+  if (!p) throw std::bad_alloc();
+  return p;
+}
+
+void operator delete(void *p) noexcept {
+  free(p);
+}
+
+struct Patch {
+  char name[PATCH_NAME_LEN];
+  int16_t values[PATCH_VALUES];
+};
+
+//File::read() on the card, up to n bytes a call
+struct BlockSource {
+  const char *data;
+  size_t left;
+  unsigned long reads;
+
+  int read(void *buf, size_t n) {
+    reads++;
+    if (n > left) n = left;
+    memcpy(buf, data, n);
+    data += n;
+    left -= n;
+    return n;
+  }
+};
+
+//A byte a call, the cost readField() had on every character
+struct ByteSource {
+  BlockSource block;
+
+  int read(void *buf, size_t) {
+    return block.read(buf, 1);
+  }
+};
+
+static uint32_t seed = 1;
+static uint32_t rnd(uint32_t range) {
+  seed = seed * 1664525 + 1013904223;
+  return (seed >> 8) % range;
+}
+
+static void randomPatch(Patch &p) {
+  static const char chars[] = "abcdefghijklmnopqrstuvwxyzABCDEFGHIJKLMNOPQRSTUVWXYZ 1234567890";
+  int length = 1 + rnd(PATCH_NAME_LEN - 1);
+  for (int i = 0; i < length; i++) p.name[i] = chars[rnd(sizeof(chars) - 1)];
+  p.name[length] = '\0';
+  p.values[0] = 0;
+  for (int i = 1; i < PATCH_VALUES; i++) {
+    switch (rnd(4)) {
+      case 0:
+        p.values[i] = rnd(2);  //Switches
+        break;
+      case 1:
+        p.values[i] = rnd(13);  //Intervals and modes
+        break;
+      default:
+        p.values[i] = rnd(1024);  //Pots
+        break;
+    }
+  }
+  if (rnd(8) == 0) p.values[1 + rnd(PATCH_VALUES - 1)] = -(int)rnd(100);  //Nothing negative today, but allowed
+}
+
+static bool samePatch(const Patch &a, const Patch &b) {
+  return strcmp(a.name, b.name) == 0 && memcmp(a.values, b.values, sizeof(a.values)) == 0;
+}
+
+static size_t writeBank(const std::vector<Patch> &bank, std::vector<char> &file) {
+  size_t n = 0;
+  for (const Patch &p : bank) {
+    size_t length = formatPatchCsv(&file[n], PATCH_LINE_LEN, p.name, p.values, PATCH_VALUES);
+    if (!length) return 0;
+    n += length;
+    file[n++] = '\r';
+    file[n++] = '\n';
+  }
+  return n;
+}
+
+template <typename Source>
+static size_t readBank(Source &source, std::vector<Patch> &out) {
+  PatchCsvReader<Source> reader(source);
+  size_t count = 0;
+  while (count < out.size() && reader.readPatch(out[count].name, PATCH_NAME_LEN, out[count].values, PATCH_VALUES)) count++;
+  return count;
+}
+
+static double seconds(std::chrono::steady_clock::time_point start) {
+  return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+//One line through the reader, fields 1 to 3 checked against want
+static bool checkLine(const char *what, const char *line, const char *name, int v1, int v2, int v3) {
+  Patch p;
+  PatchLineSource source(line);
+  PatchCsvReader<PatchLineSource> reader(source);
+  bool ok = reader.readPatch(p.name, PATCH_NAME_LEN, p.values, PATCH_VALUES) && strcmp(p.name, name) == 0 && p.values[0] == 0
+            && p.values[1] == v1 && p.values[2] == v2 && p.values[3] == v3;
+  for (int i = 4; ok && i < PATCH_VALUES; i++) ok = p.values[i] == 0;
+  printf("  %-22s %s\n", what, ok ? "ok" : "FAIL");
+  return ok;
+}
+
+int main(int argc, char **argv) {
+  int patches = 999, rounds = 20;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      fprintf(stderr, "%s needs a value\n", argv[i]);
+      return 1;
+    }
+    const char *value = argv[++i];
+    if (arg == "--patches") patches = atoi(value);
+    else if (arg == "--rounds") rounds = atoi(value);
+    else if (arg == "--seed") seed = atoi(value);
+    else {
+      fprintf(stderr, "Unknown option %s\n", argv[i - 1]);
+      return 1;
+    }
+  }
+  if (patches < 1 || rounds < 1) {
+    fprintf(stderr, "patches and rounds start at 1\n");
+    return 1;
+  }
+
+  std::vector<Patch> bank(patches), back(patches);
+  for (Patch &p : bank) randomPatch(p);
+  std::vector<char> file((size_t)patches * (PATCH_LINE_LEN + 2));
+
+  int failed = 0;
+  size_t size = 0;
+  unsigned long before = allocations;
+  auto start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) size = writeBank(bank, file);
+  double writeTime = seconds(start);
+  if (!size) {
+    printf("formatPatchCsv ran out of room\n");
+    return 1;
+  }
+
+  BlockSource block = {};
+  size_t count = 0;
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    block = { file.data(), size, 0 };
+    count = readBank(block, back);
+  }
+  double blockTime = seconds(start);
+  bool blockSame = count == (size_t)patches;
+  for (int i = 0; blockSame && i < patches; i++) blockSame = samePatch(bank[i], back[i]);
+
+  ByteSource bytes = {};
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    bytes = { { file.data(), size, 0 } };
+    count = readBank(bytes, back);
+  }
+  double byteTime = seconds(start);
+  bool byteSame = count == (size_t)patches;
+  for (int i = 0; byteSame && i < patches; i++) byteSame = samePatch(bank[i], back[i]);
+  unsigned long used = allocations - before;
+
+  double mb = (double)size * rounds / 1e6;
+  printf("%d patches, %zu bytes, %.0f bytes a patch, %d rounds\n", patches, size, (double)size / patches, rounds);
+  printf("write            %8.1f MB/s %9.0f patches/s\n", mb / writeTime, (double)patches * rounds / writeTime);
+  printf("read, blocks     %8.1f MB/s %9.0f patches/s %7.2f reads a patch  %s\n", mb / blockTime,
+         (double)patches * rounds / blockTime, (double)block.reads / patches, blockSame ? "round trip ok" : "round trip FAIL");
+  printf("read, bytes      %8.1f MB/s %9.0f patches/s %7.2f reads a patch  %s\n", mb / byteTime,
+         (double)patches * rounds / byteTime, (double)bytes.block.reads / patches, byteSame ? "round trip ok" : "round trip FAIL");
+  printf("allocations      %lu%s\n", used, used ? "  FAIL" : "");
+  failed |= !blockSame || !byteSame || used;
+
+  //Recall, the card path against the bank
+  std::vector<std::string> lines(patches);
+  for (int i = 0; i < patches; i++) {
+    char line[PATCH_LINE_LEN];
+    formatPatchCsv(line, sizeof(line), bank[i].name, bank[i].values, PATCH_VALUES);
+    lines[i] = line;
+    patchBankStore(i + 1, line);
+  }
+  int layer[PATCH_VALUES];
+  long check = 0;
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    for (int i = 0; i < patches; i++) {
+      PatchRecord record;
+      ByteSource card = { { lines[i].data(), lines[i].size(), 0 } };
+      patchRecordLoad(record, card);
+      patchRecordCopy(layer, record);
+      check += layer[1];
+    }
+  }
+  double cardTime = seconds(start);
+  start = std::chrono::steady_clock::now();
+  for (int r = 0; r < rounds; r++) {
+    for (int i = 0; i < patches; i++) {
+      patchRecordCopy(layer, *patchBankRecord(i + 1));
+      check -= layer[1];
+    }
+  }
+  double bankTime = seconds(start);
+  double recalls = (double)patches * rounds;
+  printf("recall, card     %8.3f us a patch, parsed a byte a read\n", cardTime * 1e6 / recalls);
+  printf("recall, bank     %8.3f us a patch, %.0fx quicker%s\n", bankTime * 1e6 / recalls, cardTime / bankTime,
+         check ? "  values differ FAIL" : "");
+  failed |= check != 0;
+
+  printf("parsing rules\n");
+  failed |= !checkLine("plain", "Brass,1,2,3", "Brass", 1, 2, 3);
+  failed |= !checkLine("crlf", "Brass,1,2,3\r\n", "Brass", 1, 2, 3);
+  failed |= !checkLine("missing fields", "Brass,1", "Brass", 1, 0, 0);
+  failed |= !checkLine("empty fields", "Brass,,5,", "Brass", 0, 5, 0);
+  failed |= !checkLine("junk after number", "Brass,12x,7.5,abc", "Brass", 12, 7, 0);
+  failed |= !checkLine("negative", "Brass,-4,0,-0", "Brass", -4, 0, 0);
+  failed |= !checkLine("long name", "A name far longer than fits,9", "A name far longer t", 9, 0, 0);
+  failed |= !checkLine("name only", "Init", "Init", 0, 0, 0);
+
+  //Extra fields past the last value are dropped and the next line still reads
+  {
+    std::string two = "Pad";
+    for (int i = 1; i < PATCH_VALUES + 5; i++) two += "," + std::to_string(i);
+    two += "\r\nLead,7,8,9\r\n";
+    Patch p;
+    PatchLineSource source(two.c_str());
+    PatchCsvReader<PatchLineSource> reader(source);
+    bool ok = reader.readPatch(p.name, PATCH_NAME_LEN, p.values, PATCH_VALUES) && p.values[PATCH_VALUES - 1] == PATCH_VALUES - 1
+              && reader.readPatch(p.name, PATCH_NAME_LEN, p.values, PATCH_VALUES) && strcmp(p.name, "Lead") == 0 && p.values[1] == 7
+              && !reader.readPatch(p.name, PATCH_NAME_LEN, p.values, PATCH_VALUES);
+    printf("  %-22s %s\n", "extra fields", ok ? "ok" : "FAIL");
+    failed |= !ok;
+  }
+
+  //A buffer one short of the line fails cleanly, the exact size fits
+  {
+    char line[PATCH_LINE_LEN];
+    size_t length = formatPatchCsv(line, sizeof(line), bank[0].name, bank[0].values, PATCH_VALUES);
+    bool ok = length && formatPatchCsv(line, length, bank[0].name, bank[0].values, PATCH_VALUES) == 0
+              && formatPatchCsv(line, length + 1, bank[0].name, bank[0].values, PATCH_VALUES) == length;
+    printf("  %-22s %s\n", "output too small", ok ? "ok" : "FAIL");
+    failed |= !ok;
+  }
+
+  //Saved with the CR LF ending, replaced on the next save, read back by slot, a missing file isn't valid
+  {
+    PatchRecord record;
+    std::string saved = lines[0] + "\r\n";
+    bool ok = patchFileSave("1", lines[1].c_str()) && patchFileSave("1", lines[0].c_str())
+              && mockStorage.files["1"] == std::vector<uint8_t>(saved.begin(), saved.end()) && patchFileLoad(record, (uint16_t)1)
+              && strcmp(record.name, bank[0].name) == 0 && memcmp(&record.values[1], &bank[0].values[1], (PATCH_VALUES - 1) * sizeof(int16_t)) == 0
+              && !patchFileLoad(record, (uint16_t)2) && !record.valid;
+    printf("  %-22s %s\n", "patch files", ok ? "ok" : "FAIL");
+    failed |= !ok;
+  }
+  return failed ? 1 : 0;
+}
@@ -0,0 +1,200 @@
+/*
+  Pot to DAC latency harness, run on a PC with the same probe code as the sketch (PotLatency.h).
+
+  Build:  g++ -O2 -std=c++11 -o pot_latency pot_latency.cpp ../../DemuxMap.cpp
+  Usage:  pot_latency [options]
+
+  Options:
+    --steps N        probes per control (200)
+    --hold-us N      demux enable time, DEMUX_HOLD_US (800)
+    --mux-us N       checkMux() run time (40)
+    --other-us N     the rest of a loop() pass, MIDI, voices, storage (60)
+    --mux-first      run checkMux() before writeDemux() in a pass, setupTasks() has demux first
+    --demux-every N  writeDemux() on every Nth pass only (1)
+    --layer NAME     where myControlChange() stores values, upper, lower or whole (whole)
+    --max-p99 N      exit 1 if any control's p99 is over N us
+
+  Each pass runs checkMux() and writeDemux() as the scheduler does, on a virtual clock. Probes step one
+  mux input at a time from a random point in the pass, and the stages are timed by the PotLatency.h
+  hooks in the same places as in the sketch. The tables below mirror checkMux() and myControlChange().
+  Controls that don't have a demux output (pulse widths, detune, glide...) go to the voices over MIDI6,
+  POT_MIDI6 lists them. They aren't probed and show as n/a, a control missing from the list or listed
+  when the demux has it fails the run. writeDemux() leaves the enable open for the hold and moves on when it is up, so
+  the scan goes round several times for each demux channel and most of the latency is waiting for the
+  control's demux channel to come round.
+*/
+
+#define POT_LATENCY
+
+#include "../host/HalMock.h"
+#include "../../DemuxMap.h"
+#include "../../PotLatency.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#define QUANTISE_FACTOR 12  //HWControls.h
+
+//P_ index each mux input ends up in, -1 for the spare inputs
+static const int MUX_PARAMS[POT_MUXES][POT_CHANNELS] = {
+  { P_glideTime, P_osc1SawLevel, P_osc1PulseLevel, P_osc1PW, P_osc1PWM, P_osc2Detune, P_osc2Interval, P_fmDepth,
+    P_osc1SubLevel, P_osc2SawLevel, P_osc2PulseLevel, P_osc2TriangleLevel, P_osc2PW, P_osc2PWM, -1, -1 },
+  { P_filterAttack, P_filterDecay, P_filterSustain, P_filterRelease, P_ampAttack, P_ampDecay, P_ampSustain,
+    P_ampRelease, P_filterLFO, P_keytrack, P_filterCutoff, P_filterRes, P_filterEGlevel, -1, -1, -1 },
+  { P_PitchBendLevel, P_effectsMix, P_volumeControl, P_amDepth, -1, -1, P_noiseLevel, P_pwLFO, P_LFORate, P_LFODelay,
+    P_modWheelDepth, P_effectPot1, P_effectPot2, P_effectPot3, P_pmDCO2, P_pmFilterEnv },
+};
+
+static const char *const MUX_NAMES[POT_MUXES][POT_CHANNELS] = {
+  { "glide", "osc1 saw", "osc1 pulse", "osc1 pw", "osc1 pwm", "osc2 detune", "osc2 interval", "fm depth",
+    "osc1 sub", "osc2 saw", "osc2 pulse", "osc2 triangle", "osc2 pw", "osc2 pwm", "spare", "spare" },
+  { "filter attack", "filter decay", "filter sustain", "filter release", "amp attack", "amp decay", "amp sustain",
+    "amp release", "filter lfo", "keytrack", "cutoff", "resonance", "filter eg", "spare", "spare", "spare" },
+  { "bend depth", "fx mix", "volume", "am depth", "spare", "spare", "noise", "pw lfo", "lfo rate", "lfo delay",
+    "mod wheel", "fx pot1", "fx pot2", "fx pot3", "pm dco2", "pm filter env" },
+};
+
+static int upperData[76], lowerData[76];
+static int muxValuesPrev[POT_MUXES][POT_CHANNELS];
+static int muxInput = 0, muxOutput = 0;
+static uint32_t holdUs = 800, muxUs = 40, otherUs = 60;
+static std::string layer = "whole";
+
+static uint32_t seed = 12345;
+static uint32_t rnd(uint32_t range) {
+  seed = seed * 1664525 + 1013904223;
+  return (seed >> 8) % range;
+}
+
+static void myControlChange(int param, int value) {
+  POT_STAGE(POT_STAGE_CONTROL);
+  if (layer != "upper") lowerData[param] = value;
+  if (layer != "lower") upperData[param] = value;
+}
+
+static void checkMux() {
+  for (int m = 0; m < POT_MUXES; m++) {
+    int value = POT_READ(m, muxInput, hal.adc->read(m));
+    if (value > muxValuesPrev[m][muxInput] + QUANTISE_FACTOR || value < muxValuesPrev[m][muxInput] - QUANTISE_FACTOR) {
+      muxValuesPrev[m][muxInput] = value;
+      int param = MUX_PARAMS[m][muxInput];
+      if (param >= 0) myControlChange(param, param == P_osc2Interval || param == P_PitchBendLevel ? value * 12 / 1023 : value);
+    }
+  }
+  POT_STAGE(POT_STAGE_PARAM);
+  mockClock.advance(muxUs);
+  muxInput = (muxInput + 1) % POT_CHANNELS;
+}
+
+//Doesn't wait out the hold, the first call after holdUs closes the enable and moves on
+static void writeDemux() {
+  static bool open = false;
+  static uint32_t openedAt = 0;
+  if (open) {
+    if (mockClock.now - openedAt < holdUs) return;
+    open = false;
+    muxOutput = (muxOutput + 1) % POT_CHANNELS;
+  }
+  uint32_t words[4];
+  demuxWords(muxOutput, upperData, lowerData, words);
+  POT_DEMUX(muxOutput, words);
+  hal.dac->write(10, words, 4);
+  POT_STAGE(POT_STAGE_DAC);
+  openedAt = mockClock.now;
+  open = true;
+}
+
+int main(int argc, char **argv) {
+  uint32_t steps = 200, demuxEvery = 1, maxP99 = 0;
+  bool muxFirst = false;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (arg == "--mux-first") {
+      muxFirst = true;
+      continue;
+    }
+    if (i + 1 >= argc) {
+      fprintf(stderr, "%s needs a value\n", argv[i]);
+      return 1;
+    }
+    const char *value = argv[++i];
+    if (arg == "--steps") steps = atoi(value);
+    else if (arg == "--hold-us") holdUs = atoi(value);
+    else if (arg == "--mux-us") muxUs = atoi(value);
+    else if (arg == "--other-us") otherUs = atoi(value);
+    else if (arg == "--demux-every") demuxEvery = atoi(value);
+    else if (arg == "--layer") layer = value;
+    else if (arg == "--max-p99") maxP99 = atoi(value);
+    else {
+      fprintf(stderr, "Unknown option %s\n", argv[i - 1]);
+      return 1;
+    }
+  }
+  if (!steps || !demuxEvery || (layer != "upper" && layer != "lower" && layer != "whole")) {
+    fprintf(stderr, "steps and demux-every start at 1, layer is upper, lower or whole\n");
+    return 1;
+  }
+
+  upperData[P_LFODelayGo] = lowerData[P_LFODelayGo] = 1;
+  for (int m = 0; m < POT_MUXES; m++) mockAdc.values[m] = 300;
+  potLatencyReset();
+
+  //Settle the pots and the demux before the first probe
+  for (uint32_t pass = 0; pass < POT_CHANNELS * 4 * (holdUs / (muxUs + otherUs) + 1); pass++) {
+    writeDemux();
+    checkMux();
+    mockClock.advance(otherUs);
+  }
+
+  uint32_t passes = 0;
+  int failed = 0;
+  for (int i = 0; i < POT_CONTROLS; i++) {
+    int param = MUX_PARAMS[i / POT_CHANNELS][i % POT_CHANNELS], channel;
+    bool onB;
+    if (param >= 0 && potMidi6(i) == demuxLocate(param, channel, onB)) {
+      printf("%s %s in POT_MIDI6\n", MUX_NAMES[i / POT_CHANNELS][i % POT_CHANNELS], potMidi6(i) ? "shouldn't be" : "should be");
+      failed = 1;
+    }
+  }
+
+  for (uint32_t probe = 0; probe < steps * POT_CONTROLS; probe++) {
+    if (MUX_PARAMS[probe / POT_CHANNELS % POT_MUXES][probe % POT_CHANNELS] < 0 || potMidi6(probe % POT_CONTROLS)) continue;
+    //Somewhere new in the pass and in both pointer cycles
+    mockClock.advance(rnd(holdUs + muxUs + otherUs));
+    for (uint32_t skip = rnd(POT_CHANNELS * demuxEvery); skip; skip--) {
+      if (passes++ % demuxEvery == 0) writeDemux();
+      checkMux();
+      mockClock.advance(otherUs);
+    }
+    potLatencyStart(probe % POT_CONTROLS);
+    uint32_t start = mockClock.now;
+    while (potProbe.active) {
+      if (muxFirst) checkMux();
+      if (passes++ % demuxEvery == 0) writeDemux();
+      if (!muxFirst) checkMux();
+      mockClock.advance(otherUs);
+      if (mockClock.now - start > POT_TIMEOUT_US) potLatencyFinish(true);
+    }
+  }
+
+  printf("%s first, hold %u us, mux %u us, other %u us, demux every %u pass%s, %s layer\n", muxFirst ? "mux" : "demux",
+         holdUs, muxUs, otherUs, demuxEvery, demuxEvery > 1 ? "es" : "", layer.c_str());
+  char line[112];
+  potLatencyHeader(line, sizeof(line));
+  printf("%-17s%s\n", "control", line);
+  for (int i = 0; i < POT_CONTROLS; i++) {
+    if (MUX_PARAMS[i / POT_CHANNELS][i % POT_CHANNELS] < 0) continue;
+    potLatencyLine(i, line, sizeof(line));
+    printf("%-17s%s\n", MUX_NAMES[i / POT_CHANNELS][i % POT_CHANNELS], line);
+  }
+
+  for (int i = 0; i < POT_CONTROLS; i++) {
+    const PotControl &c = potControls[i];
+    if (maxP99 && c.count && potLatencyPercentile(c, 99) > maxP99) {
+      printf("%s p99 %u us is over %u us\n", MUX_NAMES[i / POT_CHANNELS][i % POT_CHANNELS], potLatencyPercentile(c, 99), maxP99);
+      failed = 1;
+    }
+  }
+  return failed;
+}
@@ -0,0 +1,109 @@
+/*
+  Loop profiler test, run on a PC against Profiler.h with its std::chrono backend.
+
+  Build:  g++ -O2 -std=c++11 -o profiler profiler.cpp
+  Usage:  profiler [-v]
+
+  Records known tick counts and checks each stage's count, min, max, total, histogram and p99, that
+  stages are kept apart and profileReset() clears them. Then times busy waits of a known length with
+  PROFILE_SCOPE, nested so the inner stage has to come out shorter than the outer one, and checks the
+  report prints two lines for each stage that has samples. -v prints the report.
+*/
+
+#define LOOP_PROFILER
+#include "../../Profiler.h"
+
+#include <cstdio>
+#include <string>
+#include <vector>
+
+static std::vector<std::string> reportLines;
+
+static void collect(const char *line) {
+  reportLines.push_back(line);
+}
+
+static int failed = 0;
+
+static void check(const char *name, bool ok) {
+  printf("  %-38s %s\n", name, ok ? "ok" : "FAIL");
+  failed |= !ok;
+}
+
+static void spin(uint32_t us) {
+  uint32_t start = profileTicks();
+  while (profileTicks() - start < us * PROFILE_TICKS_PER_US) {}
+}
+
+static void timed(uint32_t outerUs, uint32_t innerUs) {
+  PROFILE_SCOPE(PROFILE_DISPLAY);
+  spin(outerUs - innerUs);
+  {
+    PROFILE_SCOPE(PROFILE_I2C);
+    spin(innerUs);
+  }
+}
+
+int main(int argc, char **argv) {
+  bool verbose = argc > 1 && std::string(argv[1]) == "-v";
+
+  check("bucket edges", profileBucket(0) == 0 && profileBucket(1) == 0 && profileBucket(2) == 1 && profileBucket(3) == 1
+                            && profileBucket(1024) == 10 && profileBucket(0xFFFFFFFF) == 31);
+
+  //98 samples of 10 ticks and 2 of 5000, the p99 falls in the 4096-8191 bucket
+  for (int i = 0; i < 98; i++) profileRecord(PROFILE_MIDI, 10);
+  for (int i = 0; i < 2; i++) profileRecord(PROFILE_MIDI, 5000);
+  const ProfileStage &midi = profileStages[PROFILE_MIDI];
+  check("count, min, max, total", midi.count == 100 && midi.min == 10 && midi.max == 5000 && midi.total == 98 * 10 + 2 * 5000);
+  check("histogram", midi.histogram[3] == 98 && midi.histogram[12] == 2);
+  check("p99 is the upper edge of its bucket", profilePercentile(midi, 99) == 8191 && profilePercentile(midi, 50) == 15);
+
+  //One slow sample in 200 stays out of the p99
+  profileRecord(PROFILE_MUX, 100000);
+  for (int i = 0; i < 199; i++) profileRecord(PROFILE_MUX, 200);
+  check("outlier outside the p99", profilePercentile(profileStages[PROFILE_MUX], 99) == 255
+                                       && profileStages[PROFILE_MUX].max == 100000);
+  check("p99 of the top bucket", [] {
+    ProfileStage s = ProfileStage();
+    s.count = 1;
+    s.histogram[31] = 1;
+    return profilePercentile(s, 99) == 0xFFFFFFFF;
+  }());
+
+  bool apart = true;
+  for (int i = 0; i < PROFILE_STAGES; i++) {
+    if (i != PROFILE_MIDI && i != PROFILE_MUX) apart &= profileStages[i].count == 0;
+  }
+  check("stages kept apart", apart);
+
+  profileReset();
+  bool cleared = true;
+  for (int i = 0; i < PROFILE_STAGES; i++) {
+    const ProfileStage &s = profileStages[i];
+    cleared &= s.count == 0 && s.total == 0 && s.max == 0;
+    for (int b = 0; b < PROFILE_BUCKETS; b++) cleared &= s.histogram[b] == 0;
+  }
+  check("reset clears every stage", cleared);
+
+  //200us outer scope with a 100us inner one, being preempted by the OS can only make them longer
+  for (int i = 0; i < 20; i++) timed(200, 100);
+  const ProfileStage &outer = profileStages[PROFILE_DISPLAY];
+  const ProfileStage &inner = profileStages[PROFILE_I2C];
+  check("scope counts", outer.count == 20 && inner.count == 20);
+  check("scope times at least the wait", outer.min >= 200 * PROFILE_TICKS_PER_US && inner.min >= 100 * PROFILE_TICKS_PER_US);
+  check("inner scope inside the outer", inner.total < outer.total);
+  if (verbose) {
+    printf("  outer min %.1f avg %.1f us, inner min %.1f avg %.1f us\n", (float)outer.min / PROFILE_TICKS_PER_US,
+           (float)outer.total / outer.count / PROFILE_TICKS_PER_US, (float)inner.min / PROFILE_TICKS_PER_US,
+           (float)inner.total / inner.count / PROFILE_TICKS_PER_US);
+  }
+
+  profileReport(collect);
+  bool report = reportLines.size() == 5 && reportLines[1].compare(0, 3, "i2c") == 0
+                && reportLines[3].compare(0, 7, "display") == 0 && reportLines[2].compare(0, 7, "  log2:") == 0;
+  check("report lines for the timed stages", report);
+  if (verbose || !report) {
+    for (const std::string &line : reportLines) printf("      %s\n", line.c_str());
+  }
+  return failed;
+}
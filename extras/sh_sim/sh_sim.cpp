@@ -0,0 +1,303 @@
+/*
+  Sample and hold simulator for the demux CV outputs, run on a PC.
+
+  Build:  g++ -O2 -std=c++11 -o sh_sim sh_sim.cpp ../../DemuxMap.cpp
+  Usage:  sh_sim [options]
+
+  Options:
+    --seconds N       simulated time (20)
+    --pass-us N       time between writeDemux() calls (1000)
+    --hold-us N       time the demux is enabled after the DAC words are sent (800, as in writeDemux())
+    --tau-us N        hold capacitor charge time constant through the demux (50)
+    --droop2 N        droop in mV/ms for the MULT2V outputs (0.5)
+    --droop5 N        droop in mV/ms for the MULT5V outputs (1.0)
+    --droop33 N       droop in mV/ms for the MULT33V outputs (0.7)
+    --dac-volts N     output voltage for a full scale DAC word (10)
+    --tolerance N     settled when within this many mV of the new value (5)
+    --changes N       random parameter changes a second (50)
+    --trace FILE      parameter changes from a file instead, "time_us upper|lower param value" per line
+    --scheduler NAME  sequential (writeDemux() today) or dirty (changed channels first, then sequential)
+
+  Each of the 16 channels loads four DAC outputs with the words from DemuxMap.h and then enables its
+  hold capacitors for hold-us. While a capacitor is connected it charges towards the DAC voltage,
+  otherwise it droops towards 0V.
+  Staleness is measured from a parameter change to the held voltage first being within tolerance of
+  the new value. Ripple is the largest droop seen between two refreshes while the value is steady.
+*/
+
+#include "../../DemuxMap.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+#define CHANNELS 16
+#define OUTPUTS 4  //A upper, C lower, B upper, D lower, the order demuxWords() fills them
+
+struct Change {
+  uint64_t time;
+  bool upper;
+  int param;
+  int value;
+};
+
+struct Cv {
+  const DemuxSource *source;
+  bool upper;
+  double droop;   //V/us
+  double volts;   //Held voltage at lastTime
+  uint64_t lastTime;
+  double target;  //DAC voltage it will charge to next time it is connected
+  bool pending;   //A change hasn't settled yet
+  uint64_t changedAt;
+  double refreshedAt;  //Voltage at the end of the last refresh, for ripple
+  bool steady;
+  std::vector<uint32_t> staleness;
+  double ripple;
+};
+
+static uint32_t passUs = 1000, holdUs = 800;
+static double tauUs = 50, dacVolts = 10, tolerance = 0.005;
+static double droop2 = 0.5, droop5 = 1.0, droop33 = 0.7;  //mV/ms
+
+static int upperData[76], lowerData[76];
+static Cv cvs[CHANNELS][OUTPUTS];
+
+static const char *paramName(int param) {
+  switch (param) {
+    case P_noiseLevel: return "noise";
+    case P_filterAttack: return "filter attack";
+    case P_osc1SawLevel: return "osc1 saw";
+    case P_filterDecay: return "filter decay";
+    case P_osc1PulseLevel: return "osc1 pulse";
+    case P_filterSustain: return "filter sustain";
+    case P_osc1SubLevel: return "osc1 sub";
+    case P_filterRelease: return "filter release";
+    case P_pmDCO2: return "pm dco2";
+    case P_ampAttack: return "amp attack";
+    case P_pmFilterEnv: return "pm filter env";
+    case P_ampDecay: return "amp decay";
+    case P_osc2SawLevel: return "osc2 saw";
+    case P_ampSustain: return "amp sustain";
+    case P_osc2PulseLevel: return "osc2 pulse";
+    case P_ampRelease: return "amp release";
+    case P_osc2TriangleLevel: return "osc2 triangle";
+    case P_filterEGlevel: return "filter eg";
+    case P_volumeControl: return "volume";
+    case P_filterCutoff: return "cutoff";
+    case P_effectsMix: return "fx mix";
+    case P_filterRes: return "resonance";
+    case P_fmDepth: return "fm depth";
+    case P_LFORate: return "lfo rate";
+    case P_filterLFO: return "filter lfo";
+    case P_LFOWaveform: return "lfo wave";
+    case P_amDepth: return "am depth";
+    case P_effectPot1: return "fx pot1";
+    case P_effectPot2: return "fx pot2";
+    case P_effectPot3: return "fx pot3";
+    case P_pwLFO: return "pw lfo";
+    default: return "?";
+  }
+}
+
+static double wordVolts(uint32_t word) {
+  return ((word >> 4) & 0xFFFF) * dacVolts / 65536.0;
+}
+
+static double droopFor(double scale) {
+  double mvPerMs = scale == MULT2V ? droop2 : scale == MULT33V ? droop33 : droop5;
+  return mvPerMs / 1000.0 / 1000.0;
+}
+
+//Leakage between refreshes, towards 0V
+static void droopTo(Cv &cv, uint64_t now) {
+  double drop = cv.droop * (now - cv.lastTime);
+  cv.volts = cv.volts > 0 ? std::max(0.0, cv.volts - drop) : std::min(0.0, cv.volts + drop);
+  cv.lastTime = now;
+}
+
+static void setTargets(int channel) {
+  uint32_t words[4];
+  demuxWords(channel, upperData, lowerData, words);
+  for (int o = 0; o < OUTPUTS; o++) cvs[channel][o].target = wordVolts(words[o]);
+}
+
+//The channel's capacitors are connected from start for holdUs
+static void refresh(int channel, uint64_t start) {
+  setTargets(channel);
+  for (int o = 0; o < OUTPUTS; o++) {
+    Cv &cv = cvs[channel][o];
+    if (!cv.source) continue;
+    droopTo(cv, start);
+    if (cv.steady && cv.refreshedAt != 0) cv.ripple = std::max(cv.ripple, std::fabs(cv.refreshedAt - cv.volts));
+    double error = std::fabs(cv.volts - cv.target);
+    if (cv.pending && error > tolerance) {
+      double settle = tauUs * std::log(error / tolerance);
+      if (settle <= holdUs) {
+        cv.staleness.push_back((uint32_t)(start + settle - cv.changedAt));
+        cv.pending = false;
+      }
+    } else if (cv.pending) {
+      cv.staleness.push_back((uint32_t)(start - cv.changedAt));
+      cv.pending = false;
+    }
+    cv.volts = cv.target + (cv.volts - cv.target) * std::exp(-(double)holdUs / tauUs);
+    cv.lastTime = start + holdUs;
+    cv.steady = !cv.pending;
+    cv.refreshedAt = cv.volts;
+  }
+}
+
+static void applyChange(const Change &c) {
+  (c.upper ? upperData : lowerData)[c.param] = c.value;
+  for (int ch = 0; ch < CHANNELS; ch++) {
+    uint32_t words[4];
+    demuxWords(ch, upperData, lowerData, words);
+    for (int o = 0; o < OUTPUTS; o++) {
+      Cv &cv = cvs[ch][o];
+      if (!cv.source) continue;
+      double target = wordVolts(words[o]);
+      bool touched = cv.source->param == c.param && (cv.upper == c.upper || (cv.source->flags & DEMUX_UPPER_ONLY));
+      if (!touched && !(c.param == P_LFODelayGo && (cv.source->flags & DEMUX_LFO_GATED))) continue;
+      droopTo(cv, c.time);
+      if (std::fabs(target - cv.volts) <= tolerance) continue;
+      if (!cv.pending) cv.changedAt = c.time;  //Staleness runs from the first change not yet out
+      cv.pending = true;
+      cv.steady = false;
+    }
+  }
+}
+
+static std::vector<Change> randomChanges(uint32_t seconds, double perSecond) {
+  std::vector<Change> changes;
+  uint32_t seed = 12345;
+  auto rnd = [&]() {
+    seed = seed * 1664525 + 1013904223;
+    return seed >> 8;
+  };
+  std::vector<int> params;
+  for (int ch = 0; ch < CHANNELS; ch++) {
+    if (DEMUX_MAP[ch].a.param != DEMUX_ZERO) params.push_back(DEMUX_MAP[ch].a.param);
+    params.push_back(DEMUX_MAP[ch].b.param);
+  }
+  uint64_t end = (uint64_t)seconds * 1000000;
+  double gap = 1000000.0 / perSecond;
+  for (double t = 0; t < end; t += gap * (0.5 + (rnd() % 1000) / 1000.0)) {
+    changes.push_back({ (uint64_t)t, rnd() % 2 == 0, params[rnd() % params.size()], (int)(rnd() % 1024) });
+  }
+  return changes;
+}
+
+static bool readTrace(const char *path, std::vector<Change> &changes) {
+  FILE *f = fopen(path, "r");
+  if (!f) return false;
+  char layer[16];
+  unsigned long long time;
+  int param, value;
+  while (fscanf(f, "%llu %15s %d %d", &time, layer, &param, &value) == 4) {
+    if (param >= 0 && param < 76) changes.push_back({ time, std::string(layer) == "upper", param, value });
+  }
+  fclose(f);
+  std::stable_sort(changes.begin(), changes.end(), [](const Change &a, const Change &b) { return a.time < b.time; });
+  return true;
+}
+
+static uint32_t percentile(std::vector<uint32_t> v, int percent) {
+  if (v.empty()) return 0;
+  std::sort(v.begin(), v.end());
+  size_t index = (v.size() * percent + 99) / 100;
+  return v[index ? index - 1 : 0];
+}
+
+int main(int argc, char **argv) {
+  uint32_t seconds = 20;
+  double perSecond = 50;
+  const char *trace = NULL;
+  std::string scheduler = "sequential";
+  for (int i = 1; i + 1 < argc; i += 2) {
+    std::string arg = argv[i];
+    const char *value = argv[i + 1];
+    if (arg == "--seconds") seconds = atoi(value);
+    else if (arg == "--pass-us") passUs = atoi(value);
+    else if (arg == "--hold-us") holdUs = atoi(value);
+    else if (arg == "--tau-us") tauUs = atof(value);
+    else if (arg == "--droop2") droop2 = atof(value);
+    else if (arg == "--droop5") droop5 = atof(value);
+    else if (arg == "--droop33") droop33 = atof(value);
+    else if (arg == "--dac-volts") dacVolts = atof(value);
+    else if (arg == "--tolerance") tolerance = atof(value) / 1000.0;
+    else if (arg == "--changes") perSecond = atof(value);
+    else if (arg == "--trace") trace = value;
+    else if (arg == "--scheduler") scheduler = value;
+    else {
+      fprintf(stderr, "Unknown option %s\n", argv[i]);
+      return 1;
+    }
+  }
+  if (passUs < holdUs || tauUs <= 0 || perSecond <= 0 || (scheduler != "sequential" && scheduler != "dirty")) {
+    fprintf(stderr, "pass-us has to cover hold-us, scheduler is sequential or dirty\n");
+    return 1;
+  }
+
+  std::vector<Change> changes;
+  if (trace ? !readTrace(trace, changes) : (changes = randomChanges(seconds, perSecond), false)) {
+    perror(trace);
+    return 1;
+  }
+
+  upperData[P_LFODelayGo] = lowerData[P_LFODelayGo] = 1;
+  for (int ch = 0; ch < CHANNELS; ch++) {
+    const DemuxChannel &map = DEMUX_MAP[ch];
+    const DemuxSource *sources[OUTPUTS] = { &map.a, &map.a, &map.b, &map.b };
+    for (int o = 0; o < OUTPUTS; o++) {
+      bool used = sources[o]->param != DEMUX_ZERO && !(o == 1 && (sources[o]->flags & DEMUX_UPPER_ONLY));
+      cvs[ch][o] = Cv();
+      cvs[ch][o].source = used ? sources[o] : NULL;
+      cvs[ch][o].upper = o == 0 || o == 2;
+      cvs[ch][o].droop = droopFor(sources[o]->scale);
+    }
+  }
+
+  uint64_t end = (uint64_t)seconds * 1000000;
+  size_t next = 0;
+  int sequence = 0;
+  for (uint64_t now = 0; now < end; now += passUs) {
+    for (; next < changes.size() && changes[next].time <= now; next++) applyChange(changes[next]);
+    int channel = sequence;
+    if (scheduler == "dirty") {
+      //Oldest outstanding change first, the normal sequence when nothing is waiting
+      uint64_t oldest = UINT64_MAX;
+      for (int ch = 0; ch < CHANNELS; ch++) {
+        for (int o = 0; o < OUTPUTS; o++) {
+          if (cvs[ch][o].pending && cvs[ch][o].changedAt < oldest) {
+            oldest = cvs[ch][o].changedAt;
+            channel = ch;
+          }
+        }
+      }
+    }
+    refresh(channel, now);
+    if (channel == sequence) sequence = (sequence + 1) % CHANNELS;
+  }
+
+  printf("%s scheduler, pass %u us, hold %u us, tau %.0f us, %zu changes\n", scheduler.c_str(), passUs, holdUs, tauUs, changes.size());
+  printf("ch out  parameter        changes   p50 ms   p99 ms   max ms  ripple mV\n");
+  std::vector<uint32_t> all;
+  double worstRipple = 0;
+  for (int ch = 0; ch < CHANNELS; ch++) {
+    for (int o = 0; o < OUTPUTS; o++) {
+      const Cv &cv = cvs[ch][o];
+      if (!cv.source) continue;
+      all.insert(all.end(), cv.staleness.begin(), cv.staleness.end());
+      worstRipple = std::max(worstRipple, cv.ripple);
+      uint32_t worst = cv.staleness.empty() ? 0 : *std::max_element(cv.staleness.begin(), cv.staleness.end());
+      printf("%2d  %c   %-15s %8zu %8.2f %8.2f %8.2f %10.2f\n", ch, "ACBD"[o], paramName(cv.source->param), cv.staleness.size(),
+             percentile(cv.staleness, 50) / 1000.0, percentile(cv.staleness, 99) / 1000.0, worst / 1000.0, cv.ripple * 1000);
+    }
+  }
+  printf("all             %8zu %8.2f %8.2f          %10.2f\n", all.size(), percentile(all, 50) / 1000.0, percentile(all, 99) / 1000.0, worstRipple * 1000);
+  return 0;
+}
@@ -0,0 +1,438 @@
+/*
+  Host client for the USB serial bank transfer (UsbTransfer.h on the synth).
+
+  Build:  g++ -O2 -std=c++11 -o usb_bank usb_bank.cpp
+  Usage:  usb_bank <port> info
+          usb_bank <port> backup <file>
+          usb_bank <port> restore <file>
+          usb_bank loopback <file> [options]
+
+  Backup files hold every patch and the settings:
+    "ABMK", version u8, patch count u16, patch records (USB_PATCH payloads),
+    settings size u16, settings bytes, crc32 of everything before it.
+
+  Loopback runs info, backup to <file> and restore from it against a stand-in for UsbTransfer.h on a
+  modelled USB link instead of a port, and checks the bank and settings come back the same. Times are
+  the modelled ones, so the full bank transfer time can be had without the synth.
+
+  Loopback options:
+    --patches N       patches in the stand-in's bank (999)
+    --bytes-per-ms N  USB serial throughput either way (4000)
+    --latency-us N    a byte's trip across USB and the host's serial driver (500)
+    --loop-us N       how often loop() calls checkUsbTransfer() (100)
+    --tx-buffer N     Serial's transmit buffer on the synth, availableForWrite() when empty (8192)
+    --chatter-ms N    a debug line printed between the frames this often, 0 for none (20)
+    --seed N          random seed (1)
+*/
+
+#include "../../UsbFrame.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <fcntl.h>
+#include <poll.h>
+#include <string>
+#include <termios.h>
+#include <unistd.h>
+#include <vector>
+
+#define TIMEOUT_MS 2000
+
+static int port = -1;
+static UsbFrameParser parser;
+static bool loopback = false;
+
+//Modelled USB link for loopback, see the stand-in below
+static uint32_t bytesPerMs = 4000, latencyUs = 500, loopUs = 100, txBuffer = 8192, chatterMs = 20;
+static uint32_t simNow = 0;  //us
+static void loopbackWrite(const uint8_t *data, size_t length);
+static bool loopbackRead(std::vector<uint8_t> &pending, uint32_t deadline);
+
+static bool openPort(const char *path) {
+  port = open(path, O_RDWR | O_NOCTTY);
+  if (port < 0) {
+    perror(path);
+    return false;
+  }
+  termios tty;
+  tcgetattr(port, &tty);
+  cfmakeraw(&tty);
+  cfsetspeed(&tty, B115200);  //Ignored by USB serial, the link runs at USB speed
+  tcsetattr(port, TCSANOW, &tty);
+  tcflush(port, TCIOFLUSH);
+  return true;
+}
+
+static bool sendFrame(uint8_t cmd, const uint8_t *payload, uint16_t len) {
+  uint8_t frame[USB_MAX_PAYLOAD + USB_FRAME_OVERHEAD];
+  size_t n = encodeUsbFrame(cmd, payload, len, frame);
+  if (loopback) {
+    loopbackWrite(frame, n);
+    return true;
+  }
+  return write(port, frame, n) == (ssize_t)n;
+}
+
+//Wait for the next good frame, anything else on the port (debug prints) is skipped
+static bool readFrame() {
+  uint8_t buffer[512];
+  static std::vector<uint8_t> pending;
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(TIMEOUT_MS);
+  uint32_t simDeadline = simNow + TIMEOUT_MS * 1000;
+  while (true) {
+    while (!pending.empty()) {
+      uint8_t byte = pending.front();
+      pending.erase(pending.begin());
+      if (parser.feed(byte) == USB_FRAME_READY) return true;
+    }
+    if (loopback) {
+      if (!loopbackRead(pending, simDeadline)) return false;
+      continue;
+    }
+    int left = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+    if (left <= 0) return false;
+    pollfd fd = { port, POLLIN, 0 };
+    if (poll(&fd, 1, left) <= 0) return false;
+    ssize_t got = read(port, buffer, sizeof(buffer));
+    if (got <= 0) return false;
+    pending.insert(pending.end(), buffer, buffer + got);
+  }
+}
+
+static bool expect(uint8_t cmd) {
+  while (readFrame()) {
+    if (parser.cmd() == cmd) return true;
+    if (parser.cmd() == USB_NAK) return false;
+  }
+  fprintf(stderr, "Timed out waiting for reply\n");
+  return false;
+}
+
+//Wall clock, or the modelled one in loopback
+static double clockSeconds() {
+  if (loopback) return simNow / 1e6;
+  return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static int info() {
+  if (!sendFrame(USB_HELLO, nullptr, 0) || !expect(USB_INFO)) return 1;
+  const uint8_t *p = parser.payload();
+  printf("Protocol %d, %d patches, %d settings bytes\n", p[0], getU16(&p[1]), getU16(&p[3]));
+  return 0;
+}
+
+static int backup(const char *file) {
+  double start = clockSeconds();
+  std::vector<uint8_t> data = { 'A', 'B', 'M', 'K', USB_PROTOCOL_VERSION, 0, 0 };
+  int count = 0;
+  if (!sendFrame(USB_GET_BANK, nullptr, 0)) return 1;
+  while (true) {
+    if (!readFrame()) {
+      fprintf(stderr, "Timed out after %d patches\n", count);
+      return 1;
+    }
+    if (parser.cmd() == USB_END) break;
+    if (parser.cmd() != USB_PATCH || parser.payloadLength() != USB_PATCH_PAYLOAD) continue;
+    data.insert(data.end(), parser.payload(), parser.payload() + USB_PATCH_PAYLOAD);
+    count++;
+  }
+  putU16(&data[5], count);
+  double bankTime = clockSeconds() - start;
+
+  if (!sendFrame(USB_GET_SETTINGS, nullptr, 0) || !expect(USB_SETTINGS)) return 1;
+  uint8_t size[2];
+  putU16(size, parser.payloadLength());
+  data.insert(data.end(), size, size + 2);
+  data.insert(data.end(), parser.payload(), parser.payload() + parser.payloadLength());
+  uint32_t crc = crc32(data.data(), data.size());
+  for (int i = 0; i < 4; i++) data.push_back(crc >> (8 * i));
+
+  FILE *out = fopen(file, "wb");
+  if (!out || fwrite(data.data(), 1, data.size(), out) != data.size()) {
+    perror(file);
+    return 1;
+  }
+  fclose(out);
+  printf("Backed up %d patches in %.3fs (%.0f bytes/s), %zu bytes written\n", count, bankTime,
+         count * (USB_PATCH_PAYLOAD + USB_FRAME_OVERHEAD) / bankTime, data.size());
+  return 0;
+}
+
+static int restore(const char *file) {
+  FILE *in = fopen(file, "rb");
+  if (!in) {
+    perror(file);
+    return 1;
+  }
+  std::vector<uint8_t> data;
+  uint8_t buffer[4096];
+  size_t got;
+  while ((got = fread(buffer, 1, sizeof(buffer), in)) > 0) data.insert(data.end(), buffer, buffer + got);
+  fclose(in);
+
+  if (data.size() < 13 || memcmp(data.data(), "ABMK", 4) != 0) {
+    fprintf(stderr, "Not a bank backup\n");
+    return 1;
+  }
+  uint32_t crc = 0;
+  for (int i = 0; i < 4; i++) crc |= (uint32_t)data[data.size() - 4 + i] << (8 * i);
+  if (crc != crc32(data.data(), data.size() - 4)) {
+    fprintf(stderr, "Backup checksum doesn't match\n");
+    return 1;
+  }
+  int count = getU16(&data[5]);
+  size_t pos = 7;
+  if (pos + (size_t)count * USB_PATCH_PAYLOAD + 2 > data.size() - 4) {
+    fprintf(stderr, "Backup is truncated\n");
+    return 1;
+  }
+
+  double start = clockSeconds();
+  for (int i = 0; i < count; i++, pos += USB_PATCH_PAYLOAD) {
+    if (!sendFrame(USB_PATCH, &data[pos], USB_PATCH_PAYLOAD) || !expect(USB_ACK)) {
+      fprintf(stderr, "Patch %d refused\n", getU16(&data[pos]));
+      return 1;
+    }
+  }
+  double bankTime = clockSeconds() - start;
+
+  int settingsSize = getU16(&data[pos]);
+  pos += 2;
+  if (!sendFrame(USB_SETTINGS, &data[pos], settingsSize) || !expect(USB_ACK)) {
+    fprintf(stderr, "Settings refused\n");
+    return 1;
+  }
+  printf("Restored %d patches in %.3fs (%.0f bytes/s), settings apply after a power cycle\n", count, bankTime,
+         count * (USB_PATCH_PAYLOAD + USB_FRAME_OVERHEAD) / bankTime);
+  return 0;
+}
+
+//The synth's side for loopback: handleUsbFrame() and checkUsbTransfer() from UsbTransfer.h with the
+//bank as USB_PATCH payloads. Restored patches are taken as storeIncomingPatch() takes them, the card
+//write goes to the storage worker so the ack doesn't wait for it.
+struct StandIn {
+  std::vector<std::vector<uint8_t>> bank;  //By patch no - 1
+  std::vector<uint8_t> settings;
+  UsbFrameParser parser;
+  std::deque<uint8_t> tx;  //Serial's transmit buffer
+  bool dumpActive = false;
+  size_t dumpNext = 0;
+
+  size_t availableForWrite() const {
+    return tx.size() < txBuffer ? txBuffer - tx.size() : 0;
+  }
+
+  void send(uint8_t cmd, const uint8_t *payload, uint16_t len) {
+    uint8_t frame[USB_MAX_PAYLOAD + USB_FRAME_OVERHEAD];
+    size_t n = encodeUsbFrame(cmd, payload, len, frame);
+    tx.insert(tx.end(), frame, frame + n);
+  }
+
+  void reply(uint8_t cmd, uint8_t ackCmd, uint16_t value) {
+    uint8_t payload[3] = { ackCmd };
+    putU16(&payload[1], value);
+    send(cmd, payload, sizeof(payload));
+  }
+
+  void handle() {
+    const uint8_t *payload = parser.payload();
+    uint16_t len = parser.payloadLength();
+    switch (parser.cmd()) {
+      case USB_HELLO:
+        {
+          uint8_t info[5] = { USB_PROTOCOL_VERSION };
+          putU16(&info[1], bank.size());
+          putU16(&info[3], settings.size());
+          send(USB_INFO, info, sizeof(info));
+        }
+        break;
+      case USB_GET_BANK:
+        dumpActive = true;
+        dumpNext = 0;
+        break;
+      case USB_PATCH:
+        {
+          size_t patchNo = len == USB_PATCH_PAYLOAD ? getU16(payload) : 0;
+          if (patchNo < 1 || patchNo > bank.size() + 1 || patchNo > 999) {
+            reply(USB_NAK, USB_PATCH, patchNo);
+            break;
+          }
+          if (patchNo == bank.size() + 1) bank.emplace_back();
+          bank[patchNo - 1].assign(payload, payload + len);
+          reply(USB_ACK, USB_PATCH, patchNo);
+        }
+        break;
+      case USB_GET_SETTINGS:
+        send(USB_SETTINGS, settings.data(), settings.size());
+        break;
+      case USB_SETTINGS:
+        settings.assign(payload, payload + len);
+        reply(USB_ACK, USB_SETTINGS, 0);
+        break;
+    }
+  }
+
+  void loop(std::deque<uint8_t> &rx) {
+    while (!rx.empty()) {
+      uint8_t c = rx.front();
+      rx.pop_front();
+      if (parser.feed(c) == USB_FRAME_READY) handle();
+    }
+    while (dumpActive && availableForWrite() >= USB_PATCH_PAYLOAD + USB_FRAME_OVERHEAD) {
+      if (dumpNext >= bank.size()) {
+        uint8_t end[2];
+        putU16(end, bank.size());
+        send(USB_END, end, sizeof(end));
+        dumpActive = false;
+        break;
+      }
+      const std::vector<uint8_t> &patch = bank[dumpNext++];
+      send(USB_PATCH, patch.data(), patch.size());
+    }
+  }
+};
+
+static StandIn synth;
+static std::deque<std::pair<uint32_t, uint8_t>> toSynth, toHost;  //Bytes on the link and when they arrive
+static uint32_t nextLoop = 0, nextChatter = 0;
+static double hostFree = 0, txCredit = 0;
+
+//Host writes queue behind each other at the link rate
+static void loopbackWrite(const uint8_t *data, size_t length) {
+  if (hostFree < simNow) hostFree = simNow;
+  for (size_t i = 0; i < length; i++) {
+    hostFree += 1000.0 / bytesPerMs;
+    toSynth.push_back({ (uint32_t)hostFree + latencyUs, data[i] });
+  }
+}
+
+//A modelled microsecond: loop() when it's due, then Serial's buffer drains onto the link
+static void loopbackStep() {
+  if (simNow >= nextLoop) {
+    std::deque<uint8_t> rx;
+    while (!toSynth.empty() && toSynth.front().first <= simNow) {
+      rx.push_back(toSynth.front().second);
+      toSynth.pop_front();
+    }
+    if (chatterMs && simNow >= nextChatter) {
+      static const char line[] = "Debug print between the frames\r\n";
+      if (synth.availableForWrite() >= sizeof(line)) synth.tx.insert(synth.tx.end(), line, line + sizeof(line) - 1);
+      nextChatter += chatterMs * 1000;
+    }
+    synth.loop(rx);
+    nextLoop += loopUs;
+  }
+  txCredit += bytesPerMs / 1000.0;
+  while (txCredit >= 1 && !synth.tx.empty()) {
+    toHost.push_back({ simNow + latencyUs, synth.tx.front() });
+    synth.tx.pop_front();
+    txCredit -= 1;
+  }
+  if (synth.tx.empty() && txCredit > 1) txCredit = 1;
+  simNow++;
+}
+
+static bool loopbackRead(std::vector<uint8_t> &pending, uint32_t deadline) {
+  while (simNow < deadline) {
+    while (!toHost.empty() && toHost.front().first <= simNow) {
+      pending.push_back(toHost.front().second);
+      toHost.pop_front();
+    }
+    if (!pending.empty()) return true;
+    loopbackStep();
+  }
+  return false;
+}
+
+static uint32_t seed = 1;
+static uint32_t rnd(uint32_t range) {
+  seed = seed * 1664525 + 1013904223;
+  return (seed >> 8) % range;
+}
+
+static int runLoopback(const char *file, int argc, char **argv) {
+  uint32_t patchCount = 999;
+  for (int i = 0; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      fprintf(stderr, "%s needs a value\n", argv[i]);
+      return 2;
+    }
+    const char *value = argv[++i];
+    if (arg == "--patches") patchCount = atoi(value);
+    else if (arg == "--bytes-per-ms") bytesPerMs = atoi(value);
+    else if (arg == "--latency-us") latencyUs = atoi(value);
+    else if (arg == "--loop-us") loopUs = atoi(value);
+    else if (arg == "--tx-buffer") txBuffer = atoi(value);
+    else if (arg == "--chatter-ms") chatterMs = atoi(value);
+    else if (arg == "--seed") seed = atoi(value);
+    else {
+      fprintf(stderr, "Unknown option %s\n", argv[i - 1]);
+      return 2;
+    }
+  }
+  if (!bytesPerMs || bytesPerMs > 1000000 || !loopUs || !patchCount || patchCount > 999) {
+    fprintf(stderr, "bytes-per-ms goes from 1 to 1000000, loop-us starts at 1, patches goes from 1 to 999\n");
+    return 2;
+  }
+  loopback = true;
+
+  for (uint32_t n = 1; n <= patchCount; n++) {
+    std::vector<uint8_t> patch(USB_PATCH_PAYLOAD, 0);
+    putU16(patch.data(), n);
+    int length = 1 + rnd(USB_NAME_LEN - 1);
+    for (int i = 0; i < length; i++) patch[2 + i] = 'a' + rnd(26);
+    for (int i = 0; i < USB_PATCH_VALUES; i++) putU16(&patch[2 + USB_NAME_LEN + i * 2], rnd(1024));
+    synth.bank.push_back(patch);
+  }
+  synth.settings.resize(1 + 64);
+  for (uint8_t &b : synth.settings) b = rnd(256);
+  std::vector<std::vector<uint8_t>> bank = synth.bank;
+  std::vector<uint8_t> settings = synth.settings;
+
+  printf("Loopback at %u bytes/ms, %u us latency, loop() every %u us, %u byte transmit buffer\n", bytesPerMs,
+         latencyUs, loopUs, txBuffer);
+  int result = info();
+  if (!result) result = backup(file);
+  synth.bank.clear();
+  synth.settings.clear();
+  if (!result) result = restore(file);
+  if (result) return result;
+
+  bool same = synth.bank == bank && synth.settings == settings;
+  double frameUs = (USB_PATCH_PAYLOAD + USB_FRAME_OVERHEAD) * 1000.0 / bytesPerMs;
+  printf("Link limit %.3fs a bank streamed, about %.3fs acknowledged patch by patch\n", patchCount * frameUs / 1e6,
+         patchCount * (frameUs + 2 * latencyUs + loopUs / 2.0) / 1e6);
+  printf("Bank and settings %s after restore\n", same ? "the same" : "differ  FAIL");
+  return same ? 0 : 1;
+}
+
+int main(int argc, char **argv) {
+  if (argc < 3) {
+    fprintf(stderr, "usage: %s <port> info | backup <file> | restore <file>, or %s loopback <file> [options]\n", argv[0],
+            argv[0]);
+    return 2;
+  }
+  if (std::string(argv[1]) == "loopback") {
+    int result = runLoopback(argv[2], argc - 3, argv + 3);
+    if (parser.crcErrors()) fprintf(stderr, "%lu frames failed the CRC\n", parser.crcErrors());
+    return result;
+  }
+  if (!openPort(argv[1])) return 1;
+  std::string command = argv[2];
+  int result = 2;
+  if (command == "info") {
+    result = info();
+  } else if (command == "backup" && argc > 3) {
+    result = backup(argv[3]);
+  } else if (command == "restore" && argc > 3) {
+    result = restore(argv[3]);
+  } else {
+    fprintf(stderr, "Unknown command %s\n", command.c_str());
+  }
+  if (parser.crcErrors()) fprintf(stderr, "%lu frames failed the CRC\n", parser.crcErrors());
+  close(port);
+  return result;
+}
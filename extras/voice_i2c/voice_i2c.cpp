@@ -0,0 +1,212 @@
+/*
+  Voice board I2C link test, run on a PC against VoiceI2C.h with a mock bus as hal.i2c and a mock voice board.
+
+  Build:  g++ -O2 -std=c++11 -o voice_i2c voice_i2c.cpp
+          g++ -O2 -std=c++11 -DVOICE_I2C_DELTA -o voice_i2c_delta voice_i2c.cpp
+  Usage:  voice_i2c [options]
+
+  Options:
+    --steps N       edits to make (100000)
+    --error-pct N   transfers that fail, percent (2)
+    --busy-polls N  checkVoiceI2C() calls a transfer stays busy for, at most (3)
+    --seed N        random seed (1)
+
+  Each step edits a few values of one layer, or loads a whole new patch, and pushes that layer as
+  setCurrentPatchData() and the panel do. The mock bus keeps a transfer busy for a few polls and only
+  reads the frame buffer when it finishes, so a frame changed while it is on the wire shows up. Failed
+  transfers deliver nothing or a cut off frame. The mock board decodes frames into its own copy of both
+  layers, the way the voice board firmware has to. Without VOICE_I2C_DELTA it is the firmware already
+  in the field and counts a delta frame as a bad frame, with it the board takes delta frames too. After every few steps the bus is
+  left to go idle and the board must hold exactly what upperData and lowerData hold, unless the link
+  gave up on a layer after VOICE_RETRIES failed full frames in a row.
+*/
+
+#include "../host/HalMock.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+
+static int upperData[76], lowerData[76];
+
+static uint32_t seed = 1;
+static uint32_t rnd(uint32_t range) {
+  seed = seed * 1664525 + 1013904223;
+  return (seed >> 8) % range;
+}
+
+static uint32_t errorPct = 2, busyPolls = 3;
+
+//Transfers stay busy for a few polls like the i2c_driver asynchronous master, and some fail
+class MockBus : public HalI2c {
+  public:
+    void writeAsync(uint8_t address, const uint8_t *data, size_t size) override {
+      (void)address;
+      if (busy) {
+        printf("writeAsync while a transfer is running\n");
+        exit(1);
+      }
+      buffer = data;
+      length = size;
+      busy = true;
+      pollsLeft = rnd(busyPolls + 1);
+      transfers++;
+      bytes += size + 1;  //Address byte
+    }
+
+    bool finished() override {
+      if (!busy) return true;
+      if (pollsLeft) {
+        pollsLeft--;
+        return false;
+      }
+      busy = false;
+      error = rnd(100) < errorPct;
+      if (!error) {
+        deliver(buffer, length);
+      } else {
+        failures++;
+        if (rnd(2)) deliver(buffer, rnd(length));  //NAK part way through
+      }
+      return true;
+    }
+
+    bool failed() override {
+      return error;
+    }
+
+    const uint8_t *buffer = nullptr;
+    size_t length = 0;
+    bool busy = false;
+    bool error = false;
+    uint32_t pollsLeft = 0;
+    void (*deliver)(const uint8_t *data, size_t length) = nullptr;
+    unsigned long transfers = 0, bytes = 0, failures = 0;
+};
+
+static MockBus bus;
+
+#include "../../VoiceI2C.h"
+
+//The voice board's copy, index by layer flag
+static int board[2][VOICE_PARAMS];
+static bool boardLoaded[2] = { false, false };
+static unsigned long badFrames = 0;
+
+static int getWord(const uint8_t *p) {
+  return (int16_t)(p[0] << 8 | p[1]);
+}
+
+//Full frames start with the layer flag word, so their first byte is 0. Delta frames are applied a whole
+//run at a time, a cut off run is dropped.
+static void boardReceive(const uint8_t *data, size_t length) {
+  if (length == 0) return;
+  if (!(data[0] & VOICE_DELTA_FLAG)) {
+    if (length != VOICE_FULL_FRAME) return;  //Cut off, the board ignores short full frames
+    int layer = getWord(data);
+    if (layer != 0 && layer != 1) {
+      badFrames++;
+      return;
+    }
+    for (int i = 0; i < VOICE_PARAMS; i++) board[layer][i] = getWord(&data[i * 2]);
+    boardLoaded[layer] = true;
+    return;
+  }
+#ifndef VOICE_I2C_DELTA
+  badFrames++;
+  return;
+#endif
+  int layer = data[0] & 1;
+  size_t n = 1;
+  while (n + 2 <= length) {
+    int start = data[n], count = data[n + 1];
+    if (count == 0 || start + count > VOICE_PARAMS) {
+      badFrames++;
+      return;
+    }
+    if (n + 2 + count * 2 > length) return;
+    for (int k = 0; k < count; k++) board[layer][start + k] = getWord(&data[n + 2 + k * 2]);
+    n += 2 + count * 2;
+  }
+}
+
+static void edit(int layer) {
+  int *data = voiceLayerData(layer);
+  if (rnd(20) == 0) {
+    for (int i = 1; i < VOICE_PARAMS; i++) data[i] = rnd(1024);  //Patch recall
+  } else {
+    for (int edits = 1 + rnd(6); edits; edits--) data[1 + rnd(VOICE_PARAMS - 1)] = rnd(1024);
+  }
+  data[0] = layer;
+}
+
+//Poll until nothing is on the bus or waiting
+static void settle() {
+  while (voiceSendingLayer >= 0 || voicePushPending[0] || voicePushPending[1]) checkVoiceI2C();
+}
+
+//Layers the link gave up on after VOICE_RETRIES failures in a row are left for the next push
+static bool converged(unsigned long &gaveUp) {
+  for (int layer = 0; layer < 2; layer++) {
+    if (!voiceShadow[layer].valid && !boardLoaded[layer]) continue;  //Never pushed
+    if (voiceRetries[layer] > VOICE_RETRIES) {
+      gaveUp++;
+      continue;
+    }
+    if (memcmp(board[layer], voiceLayerData(layer), sizeof(board[layer])) != 0) return false;
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  uint32_t steps = 100000;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      fprintf(stderr, "%s needs a value\n", argv[i]);
+      return 1;
+    }
+    const char *value = argv[++i];
+    if (arg == "--steps") steps = atoi(value);
+    else if (arg == "--error-pct") errorPct = atoi(value);
+    else if (arg == "--busy-polls") busyPolls = atoi(value);
+    else if (arg == "--seed") seed = atoi(value);
+    else {
+      fprintf(stderr, "Unknown option %s\n", argv[i - 1]);
+      return 1;
+    }
+  }
+  bus.deliver = boardReceive;
+  hal.i2c = &bus;
+
+  unsigned long checks = 0, mismatches = 0, gaveUp = 0, pushes = 0;
+  for (uint32_t step = 0; step < steps; step++) {
+    int layer = rnd(2);
+    edit(layer);
+    pushVoiceLayer(layer);
+    pushes++;
+    for (int polls = rnd(3); polls; polls--) checkVoiceI2C();
+    if (rnd(4) == 0) {
+      settle();
+      checks++;
+      if (!converged(gaveUp)) {
+        mismatches++;
+        if (mismatches <= 5) printf("step %u: board differs from the layer data after settling\n", step);
+      }
+    }
+  }
+  settle();
+  checks++;
+  if (!converged(gaveUp)) mismatches++;
+
+  double fullBytes = (double)pushes * (VOICE_FULL_FRAME + 1);
+  printf("%lu pushes, %lu transfers (%lu full, %lu delta), %lu failed\n", pushes, bus.transfers, voiceFullFrames,
+         voiceDeltaFrames, bus.failures);
+  printf("%.1f bytes a transfer, %.0f%% of sending every push as a full frame, %.2f ms a transfer at 400kHz\n",
+         (double)bus.bytes / bus.transfers, bus.bytes * 100.0 / fullBytes, bus.bytes * 9 / 400.0 / bus.transfers);
+  printf("%lu convergence checks, %lu mismatches, %lu bad frames, gave up %lu times%s\n", checks, mismatches, badFrames,
+         gaveUp, mismatches || badFrames ? "  FAIL" : "");
+  return mismatches || badFrames ? 1 : 0;
+}
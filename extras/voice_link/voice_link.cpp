@@ -0,0 +1,241 @@
+/*
+  Voice link loopback test, run on a PC against VoiceLink.h with a stand-in voice board.
+
+  Build:  g++ -O2 -std=c++11 -o voice_link voice_link.cpp
+  Usage:  voice_link [options]
+
+  Options:
+    --seconds N     how long the controller keeps sending (10)
+    --param-us N    a parameter update every N us, a pot being swept (250)
+    --params N      parameters the updates go round, fewer means more replaced frames (8)
+    --layer-ms N    a whole layer in batches every N ms, a patch recall (200)
+    --ber N         byte error rate on both wires, a byte is corrupted or lost (0.0001)
+    --seed N        random seed (1)
+
+  Frames leave through hal.midiVoices onto a virtual VOICE_LINK_BAUD wire. The stand-in board splits
+  the SysEx out of the bytes that arrive, decodes them with VoiceLinkFrame.h, applies the values and
+  sends an acknowledgement back on a second wire to voiceLinkSysEx(). checkVoiceLink() runs every
+  millisecond like loop(). Each parameter counts up, so the board applying an older value after a
+  newer one has landed is counted as a revert. At the end the board must hold every last value, less
+  any frames the link reports dropped or overflowed.
+*/
+
+#include "../host/HalMock.h"
+#include "../../VoiceLink.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <string>
+#include <vector>
+
+#define BYTE_US (10000000 / VOICE_LINK_BAUD)  //10 bits a byte
+#define CHANNELS 3                            //1 lower, 2 upper
+#define PARAMS 128
+#define LAYER_PARAMS 76  //VOICE_PARAMS in VoiceI2C.h
+
+static uint32_t seed = 1;
+static uint32_t rnd(uint32_t range) {
+  seed = seed * 1664525 + 1013904223;
+  return (seed >> 8) % range;
+}
+
+static double ber = 0.0001;
+
+//One direction of the UART, a byte per BYTE_US with errors
+struct Wire {
+  std::deque<uint8_t> queue;
+  uint32_t busyUntil = 0;
+  unsigned long bytes = 0, errors = 0;
+
+  //A byte due now, false if the wire is idle or the byte was lost
+  bool next(uint32_t now, uint8_t &byte) {
+    if (queue.empty() || now < busyUntil) return false;
+    byte = queue.front();
+    queue.pop_front();
+    busyUntil = now + BYTE_US;
+    bytes++;
+    if (rnd(1000000) >= ber * 1000000) return true;
+    errors++;
+    switch (rnd(3)) {
+      case 0:
+        return false;
+      case 1:
+        byte ^= 1 << rnd(7);
+        return true;
+      default:
+        byte ^= 1 << rnd(8);  //Can turn a data byte into a status byte
+        return true;
+    }
+  }
+};
+
+//SysEx out of a MIDI byte stream, as the MIDI library does it for MIDI6
+struct SysexSplitter {
+  std::vector<uint8_t> message;
+  bool inside = false;
+
+  bool feed(uint8_t byte) {
+    if (byte >= 0xF8) return false;  //Real time can go anywhere
+    if (byte == 0xF0) {
+      message.assign(1, byte);
+      inside = true;
+      return false;
+    }
+    if (!inside) return false;
+    if (byte == 0xF7) {
+      message.push_back(byte);
+      inside = false;
+      return true;
+    }
+    if (byte & 0x80 || message.size() > VLINK_MAX_SYSEX) {
+      inside = false;
+      return false;
+    }
+    message.push_back(byte);
+    return false;
+  }
+};
+
+//What the controller last sent and what the board holds, index by space, channel and parameter
+static int want[2][CHANNELS][PARAMS];
+static int board[2][CHANNELS][PARAMS];
+static bool landed[2][CHANNELS][PARAMS];  //The board has had want since it was set
+static bool used[2][CHANNELS][PARAMS];
+static unsigned long reverts = 0, applied = 0, boardFrames = 0, boardBad = 0;
+static Wire down, up;
+static uint8_t boardSeq = 0;
+
+//Counts up for each parameter, so no value comes round again while an old frame could still be about
+static int newValue(int space, int channel, int param) {
+  return (want[space][channel][param] + 1) & 0x7FFF;
+}
+
+static void boardApply(int space, int channel, int param, int value) {
+  if (space > 1 || channel >= CHANNELS || param >= PARAMS) return;
+  board[space][channel][param] = value;
+  applied++;
+  if (value == want[space][channel][param]) {
+    landed[space][channel][param] = true;
+  } else if (landed[space][channel][param]) {
+    reverts++;
+  }
+}
+
+static void boardReceive(const std::vector<uint8_t> &sysex) {
+  uint8_t seq, type, payload[VLINK_MAX_PAYLOAD];
+  size_t len;
+  boardFrames++;
+  if (!decodeVoiceFrame(sysex.data(), sysex.size(), seq, type, payload, len)) {
+    boardBad++;
+    return;
+  }
+  if (type == VLINK_PARAM && len == 5) {
+    boardApply(payload[0], payload[1], payload[2], (int16_t)(payload[3] << 8 | payload[4]));
+  } else if (type == VLINK_BATCH && len >= 3) {
+    for (int i = 0; i < payload[2] && 3 + i * 3 + 2 < (int)len; i++) {
+      const uint8_t *p = &payload[3 + i * 3];
+      boardApply(payload[0], payload[1], p[0], (int16_t)(p[1] << 8 | p[2]));
+    }
+  }
+  uint8_t ack[VLINK_MAX_SYSEX];
+  size_t n = encodeVoiceFrame(boardSeq++, VLINK_ACK, &seq, 1, ack);
+  up.queue.insert(up.queue.end(), ack, ack + n);
+}
+
+static void sendParam(int channel, int param) {
+  int value = newValue(0, channel, param);
+  want[0][channel][param] = value;
+  landed[0][channel][param] = false;
+  used[0][channel][param] = true;
+  voiceLinkSendParam(VLINK_SPACE_CONTROL, channel, param, value);
+}
+
+static void sendLayer(int channel) {
+  int data[LAYER_PARAMS];
+  for (int i = 0; i < LAYER_PARAMS; i++) {
+    data[i] = newValue(1, channel, i);
+    want[1][channel][i] = data[i];
+    landed[1][channel][i] = false;
+    used[1][channel][i] = true;
+  }
+  voiceLinkSendLayer(channel, data, LAYER_PARAMS);
+}
+
+int main(int argc, char **argv) {
+  uint32_t seconds = 10, paramUs = 250, params = 8, layerMs = 200;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    if (i + 1 >= argc) {
+      fprintf(stderr, "%s needs a value\n", argv[i]);
+      return 1;
+    }
+    const char *value = argv[++i];
+    if (arg == "--seconds") seconds = atoi(value);
+    else if (arg == "--param-us") paramUs = atoi(value);
+    else if (arg == "--params") params = atoi(value);
+    else if (arg == "--layer-ms") layerMs = atoi(value);
+    else if (arg == "--ber") ber = atof(value);
+    else if (arg == "--seed") seed = atoi(value);
+    else {
+      fprintf(stderr, "Unknown option %s\n", argv[i - 1]);
+      return 1;
+    }
+  }
+  if (!seconds || !paramUs || !params || params > 2 * PARAMS || !layerMs) {
+    fprintf(stderr, "seconds, param-us, params and layer-ms start at 1, params goes to %d\n", 2 * PARAMS);
+    return 1;
+  }
+
+  voiceLinkBegin();
+  SysexSplitter boardIn, controllerIn;
+  uint32_t end = seconds * 1000000, settle = end + 1000000;
+  uint32_t nextParam = 0, nextLayer = 0, nextLoop = 0;
+  for (uint32_t now = 0; now < settle; now++) {
+    mockClock.now = now;
+    if (now < end && now >= nextParam) {
+      uint32_t key = rnd(params);
+      sendParam(1 + key % 2, key / 2);
+      nextParam += paramUs;
+    }
+    if (now < end && now >= nextLayer) {
+      sendLayer(1 + rnd(2));
+      nextLayer += layerMs * 1000;
+    }
+    if (now >= nextLoop) {
+      checkVoiceLink();
+      nextLoop += 1000;
+    }
+    down.queue.insert(down.queue.end(), mockMidiVoices.bytes.begin(), mockMidiVoices.bytes.end());
+    mockMidiVoices.bytes.clear();
+    uint8_t byte;
+    if (down.next(now, byte) && boardIn.feed(byte)) boardReceive(boardIn.message);
+    if (up.next(now, byte) && controllerIn.feed(byte)) voiceLinkSysEx(controllerIn.message.data(), controllerIn.message.size());
+  }
+
+  unsigned long mismatches = 0, keys = 0;
+  for (int s = 0; s < 2; s++) {
+    for (int c = 0; c < CHANNELS; c++) {
+      for (int p = 0; p < PARAMS; p++) {
+        if (!used[s][c][p]) continue;
+        keys++;
+        if (board[s][c][p] != want[s][c][p]) mismatches++;
+      }
+    }
+  }
+  const VoiceLinkStats &st = voiceLinkStats;
+  unsigned long lost = st.dropped + st.overflowed;
+  printf("%u s at %d baud, byte error rate %g, a parameter every %u us over %u, a layer every %u ms\n", seconds,
+         VOICE_LINK_BAUD, ber, paramUs, params, layerMs);
+  printf("down  %lu bytes, %.1f%% of the wire, %lu corrupted or lost\n", down.bytes, down.bytes * 100.0 * BYTE_US / settle,
+         down.errors);
+  printf("up    %lu bytes, %.1f%% of the wire, %lu corrupted or lost\n", up.bytes, up.bytes * 100.0 * BYTE_US / settle, up.errors);
+  printf("frames sent %lu, %.0f a second, resent %lu, superseded %lu, overflowed %lu, dropped %lu\n", st.sent,
+         st.sent / (double)seconds, st.resent, st.superseded, st.overflowed, st.dropped);
+  printf("board frames %lu, %.3f%% bad, %lu values applied, %.0f a second\n", boardFrames,
+         boardFrames ? boardBad * 100.0 / boardFrames : 0.0, applied, applied / (double)seconds);
+  printf("acks  %lu, %lu bad at the controller\n", st.acked, st.badFrames);
+  bool failed = reverts || mismatches > lost;
+  printf("%lu reverts, %lu of %lu parameters differ at the end%s\n", reverts, mismatches, keys, failed ? "  FAIL" : "");
+  return failed ? 1 : 0;
+}